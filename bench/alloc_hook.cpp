@@ -0,0 +1,132 @@
+/**
+ * @file alloc_hook.cpp
+ * @author 赵曦 (535394140@qq.com)
+ * @brief Heap allocation counters for the benchmarks
+ * @version 1.0
+ * @date 2023-03-08
+ *
+ * @copyright Copyright (c) 2023, zhaoxi
+ *
+ */
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include <malloc.h>
+
+#include "alloc_hook.hpp"
+
+extern "C"
+{
+    void *__libc_malloc(size_t size);
+    void *__libc_calloc(size_t n, size_t size);
+    void *__libc_realloc(void *ptr, size_t size);
+    void __libc_free(void *ptr);
+}
+
+namespace
+{
+
+std::atomic_bool tracking{false};
+std::atomic<uint64_t> c_allocs{0};
+std::atomic<uint64_t> cxx_allocs{0};
+std::atomic<uint64_t> frees{0};
+std::atomic<uint64_t> bytes{0};
+std::atomic<int64_t> live_bytes{0};
+
+inline void onAlloc(void *ptr, size_t size, std::atomic<uint64_t> &counter)
+{
+    if (ptr == nullptr || !tracking.load(std::memory_order_relaxed))
+        return;
+    counter.fetch_add(1, std::memory_order_relaxed);
+    bytes.fetch_add(size, std::memory_order_relaxed);
+    live_bytes.fetch_add(malloc_usable_size(ptr), std::memory_order_relaxed);
+}
+
+inline void onFree(void *ptr)
+{
+    if (ptr == nullptr || !tracking.load(std::memory_order_relaxed))
+        return;
+    frees.fetch_add(1, std::memory_order_relaxed);
+    live_bytes.fetch_sub(malloc_usable_size(ptr), std::memory_order_relaxed);
+}
+
+inline void *cxxAlloc(size_t size)
+{
+    void *ptr = __libc_malloc(size == 0 ? 1 : size);
+    if (ptr == nullptr)
+        throw std::bad_alloc();
+    onAlloc(ptr, size, cxx_allocs);
+    return ptr;
+}
+
+} // namespace
+
+extern "C"
+{
+
+void *malloc(size_t size)
+{
+    void *ptr = __libc_malloc(size);
+    onAlloc(ptr, size, c_allocs);
+    return ptr;
+}
+
+void *calloc(size_t n, size_t size)
+{
+    void *ptr = __libc_calloc(n, size);
+    onAlloc(ptr, n * size, c_allocs);
+    return ptr;
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    onFree(ptr);
+    void *new_ptr = __libc_realloc(ptr, size);
+    onAlloc(new_ptr, size, c_allocs);
+    return new_ptr;
+}
+
+void free(void *ptr)
+{
+    onFree(ptr);
+    __libc_free(ptr);
+}
+
+} // extern "C"
+
+void *operator new(size_t size) { return cxxAlloc(size); }
+void *operator new[](size_t size) { return cxxAlloc(size); }
+void operator delete(void *ptr) noexcept { free(ptr); }
+void operator delete[](void *ptr) noexcept { free(ptr); }
+void operator delete(void *ptr, size_t) noexcept { free(ptr); }
+void operator delete[](void *ptr, size_t) noexcept { free(ptr); }
+
+namespace bench
+{
+
+void startAllocCount()
+{
+    tracking = false;
+    c_allocs = 0;
+    cxx_allocs = 0;
+    frees = 0;
+    bytes = 0;
+    live_bytes = 0;
+    tracking = true;
+}
+
+AllocStats stopAllocCount()
+{
+    tracking = false;
+    AllocStats stats;
+    stats.c_allocs = c_allocs;
+    stats.cxx_allocs = cxx_allocs;
+    stats.frees = frees;
+    stats.bytes = bytes;
+    stats.live_bytes = live_bytes;
+    return stats;
+}
+
+} // namespace bench
@@ -0,0 +1,43 @@
+/**
+ * @file alloc_hook.hpp
+ * @author 赵曦 (535394140@qq.com)
+ * @brief Heap allocation counters for the benchmarks
+ * @version 1.0
+ * @date 2023-03-08
+ *
+ * @copyright Copyright (c) 2023, zhaoxi
+ *
+ */
+
+#pragma once
+
+#include <cstdint>
+
+namespace bench
+{
+
+/**
+ * @brief 堆内存分配统计
+ * @note 链接 alloc_hook.cpp 的可执行文件会替换 malloc 系列函数与全局 operator new，
+ *       open62541 经由 malloc 的分配与 C++ 的 operator new 分配会被分别统计。
+ *       不能与 AddressSanitizer 同时使用
+ */
+struct AllocStats
+{
+    uint64_t c_allocs = 0;   //!< malloc / calloc / realloc 次数 (包括 open62541 内部的分配)
+    uint64_t cxx_allocs = 0; //!< operator new 次数
+    uint64_t frees = 0;      //!< 释放次数
+    uint64_t bytes = 0;      //!< 申请的字节数
+    int64_t live_bytes = 0;  //!< 统计期间净增的堆内存字节数，持续增长说明存在泄漏
+
+    //! 分配总次数
+    inline uint64_t allocs() const { return c_allocs + cxx_allocs; }
+};
+
+//! 清零统计并开始统计当前进程中所有线程的堆内存分配
+void startAllocCount();
+
+//! 停止统计并返回统计结果
+AllocStats stopAllocCount();
+
+} // namespace bench
@@ -0,0 +1,181 @@
+/**
+ * @file bench_utility.hpp
+ * @author 赵曦 (535394140@qq.com)
+ * @brief Common utilities for the OPC UA benchmarks
+ * @version 1.0
+ * @date 2023-03-04
+ *
+ * @copyright Copyright (c) 2023, zhaoxi
+ *
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <numeric>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "asmpro/opcua_cs/client.hpp"
+#include "asmpro/opcua_cs/server.hpp"
+
+namespace bench
+{
+
+//! 分位数统计结果 (单位与样本一致)
+struct Summary
+{
+    std::size_t count = 0; //!< 样本数
+    double mean = 0;       //!< 均值
+    double min = 0;        //!< 最小值
+    double p50 = 0;        //!< 50% 分位数
+    double p90 = 0;        //!< 90% 分位数
+    double p99 = 0;        //!< 99% 分位数
+    double p999 = 0;       //!< 99.9% 分位数
+    double max = 0;        //!< 最大值
+};
+
+/**
+ * @brief 计算样本的分位数统计结果
+ *
+ * @param samples 样本，计算过程中会被排序
+ * @return 统计结果
+ */
+inline Summary summarize(std::vector<double> &samples)
+{
+    Summary s;
+    if (samples.empty())
+        return s;
+    std::sort(samples.begin(), samples.end());
+    auto at = [&](double q) { return samples[static_cast<std::size_t>(q * (samples.size() - 1))]; };
+    s.count = samples.size();
+    s.mean = std::accumulate(samples.begin(), samples.end(), 0.0) / samples.size();
+    s.min = samples.front();
+    s.p50 = at(0.5);
+    s.p90 = at(0.9);
+    s.p99 = at(0.99);
+    s.p999 = at(0.999);
+    s.max = samples.back();
+    return s;
+}
+
+//! 将统计结果转换为 JSON 对象
+inline std::string toJson(const Summary &s)
+{
+    std::ostringstream os;
+    os << "{\"count\": " << s.count << ", \"mean\": " << s.mean << ", \"min\": " << s.min
+       << ", \"p50\": " << s.p50 << ", \"p90\": " << s.p90 << ", \"p99\": " << s.p99
+       << ", \"p99.9\": " << s.p999 << ", \"max\": " << s.max << "}";
+    return os.str();
+}
+
+//! 单调时钟的当前时间 (单位：us)
+inline double nowMicros()
+{
+    using namespace std::chrono;
+    return duration<double, std::micro>(steady_clock::now().time_since_epoch()).count();
+}
+
+//! 当前进程消耗的 CPU 时间，包括用户态与内核态 (单位：s)
+inline double cpuSeconds()
+{
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+           (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1e-6;
+}
+
+/**
+ * @brief 指定进程消耗的 CPU 时间，包括用户态与内核态
+ * @note 从 /proc/<pid>/stat 中读取，用于统计服务器子进程的 CPU 占用
+ *
+ * @param pid 进程号
+ * @return CPU 时间 (单位：s)，读取失败时返回 0
+ */
+inline double processCpuSeconds(pid_t pid)
+{
+    FILE *fp = std::fopen(("/proc/" + std::to_string(pid) + "/stat").c_str(), "r");
+    if (fp == nullptr)
+        return 0;
+    char buf[1024] = {};
+    std::size_t len = std::fread(buf, 1, sizeof(buf) - 1, fp);
+    std::fclose(fp);
+    // 进程名可能包含空格，从最后一个 ')' 之后开始解析，utime、stime 分别为第 14、15 个字段
+    const char *p = std::strrchr(buf, ')');
+    if (len == 0 || p == nullptr)
+        return 0;
+    unsigned long utime = 0, stime = 0;
+    if (std::sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu", &utime, &stime) != 2)
+        return 0;
+    return static_cast<double>(utime + stime) / sysconf(_SC_CLK_TCK);
+}
+
+/**
+ * @brief 在子进程中启动回环服务器，返回时服务器已能够接受连接
+ * @note 必须在创建任何线程之前调用，子进程在 Server::run 返回后直接退出
+ *
+ * @param port 服务器端口号
+ * @param build_model 在 Server::init 之后、Server::run 之前执行的地址空间构建函数
+ * @param timeout_ms 等待服务器开始监听的最长时间 (单位：ms)
+ * @return 服务器进程号，启动失败时返回 -1
+ */
+inline pid_t spawnServer(UA_UInt16 port, const std::function<void()> &build_model, int timeout_ms = 5000)
+{
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        ua::Server::init(port);
+        build_model();
+        ua::Server::run();
+        _exit(0);
+    }
+    if (pid < 0)
+        return -1;
+    // 等待服务器开始监听
+    const std::string address = "opc.tcp://localhost:" + std::to_string(port);
+    for (int i = 0; i < timeout_ms / 50; ++i)
+    {
+        ua::Client probe;
+        if (probe.connect(address))
+            return pid;
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    kill(pid, SIGKILL);
+    waitpid(pid, nullptr, 0);
+    return -1;
+}
+
+//! 通知服务器进程退出并回收
+inline void stopServer(pid_t pid)
+{
+    if (pid <= 0)
+        return;
+    kill(pid, SIGINT);
+    waitpid(pid, nullptr, 0);
+}
+
+//! 将 JSON 结果写入文件，同时输出至标准输出
+inline void report(const std::string &json, const std::string &path)
+{
+    std::printf("%s\n", json.c_str());
+    if (path.empty())
+        return;
+    FILE *fp = std::fopen(path.c_str(), "w");
+    if (fp == nullptr)
+        return;
+    std::fprintf(fp, "%s\n", json.c_str());
+    std::fclose(fp);
+}
+
+} // namespace bench
@@ -0,0 +1,130 @@
+/**
+ * @file call_alloc_bench.cpp
+ * @author 赵曦 (535394140@qq.com)
+ * @brief Count the heap allocations and the retained memory of Client::call
+ * @version 1.0
+ * @date 2023-03-08
+ *
+ * @copyright Copyright (c) 2023, zhaoxi
+ *
+ */
+
+#include <cstdlib>
+
+#include "alloc_hook.hpp"
+#include "bench_utility.hpp"
+
+using namespace std;
+using namespace ua;
+
+static constexpr UA_UInt16 port = 4861;
+
+// 与 ua_server 中 VisionTrigger 方法相同的输入输出
+static UA_StatusCode visionTrigger(UA_Server *, const UA_NodeId *, void *, const UA_NodeId *, void *, const UA_NodeId *,
+                                   void *, size_t, const UA_Variant *, size_t, UA_Variant *output)
+{
+    double position[] = {1.1, 2.2};
+    UA_Variant_setArrayCopy(&output[0], position, 2, &UA_TYPES[UA_TYPES_DOUBLE]);
+    double angle = 3.3;
+    UA_Variant_setScalarCopy(&output[1], &angle, &UA_TYPES[UA_TYPES_DOUBLE]);
+    return UA_STATUSCODE_GOOD;
+}
+
+// 原样返回输入的字节串
+static UA_StatusCode echo(UA_Server *, const UA_NodeId *, void *, const UA_NodeId *, void *, const UA_NodeId *,
+                          void *, size_t, const UA_Variant *input, size_t, UA_Variant *output)
+{
+    return UA_Variant_copy(&input[0], &output[0]);
+}
+
+static void buildModel()
+{
+    vector<Argument> trigger_inputs, trigger_outputs;
+    trigger_inputs.reserve(3);
+    trigger_inputs.emplace_back("CameraIdx", "Index of the camera", &UA_TYPES[UA_TYPES_UINT16]);
+    trigger_inputs.emplace_back("ControllerIdx", "Index of the light controller", &UA_TYPES[UA_TYPES_UINT16]);
+    trigger_inputs.emplace_back("ChannelIdx", "Channel of the light controller", &UA_TYPES[UA_TYPES_BYTE]);
+    trigger_outputs.reserve(2);
+    trigger_outputs.emplace_back("TargetPosition", "Position of the target", &UA_TYPES[UA_TYPES_DOUBLE], 2);
+    trigger_outputs.emplace_back("TargetAngle", "Delta angle of the target", &UA_TYPES[UA_TYPES_DOUBLE]);
+    Server::addMethodNode("VisionTrigger", "Trigger the vision program", visionTrigger, trigger_inputs, trigger_outputs);
+
+    vector<Argument> echo_inputs, echo_outputs;
+    echo_inputs.emplace_back("Input", "Input bytes", &UA_TYPES[UA_TYPES_BYTESTRING]);
+    echo_outputs.emplace_back("Output", "Output bytes", &UA_TYPES[UA_TYPES_BYTESTRING]);
+    Server::addMethodNode("Echo", "Echo the input bytes", echo, echo_inputs, echo_outputs);
+}
+
+static string runCase(Client &client, const string &name, const UA_NodeId &method_id,
+                      const vector<Variable> &inputs, int iterations)
+{
+    // 预热，排除首次调用时建立内部缓存的分配
+    for (int i = 0; i < 10; ++i)
+    {
+        vector<Variable> outputs;
+        client.call(method_id, inputs, outputs);
+    }
+    vector<double> latency;
+    latency.reserve(iterations);
+    bench::startAllocCount();
+    for (int i = 0; i < iterations; ++i)
+    {
+        double begin = bench::nowMicros();
+        {
+            vector<Variable> outputs;
+            client.call(method_id, inputs, outputs);
+        }
+        latency.push_back(bench::nowMicros() - begin);
+    }
+    bench::AllocStats stats = bench::stopAllocCount();
+    ostringstream os;
+    os << "{\"case\": \"" << name << "\", \"iterations\": " << iterations
+       << ", \"allocs_per_call\": " << static_cast<double>(stats.allocs()) / iterations
+       << ", \"c_allocs_per_call\": " << static_cast<double>(stats.c_allocs) / iterations
+       << ", \"cxx_allocs_per_call\": " << static_cast<double>(stats.cxx_allocs) / iterations
+       << ", \"bytes_per_call\": " << static_cast<double>(stats.bytes) / iterations
+       << ", \"retained_bytes_per_call\": " << static_cast<double>(stats.live_bytes) / iterations
+       << ", \"latency_us\": " << bench::toJson(bench::summarize(latency)) << "}";
+    return os.str();
+}
+
+int main(int argc, char *argv[])
+{
+    int iterations = argc > 1 ? atoi(argv[1]) : 1000;
+    string out = argc > 2 ? argv[2] : "call_alloc_bench.json";
+
+    pid_t server = bench::spawnServer(port, buildModel);
+    if (server < 0)
+    {
+        printf("Failed to start the server on port %u\n", port);
+        return -1;
+    }
+    Client client;
+    client.connect("opc.tcp://localhost:" + to_string(port));
+    UA_NodeId objects_id = UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER);
+    UA_NodeId trigger_id = client.findNodeId(objects_id, 1, "VisionTrigger");
+    UA_NodeId echo_id = client.findNodeId(objects_id, 1, "Echo");
+
+    vector<string> results;
+    vector<Variable> trigger_inputs;
+    trigger_inputs.emplace_back(UA_UInt16(1));
+    trigger_inputs.emplace_back(UA_UInt16(0));
+    trigger_inputs.emplace_back(UA_Byte(2));
+    results.push_back(runCase(client, "VisionTrigger", trigger_id, trigger_inputs, iterations));
+    for (size_t size : {1UL, 1024UL, 640UL * 480UL * 3UL})
+    {
+        vector<UA_Byte> data(size, 0x5a);
+        UA_ByteString str{data.size(), data.data()};
+        vector<Variable> echo_inputs;
+        echo_inputs.emplace_back(&str, &UA_TYPES[UA_TYPES_BYTESTRING]);
+        results.push_back(runCase(client, "Echo_" + to_string(size) + "B", echo_id, echo_inputs, iterations));
+    }
+    client.disconnect();
+    bench::stopServer(server);
+
+    string json = "{\"benchmark\": \"call_alloc\", \"results\": [";
+    for (size_t i = 0; i < results.size(); ++i)
+        json += (i == 0 ? "" : ", ") + results[i];
+    bench::report(json + "]}", out);
+    return 0;
+}
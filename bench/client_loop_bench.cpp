@@ -0,0 +1,138 @@
+/**
+ * @file client_loop_bench.cpp
+ * @author 赵曦 (535394140@qq.com)
+ * @brief Compare the CPU usage, notification latency and foreground request latency of the
+ *        busy-spinning runIterate(0) loop and the background event loop of ua::Client
+ * @version 1.0
+ * @date 2023-03-04
+ *
+ * @copyright Copyright (c) 2023, zhaoxi
+ *
+ */
+
+#include <atomic>
+#include <cstdlib>
+#include <mutex>
+
+#include "bench_utility.hpp"
+
+using namespace std;
+using namespace ua;
+
+static constexpr UA_UInt16 port = 4860;
+
+static mutex samples_mtx;
+static vector<double> samples; // 通知延迟 (单位：us)
+
+// 服务器端周期性写入当前时间
+static void writeTick(UA_NodeId tick_id, int period_ms)
+{
+    while (true)
+    {
+        this_thread::sleep_for(chrono::milliseconds(period_ms));
+        Server::writeVariable(tick_id, UA_DateTime_now());
+    }
+}
+
+static void tickChange(UA_UInt32, const UA_DataValue &value)
+{
+    if (!UA_Variant_hasScalarType(&value.value, &UA_TYPES[UA_TYPES_DATETIME]))
+        return;
+    UA_DateTime tick = *static_cast<UA_DateTime *>(value.value.data);
+    double latency = static_cast<double>(UA_DateTime_now() - tick) / UA_DATETIME_USEC;
+    lock_guard<mutex> lk(samples_mtx);
+    samples.push_back(latency);
+}
+
+/**
+ * @brief 事件循环运行期间在前台线程中周期性读取变量，模拟与订阅并行的业务请求
+ *
+ * @param client 客户端
+ * @param node_id 读取的变量
+ * @param seconds 持续时间 (单位：s)
+ * @return 单次读取的耗时 (单位：us)
+ */
+static vector<double> foregroundReads(Client &client, const UA_NodeId &node_id, int seconds)
+{
+    vector<double> latency;
+    auto end = chrono::steady_clock::now() + chrono::seconds(seconds);
+    while (chrono::steady_clock::now() < end)
+    {
+        // 两次请求之间留出空闲，使事件循环处于等待网络数据的状态
+        this_thread::sleep_for(chrono::milliseconds(7));
+        double begin = bench::nowMicros();
+        client.readVariable(node_id);
+        latency.push_back(bench::nowMicros() - begin);
+    }
+    return latency;
+}
+
+static string runMode(const string &mode, int seconds, UA_UInt32 timeout)
+{
+    Client client;
+    client.connect("opc.tcp://localhost:" + to_string(port));
+    UA_NodeId tick_id = client.findNodeId(UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER), 1, "Tick");
+    // 以服务器允许的最快速率采样、发布，使延迟尽可能反映事件循环本身
+    UA_UInt32 sub_id = client.createSubscription(0.0);
+    client.createVariableMonitors(sub_id, {tick_id}, {tickChange}, 0.0);
+    {
+        lock_guard<mutex> lk(samples_mtx);
+        samples.clear();
+    }
+
+    vector<double> foreground;
+    double cpu_begin = bench::cpuSeconds();
+    double wall_begin = bench::nowMicros();
+    if (mode == "spin")
+    {
+        atomic_bool running{true};
+        thread spin([&]() {
+            while (running)
+                client.runIterate(0);
+        });
+        foreground = foregroundReads(client, tick_id, seconds);
+        running = false;
+        spin.join();
+    }
+    else
+    {
+        client.start(timeout);
+        foreground = foregroundReads(client, tick_id, seconds);
+        client.stop();
+    }
+    double cpu = bench::cpuSeconds() - cpu_begin;
+    double wall = (bench::nowMicros() - wall_begin) * 1e-6;
+
+    lock_guard<mutex> lk(samples_mtx);
+    ostringstream os;
+    os << "{\"mode\": \"" << mode << "\", \"cpu_percent\": " << 100.0 * cpu / wall
+       << ", \"latency_us\": " << bench::toJson(bench::summarize(samples))
+       << ", \"foreground_read_us\": " << bench::toJson(bench::summarize(foreground)) << "}";
+    return os.str();
+}
+
+int main(int argc, char *argv[])
+{
+    int seconds = argc > 1 ? atoi(argv[1]) : 10;
+    int period_ms = argc > 2 ? atoi(argv[2]) : 20;
+    UA_UInt32 timeout = argc > 3 ? static_cast<UA_UInt32>(atoi(argv[3])) : 100;
+    string out = argc > 4 ? argv[4] : "client_loop_bench.json";
+
+    pid_t server = bench::spawnServer(port, [period_ms]() {
+        UA_NodeId tick_id = Server::addVariableNode("Tick", "Time tick of the server", UA_DateTime_now());
+        thread(writeTick, tick_id, period_ms).detach();
+    });
+    if (server < 0)
+    {
+        printf("Failed to start the server on port %u\n", port);
+        return -1;
+    }
+    string spin = runMode("spin", seconds, timeout);
+    string loop = runMode("background", seconds, timeout);
+    bench::stopServer(server);
+
+    bench::report("{\"benchmark\": \"client_loop\", \"period_ms\": " + to_string(period_ms) +
+                      ", \"timeout_ms\": " + to_string(timeout) + ", \"results\": [" + spin + ", " + loop + "]}",
+                  out);
+    return 0;
+}
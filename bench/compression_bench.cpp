@@ -0,0 +1,240 @@
+/**
+ * @file compression_bench.cpp
+ * @author 赵曦 (535394140@qq.com)
+ * @brief Compression ratio against CPU cost per frame, and bandwidth of subscribers to raw and compressed images
+ * @version 1.0
+ * @date 2023-03-20
+ *
+ * @copyright Copyright (c) 2023, zhaoxi
+ *
+ */
+
+#include <atomic>
+#include <cstring>
+#include <cstdlib>
+#include <fstream>
+#include <random>
+
+#include "asmpro/opcua_cs/compression.hpp"
+#include "bench_utility.hpp"
+
+using namespace std;
+using namespace ua;
+
+static constexpr UA_UInt16 port = 4871;
+static constexpr UA_UInt32 width = 640;
+static constexpr UA_UInt32 height = 480;
+static constexpr size_t frame_size = size_t(width) * height * 3;
+
+//! 测试的图像内容
+static vector<pair<string, vector<UA_Byte>>> contents(const string &raw_file)
+{
+    vector<pair<string, vector<UA_Byte>>> retval;
+    mt19937 rng(42);
+    // 均匀背景，压缩的上限
+    retval.emplace_back("uniform", vector<UA_Byte>(frame_size, 128));
+    // 平滑渐变叠加传感器噪声，接近工业相机拍摄的实际图像
+    vector<UA_Byte> gradient(frame_size);
+    normal_distribution<double> noise(0, 2);
+    for (size_t y = 0; y < height; ++y)
+        for (size_t x = 0; x < width; ++x)
+            for (size_t c = 0; c < 3; ++c)
+            {
+                double v = 64 + 96.0 * x / width + 48.0 * y / height + 16 * c + noise(rng);
+                gradient[(y * width + x) * 3 + c] = static_cast<UA_Byte>(min(max(v, 0.0), 255.0));
+            }
+    retval.emplace_back("gradient_noise", std::move(gradient));
+    // 随机数据，压缩的下限
+    vector<UA_Byte> random(frame_size);
+    for (auto &b : random)
+        b = static_cast<UA_Byte>(rng());
+    retval.emplace_back("random", std::move(random));
+    // 实际拍摄的原始 BGR888 图像
+    if (!raw_file.empty())
+    {
+        ifstream ifs(raw_file, ios::binary);
+        vector<UA_Byte> raw((istreambuf_iterator<char>(ifs)), istreambuf_iterator<char>());
+        if (!raw.empty())
+            retval.emplace_back(raw_file, std::move(raw));
+    }
+    return retval;
+}
+
+//! 测试的压缩参数
+static vector<Compression> codecs()
+{
+    vector<Compression> retval;
+    for (Codec codec : {Codec::Deflate, Codec::DeltaDeflate})
+        for (int level : {1, 6})
+        {
+            Compression options;
+            options.codec = codec;
+            options.level = level;
+            retval.push_back(options);
+        }
+    return retval;
+}
+
+//! 压缩与还原一帧所需的时间以及压缩率
+static string kernelResult(const string &name, const vector<UA_Byte> &content, const Compression &options,
+                           int iterations)
+{
+    UA_Variant value;
+    UA_Variant_setArray(&value, const_cast<UA_Byte *>(content.data()), content.size(), &UA_TYPES[UA_TYPES_BYTE]);
+    vector<UA_Byte> out, scratch;
+    vector<double> encode, decode;
+    encode.reserve(iterations);
+    decode.reserve(iterations);
+    bool ok = true;
+    for (int i = 0; i < iterations && ok; ++i)
+    {
+        double t0 = bench::nowMicros();
+        ok = compressValue(value, options, out, scratch);
+        encode.push_back(bench::nowMicros() - t0);
+        UA_ByteString str{out.size(), out.data()};
+        UA_Variant compressed;
+        UA_Variant_init(&compressed);
+        UA_Variant_setScalarCopy(&compressed, &str, &UA_TYPES[UA_TYPES_BYTESTRING]);
+        t0 = bench::nowMicros();
+        ok = ok && decompressValue(compressed, options.codec);
+        decode.push_back(bench::nowMicros() - t0);
+        ok = ok && compressed.arrayLength == content.size() &&
+             memcmp(compressed.data, content.data(), content.size()) == 0;
+        UA_Variant_clear(&compressed);
+    }
+    ostringstream os;
+    os << "{\"content\": \"" << name << "\", \"codec\": \"" << options.describe() << "\", \"ok\": "
+       << (ok ? "true" : "false") << ", \"raw_bytes\": " << content.size() << ", \"compressed_bytes\": " << out.size()
+       << ", \"ratio\": " << double(content.size()) / max<size_t>(out.size(), 1)
+       << ", \"encode_us\": " << bench::toJson(bench::summarize(encode))
+       << ", \"decode_us\": " << bench::toJson(bench::summarize(decode)) << "}";
+    return os.str();
+}
+
+static vector<UA_Byte> frame;
+static UA_NodeId image_id;
+static size_t frame_seq = 0;
+static double fps = 30;
+
+// 以固定帧率写入图像，每帧平移一列像素以触发数据变更
+static void writeFrame(UA_Server *, void *)
+{
+    static vector<UA_Byte> shifted(frame.size());
+    size_t offset = (++frame_seq % width) * 3;
+    memcpy(shifted.data(), frame.data() + offset, frame.size() - offset);
+    memcpy(shifted.data() + frame.size() - offset, frame.data(), offset);
+    Server::writeVariable(image_id, Variable(shifted.data(), &UA_TYPES[UA_TYPES_BYTE], shifted.size()),
+                          UA_DateTime_now());
+}
+
+// 由客户端调用以开始产生图像
+static UA_StatusCode startFrames(UA_Server *server, const UA_NodeId *, void *, const UA_NodeId *, void *,
+                                 const UA_NodeId *, void *, size_t, const UA_Variant *, size_t, UA_Variant *)
+{
+    return UA_Server_addRepeatedCallback(server, writeFrame, nullptr, 1000.0 / fps, nullptr);
+}
+
+static void buildModel()
+{
+    image_id = Server::addVariableNode("Image", "Image of the camera",
+                                       Variable(frame.data(), &UA_TYPES[UA_TYPES_BYTE], frame.size()));
+    Server::addCompressedVariable("ImageCompressed", "Compressed image of the camera", image_id);
+    Server::addMethodNode("StartFrames", "Start writing frames", startFrames, null_args, null_args);
+}
+
+//! 订阅指定变量一段时间，统计收到的帧数、线路上的字节数以及两端的 CPU 占用
+static string subscribeResult(pid_t server, const string &name, double seconds)
+{
+    Client client;
+    client.connect("opc.tcp://localhost:" + to_string(port));
+    UA_NodeId node_id = client.findNodeId(UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER), 1, name);
+    // 压缩参数由压缩变量的 Codec 属性给出
+    string codec = "none";
+    if (name != "Image")
+    {
+        Variable val = client.readVariable(client.findNodeId(node_id, 1, "Codec"));
+        if (UA_Variant_hasScalarType(&val.get(), &UA_TYPES[UA_TYPES_STRING]))
+        {
+            auto str = static_cast<const UA_String *>(val.get().data);
+            codec.assign(reinterpret_cast<const char *>(str->data), str->length);
+        }
+    }
+    atomic<UA_UInt64> frames{0}, raw_bytes{0};
+    UA_UInt32 sub_id = client.createSubscription(1000.0 / fps);
+    client.createVariableMonitors(sub_id, {node_id}, {[&](UA_UInt32, const UA_DataValue &value) {
+                                      ++frames;
+                                      raw_bytes += value.value.arrayLength;
+                                  }},
+                                  1000.0 / fps);
+    double server_cpu = bench::processCpuSeconds(server);
+    double client_cpu = bench::cpuSeconds();
+    client.start(10);
+    this_thread::sleep_for(chrono::duration<double>(seconds));
+    client.stop();
+    server_cpu = bench::processCpuSeconds(server) - server_cpu;
+    client_cpu = bench::cpuSeconds() - client_cpu;
+    // 客户端透明地还原压缩变量，线路上的字节数由本地以默认参数压缩同一帧的大小估算
+    size_t wire_bytes = frame.size();
+    if (name != "Image")
+    {
+        UA_Variant value;
+        UA_Variant_setArray(&value, frame.data(), frame.size(), &UA_TYPES[UA_TYPES_BYTE]);
+        vector<UA_Byte> compressed, scratch;
+        if (compressValue(value, Compression(), compressed, scratch))
+            wire_bytes = compressed.size();
+    }
+    client.disconnect();
+
+    ostringstream os;
+    os << "{\"variable\": \"" << name << "\", \"codec\": \"" << codec << "\", \"frames_per_s\": " << frames / seconds
+       << ", \"decoded_kbytes_per_s\": " << raw_bytes / seconds / 1024
+       << ", \"wire_kbytes_per_s\": " << frames * wire_bytes / seconds / 1024 << ", \"server_cpu_s\": " << server_cpu
+       << ", \"client_cpu_s\": " << client_cpu << "}";
+    return os.str();
+}
+
+int main(int argc, char *argv[])
+{
+    // compression_bench [out] [fps] [seconds] [iterations] [raw_bgr_file]
+    string out = argc > 1 ? argv[1] : "compression_bench.json";
+    fps = argc > 2 ? atof(argv[2]) : 30;
+    double seconds = argc > 3 ? atof(argv[3]) : 5;
+    int iterations = argc > 4 ? atoi(argv[4]) : 100;
+    string raw_file = argc > 5 ? argv[5] : "";
+
+    auto images = contents(raw_file);
+    vector<string> kernels;
+    for (auto &[name, content] : images)
+        for (auto &options : codecs())
+            kernels.push_back(kernelResult(name, content, options, iterations));
+
+    // 订阅测试使用渐变叠加噪声的图像
+    frame = images[1].second;
+    pid_t server = bench::spawnServer(port, buildModel);
+    if (server < 0)
+    {
+        printf("Failed to start the server on port %u\n", port);
+        return -1;
+    }
+    {
+        Client client;
+        client.connect("opc.tcp://localhost:" + to_string(port));
+        vector<Variable> outputs;
+        client.call(client.findNodeId(UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER), 1, "StartFrames"), {}, outputs);
+        client.disconnect();
+    }
+    // 每次只有一个订阅者，服务器的 CPU 时间包括写入图像与压缩
+    vector<string> subscribers;
+    subscribers.push_back(subscribeResult(server, "Image", seconds));
+    subscribers.push_back(subscribeResult(server, "ImageCompressed", seconds));
+    bench::stopServer(server);
+
+    string json = "{\"benchmark\": \"compression\", \"fps\": " + to_string(fps) + ", \"kernels\": [";
+    for (size_t i = 0; i < kernels.size(); ++i)
+        json += (i == 0 ? "" : ", ") + kernels[i];
+    json += "], \"subscribers\": [";
+    for (size_t i = 0; i < subscribers.size(); ++i)
+        json += (i == 0 ? "" : ", ") + subscribers[i];
+    bench::report(json + "]}", out);
+    return 0;
+}
@@ -0,0 +1,146 @@
+/**
+ * @file delta_bench.cpp
+ * @author 赵曦 (535394140@qq.com)
+ * @brief Bandwidth and end-to-end latency of subscribers to full frames against dirty-tile deltas
+ * @version 1.0
+ * @date 2023-03-21
+ *
+ * @copyright Copyright (c) 2023, zhaoxi
+ *
+ */
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+
+#include "asmpro/opcua_cs/frame_delta.hpp"
+#include "bench_utility.hpp"
+
+using namespace std;
+using namespace ua;
+
+static constexpr UA_UInt16 port = 4872;
+static constexpr UA_UInt32 width = 640;
+static constexpr UA_UInt32 height = 480;
+
+static vector<UA_Byte> frame(size_t(width) * height * 3);
+static UA_NodeId image_id;
+static size_t frame_seq = 0;
+static double fps = 30;
+static UA_UInt32 object_size = 64;
+
+// 静止的背景上有一个移动的方块，模拟传送带上的工件
+static void writeFrame(UA_Server *, void *)
+{
+    static vector<UA_Byte> background = frame;
+    frame = background;
+    size_t x0 = (frame_seq * 8) % (width - object_size), y0 = (height - object_size) / 2;
+    for (size_t y = y0; y < y0 + object_size; ++y)
+        memset(frame.data() + (y * width + x0) * 3, static_cast<int>(frame_seq & 0xFF), object_size * 3);
+    ++frame_seq;
+    Server::writeVariable(image_id, Variable(frame.data(), &UA_TYPES[UA_TYPES_BYTE], frame.size()),
+                          UA_DateTime_now());
+}
+
+// 由客户端调用以开始产生图像
+static UA_StatusCode startFrames(UA_Server *server, const UA_NodeId *, void *, const UA_NodeId *, void *,
+                                 const UA_NodeId *, void *, size_t, const UA_Variant *, size_t, UA_Variant *)
+{
+    return UA_Server_addRepeatedCallback(server, writeFrame, nullptr, 1000.0 / fps, nullptr);
+}
+
+static void buildModel()
+{
+    for (size_t i = 0; i < frame.size(); ++i)
+        frame[i] = static_cast<UA_Byte>(i / 3 % 251);
+    image_id = Server::addVariableNode("Image", "Image of the camera",
+                                       Variable(frame.data(), &UA_TYPES[UA_TYPES_BYTE], frame.size()));
+    Server::addDeltaVariable("ImageDelta", "Dirty-tile delta of the image", image_id);
+    Server::addMethodNode("StartFrames", "Start writing frames", startFrames, null_args, null_args);
+}
+
+//! 订阅指定变量一段时间，统计帧率、线路上的字节数、端到端延迟以及两端的 CPU 占用
+static string subscribeResult(pid_t server, const string &name, double seconds)
+{
+    Client client;
+    client.connect("opc.tcp://localhost:" + to_string(port));
+    UA_NodeId node_id = client.findNodeId(UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER), 1, name);
+    bool delta = name != "Image";
+    DeltaAssembler assembler;
+    mutex mtx;
+    vector<double> latency;
+    latency.reserve(static_cast<size_t>(fps * seconds * 2));
+    atomic<UA_UInt64> frames{0}, bytes{0};
+    UA_UInt32 sub_id = client.createSubscription(1000.0 / fps);
+    // 采样间隔为 0 时每次写入都会被采样，差分不会在服务器端被合并
+    client.createVariableMonitors(sub_id, {node_id}, {[&](UA_UInt32, const UA_DataValue &value) {
+                                      if (delta)
+                                      {
+                                          if (UA_Variant_hasScalarType(&value.value, &UA_TYPES[UA_TYPES_BYTESTRING]))
+                                              bytes += static_cast<const UA_ByteString *>(value.value.data)->length;
+                                          if (!assembler.apply(value.value))
+                                              return;
+                                      }
+                                      else
+                                          bytes += value.value.arrayLength;
+                                      ++frames;
+                                      lock_guard<mutex> lk(mtx);
+                                      latency.push_back((UA_DateTime_now() - value.sourceTimestamp) / 10.0);
+                                  }},
+                                  0, 8);
+    double server_cpu = bench::processCpuSeconds(server);
+    double client_cpu = bench::cpuSeconds();
+    client.start(10);
+    this_thread::sleep_for(chrono::duration<double>(seconds));
+    client.stop();
+    server_cpu = bench::processCpuSeconds(server) - server_cpu;
+    client_cpu = bench::cpuSeconds() - client_cpu;
+    client.disconnect();
+
+    ostringstream os;
+    os << "{\"variable\": \"" << name << "\", \"frames_per_s\": " << frames / seconds
+       << ", \"wire_kbytes_per_s\": " << bytes / seconds / 1024 << ", \"latency_us\": "
+       << bench::toJson(bench::summarize(latency)) << ", \"server_cpu_s\": " << server_cpu
+       << ", \"client_cpu_s\": " << client_cpu;
+    if (delta)
+        os << ", \"gaps\": " << assembler.gaps() << ", \"discarded\": " << assembler.discarded();
+    os << "}";
+    return os.str();
+}
+
+int main(int argc, char *argv[])
+{
+    // delta_bench [out] [fps] [seconds] [object_size]
+    string out = argc > 1 ? argv[1] : "delta_bench.json";
+    fps = argc > 2 ? atof(argv[2]) : 30;
+    double seconds = argc > 3 ? atof(argv[3]) : 5;
+    object_size = argc > 4 ? static_cast<UA_UInt32>(atoi(argv[4])) : 64;
+    object_size = min(max<UA_UInt32>(object_size, 1), height);
+
+    pid_t server = bench::spawnServer(port, buildModel);
+    if (server < 0)
+    {
+        printf("Failed to start the server on port %u\n", port);
+        return -1;
+    }
+    {
+        Client client;
+        client.connect("opc.tcp://localhost:" + to_string(port));
+        vector<Variable> outputs;
+        client.call(client.findNodeId(UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER), 1, "StartFrames"), {}, outputs);
+        client.disconnect();
+    }
+    // 每次只有一个订阅者，服务器的 CPU 时间包括写入图像与差分编码
+    vector<string> subscribers;
+    subscribers.push_back(subscribeResult(server, "Image", seconds));
+    subscribers.push_back(subscribeResult(server, "ImageDelta", seconds));
+    bench::stopServer(server);
+
+    string json = "{\"benchmark\": \"delta\", \"fps\": " + to_string(fps) +
+                  ", \"object_size\": " + to_string(object_size) + ", \"subscribers\": [";
+    for (size_t i = 0; i < subscribers.size(); ++i)
+        json += (i == 0 ? "" : ", ") + subscribers[i];
+    bench::report(json + "]}", out);
+    return 0;
+}
@@ -0,0 +1,142 @@
+/**
+ * @file history_bench.cpp
+ * @author 赵曦 (535394140@qq.com)
+ * @brief History ingest rate and HistoryRead range-query latency over the ring and the spill segments
+ * @version 1.0
+ * @date 2023-03-22
+ *
+ * @copyright Copyright (c) 2023, zhaoxi
+ *
+ */
+
+#include <cstdlib>
+
+#include "bench_utility.hpp"
+
+using namespace std;
+using namespace ua;
+
+static constexpr UA_UInt16 port = 4876;
+
+//! 样本间隔 10 ms，父进程与服务器子进程使用相同的起始时刻
+static const UA_DateTime t0 = UA_DateTime_now();
+static constexpr UA_DateTime step = 10 * UA_DATETIME_MSEC;
+
+static size_t samples = 200000;
+static HistoryOptions options;
+
+//! 以固定间隔的源时间戳生成 Double 样本
+static UA_DataValue makeSample(double &x, size_t i)
+{
+    UA_DataValue value;
+    UA_DataValue_init(&value);
+    UA_Variant_setScalar(&value.value, &x, &UA_TYPES[UA_TYPES_DOUBLE]);
+    value.hasValue = true;
+    value.sourceTimestamp = t0 + static_cast<UA_DateTime>(i) * step;
+    value.hasSourceTimestamp = true;
+    return value;
+}
+
+//! 直接向历史数据存储追加样本，返回每秒追加的样本数
+static string ingestResult(const string &mode, const HistoryOptions &opts)
+{
+    HistoryBuffer history(opts);
+    double x = 0;
+    double begin = bench::nowMicros();
+    for (size_t i = 0; i < samples; ++i)
+    {
+        x += 1;
+        history.append(makeSample(x, i));
+    }
+    double seconds = (bench::nowMicros() - begin) / 1e6;
+    ostringstream os;
+    os << "{\"mode\": \"" << mode << "\", \"samples\": " << samples << ", \"samples_per_s\": " << samples / seconds
+       << ", \"kept\": " << history.size() << ", \"spilled\": " << history.spilled()
+       << ", \"dropped\": " << history.dropped() << "}";
+    return os.str();
+}
+
+static void buildModel()
+{
+    double x = 0;
+    UA_NodeId node_id = Server::addVariableNode("Trend", "Historized trend signal", Variable(x));
+    Server::enableHistory(node_id, options);
+    // 经由服务器的写入路径写入，最新的 capacity 个样本位于内存中，其余位于溢出段
+    for (size_t i = 0; i < samples; ++i)
+    {
+        x += 1;
+        Server::writeVariable(node_id, Variable(x), t0 + static_cast<UA_DateTime>(i) * step);
+    }
+}
+
+//! 重复读取指定位置、指定长度的时间范围，统计单次 readHistory 的总延迟
+static string queryResult(Client &client, const UA_NodeId &node_id, const string &region, size_t first, size_t count,
+                          UA_UInt32 chunk, size_t repeats)
+{
+    vector<double> latency;
+    size_t values = 0, chunks = 0;
+    for (size_t r = 0; r < repeats; ++r)
+    {
+        values = chunks = 0;
+        double begin = bench::nowMicros();
+        client.readHistory(node_id, t0 + static_cast<UA_DateTime>(first) * step,
+                           t0 + static_cast<UA_DateTime>(first + count) * step, [&](const UA_DataValue *, size_t size) {
+                               values += size;
+                               ++chunks;
+                               return true;
+                           },
+                           chunk);
+        latency.push_back(bench::nowMicros() - begin);
+    }
+    ostringstream os;
+    os << "{\"region\": \"" << region << "\", \"range\": " << count << ", \"values\": " << values
+       << ", \"chunks\": " << chunks << ", \"latency_us\": " << bench::toJson(bench::summarize(latency)) << "}";
+    return os.str();
+}
+
+int main(int argc, char *argv[])
+{
+    // history_bench [out] [samples] [capacity] [segment_mb]
+    string out = argc > 1 ? argv[1] : "history_bench.json";
+    samples = argc > 2 ? static_cast<size_t>(atoi(argv[2])) : 200000;
+    options.capacity = argc > 3 ? static_cast<size_t>(atoi(argv[3])) : 10000;
+    options.segment_size = (argc > 4 ? static_cast<size_t>(atoi(argv[4])) : 64) << 20;
+
+    vector<string> ingest;
+    HistoryOptions ring_only = options;
+    ring_only.segment_size = 0;
+    ingest.push_back(ingestResult("ring", ring_only));
+    ingest.push_back(ingestResult("spill", options));
+
+    pid_t server = bench::spawnServer(port, buildModel, 60000);
+    if (server < 0)
+    {
+        printf("Failed to start the server on port %u\n", port);
+        return -1;
+    }
+    Client client;
+    client.connect("opc.tcp://localhost:" + to_string(port));
+    UA_NodeId node_id = client.findNodeId(UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER), 1, "Trend");
+    vector<string> queries;
+    for (size_t count : {100, 1000, 10000})
+    {
+        if (count > samples)
+            continue;
+        // 最旧的样本位于溢出段，最新的样本位于内存环形缓冲区
+        queries.push_back(queryResult(client, node_id, "segment", 0, count, 1000, 50));
+        queries.push_back(queryResult(client, node_id, "ring", samples - count, count, 1000, 50));
+    }
+    client.disconnect();
+    bench::stopServer(server);
+
+    string json = "{\"benchmark\": \"history\", \"samples\": " + to_string(samples) +
+                  ", \"capacity\": " + to_string(options.capacity) +
+                  ", \"segment_bytes\": " + to_string(options.segment_size) + ", \"ingest\": [";
+    for (size_t i = 0; i < ingest.size(); ++i)
+        json += (i == 0 ? "" : ", ") + ingest[i];
+    json += "], \"queries\": [";
+    for (size_t i = 0; i < queries.size(); ++i)
+        json += (i == 0 ? "" : ", ") + queries[i];
+    bench::report(json + "]}", out);
+    return 0;
+}
@@ -0,0 +1,182 @@
+/**
+ * @file latency_bench.cpp
+ * @author 赵曦 (535394140@qq.com)
+ * @brief Warm read, write, call and subscription latency of ua::Client against
+ *        a loopback ua::Server across payload sizes
+ * @version 1.0
+ * @date 2023-03-10
+ *
+ * @copyright Copyright (c) 2023, zhaoxi
+ *
+ */
+
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+
+#include "bench_utility.hpp"
+
+using namespace std;
+using namespace ua;
+
+static constexpr UA_UInt16 port = 4862;
+
+// 原样返回输入的字节串
+static UA_StatusCode echo(UA_Server *, const UA_NodeId *, void *, const UA_NodeId *, void *, const UA_NodeId *,
+                          void *, size_t, const UA_Variant *input, size_t, UA_Variant *output)
+{
+    return UA_Variant_copy(&input[0], &output[0]);
+}
+
+static void buildModel()
+{
+    UA_ByteString empty{0, nullptr};
+    Server::addVariableNode("Payload", "Payload of the read and write benchmark",
+                            Variable(&empty, &UA_TYPES[UA_TYPES_BYTESTRING]));
+    Server::addVariableNode("Notify", "Payload of the subscription benchmark",
+                            Variable(&empty, &UA_TYPES[UA_TYPES_BYTESTRING]));
+    vector<Argument> inputs, outputs;
+    inputs.emplace_back("Input", "Input bytes", &UA_TYPES[UA_TYPES_BYTESTRING]);
+    outputs.emplace_back("Output", "Output bytes", &UA_TYPES[UA_TYPES_BYTESTRING]);
+    Server::addMethodNode("Echo", "Echo the input bytes", echo, inputs, outputs);
+}
+
+// 订阅通知的等待状态，通知中的序号与期望值一致时唤醒等待线程
+static mutex notify_mtx;
+static condition_variable notify_cv;
+static UA_UInt64 expected_seq = 0;
+static bool notified = false;
+
+// 负载首部的序号，1 B 负载仅包含序号的最低字节
+static UA_UInt64 payloadSeq(const UA_ByteString &str)
+{
+    UA_UInt64 seq = 0;
+    memcpy(&seq, str.data, min(sizeof(seq), str.length));
+    return seq;
+}
+
+static void notifyChange(UA_UInt32, const UA_DataValue &value)
+{
+    if (!UA_Variant_hasScalarType(&value.value, &UA_TYPES[UA_TYPES_BYTESTRING]))
+        return;
+    auto str = static_cast<const UA_ByteString *>(value.value.data);
+    lock_guard<mutex> lk(notify_mtx);
+    if (str->length > 0 && payloadSeq(*str) == expected_seq)
+    {
+        notified = true;
+        notify_cv.notify_one();
+    }
+}
+
+//! 单个测试用例的结果，延迟分位数只统计成功的操作，失败的操作数单独报告
+static string result(const string &op, size_t size, vector<double> &latency, size_t errors, double seconds)
+{
+    double ops = latency.size() / seconds;
+    ostringstream os;
+    os << "{\"op\": \"" << op << "\", \"payload_bytes\": " << size << ", \"ops_per_sec\": " << ops
+       << ", \"throughput_mb_per_sec\": " << ops * size / (1024.0 * 1024.0) << ", \"errors\": " << errors
+       << ", \"latency_us\": " << bench::toJson(bench::summarize(latency)) << "}";
+    return os.str();
+}
+
+//! 预热后执行 iterations 次操作并统计延迟
+template <typename _Op>
+static string measure(const string &op_name, size_t size, int iterations, _Op &&op)
+{
+    //!< The sequence keeps counting across the warm-up and the timed loop
+    UA_UInt64 seq = 0;
+    for (int i = 0; i < max(3, iterations / 100); ++i)
+        op(seq++);
+    vector<double> latency;
+    latency.reserve(iterations);
+    size_t errors = 0;
+    double begin = bench::nowMicros();
+    for (int i = 0; i < iterations; ++i)
+    {
+        double t0 = bench::nowMicros();
+        if (!op(seq++))
+        {
+            ++errors;
+            continue;
+        }
+        latency.push_back(bench::nowMicros() - t0);
+    }
+    double seconds = (bench::nowMicros() - begin) * 1e-6;
+    return result(op_name, size, latency, errors, seconds);
+}
+
+int main(int argc, char *argv[])
+{
+    int iterations = argc > 1 ? atoi(argv[1]) : 1000;
+    size_t max_size = argc > 2 ? strtoull(argv[2], nullptr, 10) : 32UL << 20;
+    string out = argc > 3 ? argv[3] : "latency_bench.json";
+
+    pid_t server = bench::spawnServer(port, buildModel);
+    if (server < 0)
+    {
+        printf("Failed to start the server on port %u\n", port);
+        return -1;
+    }
+    Client client;
+    client.connect("opc.tcp://localhost:" + to_string(port));
+    UA_NodeId objects_id = UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER);
+    UA_NodeId payload_id = client.findNodeId(objects_id, 1, "Payload");
+    UA_NodeId notify_id = client.findNodeId(objects_id, 1, "Notify");
+    UA_NodeId echo_id = client.findNodeId(objects_id, 1, "Echo");
+    UA_UInt32 sub_id = client.createSubscription(0.0);
+    client.createVariableMonitors(sub_id, {notify_id}, {notifyChange}, 0.0);
+
+    vector<string> results;
+    for (size_t size : {1UL, 1UL << 10, 16UL << 10, 256UL << 10, 1UL << 20, 4UL << 20, 16UL << 20, 32UL << 20})
+    {
+        if (size > max_size)
+            break;
+        // 大负载的迭代次数按比例减少，保证单个用例的耗时可控
+        int n = max(20, static_cast<int>(iterations / max<size_t>(1, size >> 16)));
+        vector<UA_Byte> data(size, 0x5a);
+        UA_ByteString str{data.size(), data.data()};
+        auto payload = [&](UA_UInt64 seq) {
+            memcpy(data.data(), &seq, min(sizeof(seq), size));
+            return Variable(&str, &UA_TYPES[UA_TYPES_BYTESTRING]);
+        };
+        // 负载在计时之外构造，订阅用例交替写入两个序号不同的负载以触发数据变更
+        Variable values[] = {payload(1), payload(2)};
+
+        results.push_back(measure("write", size, n, [&](UA_UInt64) {
+            return client.writeVariable(payload_id, values[0]);
+        }));
+        results.push_back(measure("read", size, n, [&](UA_UInt64) {
+            return !UA_Variant_isEmpty(&client.readVariable(payload_id).get());
+        }));
+        vector<Variable> inputs;
+        inputs.push_back(values[0]);
+        results.push_back(measure("call", size, n, [&](UA_UInt64) {
+            vector<Variable> outputs;
+            return client.call(echo_id, inputs, outputs) && outputs.size() == 1;
+        }));
+        // 订阅延迟：从发起写入到收到对应序号的数据变更通知，仅此用例运行后台事件循环以接收通知，
+        // 其余用例的请求不与事件循环竞争客户端服务互斥锁
+        client.start(10);
+        results.push_back(measure("subscription", size, n, [&](UA_UInt64 i) {
+            {
+                lock_guard<mutex> lk(notify_mtx);
+                expected_seq = i % 2 + 1;
+                notified = false;
+            }
+            if (!client.writeVariable(notify_id, values[i % 2]))
+                return false;
+            unique_lock<mutex> lk(notify_mtx);
+            return notify_cv.wait_for(lk, chrono::seconds(5), []() { return notified; });
+        }));
+        client.stop();
+    }
+    client.disconnect();
+    bench::stopServer(server);
+
+    string json = "{\"benchmark\": \"latency\", \"results\": [";
+    for (size_t i = 0; i < results.size(); ++i)
+        json += (i == 0 ? "" : ", ") + results[i];
+    bench::report(json + "]}", out);
+    return 0;
+}
@@ -0,0 +1,281 @@
+/**
+ * @file load_bench.cpp
+ * @author 赵曦 (535394140@qq.com)
+ * @brief Multi-client load generator, measures the throughput, tail latency,
+ *        CPU usage and notification lag of ua::Server as the number of clients grows
+ * @version 1.0
+ * @date 2023-03-11
+ *
+ * @copyright Copyright (c) 2023, zhaoxi
+ *
+ */
+
+#include <array>
+#include <atomic>
+#include <cstdlib>
+#include <mutex>
+#include <random>
+
+#include "bench_utility.hpp"
+
+using namespace std;
+using namespace ua;
+
+static constexpr UA_UInt16 port = 4863;
+
+// 设备对象的 Increment 方法，Counter 自增并返回新值
+static UA_StatusCode increment(UA_Server *, const UA_NodeId *, void *, const UA_NodeId *, void *,
+                               const UA_NodeId *objectId, void *, size_t, const UA_Variant *, size_t,
+                               UA_Variant *output)
+{
+    UA_NodeId counter_id = Server::findNodeId(*objectId, 1, "Counter");
+    Variable counter = Server::readVariable(counter_id);
+    if (!UA_Variant_hasScalarType(&counter.get(), &UA_TYPES[UA_TYPES_UINT32]))
+        return UA_STATUSCODE_BAD;
+    UA_UInt32 value = *static_cast<UA_UInt32 *>(counter.get().data) + 1;
+    Server::writeVariable(counter_id, value);
+    UA_Variant_setScalarCopy(&output[0], &value, &UA_TYPES[UA_TYPES_UINT32]);
+    return UA_STATUSCODE_GOOD;
+}
+
+// 服务器端周期性写入各设备的时间戳，客户端据此计算通知延迟
+static void writeStamps(vector<UA_NodeId> stamp_ids, int period_ms)
+{
+    while (true)
+    {
+        this_thread::sleep_for(chrono::milliseconds(period_ms));
+        for (auto &stamp_id : stamp_ids)
+            Server::writeVariable(stamp_id, UA_DateTime_now());
+    }
+}
+
+static void buildModel(int nodes, int period_ms)
+{
+    ObjectType device;
+    device.add("Value", 0.0);
+    device.add("Counter", UA_UInt32(0));
+    device.add("Stamp", UA_DateTime_now());
+    UA_NodeId device_type_id = Server::addObjectTypeNode("LoadDeviceType", "Type of the load device", device);
+    vector<Argument> outputs;
+    outputs.emplace_back("Counter", "Counter after increment", &UA_TYPES[UA_TYPES_UINT32]);
+    Server::addMethodNode("Increment", "Increase the counter", increment, null_args, outputs, device_type_id);
+
+    Object load;
+    UA_NodeId load_id = Server::addObjectNode("Load", "Load devices", load);
+    vector<UA_NodeId> stamp_ids;
+    stamp_ids.reserve(nodes);
+    for (int i = 0; i < nodes; ++i)
+    {
+        string name = "Device[" + to_string(i) + "]";
+        UA_NodeId device_id = Server::addObjectNode(name, name, Object(device), device_type_id, load_id);
+        stamp_ids.push_back(Server::findNodeId(device_id, 1, "Stamp"));
+    }
+    thread(writeStamps, stamp_ids, period_ms).detach();
+}
+
+//! 单个设备对象的节点 ID
+struct Device
+{
+    UA_NodeId object_id;    //!< 设备对象节点 ID
+    UA_NodeId value_id;     //!< Value 变量节点 ID
+    UA_NodeId stamp_id;     //!< Stamp 变量节点 ID
+    UA_NodeId increment_id; //!< Increment 方法节点 ID
+};
+
+//! 负载配置
+struct LoadConfig
+{
+    int seconds = 5;                    //!< 每轮负载持续时间 (单位：s)
+    int nodes = 16;                     //!< 设备数量
+    int subscribe = 1;                  //!< 每个客户端订阅的设备时间戳数量
+    array<int, 3> mix = {{70, 20, 10}}; //!< 读、写、调用的权重
+    int period_ms = 50;                 //!< 服务器写入时间戳的周期 (单位：ms)
+};
+
+//! 所有客户端线程共享的统计结果
+struct LoadStats
+{
+    mutex mtx;                         //!< 样本合并互斥锁
+    vector<double> latency[3];         //!< 读、写、调用延迟 (单位：us)
+    vector<double> lag;                //!< 通知延迟 (单位：us)
+    atomic_bool measuring{false};      //!< 是否处于计时区间，连接建立阶段的样本不计入统计
+    atomic_uint64_t errors{0};         //!< 失败的操作数
+    atomic_uint32_t failed_clients{0}; //!< 连接失败的客户端数
+};
+
+static const char *op_names[] = {"read", "write", "call"};
+
+static void runClient(int idx, const vector<Device> &devices, const LoadConfig &cfg,
+                      atomic_bool &running, LoadStats &stats)
+{
+    Client client;
+    if (!client.connect("opc.tcp://localhost:" + to_string(port)))
+    {
+        ++stats.failed_clients;
+        return;
+    }
+    vector<double> latency[3], lag;
+    mutex lag_mtx;
+    // 订阅各自的一组设备时间戳。订阅使用单独的连接并运行后台事件循环，读写调用所在的连接不运行事件循环，
+    // 操作的延迟只取决于服务器
+    Client monitor;
+    if (cfg.subscribe > 0)
+    {
+        if (!monitor.connect("opc.tcp://localhost:" + to_string(port)))
+        {
+            ++stats.failed_clients;
+            return;
+        }
+        vector<UA_NodeId> stamp_ids;
+        vector<Client::DataChangeHandler> handlers;
+        for (int i = 0; i < cfg.subscribe; ++i)
+        {
+            stamp_ids.push_back(devices[(idx + i) % devices.size()].stamp_id);
+            handlers.emplace_back([&lag, &lag_mtx, &stats](UA_UInt32, const UA_DataValue &value) {
+                if (!stats.measuring || !UA_Variant_hasScalarType(&value.value, &UA_TYPES[UA_TYPES_DATETIME]))
+                    return;
+                UA_DateTime stamp = *static_cast<UA_DateTime *>(value.value.data);
+                lock_guard<mutex> lk(lag_mtx);
+                lag.push_back(static_cast<double>(UA_DateTime_now() - stamp) / UA_DATETIME_USEC);
+            });
+        }
+        UA_UInt32 sub_id = monitor.createSubscription(0.0);
+        monitor.createVariableMonitors(sub_id, stamp_ids, std::move(handlers), 0.0);
+        monitor.start(10);
+    }
+
+    mt19937 rng(idx);
+    discrete_distribution<int> pick_op(cfg.mix.begin(), cfg.mix.end());
+    uniform_int_distribution<size_t> pick_device(0, devices.size() - 1);
+    while (running)
+    {
+        int op = pick_op(rng);
+        const Device &device = devices[pick_device(rng)];
+        double t0 = bench::nowMicros();
+        bool ok = false;
+        if (op == 0)
+            ok = !UA_Variant_isEmpty(&client.readVariable(device.value_id).get());
+        else if (op == 1)
+            ok = client.writeVariable(device.value_id, t0);
+        else
+        {
+            vector<Variable> outputs;
+            ok = client.call(device.increment_id, {}, outputs, device.object_id);
+        }
+        if (!stats.measuring)
+            continue;
+        if (ok)
+            latency[op].push_back(bench::nowMicros() - t0);
+        else
+            ++stats.errors;
+    }
+    monitor.stop();
+    monitor.disconnect();
+    client.disconnect();
+
+    lock_guard<mutex> lk(stats.mtx);
+    for (int i = 0; i < 3; ++i)
+        stats.latency[i].insert(stats.latency[i].end(), latency[i].begin(), latency[i].end());
+    stats.lag.insert(stats.lag.end(), lag.begin(), lag.end());
+}
+
+static string runLoad(pid_t server, int clients, const vector<Device> &devices, const LoadConfig &cfg)
+{
+    LoadStats stats;
+    atomic_bool running{true};
+    vector<thread> threads;
+    threads.reserve(clients);
+    for (int i = 0; i < clients; ++i)
+        threads.emplace_back(runClient, i, cref(devices), cref(cfg), ref(running), ref(stats));
+    // 连接、订阅建立后再开始计时
+    this_thread::sleep_for(chrono::milliseconds(500));
+    double cpu_begin = bench::processCpuSeconds(server);
+    double wall_begin = bench::nowMicros();
+    stats.measuring = true;
+    this_thread::sleep_for(chrono::seconds(cfg.seconds));
+    stats.measuring = false;
+    running = false;
+    double cpu = bench::processCpuSeconds(server) - cpu_begin;
+    double wall = (bench::nowMicros() - wall_begin) * 1e-6;
+    for (auto &t : threads)
+        t.join();
+
+    size_t ops = 0;
+    for (auto &latency : stats.latency)
+        ops += latency.size();
+    ostringstream os;
+    os << "{\"clients\": " << clients << ", \"failed_clients\": " << stats.failed_clients
+       << ", \"ops_per_sec\": " << ops / wall << ", \"errors\": " << stats.errors
+       << ", \"server_cpu_percent\": " << 100.0 * cpu / wall;
+    for (int i = 0; i < 3; ++i)
+        os << ", \"" << op_names[i] << "_latency_us\": " << bench::toJson(bench::summarize(stats.latency[i]));
+    os << ", \"notification_lag_us\": " << bench::toJson(bench::summarize(stats.lag)) << "}";
+    return os.str();
+}
+
+// 解析以分隔符分隔的整数列表
+static vector<int> parseList(const string &str, char delim)
+{
+    vector<int> values;
+    istringstream is(str);
+    string item;
+    while (getline(is, item, delim))
+        if (!item.empty())
+            values.push_back(atoi(item.c_str()));
+    return values;
+}
+
+int main(int argc, char *argv[])
+{
+    // load_bench [clients=1,2,4,8,16,32] [nodes] [seconds] [read:write:call] [subscribe] [period_ms] [out]
+    vector<int> client_counts = parseList(argc > 1 ? argv[1] : "1,2,4,8,16,32", ',');
+    LoadConfig cfg;
+    cfg.nodes = argc > 2 ? max(1, atoi(argv[2])) : cfg.nodes;
+    cfg.seconds = argc > 3 ? atoi(argv[3]) : cfg.seconds;
+    if (argc > 4)
+    {
+        vector<int> mix = parseList(argv[4], ':');
+        if (mix.size() == 3)
+            copy(mix.begin(), mix.end(), cfg.mix.begin());
+    }
+    cfg.subscribe = argc > 5 ? atoi(argv[5]) : cfg.subscribe;
+    cfg.period_ms = argc > 6 ? max(1, atoi(argv[6])) : cfg.period_ms;
+    string out = argc > 7 ? argv[7] : "load_bench.json";
+
+    pid_t server = bench::spawnServer(port, [&cfg]() { buildModel(cfg.nodes, cfg.period_ms); });
+    if (server < 0)
+    {
+        printf("Failed to start the server on port %u\n", port);
+        return -1;
+    }
+    // 节点 ID 只解析一次，由所有客户端共享
+    vector<Device> devices(cfg.nodes);
+    {
+        Client client;
+        client.connect("opc.tcp://localhost:" + to_string(port));
+        UA_NodeId load_id = client.findNodeId(UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER), 1, "Load");
+        for (int i = 0; i < cfg.nodes; ++i)
+        {
+            Device &device = devices[i];
+            device.object_id = client.findNodeId(load_id, 1, "Device[" + to_string(i) + "]");
+            device.value_id = client.findNodeId(device.object_id, 1, "Value");
+            device.stamp_id = client.findNodeId(device.object_id, 1, "Stamp");
+            device.increment_id = client.findNodeId(device.object_id, 1, "Increment");
+        }
+    }
+
+    vector<string> results;
+    for (int clients : client_counts)
+        results.push_back(runLoad(server, clients, devices, cfg));
+    bench::stopServer(server);
+
+    ostringstream os;
+    os << "{\"benchmark\": \"load\", \"nodes\": " << cfg.nodes << ", \"seconds\": " << cfg.seconds
+       << ", \"mix\": {\"read\": " << cfg.mix[0] << ", \"write\": " << cfg.mix[1] << ", \"call\": " << cfg.mix[2]
+       << "}, \"subscribe\": " << cfg.subscribe << ", \"period_ms\": " << cfg.period_ms << ", \"results\": [";
+    for (size_t i = 0; i < results.size(); ++i)
+        os << (i == 0 ? "" : ", ") << results[i];
+    os << "]}";
+    bench::report(os.str(), out);
+    return 0;
+}
@@ -0,0 +1,117 @@
+/**
+ * @file log_storm_bench.cpp
+ * @author 赵曦 (535394140@qq.com)
+ * @brief Server loop latency under a storm of error logs, UA_Log_Stdout against AsyncLogger
+ * @version 1.0
+ * @date 2023-03-17
+ *
+ * @copyright Copyright (c) 2023, zhaoxi
+ *
+ */
+
+#include <cstdlib>
+
+#include "asmpro/opcua_cs/async_logger.hpp"
+#include "bench_utility.hpp"
+
+using namespace std;
+using namespace ua;
+
+static constexpr UA_UInt16 port = 4868;
+
+//! 日志风暴的生成速率 (单位：条/s)
+static UA_UInt32 storm_rate = 10000;
+static double storm_begin = 0;
+static UA_UInt64 storm_count = 0;
+
+// 在服务器事件循环中以定时回调产生错误日志，按实际经过的时间补齐条数，不受定时器精度影响
+static void stormTick(UA_Server *server, void *)
+{
+    const UA_Logger *logger = &UA_Server_getConfig(server)->logger;
+    UA_UInt64 target = static_cast<UA_UInt64>((bench::nowMicros() - storm_begin) * 1e-6 * storm_rate);
+    for (; storm_count < target; ++storm_count)
+        UA_LOG_ERROR(logger, UA_LOGCATEGORY_SERVER, "Device %u isn't responding: %s",
+                     static_cast<unsigned>(storm_count % 64), UA_StatusCode_name(UA_STATUSCODE_BADTIMEOUT));
+}
+
+// 由客户端调用以开始日志风暴，保证风暴只覆盖测量区间
+static UA_StatusCode startStorm(UA_Server *server, const UA_NodeId *, void *, const UA_NodeId *, void *,
+                                const UA_NodeId *, void *, size_t, const UA_Variant *, size_t, UA_Variant *)
+{
+    storm_begin = bench::nowMicros();
+    return UA_Server_addRepeatedCallback(server, stormTick, nullptr, 1.0, nullptr);
+}
+
+//! 运行一种日志模式，返回 JSON 结果
+static string runMode(const string &mode, const string &log_path, double seconds)
+{
+    pid_t server = bench::spawnServer(port, [&]() {
+        // 服务器的标准输出重定向至日志文件，两种记录器写入相同的目标
+        if (freopen(log_path.c_str(), "a", stdout) == nullptr)
+            _exit(1);
+        if (mode == "async" || mode == "async_ratelimit")
+        {
+            // 子进程在 Server::run 返回后直接退出，记录器无需释放
+            auto logger = new AsyncLogger(stdout);
+            if (mode == "async_ratelimit")
+                logger->setRateLimit(10);
+            Server::setLogger(logger->logger());
+        }
+        Server::addVariableNode("Gain", "Gain of the camera", 1.0);
+        Server::addMethodNode("StartStorm", "Start the log storm", startStorm, null_args, null_args);
+    });
+    if (server < 0)
+        return "{\"mode\": \"" + mode + "\", \"error\": \"failed to start the server\"}";
+
+    Client client;
+    client.connect("opc.tcp://localhost:" + to_string(port));
+    UA_NodeId objects_id = UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER);
+    UA_NodeId gain_id = client.findNodeId(objects_id, 1, "Gain");
+    UA_NodeId storm_id = client.findNodeId(objects_id, 1, "StartStorm");
+    for (int i = 0; i < 100; ++i)
+        client.readVariable(gain_id);
+    if (mode != "none")
+    {
+        vector<Variable> outputs;
+        client.call(storm_id, {}, outputs);
+    }
+
+    // 读取往返时间包括请求在服务器事件循环中的排队，日志 I/O 阻塞事件循环时直接体现为读取延迟
+    vector<double> samples;
+    double deadline = bench::nowMicros() + seconds * 1e6;
+    while (bench::nowMicros() < deadline)
+    {
+        double t0 = bench::nowMicros();
+        client.readVariable(gain_id);
+        samples.push_back(bench::nowMicros() - t0);
+    }
+    client.disconnect();
+    double cpu = bench::processCpuSeconds(server);
+    bench::stopServer(server);
+
+    ostringstream os;
+    os << "{\"mode\": \"" << mode << "\", \"reads_per_s\": " << samples.size() / seconds
+       << ", \"server_cpu_s\": " << cpu << ", \"read_us\": " << bench::toJson(bench::summarize(samples)) << "}";
+    return os.str();
+}
+
+int main(int argc, char *argv[])
+{
+    // log_storm_bench [out] [rate] [seconds] [log_path]
+    string out = argc > 1 ? argv[1] : "log_storm_bench.json";
+    storm_rate = argc > 2 ? static_cast<UA_UInt32>(atoi(argv[2])) : 10000;
+    double seconds = argc > 3 ? atof(argv[3]) : 5;
+    // 将日志写入终端或管道 (如 /dev/stdout | less) 时同步输出的阻塞更为明显
+    string log_path = argc > 4 ? argv[4] : "log_storm.log";
+
+    vector<string> results;
+    for (const char *mode : {"none", "stdout", "async", "async_ratelimit"})
+        results.push_back(runMode(mode, log_path, seconds));
+
+    string json = "{\"benchmark\": \"log_storm\", \"rate\": " + to_string(storm_rate) +
+                  ", \"seconds\": " + to_string(seconds) + ", \"results\": [";
+    for (size_t i = 0; i < results.size(); ++i)
+        json += (i == 0 ? "" : ", ") + results[i];
+    bench::report(json + "]}", out);
+    return 0;
+}
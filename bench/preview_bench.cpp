@@ -0,0 +1,171 @@
+/**
+ * @file preview_bench.cpp
+ * @author 赵曦 (535394140@qq.com)
+ * @brief Cost of the preview kernels and bandwidth of subscribers to full frames against previews
+ * @version 1.0
+ * @date 2023-03-19
+ *
+ * @copyright Copyright (c) 2023, zhaoxi
+ *
+ */
+
+#include <atomic>
+#include <cstdlib>
+
+#include "asmpro/opcua_cs/image_preview.hpp"
+#include "bench_utility.hpp"
+
+using namespace std;
+using namespace ua;
+
+static constexpr UA_UInt16 port = 4869;
+static constexpr UA_UInt32 width = 640;
+static constexpr UA_UInt32 height = 480;
+
+//! 测试的预览，名称与服务器中的变量名一致
+static vector<pair<string, ImagePreview>> previews()
+{
+    ImagePreview thumbnail;
+    thumbnail.src_width = width;
+    thumbnail.src_height = height;
+    thumbnail.width = 160;
+    thumbnail.height = 120;
+    ImagePreview thumbnail_mono = thumbnail;
+    thumbnail_mono.mono = true;
+    ImagePreview mono = thumbnail;
+    mono.width = mono.height = 0;
+    mono.mono = true;
+    ImagePreview roi = thumbnail;
+    roi.width = roi.height = 0;
+    roi.roi_x = 160;
+    roi.roi_y = 120;
+    roi.roi_width = 320;
+    roi.roi_height = 240;
+    // 非整数倍的缩放使用最近邻采样
+    ImagePreview nearest = thumbnail;
+    nearest.width = 256;
+    nearest.height = 192;
+    return {{"Thumbnail", thumbnail}, {"ThumbnailMono", thumbnail_mono}, {"Mono", mono},
+            {"Roi", roi}, {"Nearest", nearest}};
+}
+
+static vector<UA_Byte> frame(size_t(width) * height * 3);
+static UA_NodeId image_id;
+static UA_Byte frame_seq = 0;
+static double fps = 30;
+
+// 以固定帧率写入图像，每帧内容不同以触发数据变更
+static void writeFrame(UA_Server *, void *)
+{
+    for (size_t i = 0; i < frame.size(); ++i)
+        frame[i] = static_cast<UA_Byte>(i + frame_seq);
+    ++frame_seq;
+    Server::writeVariable(image_id, Variable(frame.data(), &UA_TYPES[UA_TYPES_BYTE], frame.size()),
+                          UA_DateTime_now());
+}
+
+// 由客户端调用以开始产生图像
+static UA_StatusCode startFrames(UA_Server *server, const UA_NodeId *, void *, const UA_NodeId *, void *,
+                                 const UA_NodeId *, void *, size_t, const UA_Variant *, size_t, UA_Variant *)
+{
+    return UA_Server_addRepeatedCallback(server, writeFrame, nullptr, 1000.0 / fps, nullptr);
+}
+
+static void buildModel()
+{
+    image_id = Server::addVariableNode("Image", "Image of the camera",
+                                       Variable(frame.data(), &UA_TYPES[UA_TYPES_BYTE], frame.size()));
+    for (auto &[name, preview] : previews())
+        Server::addImagePreview(name, "Preview of the image", image_id, preview);
+    Server::addMethodNode("StartFrames", "Start writing frames", startFrames, null_args, null_args);
+}
+
+//! 预览内核生成一帧所需的时间
+static string kernelResult(const string &name, const ImagePreview &preview, int iterations)
+{
+    vector<UA_Byte> dst(preview.outSize());
+    vector<UA_UInt32> buffer;
+    vector<double> samples;
+    samples.reserve(iterations);
+    for (int i = 0; i < iterations; ++i)
+    {
+        double t0 = bench::nowMicros();
+        makePreview(frame.data(), preview, dst.data(), buffer);
+        samples.push_back(bench::nowMicros() - t0);
+    }
+    ostringstream os;
+    os << "{\"preview\": \"" << name << "\", \"bytes\": " << preview.outSize()
+       << ", \"kernel_us\": " << bench::toJson(bench::summarize(samples)) << "}";
+    return os.str();
+}
+
+//! 订阅指定变量一段时间，统计收到的帧数、字节数以及两端的 CPU 占用
+static string subscribeResult(pid_t server, const string &name, double seconds)
+{
+    Client client;
+    client.connect("opc.tcp://localhost:" + to_string(port));
+    UA_NodeId node_id = client.findNodeId(UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER), 1, name);
+    atomic<UA_UInt64> frames{0}, bytes{0};
+    UA_UInt32 sub_id = client.createSubscription(1000.0 / fps);
+    client.createVariableMonitors(sub_id, {node_id}, {[&](UA_UInt32, const UA_DataValue &value) {
+                                      ++frames;
+                                      bytes += value.value.arrayLength;
+                                  }},
+                                  1000.0 / fps);
+    double server_cpu = bench::processCpuSeconds(server);
+    double client_cpu = bench::cpuSeconds();
+    client.start(10);
+    this_thread::sleep_for(chrono::duration<double>(seconds));
+    client.stop();
+    server_cpu = bench::processCpuSeconds(server) - server_cpu;
+    client_cpu = bench::cpuSeconds() - client_cpu;
+    client.disconnect();
+
+    ostringstream os;
+    os << "{\"variable\": \"" << name << "\", \"frames_per_s\": " << frames / seconds
+       << ", \"kbytes_per_s\": " << bytes / seconds / 1024 << ", \"server_cpu_s\": " << server_cpu
+       << ", \"client_cpu_s\": " << client_cpu << "}";
+    return os.str();
+}
+
+int main(int argc, char *argv[])
+{
+    // preview_bench [out] [fps] [seconds] [iterations]
+    string out = argc > 1 ? argv[1] : "preview_bench.json";
+    fps = argc > 2 ? atof(argv[2]) : 30;
+    double seconds = argc > 3 ? atof(argv[3]) : 5;
+    int iterations = argc > 4 ? atoi(argv[4]) : 1000;
+
+    pid_t server = bench::spawnServer(port, buildModel);
+    if (server < 0)
+    {
+        printf("Failed to start the server on port %u\n", port);
+        return -1;
+    }
+    {
+        Client client;
+        client.connect("opc.tcp://localhost:" + to_string(port));
+        vector<Variable> outputs;
+        client.call(client.findNodeId(UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER), 1, "StartFrames"), {}, outputs);
+        client.disconnect();
+    }
+    // 每次只有一个订阅者，服务器的 CPU 时间包括写入图像与生成该预览
+    vector<string> subscribers;
+    subscribers.push_back(subscribeResult(server, "Image", seconds));
+    for (auto &each : previews())
+        subscribers.push_back(subscribeResult(server, each.first, seconds));
+    bench::stopServer(server);
+
+    vector<string> kernels;
+    for (auto &[name, preview] : previews())
+        kernels.push_back(kernelResult(name, preview, iterations));
+
+    string json = "{\"benchmark\": \"preview\", \"fps\": " + to_string(fps) + ", \"kernels\": [";
+    for (size_t i = 0; i < kernels.size(); ++i)
+        json += (i == 0 ? "" : ", ") + kernels[i];
+    json += "], \"subscribers\": [";
+    for (size_t i = 0; i < subscribers.size(); ++i)
+        json += (i == 0 ? "" : ", ") + subscribers[i];
+    bench::report(json + "]}", out);
+    return 0;
+}
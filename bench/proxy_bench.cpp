@@ -0,0 +1,147 @@
+/**
+ * @file proxy_bench.cpp
+ * @author 赵曦 (535394140@qq.com)
+ * @brief Upstream CPU and end-to-end latency of many subscribers served directly against through the proxy
+ * @version 1.0
+ * @date 2023-03-22
+ *
+ * @copyright Copyright (c) 2023, zhaoxi
+ *
+ */
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+
+#include "asmpro/opcua_cs/proxy.hpp"
+#include "bench_utility.hpp"
+
+using namespace std;
+using namespace ua;
+
+static constexpr UA_UInt16 upstream_port = 4873;
+static constexpr UA_UInt16 proxy_port = 4874;
+
+static vector<UA_Byte> frame(160 * 120 * 3);
+static UA_NodeId frame_id;
+static size_t frame_seq = 0;
+static double fps = 10;
+
+// 模拟 HMI 订阅的缩略图，每帧内容均不同
+static void writeFrame(UA_Server *, void *)
+{
+    memset(frame.data(), static_cast<int>(++frame_seq & 0xFF), frame.size());
+    Server::writeVariable(frame_id, Variable(frame.data(), &UA_TYPES[UA_TYPES_BYTE], frame.size()),
+                          UA_DateTime_now());
+}
+
+// 由客户端调用以开始产生图像
+static UA_StatusCode startFrames(UA_Server *server, const UA_NodeId *, void *, const UA_NodeId *, void *,
+                                 const UA_NodeId *, void *, size_t, const UA_Variant *, size_t, UA_Variant *)
+{
+    return UA_Server_addRepeatedCallback(server, writeFrame, nullptr, 1000.0 / fps, nullptr);
+}
+
+static void buildUpstream()
+{
+    frame_id = Server::addVariableNode("Frame", "Thumbnail of the camera",
+                                       Variable(frame.data(), &UA_TYPES[UA_TYPES_BYTE], frame.size()));
+    Server::addMethodNode("StartFrames", "Start writing frames", startFrames, null_args, null_args);
+}
+
+static void buildProxy()
+{
+    Proxy::connect("opc.tcp://localhost:" + to_string(upstream_port));
+    Proxy::mirrorVariable("Frame");
+    Proxy::mirrorMethod("StartFrames");
+    Proxy::start(1000.0 / fps / 2);
+}
+
+//! 多个客户端同时订阅指定服务器中的 Frame，统计每个客户端的帧率、端到端延迟以及上游与代理的 CPU 占用
+static string fanOutResult(const string &mode, UA_UInt16 port, pid_t upstream, pid_t proxy, size_t count,
+                           double seconds)
+{
+    mutex mtx;
+    vector<double> latency;
+    latency.reserve(static_cast<size_t>(fps * seconds * count * 2));
+    atomic<UA_UInt64> frames{0};
+    vector<unique_ptr<Client>> clients;
+    for (size_t i = 0; i < count; ++i)
+    {
+        auto client = make_unique<Client>();
+        client->connect("opc.tcp://localhost:" + to_string(port));
+        UA_NodeId node_id = client->findNodeId(UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER), 1, "Frame");
+        UA_UInt32 sub_id = client->createSubscription(1000.0 / fps / 2);
+        // 代理的镜像变量为数据源变量，两种模式均以半个帧间隔采样，保证每帧都能被采到
+        client->createVariableMonitors(sub_id, {node_id}, {[&](UA_UInt32, const UA_DataValue &value) {
+                                           ++frames;
+                                           lock_guard<mutex> lk(mtx);
+                                           latency.push_back((UA_DateTime_now() - value.sourceTimestamp) / 10.0);
+                                       }},
+                                       1000.0 / fps / 2, 1);
+        clients.push_back(std::move(client));
+    }
+    double upstream_cpu = bench::processCpuSeconds(upstream);
+    double proxy_cpu = proxy > 0 ? bench::processCpuSeconds(proxy) : 0;
+    for (auto &client : clients)
+        client->start(10);
+    this_thread::sleep_for(chrono::duration<double>(seconds));
+    for (auto &client : clients)
+        client->stop();
+    upstream_cpu = bench::processCpuSeconds(upstream) - upstream_cpu;
+    proxy_cpu = proxy > 0 ? bench::processCpuSeconds(proxy) - proxy_cpu : 0;
+    for (auto &client : clients)
+        client->disconnect();
+
+    ostringstream os;
+    os << "{\"mode\": \"" << mode << "\", \"clients\": " << count
+       << ", \"frames_per_s_per_client\": " << frames / seconds / count
+       << ", \"latency_us\": " << bench::toJson(bench::summarize(latency)) << ", \"upstream_cpu_s\": " << upstream_cpu
+       << ", \"proxy_cpu_s\": " << proxy_cpu << "}";
+    return os.str();
+}
+
+int main(int argc, char *argv[])
+{
+    // proxy_bench [out] [clients] [fps] [seconds]
+    string out = argc > 1 ? argv[1] : "proxy_bench.json";
+    size_t count = argc > 2 ? static_cast<size_t>(atoi(argv[2])) : 30;
+    fps = argc > 3 ? atof(argv[3]) : 10;
+    double seconds = argc > 4 ? atof(argv[4]) : 5;
+
+    pid_t upstream = bench::spawnServer(upstream_port, buildUpstream);
+    if (upstream < 0)
+    {
+        printf("Failed to start the upstream server on port %u\n", upstream_port);
+        return -1;
+    }
+    pid_t proxy = bench::spawnServer(proxy_port, buildProxy);
+    if (proxy < 0)
+    {
+        printf("Failed to start the proxy on port %u\n", proxy_port);
+        bench::stopServer(upstream);
+        return -1;
+    }
+    // 方法调用经由代理转发至上游
+    {
+        Client client;
+        client.connect("opc.tcp://localhost:" + to_string(proxy_port));
+        vector<Variable> outputs;
+        client.call(client.findNodeId(UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER), 1, "StartFrames"), {}, outputs);
+        client.disconnect();
+    }
+    vector<string> modes;
+    modes.push_back(fanOutResult("direct", upstream_port, upstream, -1, count, seconds));
+    modes.push_back(fanOutResult("proxy", proxy_port, upstream, proxy, count, seconds));
+    bench::stopServer(proxy);
+    bench::stopServer(upstream);
+
+    string json = "{\"benchmark\": \"proxy\", \"fps\": " + to_string(fps) + ", \"frame_bytes\": " +
+                  to_string(frame.size()) + ", \"modes\": [";
+    for (size_t i = 0; i < modes.size(); ++i)
+        json += (i == 0 ? "" : ", ") + modes[i];
+    bench::report(json + "]}", out);
+    return 0;
+}
@@ -0,0 +1,94 @@
+/**
+ * @file read_cache_bench.cpp
+ * @author 赵曦 (535394140@qq.com)
+ * @brief Read latency and server CPU of repeated parameter reads with and without the client read cache
+ * @version 1.0
+ * @date 2023-03-22
+ *
+ * @copyright Copyright (c) 2023, zhaoxi
+ *
+ */
+
+#include <cstdlib>
+
+#include "bench_utility.hpp"
+
+using namespace std;
+using namespace ua;
+
+static constexpr UA_UInt16 port = 4878;
+
+static const vector<string> params = {"IP", "Exposure", "Delay"};
+
+static void buildModel()
+{
+    Server::addVariableNode("IP", "Camera address", Variable("192.168.1.10"));
+    Server::addVariableNode("Exposure", "Exposure time (us)", Variable(2000.0));
+    Server::addVariableNode("Delay", "Trigger delay (ms)", Variable(5));
+}
+
+//! 配方逻辑轮流读取各参数，统计单次读取的耗时与服务器 CPU 占用
+static string readResult(const string &mode, pid_t server, size_t reads, UA_Double max_age)
+{
+    Client client;
+    client.connect("opc.tcp://localhost:" + to_string(port));
+    vector<UA_NodeId> node_ids;
+    for (auto &name : params)
+        node_ids.push_back(client.findNodeId(UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER), 1, name));
+    if (max_age > 0)
+    {
+        client.enableReadCache();
+        client.start(10);
+    }
+    // 预热，使参数成为热点并由内部订阅保持更新
+    for (size_t i = 0; i < 10 * node_ids.size(); ++i)
+        client.readVariable(node_ids[i % node_ids.size()], max_age);
+    this_thread::sleep_for(chrono::milliseconds(300));
+
+    vector<double> latency;
+    latency.reserve(reads);
+    UA_UInt64 misses = client.cacheMisses();
+    double server_cpu = bench::processCpuSeconds(server);
+    for (size_t i = 0; i < reads; ++i)
+    {
+        double begin = bench::nowMicros();
+        Variable value = client.readVariable(node_ids[i % node_ids.size()], max_age);
+        latency.push_back((bench::nowMicros() - begin) * 1000);
+    }
+    server_cpu = bench::processCpuSeconds(server) - server_cpu;
+    misses = client.cacheMisses() - misses;
+    client.stop();
+    client.disconnect();
+
+    ostringstream os;
+    os << "{\"mode\": \"" << mode << "\", \"max_age_ms\": " << max_age << ", \"reads\": " << reads
+       << ", \"server_reads\": " << (max_age > 0 ? misses : reads)
+       << ", \"latency_ns\": " << bench::toJson(bench::summarize(latency)) << ", \"server_cpu_s\": " << server_cpu
+       << "}";
+    return os.str();
+}
+
+int main(int argc, char *argv[])
+{
+    // read_cache_bench [out] [reads] [max_age]
+    string out = argc > 1 ? argv[1] : "read_cache_bench.json";
+    size_t reads = argc > 2 ? static_cast<size_t>(atoi(argv[2])) : 20000;
+    UA_Double max_age = argc > 3 ? atof(argv[3]) : 1000;
+
+    pid_t server = bench::spawnServer(port, buildModel);
+    if (server < 0)
+    {
+        printf("Failed to start the server on port %u\n", port);
+        return -1;
+    }
+    vector<string> modes;
+    modes.push_back(readResult("uncached", server, reads, 0));
+    modes.push_back(readResult("cached", server, reads, max_age));
+    bench::stopServer(server);
+
+    string json = "{\"benchmark\": \"read_cache\", \"params\": " + to_string(params.size()) + ", \"modes\": [";
+    for (size_t i = 0; i < modes.size(); ++i)
+        json += (i == 0 ? "" : ", ") + modes[i];
+    bench::report(json + "]}", out);
+    return 0;
+}
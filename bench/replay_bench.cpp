@@ -0,0 +1,132 @@
+/**
+ * @file replay_bench.cpp
+ * @author 赵曦 (535394140@qq.com)
+ * @brief Subscriber throughput and latency while a recorded data-change stream is replayed at N times speed
+ * @version 1.0
+ * @date 2023-03-22
+ *
+ * @copyright Copyright (c) 2023, zhaoxi
+ *
+ */
+
+#include <atomic>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+
+#include "asmpro/opcua_cs/recorder.hpp"
+#include "bench_utility.hpp"
+
+using namespace std;
+using namespace ua;
+
+static constexpr UA_UInt16 port = 4875;
+
+static string log_path = "replay_bench.uarc";
+static ReplayOptions options;
+static unique_ptr<Replayer> replayer;
+
+//! 合成突发流量：每 100 ms 一个信号缓慢变化，每秒所有信号在 10 ms 内连续变化 5 次，返回时长 (单位：s)
+static double synthesize(const string &path, size_t signals, double seconds)
+{
+    Recorder recorder(path);
+    vector<UA_NodeId> node_ids;
+    for (size_t i = 0; i < signals; ++i)
+    {
+        node_ids.push_back(UA_NODEID_NUMERIC(1, static_cast<UA_UInt32>(1000 + i)));
+        recorder.declare(node_ids.back(), "Signal[" + to_string(i) + "]");
+    }
+    UA_DateTime t0 = UA_DateTime_now();
+    UA_DataValue value;
+    UA_DataValue_init(&value);
+    value.hasValue = true;
+    double x = 0;
+    for (UA_DateTime t = 0; t < seconds * UA_DATETIME_SEC; t += 100 * UA_DATETIME_MSEC)
+    {
+        x += 1;
+        UA_Variant_setScalar(&value.value, &x, &UA_TYPES[UA_TYPES_DOUBLE]);
+        recorder.record(node_ids[(t / (100 * UA_DATETIME_MSEC)) % signals], value, t0 + t);
+        if (t % UA_DATETIME_SEC != 0)
+            continue;
+        for (UA_DateTime k = 0; k < 5; ++k)
+            for (size_t i = 0; i < signals; ++i)
+            {
+                x += 1;
+                recorder.record(node_ids[i], value, t0 + t + k * 2 * UA_DATETIME_MSEC);
+            }
+    }
+    return seconds;
+}
+
+// 由客户端调用以开始回放
+static UA_StatusCode startReplay(UA_Server *, const UA_NodeId *, void *, const UA_NodeId *, void *, const UA_NodeId *,
+                                 void *, size_t, const UA_Variant *, size_t, UA_Variant *)
+{
+    thread([] { replayer->run(options); }).detach();
+    return UA_STATUSCODE_GOOD;
+}
+
+static void buildModel()
+{
+    replayer = make_unique<Replayer>(log_path);
+    replayer->addNodes();
+    Server::addMethodNode("StartReplay", "Start replaying the record", startReplay, null_args, null_args);
+}
+
+int main(int argc, char *argv[])
+{
+    // replay_bench [out] [record] [speed] [seconds]，未指定日志时先合成 5 s 的突发流量
+    string out = argc > 1 ? argv[1] : "replay_bench.json";
+    double seconds = 0;
+    if (argc > 2)
+        log_path = argv[2];
+    else
+        seconds = synthesize(log_path, 20, 5);
+    options.speed = argc > 3 ? atof(argv[3]) : 1;
+    seconds = argc > 4 ? atof(argv[4]) : seconds / max(options.speed, 1e-3) + 1;
+
+    vector<string> names = Replayer(log_path).names();
+    pid_t server = bench::spawnServer(port, buildModel);
+    if (server < 0)
+    {
+        printf("Failed to start the server on port %u\n", port);
+        return -1;
+    }
+    Client client;
+    client.connect("opc.tcp://localhost:" + to_string(port));
+    mutex mtx;
+    vector<double> latency;
+    atomic<UA_UInt64> notifications{0};
+    vector<UA_NodeId> node_ids;
+    vector<Client::DataChangeHandler> handlers;
+    for (auto &name : names)
+    {
+        node_ids.push_back(client.findNodeId(UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER), 1, name));
+        handlers.emplace_back([&](UA_UInt32, const UA_DataValue &value) {
+            ++notifications;
+            lock_guard<mutex> lk(mtx);
+            latency.push_back((UA_DateTime_now() - value.sourceTimestamp) / 10.0);
+        });
+    }
+    // 采样间隔为 0 且队列较长，突发中的每次写入都会被通知
+    UA_UInt32 sub_id = client.createSubscription(50);
+    client.createVariableMonitors(sub_id, node_ids, std::move(handlers), 0, 16);
+    client.start(10);
+    double server_cpu = bench::processCpuSeconds(server);
+    vector<Variable> outputs;
+    client.call(client.findNodeId(UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER), 1, "StartReplay"), {}, outputs);
+    this_thread::sleep_for(chrono::duration<double>(seconds));
+    server_cpu = bench::processCpuSeconds(server) - server_cpu;
+    client.stop();
+    client.disconnect();
+    bench::stopServer(server);
+
+    ostringstream os;
+    os << "{\"benchmark\": \"replay\", \"record\": \"" << log_path << "\", \"speed\": " << options.speed
+       << ", \"nodes\": " << names.size() << ", \"notifications\": " << notifications
+       << ", \"notifications_per_s\": " << notifications / seconds
+       << ", \"latency_us\": " << bench::toJson(bench::summarize(latency)) << ", \"server_cpu_s\": " << server_cpu
+       << "}";
+    bench::report(os.str(), out);
+    return 0;
+}
@@ -0,0 +1,178 @@
+/**
+ * @file shm_bench.cpp
+ * @author 赵曦 (535394140@qq.com)
+ * @brief Frame delivery over loopback TCP subscriptions against the shared memory channel at 30/60/120 fps
+ * @version 1.0
+ * @date 2023-03-19
+ *
+ * @copyright Copyright (c) 2023, zhaoxi
+ *
+ */
+
+#include <atomic>
+#include <cstdlib>
+#include <mutex>
+
+#include "asmpro/opcua_cs/shm_channel.hpp"
+#include "bench_utility.hpp"
+
+using namespace std;
+using namespace ua;
+
+static constexpr UA_UInt16 port = 4870;
+static const string shm_name = "/ua_shm_bench_image";
+
+static vector<UA_Byte> frame;
+static UA_NodeId image_id;
+static UA_Byte frame_seq = 0;
+static double fps = 30;
+
+// 以固定帧率写入图像，源时间戳为写入时刻
+static void writeFrame(UA_Server *, void *)
+{
+    memset(frame.data(), frame_seq++, frame.size());
+    Server::writeVariable(image_id, Variable(frame.data(), &UA_TYPES[UA_TYPES_BYTE], frame.size()),
+                          UA_DateTime_now());
+}
+
+// 由客户端调用以开始产生图像
+static UA_StatusCode startFrames(UA_Server *server, const UA_NodeId *, void *, const UA_NodeId *, void *,
+                                 const UA_NodeId *, void *, size_t, const UA_Variant *, size_t, UA_Variant *)
+{
+    return UA_Server_addRepeatedCallback(server, writeFrame, nullptr, 1000.0 / fps, nullptr);
+}
+
+static void buildModel()
+{
+    image_id = Server::addVariableNode("Image", "Image of the camera",
+                                       Variable(frame.data(), &UA_TYPES[UA_TYPES_BYTE], frame.size()));
+    Server::addSharedMemoryChannel(image_id, shm_name);
+    Server::addMethodNode("StartFrames", "Start writing frames", startFrames, null_args, null_args);
+}
+
+//! 单个传输方式的结果
+static string result(const string &transport, UA_UInt64 frames, UA_UInt64 lost, double seconds,
+                     vector<double> &latency, double client_cpu, double server_cpu)
+{
+    ostringstream os;
+    os << "{\"transport\": \"" << transport << "\", \"frames_per_s\": " << frames / seconds
+       << ", \"mbytes_per_s\": " << frames * frame.size() / seconds / (1024.0 * 1024.0) << ", \"lost\": " << lost
+       << ", \"client_cpu_s\": " << client_cpu << ", \"server_cpu_s\": " << server_cpu
+       << ", \"latency_us\": " << bench::toJson(bench::summarize(latency)) << "}";
+    return os.str();
+}
+
+//! 通过回环 TCP 订阅接收图像，回调中将数据拷贝至应用缓冲区，与共享内存的读取方式保持一致
+static string viaTcp(pid_t server, double seconds)
+{
+    Client client;
+    client.connect("opc.tcp://localhost:" + to_string(port));
+    UA_NodeId node_id = client.findNodeId(UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER), 1, "Image");
+    vector<UA_Byte> buffer(frame.size());
+    vector<double> latency;
+    UA_UInt64 frames = 0;
+    mutex mtx;
+    UA_UInt32 sub_id = client.createSubscription(0.0);
+    client.createVariableMonitors(sub_id, {node_id}, {[&](UA_UInt32, const UA_DataValue &value) {
+                                      double us = static_cast<double>(UA_DateTime_now() - value.sourceTimestamp) /
+                                                  UA_DATETIME_USEC;
+                                      size_t size = min<size_t>(value.value.arrayLength, buffer.size());
+                                      memcpy(buffer.data(), value.value.data, size);
+                                      lock_guard<mutex> lk(mtx);
+                                      latency.push_back(us);
+                                      ++frames;
+                                  }},
+                                  0.0, 4);
+    double server_cpu = bench::processCpuSeconds(server);
+    double client_cpu = bench::cpuSeconds();
+    client.start(10);
+    this_thread::sleep_for(chrono::duration<double>(seconds));
+    client.stop();
+    server_cpu = bench::processCpuSeconds(server) - server_cpu;
+    client_cpu = bench::cpuSeconds() - client_cpu;
+    client.disconnect();
+    lock_guard<mutex> lk(mtx);
+    UA_UInt64 expected = static_cast<UA_UInt64>(seconds * fps);
+    return result("tcp", frames, expected > frames ? expected - frames : 0, seconds, latency, client_cpu, server_cpu);
+}
+
+//! 通过共享内存通道接收图像
+static string viaShm(pid_t server, double seconds)
+{
+    // 通道名由图像变量的 SharedMemory 属性给出
+    string name;
+    {
+        Client client;
+        client.connect("opc.tcp://localhost:" + to_string(port));
+        UA_NodeId node_id = client.findNodeId(UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER), 1, "Image");
+        Variable val = client.readVariable(client.findNodeId(node_id, 1, "SharedMemory"));
+        if (UA_Variant_hasScalarType(&val.get(), &UA_TYPES[UA_TYPES_STRING]))
+        {
+            auto str = static_cast<const UA_String *>(val.get().data);
+            name.assign(reinterpret_cast<const char *>(str->data), str->length);
+        }
+        client.disconnect();
+    }
+    ShmReader reader(name);
+    if (!reader.isOpen())
+        return "{\"transport\": \"shm\", \"error\": \"failed to open " + name + "\"}";
+    vector<UA_Byte> buffer(frame.size());
+    vector<double> latency;
+    double server_cpu = bench::processCpuSeconds(server);
+    double client_cpu = bench::cpuSeconds();
+    double deadline = bench::nowMicros() + seconds * 1e6;
+    while (bench::nowMicros() < deadline)
+    {
+        double us = 0;
+        bool ok = reader.consume([&](const UA_Byte *data, size_t size, UA_UInt64, UA_DateTime source_timestamp) {
+            us = static_cast<double>(UA_DateTime_now() - source_timestamp) / UA_DATETIME_USEC;
+            memcpy(buffer.data(), data, min(size, buffer.size()));
+        }, 100);
+        if (ok)
+            latency.push_back(us);
+    }
+    server_cpu = bench::processCpuSeconds(server) - server_cpu;
+    client_cpu = bench::cpuSeconds() - client_cpu;
+    return result("shm", reader.received(), reader.skipped() + reader.torn(), seconds, latency, client_cpu,
+                  server_cpu);
+}
+
+int main(int argc, char *argv[])
+{
+    // shm_bench [out] [seconds] [frame_bytes]
+    string out = argc > 1 ? argv[1] : "shm_bench.json";
+    double seconds = argc > 2 ? atof(argv[2]) : 5;
+    frame.resize(argc > 3 ? strtoull(argv[3], nullptr, 10) : 640 * 480 * 3);
+
+    vector<string> results;
+    for (double rate : {30.0, 60.0, 120.0})
+    {
+        fps = rate;
+        pid_t server = bench::spawnServer(port, buildModel);
+        if (server < 0)
+        {
+            printf("Failed to start the server on port %u\n", port);
+            return -1;
+        }
+        {
+            Client client;
+            client.connect("opc.tcp://localhost:" + to_string(port));
+            vector<Variable> outputs;
+            client.call(client.findNodeId(UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER), 1, "StartFrames"), {},
+                        outputs);
+            client.disconnect();
+        }
+        // 两种方式依次测量，服务器在两个阶段中均会写入共享内存，CPU 时间的差异来自 TCP 编码与发送
+        string tcp = viaTcp(server, seconds);
+        string shm = viaShm(server, seconds);
+        bench::stopServer(server);
+        results.push_back("{\"fps\": " + to_string(rate) + ", \"results\": [" + tcp + ", " + shm + "]}");
+    }
+
+    string json = "{\"benchmark\": \"shm\", \"frame_bytes\": " + to_string(frame.size()) + ", \"seconds\": " +
+                  to_string(seconds) + ", \"rates\": [";
+    for (size_t i = 0; i < results.size(); ++i)
+        json += (i == 0 ? "" : ", ") + results[i];
+    bench::report(json + "]}", out);
+    return 0;
+}
@@ -0,0 +1,162 @@
+/**
+ * @file snapshot_bench.cpp
+ * @author 赵曦 (535394140@qq.com)
+ * @brief Cold address space build against snapshot restore for 10k - 100k nodes
+ * @version 1.0
+ * @date 2023-03-16
+ *
+ * @copyright Copyright (c) 2023, zhaoxi
+ *
+ */
+
+#include <cstdlib>
+
+#include <sys/stat.h>
+
+#include "bench_utility.hpp"
+
+using namespace std;
+using namespace ua;
+
+static constexpr UA_UInt16 port = 4867;
+static constexpr int vars_per_device = 8;
+
+// 设备对象的 Reset 方法，将 Value 置为 0
+static UA_StatusCode reset(UA_Server *, const UA_NodeId *, void *, const UA_NodeId *, void *,
+                           const UA_NodeId *objectId, void *, size_t, const UA_Variant *, size_t, UA_Variant *)
+{
+    UA_NodeId value_id = Server::findNodeId(*objectId, 1, "Value");
+    return Server::writeVariable(value_id, 0.0) ? UA_STATUSCODE_GOOD : UA_STATUSCODE_BADINTERNALERROR;
+}
+
+// 与 ua_server 相同的构建方式：类型节点、方法节点，再逐个实例化对象，每个对象包含 1 + vars_per_device 个节点
+static void buildModel(int nodes)
+{
+    ObjectType device;
+    device.add("Value", 1.0);
+    device.add("Counter", UA_UInt32(0));
+    device.add("IP", "0.0.0.0");
+    device.add("Message", "No Message");
+    for (int i = 0; i < vars_per_device - 4; ++i)
+        device.add("Param" + to_string(i), static_cast<double>(i));
+    UA_NodeId device_type_id = Server::addObjectTypeNode("SnapshotDeviceType", "Type of the device", device);
+    Server::addMethodNode("Reset", "Reset the value", reset, null_args, null_args, device_type_id);
+
+    Object devices;
+    UA_NodeId devices_id = Server::addObjectNode("Devices", "Devices", devices);
+    int count = nodes / (1 + vars_per_device);
+    for (int i = 0; i < count; ++i)
+    {
+        string name = "Device[" + to_string(i) + "]";
+        Object each(device);
+        each.add("Value", 2.0 + i);
+        Server::addObjectNode(name, name, each, device_type_id, devices_id);
+    }
+}
+
+static UA_NodeId lastDevice(int nodes)
+{
+    UA_NodeId devices_id = Server::findNodeId(UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER), 1, "Devices");
+    int count = nodes / (1 + vars_per_device);
+    return Server::findNodeId(devices_id, 1, "Device[" + to_string(count - 1) + "]");
+}
+
+// 校验恢复结果：最后一个设备的 Value 与构建时写入的值一致
+static bool verifyModel(int nodes)
+{
+    int count = nodes / (1 + vars_per_device);
+    UA_NodeId device_id = lastDevice(nodes);
+    if (UA_NodeId_isNull(&device_id))
+        return false;
+    Variable value = Server::readVariable(Server::findNodeId(device_id, 1, "Value"));
+    const UA_Variant &val = value.get();
+    return val.type == &UA_TYPES[UA_TYPES_DOUBLE] && *static_cast<double *>(val.data) == 2.0 + (count - 1);
+}
+
+// 在子进程中启动服务器，返回从 fork 至可接受连接的时间，并通过客户端调用 Reset 校验方法回调
+static double timeToReady(const function<void()> &build_model, bool &callable)
+{
+    double t0 = bench::nowMicros();
+    // 大模型的冷启动构建可能需要数十秒
+    pid_t server = bench::spawnServer(port, build_model, 600000);
+    double ready = (bench::nowMicros() - t0) / 1e3;
+    callable = false;
+    if (server < 0)
+        return -1;
+    Client client;
+    if (client.connect("opc.tcp://localhost:" + to_string(port)))
+    {
+        UA_NodeId devices_id = client.findNodeId(UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER), 1, "Devices");
+        UA_NodeId device_id = client.findNodeId(devices_id, 1, "Device[0]");
+        UA_NodeId reset_id = client.findNodeId(device_id, 1, "Reset");
+        vector<Variable> outputs;
+        if (client.call(reset_id, {}, outputs, device_id))
+        {
+            Variable value = client.readVariable(client.findNodeId(device_id, 1, "Value"));
+            const UA_Variant &val = value.get();
+            callable = val.type == &UA_TYPES[UA_TYPES_DOUBLE] && *static_cast<double *>(val.data) == 0.0;
+        }
+        client.disconnect();
+    }
+    bench::stopServer(server);
+    return ready;
+}
+
+int main(int argc, char *argv[])
+{
+    // snapshot_bench [out] [nodes...]
+    string out = argc > 1 ? argv[1] : "snapshot_bench.json";
+    vector<int> sizes;
+    for (int i = 2; i < argc; ++i)
+        sizes.push_back(atoi(argv[i]));
+    if (sizes.empty())
+        sizes = {10000, 30000, 100000};
+    const string path = "snapshot_bench.uasnap";
+    const unordered_map<string, UA_MethodCallback> methods = {{"Reset", reset}};
+
+    vector<string> results;
+    for (int nodes : sizes)
+    {
+        // 冷启动构建并保存快照
+        Server::init(port);
+        double t0 = bench::nowMicros();
+        buildModel(nodes);
+        double build_ms = (bench::nowMicros() - t0) / 1e3;
+        t0 = bench::nowMicros();
+        bool saved = Server::saveSnapshot(path);
+        double save_ms = (bench::nowMicros() - t0) / 1e3;
+        Server::stop();
+        struct stat st{};
+        stat(path.c_str(), &st);
+
+        // 从快照恢复
+        Server::init(port);
+        t0 = bench::nowMicros();
+        bool loaded = Server::loadSnapshot(path, methods);
+        double restore_ms = (bench::nowMicros() - t0) / 1e3;
+        bool verified = loaded && verifyModel(nodes);
+        Server::stop();
+
+        // 包括 Server::init 与网络监听在内，从进程启动至可服务的时间
+        bool cold_callable = false, snapshot_callable = false;
+        double cold_ready = timeToReady([nodes]() { buildModel(nodes); }, cold_callable);
+        double snapshot_ready = timeToReady([&]() { Server::loadSnapshot(path, methods); }, snapshot_callable);
+
+        ostringstream os;
+        os << "{\"nodes\": " << nodes << ", \"snapshot_bytes\": " << st.st_size
+           << ", \"saved\": " << (saved ? "true" : "false")
+           << ", \"verified\": " << (verified ? "true" : "false")
+           << ", \"cold_build_ms\": " << build_ms << ", \"save_ms\": " << save_ms
+           << ", \"restore_ms\": " << restore_ms << ", \"speedup\": " << (restore_ms > 0 ? build_ms / restore_ms : 0)
+           << ", \"cold_ready_ms\": " << cold_ready << ", \"snapshot_ready_ms\": " << snapshot_ready
+           << ", \"method_rebound\": " << (cold_callable && snapshot_callable ? "true" : "false") << "}";
+        results.push_back(os.str());
+    }
+    remove(path.c_str());
+
+    string json = "{\"benchmark\": \"snapshot\", \"results\": [";
+    for (size_t i = 0; i < results.size(); ++i)
+        json += (i == 0 ? "" : ", ") + results[i];
+    bench::report(json + "]}", out);
+    return 0;
+}
@@ -0,0 +1,191 @@
+/**
+ * @file variable_bench.cpp
+ * @author 赵曦 (535394140@qq.com)
+ * @brief Microbenchmarks of the value layer: Variable construction, clone,
+ *        ObjectType::add, node attribute configuration and binary encoding
+ * @version 1.0
+ * @date 2023-03-12
+ *
+ * @copyright Copyright (c) 2023, zhaoxi
+ *
+ */
+
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "alloc_hook.hpp"
+#include "asmpro/opcua_cs/object.hpp"
+#include "asmpro/opcua_cs/server.hpp"
+
+using namespace std;
+using namespace ua;
+
+//! 变量的数据类型
+enum class Kind
+{
+    Scalar, //!< Double 标量，与负载大小无关
+    String, //!< 长度为负载大小的 String 标量
+    Array   //!< 长度为负载大小的 Byte 数组
+};
+
+//! 构造测试用的变量数据，data 需在变量构造期间保持有效
+static Variable makeVariable(Kind kind, vector<UA_Byte> &data)
+{
+    switch (kind)
+    {
+    case Kind::Scalar:
+        return Variable(3.14);
+    case Kind::String:
+    {
+        UA_String str{data.size(), data.data()};
+        return Variable(&str, &UA_TYPES[UA_TYPES_STRING]);
+    }
+    default:
+        return Variable(data.data(), &UA_TYPES[UA_TYPES_BYTE], data.size());
+    }
+}
+
+//! 在测试循环外统计分配次数，并以每次迭代的平均值写入计数器
+class AllocCounter
+{
+    benchmark::State &__state;
+
+public:
+    explicit AllocCounter(benchmark::State &state) : __state(state) { bench::startAllocCount(); }
+
+    ~AllocCounter()
+    {
+        bench::AllocStats stats = bench::stopAllocCount();
+        __state.counters["allocs"] = benchmark::Counter(static_cast<double>(stats.allocs()), benchmark::Counter::kAvgIterations);
+        __state.counters["alloc_bytes"] = benchmark::Counter(static_cast<double>(stats.bytes), benchmark::Counter::kAvgIterations);
+    }
+};
+
+template <Kind kind>
+static void BM_Construct(benchmark::State &state)
+{
+    vector<UA_Byte> data(state.range(0), 0x5a);
+    {
+        AllocCounter counter(state);
+        for (auto _ : state)
+        {
+            Variable val = makeVariable(kind, data);
+            benchmark::DoNotOptimize(val.get().data);
+        }
+    }
+    state.SetBytesProcessed(state.iterations() * (kind == Kind::Scalar ? sizeof(UA_Double) : data.size()));
+}
+
+template <Kind kind>
+static void BM_Clone(benchmark::State &state)
+{
+    vector<UA_Byte> data(state.range(0), 0x5a);
+    Variable val = makeVariable(kind, data);
+    {
+        AllocCounter counter(state);
+        for (auto _ : state)
+        {
+            Variable copy = val.clone();
+            benchmark::DoNotOptimize(copy.get().data);
+        }
+    }
+    state.SetBytesProcessed(state.iterations() * (kind == Kind::Scalar ? sizeof(UA_Double) : data.size()));
+}
+
+template <Kind kind>
+static void BM_Encode(benchmark::State &state)
+{
+    vector<UA_Byte> data(state.range(0), 0x5a);
+    Variable val = makeVariable(kind, data);
+    size_t encoded_size = UA_calcSizeBinary(&val.get(), &UA_TYPES[UA_TYPES_VARIANT]);
+    {
+        AllocCounter counter(state);
+        for (auto _ : state)
+        {
+            UA_ByteString buf = UA_BYTESTRING_NULL;
+            UA_encodeBinary(&val.get(), &UA_TYPES[UA_TYPES_VARIANT], &buf);
+            benchmark::DoNotOptimize(buf.data);
+            UA_ByteString_clear(&buf);
+        }
+    }
+    state.SetBytesProcessed(state.iterations() * encoded_size);
+}
+
+template <Kind kind>
+static void BM_Decode(benchmark::State &state)
+{
+    vector<UA_Byte> data(state.range(0), 0x5a);
+    Variable val = makeVariable(kind, data);
+    UA_ByteString buf = UA_BYTESTRING_NULL;
+    UA_encodeBinary(&val.get(), &UA_TYPES[UA_TYPES_VARIANT], &buf);
+    {
+        AllocCounter counter(state);
+        for (auto _ : state)
+        {
+            size_t offset = 0;
+            UA_Variant decoded;
+            UA_Variant_init(&decoded);
+            UA_decodeBinary(&buf, &offset, &decoded, &UA_TYPES[UA_TYPES_VARIANT], nullptr);
+            benchmark::DoNotOptimize(decoded.data);
+            UA_Variant_clear(&decoded);
+        }
+    }
+    state.SetBytesProcessed(state.iterations() * buf.length);
+    UA_ByteString_clear(&buf);
+}
+
+// ObjectType::add 会克隆默认值，覆盖对象类型构建时的开销
+template <Kind kind>
+static void BM_ObjectTypeAdd(benchmark::State &state)
+{
+    vector<UA_Byte> data(state.range(0), 0x5a);
+    Variable val = makeVariable(kind, data);
+    ObjectType obj_type;
+    {
+        AllocCounter counter(state);
+        for (auto _ : state)
+            obj_type.add("Value", val);
+    }
+    state.SetBytesProcessed(state.iterations() * (kind == Kind::Scalar ? sizeof(UA_Double) : data.size()));
+}
+
+// configVariableAttribute 为私有函数，通过 Server::addVariableNode 间接测量，包括节点的插入。
+// 节点在测试过程中不会被删除，因此负载上限为 1 MB
+template <Kind kind>
+static void BM_AddVariableNode(benchmark::State &state)
+{
+    static bool is_init = false;
+    if (!is_init)
+    {
+        Server::init(4864);
+        is_init = true;
+    }
+    vector<UA_Byte> data(state.range(0), 0x5a);
+    Variable val = makeVariable(kind, data);
+    static size_t idx = 0;
+    {
+        AllocCounter counter(state);
+        for (auto _ : state)
+        {
+            UA_NodeId node_id = Server::addVariableNode("Value" + to_string(idx++), "Benchmark value", val);
+            benchmark::DoNotOptimize(node_id);
+        }
+    }
+    state.SetBytesProcessed(state.iterations() * (kind == Kind::Scalar ? sizeof(UA_Double) : data.size()));
+}
+
+#define VARIABLE_BENCHMARK(func, max_size)                                                 \
+    BENCHMARK_TEMPLATE(func, Kind::Scalar)->Arg(8);                                        \
+    BENCHMARK_TEMPLATE(func, Kind::String)->RangeMultiplier(8)->Range(1, max_size);        \
+    BENCHMARK_TEMPLATE(func, Kind::Array)->RangeMultiplier(8)->Range(1, max_size)
+
+VARIABLE_BENCHMARK(BM_Construct, 32 << 20);
+VARIABLE_BENCHMARK(BM_Clone, 32 << 20);
+VARIABLE_BENCHMARK(BM_Encode, 32 << 20);
+VARIABLE_BENCHMARK(BM_Decode, 32 << 20);
+VARIABLE_BENCHMARK(BM_ObjectTypeAdd, 32 << 20);
+VARIABLE_BENCHMARK(BM_AddVariableNode, 1 << 20);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,129 @@
+/**
+ * @file write_scheduler_bench.cpp
+ * @author 赵曦 (535394140@qq.com)
+ * @brief Caller blocking time, request count and server CPU of slider-style writes, direct against coalesced
+ * @version 1.0
+ * @date 2023-03-22
+ *
+ * @copyright Copyright (c) 2023, zhaoxi
+ *
+ */
+
+#include <cstdlib>
+
+#include "asmpro/opcua_cs/write_scheduler.hpp"
+#include "bench_utility.hpp"
+
+using namespace std;
+using namespace ua;
+
+static constexpr UA_UInt16 port = 4877;
+static constexpr size_t slider_count = 4;
+
+static void buildModel()
+{
+    for (size_t i = 0; i < slider_count; ++i)
+        Server::addVariableNode("Slider[" + to_string(i) + "]", "Operator slider", Variable(0.0));
+}
+
+/**
+ * @brief 模拟操作员拖动滑块，以固定频率轮流改变各滑块的值
+ *
+ * @param write 执行一次写入的函数
+ * @param rate UI 变更事件的频率 (单位：Hz)
+ * @param seconds 持续时间 (单位：s)
+ * @param blocking 每次写入的调用耗时 (单位：us)
+ * @return 实际产生的事件数
+ */
+static size_t drag(const function<void(size_t, double)> &write, double rate, double seconds, vector<double> &blocking)
+{
+    auto period = chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(1.0 / rate));
+    auto next = chrono::steady_clock::now();
+    auto end = next + chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(seconds));
+    size_t events = 0;
+    while (chrono::steady_clock::now() < end)
+    {
+        this_thread::sleep_until(next);
+        next += period;
+        double begin = bench::nowMicros();
+        write(events % slider_count, static_cast<double>(events));
+        blocking.push_back(bench::nowMicros() - begin);
+        ++events;
+    }
+    return events;
+}
+
+static string directResult(Client &client, const vector<UA_NodeId> &sliders, pid_t server, double rate, double seconds)
+{
+    vector<double> blocking;
+    UA_UInt64 requests = client.requests();
+    double server_cpu = bench::processCpuSeconds(server);
+    size_t events = drag([&](size_t i, double x) { client.writeVariable(sliders[i], Variable(x)); }, rate, seconds,
+                         blocking);
+    server_cpu = bench::processCpuSeconds(server) - server_cpu;
+    requests = client.requests() - requests;
+    ostringstream os;
+    os << "{\"mode\": \"direct\", \"events\": " << events << ", \"requests\": " << requests
+       << ", \"blocking_us\": " << bench::toJson(bench::summarize(blocking)) << ", \"server_cpu_s\": " << server_cpu
+       << "}";
+    return os.str();
+}
+
+static string coalescedResult(Client &client, const vector<UA_NodeId> &sliders, pid_t server, double rate,
+                              double seconds, double max_rate)
+{
+    vector<double> blocking;
+    UA_UInt64 requests = client.requests();
+    double server_cpu = bench::processCpuSeconds(server);
+    WriteScheduler scheduler(client, max_rate);
+    future<UA_StatusCode> last;
+    size_t events = drag([&](size_t i, double x) { last = scheduler.write(sliders[i], Variable(x)); }, rate, seconds,
+                         blocking);
+    // 最后一次变更从提交到被服务器确认的延迟
+    double begin = bench::nowMicros();
+    UA_StatusCode status = last.valid() ? last.get() : UA_STATUSCODE_GOOD;
+    double settle = bench::nowMicros() - begin;
+    server_cpu = bench::processCpuSeconds(server) - server_cpu;
+    // 包括批量写入之前读取 MaxNodesPerWrite 的请求
+    requests = client.requests() - requests;
+    ostringstream os;
+    os << "{\"mode\": \"coalesced\", \"max_rate\": " << max_rate << ", \"events\": " << events
+       << ", \"requests\": " << requests << ", \"batches\": " << scheduler.batches() << ", \"written\": " << scheduler.written()
+       << ", \"blocking_us\": " << bench::toJson(bench::summarize(blocking)) << ", \"settle_us\": " << settle
+       << ", \"last_status\": \"" << UA_StatusCode_name(status) << "\", \"server_cpu_s\": " << server_cpu << "}";
+    return os.str();
+}
+
+int main(int argc, char *argv[])
+{
+    // write_scheduler_bench [out] [event_rate] [max_rate] [seconds]
+    string out = argc > 1 ? argv[1] : "write_scheduler_bench.json";
+    double rate = argc > 2 ? atof(argv[2]) : 500;
+    double max_rate = argc > 3 ? atof(argv[3]) : 20;
+    double seconds = argc > 4 ? atof(argv[4]) : 3;
+
+    pid_t server = bench::spawnServer(port, buildModel);
+    if (server < 0)
+    {
+        printf("Failed to start the server on port %u\n", port);
+        return -1;
+    }
+    Client client;
+    client.connect("opc.tcp://localhost:" + to_string(port));
+    vector<UA_NodeId> sliders;
+    for (size_t i = 0; i < slider_count; ++i)
+        sliders.push_back(
+            client.findNodeId(UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER), 1, "Slider[" + to_string(i) + "]"));
+    vector<string> modes;
+    modes.push_back(directResult(client, sliders, server, rate, seconds));
+    modes.push_back(coalescedResult(client, sliders, server, rate, seconds, max_rate));
+    client.disconnect();
+    bench::stopServer(server);
+
+    string json = "{\"benchmark\": \"write_scheduler\", \"event_rate\": " + to_string(rate) +
+                  ", \"sliders\": " + to_string(slider_count) + ", \"modes\": [";
+    for (size_t i = 0; i < modes.size(); ++i)
+        json += (i == 0 ? "" : ", ") + modes[i];
+    bench::report(json + "]}", out);
+    return 0;
+}
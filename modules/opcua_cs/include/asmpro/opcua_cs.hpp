@@ -13,5 +13,20 @@
 
 //! @defgroup opcua_cs Cient / Server in OPC UA
 
+#include "opcua_cs/async_logger.hpp"
 #include "opcua_cs/client.hpp"
+#include "opcua_cs/compression.hpp"
+#include "opcua_cs/content_hash.hpp"
+#include "opcua_cs/frame_channel.hpp"
+#include "opcua_cs/frame_delta.hpp"
+#include "opcua_cs/history.hpp"
+#include "opcua_cs/image_frame.hpp"
+#include "opcua_cs/image_preview.hpp"
+#include "opcua_cs/latency_probe.hpp"
+#include "opcua_cs/latency_tracer.hpp"
+#include "opcua_cs/proxy.hpp"
+#include "opcua_cs/recorder.hpp"
 #include "opcua_cs/server.hpp"
+#include "opcua_cs/shm_channel.hpp"
+#include "opcua_cs/trace.hpp"
+#include "opcua_cs/write_scheduler.hpp"
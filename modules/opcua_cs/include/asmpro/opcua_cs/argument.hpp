@@ -24,15 +24,39 @@ namespace ua
 
 /**
  * @brief 基于 OPC UA 协议的方法参数
+ * @note Argument 独占其名称、描述与数组维度的内存，拷贝时执行深拷贝，移动时转移所有权
  */
 class Argument
 {
     UA_Argument __argument; //!< UA_Argument
-    UA_UInt32 __size;       //!< 数组大小
 
 public:
-    Argument() = default;
-    ~Argument() = default;
+    Argument() { UA_Argument_init(&__argument); }
+    ~Argument() { UA_Argument_clear(&__argument); }
+
+    Argument(const Argument &arg) { UA_Argument_copy(&arg.__argument, &__argument); }
+    Argument(Argument &&arg) noexcept : __argument(arg.__argument) { UA_Argument_init(&arg.__argument); }
+
+    Argument &operator=(const Argument &arg)
+    {
+        if (this != &arg)
+        {
+            UA_Argument_clear(&__argument);
+            UA_Argument_copy(&arg.__argument, &__argument);
+        }
+        return *this;
+    }
+
+    Argument &operator=(Argument &&arg) noexcept
+    {
+        if (this != &arg)
+        {
+            UA_Argument_clear(&__argument);
+            __argument = arg.__argument;
+            UA_Argument_init(&arg.__argument);
+        }
+        return *this;
+    }
 
     /**
      * @brief 构造参数
@@ -44,6 +68,13 @@ public:
      */
     Argument(const std::string &name, const std::string &description, const UA_DataType *type, UA_UInt32 size = 0);
 
+    /**
+     * @brief 拷贝已有的 UA_Argument 构造参数，例如从其他服务器读取的方法参数
+     *
+     * @param arg UA_Argument
+     */
+    explicit Argument(const UA_Argument &arg) { UA_Argument_copy(&arg, &__argument); }
+
     //! 获取 UA_Argument
     const UA_Argument &get() const { return __argument; }
 };
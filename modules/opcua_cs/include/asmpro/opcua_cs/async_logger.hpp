@@ -0,0 +1,151 @@
+/**
+ * @file async_logger.hpp
+ * @author 赵曦 (535394140@qq.com)
+ * @brief Asynchronous UA_Logger writing from a background thread
+ * @version 1.0
+ * @date 2023-03-17
+ *
+ * @copyright Copyright (c) 2023, zhaoxi
+ *
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "ua_utility.hpp"
+
+namespace ua
+{
+
+//! @addtogroup opcua_cs
+//! @{
+
+/**
+ * @brief 异步日志记录器，可作为 Server、Client 的 UA_Logger
+ * @note 写入方只做级别过滤、限流与消息体的格式化，结果放入无锁的多生产者环形缓冲区，时间戳与前缀的格式化以及
+ *       文件 I/O 全部在后台线程中完成，写入方不会因输出阻塞。缓冲区满时丢弃新的消息并计数。后台线程空闲时在条件变量上
+ *       等待，仅在其等待期间写入方才会加锁唤醒。消息中的 ANSI 转义序列在输出前被移除。
+ *       同一调用点 (格式字符串) 的消息在每个限流周期内最多输出 burst 条，其余被抑制，并在周期结束后汇总为一条消息
+ */
+class AsyncLogger final
+{
+    static constexpr std::size_t msg_size = 232;                                     //!< 单条消息体的最大长度
+    static constexpr std::size_t rate_slots = 256;                                   //!< 限流表的大小
+    static constexpr std::size_t category_count = UA_LOGCATEGORY_SECURITYPOLICY + 1; //!< 日志类别数
+
+    //! 日志记录
+    struct Record
+    {
+        std::atomic_size_t seq;  //!< 序号，等于写入位置 + 1 时可被读取
+        UA_DateTime time;        //!< 记录时刻
+        UA_LogLevel level;       //!< 日志级别
+        UA_LogCategory category; //!< 日志类别
+        UA_UInt16 length;        //!< 消息体长度
+        char msg[msg_size];      //!< 消息体
+    };
+
+    //! 限流表项，以格式字符串的地址区分调用点，计数为近似值
+    struct RateEntry
+    {
+        std::atomic<const char *> key{nullptr};                        //!< 格式字符串
+        std::atomic<UA_Int64> window{0};                               //!< 当前限流周期的编号
+        std::atomic<UA_UInt32> count{0};                               //!< 当前周期内的消息数
+        std::atomic<UA_UInt32> suppressed{0};                          //!< 尚未汇总的被抑制消息数
+        std::atomic<UA_LogCategory> category{UA_LOGCATEGORY_USERLAND}; //!< 日志类别
+    };
+
+    FILE *__out;                                          //!< 输出文件
+    std::unique_ptr<Record[]> __ring;                     //!< 环形缓冲区
+    std::size_t __mask;                                   //!< 容量 - 1，容量为 2 的幂
+    std::atomic_size_t __head{0};                         //!< 写入位置
+    std::size_t __tail = 0;                               //!< 读取位置，仅由后台线程修改
+    std::atomic_size_t __written{0};                      //!< 已输出的消息数
+    std::array<std::atomic_int, category_count> __levels; //!< 各类别的最低输出级别
+    std::array<RateEntry, rate_slots> __rate;             //!< 限流表
+    std::atomic<UA_UInt32> __burst{0};                    //!< 每个周期内每个调用点最多输出的消息数，0 表示不限流
+    std::atomic<UA_UInt32> __interval_ms{1000};           //!< 限流周期 (单位：ms)
+    std::atomic<UA_UInt64> __dropped{0};                  //!< 因缓冲区已满而丢弃的消息数
+    std::atomic<UA_UInt64> __suppressed{0};               //!< 被限流抑制的消息数
+    std::atomic_bool __running{true};                     //!< 后台线程运行标志
+    std::atomic_bool __sleeping{false};                   //!< 后台线程是否正在等待新的消息
+    std::mutex __wake_mtx;                                //!< 唤醒后台线程的互斥锁
+    std::condition_variable __wake;                       //!< 唤醒后台线程的条件变量
+    std::thread __worker;                                 //!< 后台线程
+
+public:
+    /**
+     * @brief 创建异步日志记录器并启动后台线程
+     *
+     * @param out 输出文件，默认为标准输出，生命周期需长于记录器
+     * @param capacity 环形缓冲区可容纳的消息数，向上取整为 2 的幂
+     * @param level 所有类别的最低输出级别
+     */
+    explicit AsyncLogger(FILE *out = stdout, std::size_t capacity = 1 << 13, UA_LogLevel level = UA_LOGLEVEL_INFO);
+
+    //! 输出剩余的消息后停止后台线程
+    ~AsyncLogger();
+
+    AsyncLogger(const AsyncLogger &) = delete;
+    AsyncLogger &operator=(const AsyncLogger &) = delete;
+
+    /**
+     * @brief 获取绑定至此记录器的 UA_Logger，可传递给 Server::setLogger 与 Client::setLogger
+     * @note 记录器的生命周期需长于使用它的服务器与客户端
+     */
+    UA_Logger logger();
+
+    //! 设置所有类别的最低输出级别
+    void setLevel(UA_LogLevel level);
+
+    //! 设置指定类别的最低输出级别
+    inline void setLevel(UA_LogCategory category, UA_LogLevel level) { __levels[category] = level; }
+
+    /**
+     * @brief 设置重复消息的限流
+     *
+     * @param burst 每个周期内同一调用点最多输出的消息数，0 表示不限流
+     * @param interval_ms 限流周期 (单位：ms)
+     */
+    void setRateLimit(UA_UInt32 burst, UA_UInt32 interval_ms = 1000);
+
+    //! 阻塞直至调用前写入的所有消息均已输出
+    void flush();
+
+    //! 因缓冲区已满而丢弃的消息数
+    inline UA_UInt64 dropped() const { return __dropped; }
+    //! 被限流抑制的消息数
+    inline UA_UInt64 suppressed() const { return __suppressed; }
+    //! 已输出的消息数
+    inline UA_UInt64 written() const { return __written; }
+
+private:
+    //! UA_Logger 的日志回调
+    static void log(void *context, UA_LogLevel level, UA_LogCategory category, const char *msg, va_list args);
+
+    /**
+     * @brief 限流检查
+     *
+     * @return 是否允许输出该消息
+     */
+    bool admit(UA_LogCategory category, const char *msg);
+
+    //! 写入一条已格式化的消息
+    void push(UA_LogLevel level, UA_LogCategory category, const char *msg, va_list args);
+
+    //! 唤醒正在等待的后台线程
+    void wake();
+
+    //! 后台线程
+    void consume();
+};
+
+//! @} opcua_cs
+
+} // namespace ua
@@ -11,7 +11,20 @@
 
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <unordered_map>
+
 #include "argument.hpp"
+#include "compression.hpp"
+#include "image_frame.hpp"
+#include "latency_tracer.hpp"
 #include "object.hpp"
 #include "variable.hpp"
 
@@ -21,36 +34,181 @@ namespace ua
 //! @addtogroup opcua_cs
 //! @{
 
+//! 客户端读取缓存参数
+struct ReadCacheOptions
+{
+    UA_UInt32 hot_reads = 3;               //!< 变量被读取的次数达到该值后由内部订阅保持更新
+    std::size_t max_watched = 256;         //!< 内部订阅最多监视的变量数
+    UA_Double publishing_interval = 100.0; //!< 内部订阅的发布间隔 (单位：ms)
+    UA_Double sampling_interval = 100.0;   //!< 内部订阅监视项的采样间隔 (单位：ms)
+};
+
 /**
  * @brief 基于 OPC UA 协议的工业互联网客户端
  */
 class Client final
 {
+public:
+    //! 回调执行器，负责执行由网络层转交的订阅回调任务
+    using Executor = std::function<void(std::function<void()>)>;
+
+    /**
+     * @brief 携带用户上下文的数据变更回调函数，参数依次为监视项 ID、变更后的数据值
+     * @note 数据值只在回调期间有效，回调函数可以直接取走其内容 (例如与自身保存的数据值交换) 以避免深拷贝，
+     *       换入的内容由客户端在回调返回后释放
+     */
+    using DataChangeHandler = std::function<void(UA_UInt32, UA_DataValue &)>;
+
+    //! 历史数据分块回调函数，参数依次为本块的数据值首地址、数据值个数，返回 false 时停止读取
+    using HistoryHandler = std::function<bool(const UA_DataValue *, size_t)>;
+
+    //! 批量调用中的单个方法调用
+    struct MethodCall
+    {
+        UA_NodeId method_id;                                                //!< 方法节点 ID
+        std::vector<Variable> inputs;                                       //!< 输入参数列表
+        UA_NodeId object_id = UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER); //!< 父对象节点 ID
+    };
+
+    //! 批量写入中的单个变量写入
+    struct VariableWrite
+    {
+        UA_NodeId node_id; //!< 变量节点 ID
+        Variable data;     //!< 写入的值
+    };
+
+    //! 批量调用中单个方法调用的结果
+    struct CallResult
+    {
+        UA_StatusCode status = UA_STATUSCODE_GOOD; //!< 调用结果状态码
+        std::vector<Variable> outputs;             //!< 输出参数列表
+    };
+
+private:
+    //! 监视项上下文，作为 monContext 传递给回调函数，提交给执行器的任务持有其共享所有权
+    struct MonitorContext : std::enable_shared_from_this<MonitorContext>
+    {
+        Client *client = nullptr;                                       //!< 所属客户端
+        UA_NodeId node_id = UA_NODEID_NULL;                             //!< 被监视的节点 ID
+        UA_Client_DataChangeNotificationCallback data_change = nullptr; //!< 数据变更回调函数
+        UA_Client_EventNotificationCallback event = nullptr;            //!< 事件回调函数
+        DataChangeHandler on_change;                                    //!< 携带用户上下文的数据变更回调函数
+        std::optional<Codec> codec;                                     //!< 节点 Codec 属性给出的压缩编码格式，为空时不还原
+
+        ~MonitorContext() { UA_NodeId_clear(&node_id); }
+    };
+
     UA_Client *__client;             //!< 客户端指针
     UA_Boolean __is_connect = false; //!< 是否已连接
 
+    std::recursive_mutex __mtx;                            //!< 客户端服务互斥锁
+    std::atomic_uint32_t __waiting{0};                     //!< 正在等待客户端服务互斥锁的线程数
+    std::thread __loop;                                    //!< 后台事件循环线程
+    std::atomic_bool __loop_running{false};                //!< 后台事件循环运行状态
+    UA_Connection *__connection = nullptr;                 //!< 客户端的网络连接，由连接轮询函数记录，供事件循环在锁外等待数据
+    Executor __executor;                                   //!< 订阅回调执行器，为空时在网络线程中直接执行
+    std::shared_ptr<LatencyTracer> __tracer;               //!< 订阅链路延迟追踪器，为空时不追踪
+    std::list<std::shared_ptr<MonitorContext>> __monitors; //!< 监视项上下文列表，创建失败的监视项的上下文被立即移除，断开连接时清空
+    std::optional<UA_UInt32> __max_method_calls;           //!< 服务器单次 Call 请求允许的最大方法数，0 表示不限制，空表示未读取
+    std::optional<UA_UInt32> __max_writes;                 //!< 服务器单次 Write 请求允许的最大节点数，0 表示不限制，空表示未读取
+    std::atomic<UA_UInt64> __requests{0};                  //!< 客户端服务发送的请求数，不含事件循环中的发布请求
+
+    struct NodeIdHash
+    {
+        inline std::size_t operator()(const UA_NodeId &id) const { return UA_NodeId_hash(&id); }
+    };
+
+    struct NodeIdEqual
+    {
+        inline bool operator()(const UA_NodeId &lhs, const UA_NodeId &rhs) const { return UA_NodeId_equal(&lhs, &rhs); }
+    };
+
+    //! 读取缓存中的变量
+    struct CacheEntry
+    {
+        Variable value;                                //!< 缓存的值
+        std::chrono::steady_clock::time_point updated; //!< 从服务器读取或收到通知的时刻
+        UA_UInt32 reads = 0;                           //!< 被读取的次数
+        UA_UInt64 generation = 0;                      //!< 失效次数，读取期间发生失效时不保存读取结果
+        UA_Boolean stale = UA_TRUE;                    //!< 缓存的值是否失效，写入之后至下一次读取或通知前失效
+        UA_Boolean watching = UA_FALSE;                //!< 是否已尝试由内部订阅监视
+        UA_Boolean watched = UA_FALSE;                 //!< 是否正由内部订阅监视
+    };
+
+    std::atomic_bool __cache_enabled{false};                                    //!< 是否开启读取缓存
+    ReadCacheOptions __cache_options;                                           //!< 读取缓存参数
+    std::mutex __cache_mtx;                                                     //!< 读取缓存互斥锁，与客户端服务互斥锁相互独立
+    std::unordered_map<UA_NodeId, CacheEntry, NodeIdHash, NodeIdEqual> __cache; //!< 读取缓存，条目不会被删除
+    std::size_t __cache_watched = 0;                                            //!< 内部订阅正在监视的变量数
+    UA_UInt32 __cache_sub = 0;                                                  //!< 内部订阅编号，0 表示尚未创建
+    std::chrono::steady_clock::time_point __cache_alive;                        //!< 内部订阅最近一次收到通知的时刻
+    std::atomic<UA_UInt64> __cache_hits{0};                                     //!< 由读取缓存返回的读取数
+    std::atomic<UA_UInt64> __cache_misses{0};                                   //!< 发送至服务器的读取数
+
+    //! 各变量 Codec 属性的读取结果，为空表示不是压缩变量，需持有客户端服务互斥锁
+    std::unordered_map<UA_NodeId, std::optional<Codec>, NodeIdHash, NodeIdEqual> __codecs;
+
 public:
     //! 创建新的客户端对象
     Client();
-    
+
     //! 销毁客户端对象
-    ~Client()
-    {
-        disconnect();
-        UA_Client_delete(__client);
-    }
+    ~Client();
 
     /**
      * @brief 断开服务器 - 客户端连接
      */
-    inline void disconnect() { UA_Client_disconnect(__client), __is_connect = UA_FALSE; }
+    void disconnect();
 
     /**
      * @brief 监听网络并在后台处理到达的异步响应。还完成了内部管理、SecureChannels 的更新和订阅管理。
      *
      * @param timeOut 服务器响应超时时间 (单位：ms)
      */
-    inline void runIterate(UA_UInt32 timeOut) { UA_Client_run_iterate(__client, timeOut); }
+    void runIterate(UA_UInt32 timeOut);
+
+    /**
+     * @brief 启动后台事件循环线程
+     * @note 事件循环在持有客户端服务互斥锁时只处理已到达的数据，随后在锁外阻塞于网络连接，直到有数据到达或超时，
+     *       空闲时几乎不占用 CPU，其余线程调用的客户端服务无需等待网络超时
+     *
+     * @param timeout 单次网络等待的超时时间 (单位：ms)
+     */
+    void start(UA_UInt32 timeout = 100);
+
+    /**
+     * @brief 停止后台事件循环线程，等待正在进行的网络迭代结束后返回
+     */
+    void stop();
+
+    //! 后台事件循环是否正在运行
+    inline bool isRunning() const { return __loop_running; }
+
+    /**
+     * @brief 设置订阅回调执行器
+     * @note 设置执行器后，数据变更、事件通知会被深拷贝并以任务的形式提交给执行器，
+     *       使回调函数的执行不再阻塞网络层。未设置时回调在网络线程中直接执行
+     *
+     * @param executor 回调执行器，传入空对象表示恢复为直接执行
+     */
+    void setExecutor(Executor executor);
+
+    /**
+     * @brief 设置订阅链路延迟追踪器
+     * @note 设置后每个数据变更通知的源时间戳、服务器时间戳以及客户端接收、回调开始、回调结束的时刻
+     *       会被记录至追踪器。提交给执行器的回调任务共享追踪器的所有权，停止追踪后仍在排队的任务继续记录至原追踪器
+     *
+     * @param tracer 延迟追踪器，传入 nullptr 表示停止追踪
+     */
+    void setTracer(std::shared_ptr<LatencyTracer> tracer);
+
+    /**
+     * @brief 替换客户端的日志记录器，此后客户端内部与本类的日志均通过该记录器输出
+     * @note 记录器的 clear 函数会在客户端销毁时调用，使用 AsyncLogger 时可避免日志 I/O 阻塞服务调用与事件循环
+     *
+     * @param logger 日志记录器
+     */
+    void setLogger(const UA_Logger &logger);
 
     /**
      * @brief 将客户端连接至指定的服务器
@@ -87,12 +245,52 @@ public:
     /**
      * @brief 从服务器中读取指定的变量节点
      * @note 返回值的变量类型为可读可写权限
+     * @note 压缩变量 (见 Server::addCompressedVariable) 的值会被透明地还原为原始的值，
+     *       变量是否为压缩变量由第一次读取到 ByteString 标量时查询的 Codec 属性确定，其余类型的值不会查询
      *
      * @param node_id 变量节点 ID
      * @return 指定的变量
      */
     Variable readVariable(const UA_NodeId &node_id);
 
+    /**
+     * @brief 开启读取缓存，此后 readVariable(node_id, max_age) 可由本地缓存返回
+     * @note 被读取次数达到 hot_reads 的变量由内部订阅保持更新，需要调用 start 运行后台事件循环，
+     *       否则缓存仅按读取时刻判断新旧。通过本客户端写入的变量在写入后的第一次读取会访问服务器
+     *
+     * @param options 读取缓存参数
+     */
+    void enableReadCache(const ReadCacheOptions &options = ReadCacheOptions());
+
+    /**
+     * @brief 读取变量，缓存的值不超过 max_age 时直接返回，否则以 max_age 作为 Read 服务的 maxAge 读取
+     * @note 由内部订阅监视的变量的年龄为距内部订阅最近一次通知的时间加上发布间隔与采样间隔之和，
+     *       内部订阅同时监视服务器时间以保证每个发布周期至少收到一次通知。max_age 为 0 时总是访问服务器
+     *
+     * @param node_id 变量节点 ID
+     * @param max_age 允许的最大值年龄 (单位：ms)
+     * @return 指定的变量
+     */
+    Variable readVariable(const UA_NodeId &node_id, UA_Double max_age);
+
+    //! 由读取缓存返回的读取数
+    inline UA_UInt64 cacheHits() const { return __cache_hits; }
+    //! 发送至服务器的缓存读取数
+    inline UA_UInt64 cacheMisses() const { return __cache_misses; }
+    //! 客户端服务发送的请求数，包括操作限制等内部读取，不含事件循环中的发布请求
+    inline UA_UInt64 requests() const { return __requests; }
+
+    /**
+     * @brief 从服务器中读取图像变量，不拷贝像素数据
+     * @note 读取至 cv::Mat 见 image_mat.hpp
+     *
+     * @param node_id 图像变量节点 ID
+     * @param header 图像首部
+     * @param pixels 像素数据首地址，指向返回值持有的内存
+     * @return 持有图像的变量，读取失败或不是有效的图像时为空
+     */
+    Variable readImage(const UA_NodeId &node_id, ImageHeader &header, const UA_Byte *&pixels);
+
     /**
      * @brief 在客户端调用服务器中的指定方法
      *
@@ -105,16 +303,67 @@ public:
     UA_Boolean call(const UA_NodeId &node_id, const std::vector<Variable> &inputs, std::vector<Variable> &outputs,
                     const UA_NodeId &parent_id = UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER));
 
+    /**
+     * @brief 在一次 Call 服务请求中批量调用服务器中的方法
+     * @note 请求会按照服务器的 MaxNodesPerMethodCall 限制自动拆分，单个方法调用失败不影响其余调用。
+     *       输入参数以浅拷贝的形式引用，输出参数直接接管响应中的数据
+     *
+     * @param calls 方法调用列表
+     * @return 与方法调用一一对应的调用结果列表
+     */
+    std::vector<CallResult> call(const std::vector<MethodCall> &calls);
+
+    /**
+     * @brief 调用 Server::addLatencyProbe 添加的 LatencyProbe 方法，供 LatencyProbe 使用
+     * @note 发送与接收时间戳在持有客户端锁期间取得，等待其他请求或后台事件循环释放锁的时间不计入延迟
+     *
+     * @param method_id LatencyProbe 方法节点 ID
+     * @param object_id 方法所属的对象节点 ID
+     * @param send_time 发送请求的时间，同时作为输入参数
+     * @param receive_time 收到响应的时间
+     * @param outputs 输出参数列表
+     * @return 是否成功完成当前操作的状态码
+     */
+    UA_Boolean callLatencyProbe(const UA_NodeId &method_id, const UA_NodeId &object_id, UA_DateTime &send_time,
+                                UA_DateTime &receive_time, std::vector<Variable> &outputs);
+
+    /**
+     * @brief 在一次 Write 服务请求中批量写入服务器中的变量
+     * @note 请求会按照服务器的 MaxNodesPerWrite 限制自动拆分，单个变量写入失败不影响其余写入。
+     *       写入的值以浅拷贝的形式引用
+     *
+     * @param writes 变量写入列表
+     * @return 与变量写入一一对应的状态码列表
+     */
+    std::vector<UA_StatusCode> write(const std::vector<VariableWrite> &writes);
+
+    /**
+     * @brief 读取变量的原始历史数据，按续读点分块请求，每收到一块调用一次 on_chunk
+     * @note 时间范围的含义见 HistoryBuffer::read，end 早于 start 时按时间倒序返回。
+     *       回调函数在调用线程中执行，执行期间不持有客户端锁，返回 false 时释放服务器中的续读点并结束读取
+     *
+     * @param node_id 开启了历史数据记录的变量节点 ID (见 Server::enableHistory)
+     * @param start 开始时刻
+     * @param end 结束时刻，0 表示不限制
+     * @param on_chunk 历史数据分块回调函数，数据值仅在回调期间有效
+     * @param values_per_chunk 每块最多包含的数据值个数，服务器可能返回更少
+     * @return 是否成功完成当前操作的状态码
+     */
+    UA_Boolean readHistory(const UA_NodeId &node_id, UA_DateTime start, UA_DateTime end,
+                           const HistoryHandler &on_chunk, UA_UInt32 values_per_chunk = 1000);
+
     /**
      * @brief 创建订阅请求
-     * 
+     *
+     * @param publishing_interval 发布间隔，服务器会将其修正至允许的范围内 (单位：ms)
      * @return 订阅编号
      */
-    UA_UInt32 createSubscription();
+    UA_UInt32 createSubscription(UA_Double publishing_interval = 500.0);
 
     /**
      * @brief 创建变量节点监视项
-     * @note 当所监测的服务器中的变量数据发生更改时，通知监视器，执行 data_change 回调函数
+     * @note 当所监测的服务器中的变量数据发生更改时，通知监视器，执行 data_change 回调函数，
+     *       回调函数中的 monContext 参数为指向被监视节点 ID 的 UA_NodeId 指针
      *
      * @param sub_id 订阅请求 ID
      * @param node_id 待监视的节点 ID（一般是变量节点 ID，成员变量需要使用 findChildId 进行路径搜索）
@@ -124,9 +373,53 @@ public:
     UA_Boolean createVariableMonitor(UA_UInt32 sub_id, UA_NodeId node_id,
                                      UA_Client_DataChangeNotificationCallback data_change_handler);
 
+    /**
+     * @brief 在一次 CreateMonitoredItems 请求中批量创建变量节点监视项
+     * @note 每个监视项携带各自的回调函数，通知到达时直接通过监视项上下文分发，无需查表。
+     *       回调函数接收完整的数据值，包括源时间戳、服务器时间戳与状态码，压缩变量的值在回调之前被还原
+     *
+     * @param sub_id 订阅请求 ID
+     * @param node_ids 待监视的节点 ID 列表
+     * @param handlers 与节点 ID 一一对应的数据变更回调函数列表
+     * @param sampling_interval 采样间隔，0 表示以服务器允许的最快速率采样 (单位：ms)
+     * @param queue_size 服务器端每个监视项的通知队列长度
+     * @return 与节点 ID 一一对应的监视项 ID 列表，创建失败的监视项 ID 为 0
+     */
+    std::vector<UA_UInt32> createVariableMonitors(UA_UInt32 sub_id, const std::vector<UA_NodeId> &node_ids,
+                                                  std::vector<DataChangeHandler> handlers,
+                                                  UA_Double sampling_interval = 250.0, UA_UInt32 queue_size = 1);
+
+    /**
+     * @brief 在一次 CreateMonitoredItems 请求中批量创建变量节点监视项，并将通知分发至所属的应用对象
+     *
+     * @tparam _Tp 应用对象类型
+     * @param sub_id 订阅请求 ID
+     * @param node_ids 待监视的节点 ID 列表
+     * @param contexts 与节点 ID 一一对应的应用对象指针列表，对象的生命周期需长于监视项
+     * @param on_change 应用对象的数据变更处理成员函数
+     * @param sampling_interval 采样间隔，0 表示以服务器允许的最快速率采样 (单位：ms)
+     * @param queue_size 服务器端每个监视项的通知队列长度
+     * @return 与节点 ID 一一对应的监视项 ID 列表，创建失败的监视项 ID 为 0
+     */
+    template <typename _Tp>
+    std::vector<UA_UInt32> createVariableMonitors(UA_UInt32 sub_id, const std::vector<UA_NodeId> &node_ids,
+                                                  const std::vector<_Tp *> &contexts,
+                                                  void (_Tp::*on_change)(UA_UInt32, const UA_DataValue &),
+                                                  UA_Double sampling_interval = 250.0, UA_UInt32 queue_size = 1)
+    {
+        std::vector<DataChangeHandler> handlers;
+        handlers.reserve(contexts.size());
+        for (_Tp *context : contexts)
+            handlers.emplace_back([context, on_change](UA_UInt32 mon_id, const UA_DataValue &value) {
+                (context->*on_change)(mon_id, value);
+            });
+        return createVariableMonitors(sub_id, node_ids, std::move(handlers), sampling_interval, queue_size);
+    }
+
     /**
      * @brief 创建事件属性监视项
-     * 
+     * @note 回调函数中的 monContext 参数为指向被监视节点 ID 的 UA_NodeId 指针
+     *
      * @param sub_id 订阅请求 ID
      * @param node_id 待监视的节点 ID (Server ID: ns=0, s=UA_NS0ID_SERVER)
      * @param names QualifiledNames 列表
@@ -135,6 +428,93 @@ public:
      */
     UA_Boolean createEventMonitor(UA_UInt32 sub_id, UA_NodeId node_id, std::vector<std::string> &names,
                                   UA_Client_EventNotificationCallback event_handler);
+
+    //! 获取客户端配置中的日志记录器
+    inline const UA_Logger *logger() const { return &UA_Client_getConfig(__client)->logger; }
+
+    /**
+     * @brief 设置同步服务请求等待响应的超时时间，超时的请求以失败返回
+     *
+     * @param timeout 超时时间 (单位：ms)
+     */
+    inline void setTimeout(UA_UInt32 timeout)
+    {
+        auto lk = lock();
+        UA_Client_getConfig(__client)->timeout = timeout;
+    }
+
+private:
+
+    //! 获取客户端服务互斥锁，后台事件循环会优先让出给正在等待的线程
+    std::unique_lock<std::recursive_mutex> lock();
+
+    //! 为被监视的节点添加监视项上下文，调用方需持有客户端服务互斥锁
+    MonitorContext &addMonitor(const UA_NodeId &node_id);
+
+    //! 获取服务器单次 Call 请求允许的最大方法数，读取失败或服务器未限制时返回 0
+    inline UA_UInt32 maxMethodCalls()
+    {
+        return readOperationLimit(UA_NS0ID_SERVER_SERVERCAPABILITIES_OPERATIONLIMITS_MAXNODESPERMETHODCALL,
+                                  __max_method_calls);
+    }
+
+    //! 获取服务器单次 Write 请求允许的最大节点数，读取失败或服务器未限制时返回 0
+    inline UA_UInt32 maxWrites()
+    {
+        return readOperationLimit(UA_NS0ID_SERVER_SERVERCAPABILITIES_OPERATIONLIMITS_MAXNODESPERWRITE, __max_writes);
+    }
+
+    /**
+     * @brief 读取服务器的操作限制，结果缓存至 cache 中直至重新连接或断开连接
+     *
+     * @param limit_id 操作限制变量在命名空间 0 中的编号
+     * @param cache 缓存的操作限制，已读取时直接返回，读取失败也会被缓存
+     * @return 操作限制，读取失败或服务器未限制时返回 0
+     */
+    UA_UInt32 readOperationLimit(UA_UInt32 limit_id, std::optional<UA_UInt32> &cache);
+
+    /**
+     * @brief 以 Read 服务读取变量的值
+     *
+     * @param node_id 变量节点 ID
+     * @param max_age 允许服务器返回的最大值年龄 (单位：ms)
+     * @return 指定的变量，读取失败时为空
+     */
+    Variable readValue(const UA_NodeId &node_id, UA_Double max_age);
+
+    //! 为读取缓存中的变量创建内部订阅的监视项，key 指向缓存中的节点 ID
+    void watchCached(const UA_NodeId *key);
+
+    //! 使通过本客户端写入的变量的缓存失效
+    void invalidateCached(const UA_NodeId &node_id);
+
+    /**
+     * @brief 批量读取尚未查询过的变量的 Codec 属性，结果保存至 __codecs，在断开连接前有效
+     * @note 没有 Codec 属性或其值不是已知的压缩编码格式的变量不会被还原，即使其值恰好以压缩首部开头
+     *
+     * @param node_ids 变量节点 ID 列表
+     */
+    void resolveCodecs(const std::vector<UA_NodeId> &node_ids);
+
+    //! 变量的压缩编码格式，为空表示不是压缩变量
+    std::optional<Codec> codecOf(const UA_NodeId &node_id);
+
+    //! 清空 Codec 属性的读取结果
+    void clearCodecs();
+
+    //! 数据变更通知的转发函数
+    static void dataChangeHandler(UA_Client *client, UA_UInt32 sub_id, void *sub_context,
+                                  UA_UInt32 mon_id, void *mon_context, UA_DataValue *value);
+
+    //! 事件通知的转发函数
+    static void eventHandler(UA_Client *client, UA_UInt32 sub_id, void *sub_context, UA_UInt32 mon_id,
+                             void *mon_context, size_t n_event_fields, UA_Variant *event_fields);
+
+    //! 连接轮询函数，调用默认的轮询函数并记录当前线程中正在连接或迭代的客户端的网络连接
+    static UA_StatusCode pollConnection(UA_Connection *connection, UA_UInt32 timeout, const UA_Logger *logger);
+
+    //! 默认的连接轮询函数
+    static inline UA_StatusCode (*__poll_connection)(UA_Connection *, UA_UInt32, const UA_Logger *) = nullptr;
 };
 
 //! @} opcua_cs
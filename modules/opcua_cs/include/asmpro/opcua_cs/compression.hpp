@@ -0,0 +1,88 @@
+/**
+ * @file compression.hpp
+ * @author 赵曦 (535394140@qq.com)
+ * @brief Self-describing compressed ByteString encoding of large variable values
+ * @version 1.0
+ * @date 2023-03-20
+ *
+ * @copyright Copyright (c) 2023, zhaoxi
+ *
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "ua_utility.hpp"
+
+namespace ua
+{
+
+//! @addtogroup opcua_cs
+//! @{
+
+//! 压缩编码格式
+enum class Codec : UA_Byte
+{
+    None = 0,        //!< 不压缩，仅添加首部
+    Deflate = 1,     //!< zlib (deflate)
+    DeltaDeflate = 2 //!< 按字节间隔差分后 deflate，适用于像素交错存储的图像
+};
+
+//! 压缩参数
+struct Compression
+{
+    Codec codec = Codec::DeltaDeflate; //!< 压缩编码格式
+    int level = 1;                     //!< deflate 压缩等级，1 最快，9 压缩率最高
+    UA_UInt32 stride = 3;              //!< 差分的字节间隔，一般为单个像素的字节数
+
+    //! 压缩参数的文本描述，如 "delta-deflate;level=1;stride=3"，写入 Codec 属性供客户端查询
+    std::string describe() const;
+};
+
+//! 压缩编码格式的名称
+const char *codecName(Codec codec);
+
+/**
+ * @brief 从 Compression::describe 生成的文本中解析压缩编码格式
+ *
+ * @param text 压缩参数的文本描述，即压缩变量的 Codec 属性
+ * @param codec 解析得到的压缩编码格式
+ * @return 是否为已知的压缩编码格式
+ */
+bool parseCodec(const std::string &text, Codec &codec);
+
+/**
+ * @brief 压缩变量的值，结果为带首部的字节串，首部记录编码格式与原始的数据类型
+ * @note 支持元素不含指针的数组与标量，以及 ByteString 类型的标量。首部按小端字节序存储，与主机字节序无关
+ *
+ * @param value 变量的值
+ * @param options 压缩参数
+ * @param out 压缩结果，容量在多次调用之间复用
+ * @param scratch 差分的中间结果缓冲区，可在多次调用之间复用以避免分配
+ * @return 是否成功压缩
+ */
+bool compressValue(const UA_Variant &value, const Compression &options, std::vector<UA_Byte> &out,
+                   std::vector<UA_Byte> &scratch);
+
+/**
+ * @brief 判断变量的值是否具有 compressValue 生成的首部
+ * @note 任意 ByteString 都可能以相同的字节开头，只能用于已确认为压缩变量 (Codec 属性) 的节点
+ *
+ * @param value 变量的值
+ */
+bool isCompressed(const UA_Variant &value);
+
+/**
+ * @brief 将 compressValue 生成的字节串还原为原始的值
+ *
+ * @param value 压缩的值，成功时原地替换为原始的值，失败时保持不变
+ * @param codec 期望的压缩编码格式，一般由 Codec 属性得到，与首部不一致时不还原
+ * @return 是否成功还原
+ */
+bool decompressValue(UA_Variant &value, Codec codec);
+
+//! @} opcua_cs
+
+} // namespace ua
@@ -0,0 +1,46 @@
+/**
+ * @file content_hash.hpp
+ * @author 赵曦 (535394140@qq.com)
+ * @brief Fast non-cryptographic 64-bit content hash of variable values
+ * @version 1.0
+ * @date 2023-03-21
+ *
+ * @copyright Copyright (c) 2023, zhaoxi
+ *
+ */
+
+#pragma once
+
+#include "ua_utility.hpp"
+
+namespace ua
+{
+
+//! @addtogroup opcua_cs
+//! @{
+
+/**
+ * @brief 计算内存块的 64 位内容哈希
+ * @note 8 条相互独立的 64 位通道每次处理 64 字节，每条通道只用到 32×32→64 位乘法与加法，
+ *       编译器可将其自动向量化 (AVX2 每条指令处理 4 条通道)，大数组的吞吐量接近内存带宽。
+ *       哈希不具备抗碰撞的密码学性质，仅用于判断内容是否变化
+ *
+ * @param data 数据首地址
+ * @param size 数据字节数
+ * @param seed 种子，可传入前一块数据的哈希以串联多块数据
+ * @return 内容哈希
+ */
+UA_UInt64 contentHash(const void *data, std::size_t size, UA_UInt64 seed = 0);
+
+/**
+ * @brief 计算变量值的 64 位内容哈希，数据类型与数组维度同样参与计算
+ * @note 元素不含指针的数组与标量、String/ByteString 标量直接对内存计算，其余类型先进行二进制编码
+ *
+ * @param value 变量的值
+ * @return 内容哈希
+ */
+UA_UInt64 contentHash(const UA_Variant &value);
+
+//! @} opcua_cs
+
+} // namespace ua
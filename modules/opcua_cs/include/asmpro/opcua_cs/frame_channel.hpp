@@ -0,0 +1,141 @@
+/**
+ * @file frame_channel.hpp
+ * @author 赵曦 (535394140@qq.com)
+ * @brief Latest frame channel with a preallocated buffer ring
+ * @version 1.0
+ * @date 2023-03-06
+ *
+ * @copyright Copyright (c) 2023, zhaoxi
+ *
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+#include "ua_utility.hpp"
+
+namespace ua
+{
+
+//! @addtogroup opcua_cs
+//! @{
+
+/**
+ * @brief 帧通道，在网络回调与消费者线程之间传递大块数据
+ * @note 所有帧缓冲区在构造时预先分配，网络回调中的 push 仅执行一次内存拷贝，
+ *       不会因消费者处理缓慢而阻塞。缓冲区耗尽时按照丢弃策略丢弃一帧并计数。
+ *       生产者与消费者各自只能有一个线程
+ */
+class FrameChannel
+{
+public:
+    //! 缓冲区耗尽时的丢弃策略
+    enum class Policy
+    {
+        DropOldest, //!< 丢弃最旧的未读帧，保证消费者读取到最新的数据
+        DropNewest  //!< 丢弃新到达的帧，保证已缓存的帧按序读取
+    };
+
+private:
+    //! 帧缓冲区
+    struct Slot
+    {
+        std::vector<UA_Byte> data; //!< 预分配的数据缓冲区
+        std::size_t size = 0;      //!< 有效数据长度
+        UA_UInt64 seq = 0;         //!< 帧序号
+    };
+
+    std::vector<Slot> __slots;           //!< 帧缓冲区
+    std::vector<std::size_t> __free;     //!< 空闲帧缓冲区下标
+    std::vector<std::size_t> __ready;    //!< 待读取帧缓冲区下标 (环形队列)
+    std::size_t __head = 0;              //!< 待读取队列队首
+    std::size_t __count = 0;             //!< 待读取队列长度
+    Policy __policy;                     //!< 丢弃策略
+    UA_UInt64 __seq = 0;                 //!< 最新的帧序号
+    std::atomic<UA_UInt64> __pushed{0};  //!< 到达的帧数
+    std::atomic<UA_UInt64> __dropped{0}; //!< 丢弃的帧数
+
+    std::mutex __mtx;
+    std::condition_variable __cv;
+
+public:
+    /**
+     * @brief 创建帧通道
+     *
+     * @param capacity 单帧的最大字节数
+     * @param slots 帧缓冲区数量，至少为 3 (写入、读取、待读取各占一个)
+     * @param policy 缓冲区耗尽时的丢弃策略 (default: Policy::DropOldest)
+     */
+    FrameChannel(std::size_t capacity, std::size_t slots = 3, Policy policy = Policy::DropOldest);
+
+    FrameChannel(const FrameChannel &) = delete;
+    FrameChannel(FrameChannel &&) = delete;
+
+    /**
+     * @brief 将一帧数据拷贝至帧缓冲区
+     * @note 耗时仅与帧的大小有关，与消费者的处理速度无关
+     *
+     * @param data 数据首地址
+     * @param size 数据字节数
+     * @return 该帧是否被接收，帧过大或按照 Policy::DropNewest 被丢弃时返回 false
+     */
+    bool push(const void *data, std::size_t size);
+
+    /**
+     * @brief 将 UA_Variant 中的数据拷贝至帧缓冲区，可直接在数据变更回调函数中使用
+     * @note 支持数组、标量以及 ByteString 类型的数据
+     *
+     * @param value 数据变更通知中的值
+     * @return 该帧是否被接收
+     */
+    bool push(const UA_Variant &value);
+
+    /**
+     * @brief 读取最早的一帧待读取数据
+     * @note 读取期间该帧缓冲区由消费者独占，不会被生产者覆盖
+     *
+     * @param f 读取函数，签名为 void(const UA_Byte *data, std::size_t size, UA_UInt64 seq)，
+     *          其中 seq 为帧序号，可以通过序号的间隔判断丢帧情况
+     * @param timeout 等待数据的超时时间 (单位：ms)
+     * @return 是否在超时前读取到数据
+     */
+    template <typename _Callable>
+    bool consume(_Callable &&f, UA_UInt32 timeout)
+    {
+        std::unique_lock<std::mutex> lk(__mtx);
+        if (!__cv.wait_for(lk, std::chrono::milliseconds(timeout), [this]() { return __count > 0; }))
+            return false;
+        std::size_t idx = __ready[__head];
+        __head = (__head + 1) % __ready.size();
+        --__count;
+        lk.unlock();
+        //!< Release the slot even if the reader throws
+        struct Release
+        {
+            FrameChannel *channel;
+            std::size_t idx;
+            ~Release()
+            {
+                std::lock_guard<std::mutex> lk(channel->__mtx);
+                channel->__free.push_back(idx);
+            }
+        } release{this, idx};
+        const Slot &slot = __slots[idx];
+        f(static_cast<const UA_Byte *>(slot.data.data()), slot.size, slot.seq);
+        return true;
+    }
+
+    //! 到达的帧数
+    inline UA_UInt64 pushed() const { return __pushed; }
+    //! 丢弃的帧数
+    inline UA_UInt64 dropped() const { return __dropped; }
+};
+
+//! @} opcua_cs
+
+} // namespace ua
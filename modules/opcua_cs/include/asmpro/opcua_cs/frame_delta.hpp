@@ -0,0 +1,120 @@
+/**
+ * @file frame_delta.hpp
+ * @author 赵曦 (535394140@qq.com)
+ * @brief Dirty-tile delta encoding of large array values and the client-side frame assembler
+ * @version 1.0
+ * @date 2023-03-21
+ *
+ * @copyright Copyright (c) 2023, zhaoxi
+ *
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "ua_utility.hpp"
+
+namespace ua
+{
+
+//! @addtogroup opcua_cs
+//! @{
+
+//! 差分参数
+struct DeltaOptions
+{
+    UA_UInt32 tile_size = 4096;       //!< 比较的块大小 (单位：字节)，640×480 BGR888 图像约 225 块
+    UA_UInt32 keyframe_interval = 30; //!< 每隔多少帧发送一次完整帧，供新加入或丢失差分的客户端同步，0 表示从不
+    double max_dirty_ratio = 0.5;     //!< 变化的字节比例超过该值时直接发送完整帧
+};
+
+/**
+ * @brief 差分编码器，比较连续两帧，只输出变化的块
+ * @note 结果为带首部的字节串：首部 (魔数、标志、块大小、区段数、帧序号、帧字节数)、
+ *       区段表 (偏移量与长度) 以及各区段的数据。相邻的变化块合并为一个区段。
+ *       编码器保存上一帧的拷贝，每帧只拷贝变化的区段
+ */
+class DeltaEncoder final
+{
+    DeltaOptions __options;          //!< 差分参数
+    std::vector<UA_Byte> __previous; //!< 上一帧
+    UA_UInt64 __seq = 0;             //!< 已编码的帧数
+    UA_UInt64 __keyframes = 0;       //!< 已编码的完整帧数
+
+public:
+    explicit DeltaEncoder(const DeltaOptions &options = DeltaOptions()) : __options(options) {}
+
+    /**
+     * @brief 编码一帧
+     *
+     * @param data 帧数据首地址
+     * @param size 帧字节数
+     * @param out 编码结果，容量在多次调用之间复用
+     */
+    void encode(const UA_Byte *data, std::size_t size, std::vector<UA_Byte> &out);
+
+    /**
+     * @brief 编码变量的值，支持元素不含指针的数组与标量，以及 ByteString 类型的标量
+     *
+     * @param value 变量的值
+     * @param out 编码结果
+     * @return 是否成功编码
+     */
+    bool encode(const UA_Variant &value, std::vector<UA_Byte> &out);
+
+    //! 已编码的帧数
+    inline UA_UInt64 encoded() const { return __seq; }
+    //! 已编码的完整帧数
+    inline UA_UInt64 keyframes() const { return __keyframes; }
+};
+
+/**
+ * @brief 差分组装器，将差分应用至持久的帧缓冲区，在客户端重建完整帧
+ * @note 帧序号不连续 (订阅丢失了差分) 时丢弃后续差分，直到收到下一个完整帧。
+ *       可直接在数据变更回调函数中使用，每个组装器只能有一个线程
+ */
+class DeltaAssembler final
+{
+    std::vector<UA_Byte> __frame; //!< 当前的完整帧
+    UA_UInt64 __seq = 0;          //!< 当前帧的序号
+    bool __synced = false;        //!< 当前帧是否有效
+    UA_UInt64 __applied = 0;      //!< 应用的差分与完整帧数
+    UA_UInt64 __gaps = 0;         //!< 检测到的序号间断次数
+    UA_UInt64 __discarded = 0;    //!< 未同步时丢弃的差分数
+
+public:
+    /**
+     * @brief 应用一个差分
+     *
+     * @param data 差分首地址
+     * @param size 差分字节数
+     * @return 应用后当前帧是否有效
+     */
+    bool apply(const UA_Byte *data, std::size_t size);
+
+    /**
+     * @brief 应用差分变量的值
+     *
+     * @param value 差分变量的值 (ByteString 标量)
+     * @return 应用后当前帧是否有效
+     */
+    bool apply(const UA_Variant &value);
+
+    //! 当前帧是否有效
+    inline bool synced() const { return __synced; }
+    //! 当前的完整帧，仅在 synced() 时有效
+    inline const std::vector<UA_Byte> &frame() const { return __frame; }
+    //! 当前帧的序号
+    inline UA_UInt64 seq() const { return __seq; }
+    //! 应用的差分与完整帧数
+    inline UA_UInt64 applied() const { return __applied; }
+    //! 检测到的序号间断次数
+    inline UA_UInt64 gaps() const { return __gaps; }
+    //! 未同步时丢弃的差分数
+    inline UA_UInt64 discarded() const { return __discarded; }
+};
+
+//! @} opcua_cs
+
+} // namespace ua
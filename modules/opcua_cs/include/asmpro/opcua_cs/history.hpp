@@ -0,0 +1,135 @@
+/**
+ * @file history.hpp
+ * @author 赵曦 (535394140@qq.com)
+ * @brief Per-node history storage with an in-memory ring and memory-mapped spill segments
+ * @version 1.0
+ * @date 2023-03-22
+ *
+ * @copyright Copyright (c) 2023, zhaoxi
+ *
+ */
+
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "ua_utility.hpp"
+
+namespace ua
+{
+
+//! @addtogroup opcua_cs
+//! @{
+
+//! 历史数据的存储参数
+struct HistoryOptions
+{
+    std::size_t capacity = 4096;    //!< 内存环形缓冲区的样本数
+    std::size_t segment_size = 0;   //!< 单个溢出段文件的字节数，0 表示不溢出，环形缓冲区满时直接丢弃最旧的样本
+    std::string directory = "/tmp"; //!< 溢出段文件所在的目录
+};
+
+/**
+ * @brief 单个变量的历史数据存储
+ * @note 最新的样本以 DataValue 拷贝保存在内存环形缓冲区中，被挤出的样本以 OPC UA 二进制编码追加至内存映射的溢出段。
+ *       溢出段共两个并轮流使用，当前段写满时清空另一段继续写入，因此磁盘占用不超过 2 倍的 segment_size。
+ *       段文件创建后即被删除，仅用于让内核在内存紧张时将冷数据换出至页缓存，不会在进程重启后保留。
+ *       每个样本按写入顺序分配连续的序号，序号至存储位置的映射为 O(1)，时间范围查询为对序号的二分查找。
+ *       样本的键为源时间戳 (缺失时依次使用服务器时间戳、写入时刻)，早于上一个样本的键被修正为上一个样本的键，
+ *       以保证键单调不减。线程安全
+ */
+class HistoryBuffer final
+{
+    //! 溢出段
+    struct Segment
+    {
+        UA_Byte *base = nullptr;          //!< 映射的段文件
+        std::size_t used = 0;             //!< 已写入的字节数
+        UA_UInt64 first = 0;              //!< 段中第一个样本的序号
+        std::vector<UA_DateTime> keys;    //!< 段中各样本的键
+        std::vector<std::size_t> offsets; //!< 段中各样本的编码起始位置
+    };
+
+    mutable std::mutex __mtx;             //!< 存储互斥锁
+    std::vector<UA_DataValue> __ring;     //!< 内存环形缓冲区
+    std::vector<UA_DateTime> __ring_keys; //!< 环形缓冲区中各样本的键
+    std::size_t __head = 0;               //!< 环形缓冲区中最旧样本的位置
+    std::size_t __count = 0;              //!< 环形缓冲区中的样本数
+    UA_UInt64 __ring_first = 1;           //!< 环形缓冲区中最旧样本的序号
+    UA_DateTime __last_key = 0;           //!< 最新样本的键
+    std::size_t __segment_size;           //!< 单个溢出段的字节数
+    Segment __segments[2];                //!< 溢出段，__segments[__active] 为当前写入的段
+    int __active = 0;                     //!< 当前写入的溢出段
+    std::atomic<UA_UInt64> __spilled{0};  //!< 写入溢出段的样本数
+    std::atomic<UA_UInt64> __dropped{0};  //!< 被丢弃的样本数
+
+public:
+    /**
+     * @brief 创建历史数据存储，segment_size 非 0 时创建并映射两个溢出段文件
+     * @note 段文件创建失败时退化为仅使用内存环形缓冲区
+     *
+     * @param options 存储参数
+     */
+    explicit HistoryBuffer(const HistoryOptions &options = HistoryOptions());
+
+    ~HistoryBuffer();
+
+    HistoryBuffer(const HistoryBuffer &) = delete;
+    HistoryBuffer &operator=(const HistoryBuffer &) = delete;
+
+    /**
+     * @brief 追加一个样本
+     *
+     * @param value 数据值，被深拷贝
+     */
+    void append(const UA_DataValue &value);
+
+    /**
+     * @brief 读取键位于时间范围内的样本，end 早于 start 时按时间倒序返回 (end, start] 内的样本
+     * @note 正序返回 [start, end) 内的样本，end 为 0 表示不限制结束时刻，start 为 0 表示从最旧的样本开始
+     *
+     * @param start 开始时刻
+     * @param end 结束时刻
+     * @param max_values 最多返回的样本数，0 表示不限制
+     * @param from 续读序号，即上一次调用的返回值，0 表示从范围的起点开始
+     * @param values 追加读取到的样本，由调用者负责释放
+     * @return 正序时为下一个待读取样本的序号，倒序时为下一个待读取样本的序号加 1，0 表示已读完
+     */
+    UA_UInt64 read(UA_DateTime start, UA_DateTime end, std::size_t max_values, UA_UInt64 from,
+                   std::vector<UA_DataValue> &values) const;
+
+    //! 当前保存的样本数
+    std::size_t size() const;
+    //! 是否启用了溢出段，映射溢出段失败时仅使用内存环形缓冲区
+    inline bool spilling() const { return __segment_size > 0; }
+    //! 写入溢出段的样本数
+    inline UA_UInt64 spilled() const { return __spilled; }
+    //! 被丢弃的样本数
+    inline UA_UInt64 dropped() const { return __dropped; }
+
+private:
+    //! 最旧样本的序号，需持有存储互斥锁
+    UA_UInt64 first() const;
+
+    //! 下一个样本的序号，需持有存储互斥锁
+    inline UA_UInt64 next() const { return __ring_first + __count; }
+
+    //! 指定序号的样本的键，需持有存储互斥锁
+    UA_DateTime keyAt(UA_UInt64 seq) const;
+
+    //! 拷贝或解码指定序号的样本，需持有存储互斥锁
+    UA_Boolean valueAt(UA_UInt64 seq, UA_DataValue &value) const;
+
+    //! 第一个键不小于 key 的样本的序号，需持有存储互斥锁
+    UA_UInt64 lowerBound(UA_DateTime key) const;
+
+    //! 将环形缓冲区中最旧的样本编码至溢出段，需持有存储互斥锁
+    void spill(const UA_DataValue &value, UA_DateTime key);
+};
+
+//! @} opcua_cs
+
+} // namespace ua
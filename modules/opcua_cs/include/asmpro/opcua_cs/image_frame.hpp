@@ -0,0 +1,99 @@
+/**
+ * @file image_frame.hpp
+ * @author 赵曦 (535394140@qq.com)
+ * @brief Image value consisting of a fixed header and the pixels in a single ByteString
+ * @version 1.0
+ * @date 2023-03-20
+ *
+ * @copyright Copyright (c) 2023, zhaoxi
+ *
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "ua_utility.hpp"
+
+namespace ua
+{
+
+//! @addtogroup opcua_cs
+//! @{
+
+//! 像素格式
+enum class PixelFormat : UA_UInt16
+{
+    Unknown = 0, //!< 未知格式，按 channels 与 8 位通道解释
+    Mono8 = 1,   //!< 8 位灰度
+    BGR8 = 2,    //!< 8 位 BGR 交错
+    RGB8 = 3,    //!< 8 位 RGB 交错
+    BGRA8 = 4,   //!< 8 位 BGRA 交错
+    Mono16 = 5   //!< 16 位灰度
+};
+
+//! 像素格式的名称
+const char *pixelFormatName(PixelFormat format);
+
+/**
+ * @brief 图像首部，以固定布局存储于 ByteString 的开头，像素数据紧随其后
+ * @note 首部按主机字节序存储，仅在同一主机或字节序相同的主机之间传递
+ */
+struct ImageHeader
+{
+    UA_Byte magic[4] = {0x89, 'U', 'A', 'I'};  //!< 魔数
+    UA_UInt16 version = 1;                     //!< 首部版本
+    PixelFormat format = PixelFormat::Unknown; //!< 像素格式
+    UA_UInt32 width = 0;                       //!< 宽度 (单位：像素)
+    UA_UInt32 height = 0;                      //!< 高度 (单位：像素)
+    UA_UInt32 channels = 0;                    //!< 通道数
+    UA_UInt32 stride = 0;                      //!< 像素数据中每行的字节数，不小于 rowSize()
+    UA_UInt64 frame = 0;                       //!< 帧计数器
+    UA_DateTime timestamp = 0;                 //!< 采集时间戳
+
+    //! 单个通道的字节数
+    inline UA_UInt32 channelSize() const { return format == PixelFormat::Mono16 ? 2 : 1; }
+    //! 每行有效像素的字节数
+    inline std::size_t rowSize() const { return std::size_t(width) * channels * channelSize(); }
+    //! 像素数据的字节数
+    inline std::size_t payloadSize() const { return std::size_t(stride) * height; }
+};
+
+static_assert(sizeof(ImageHeader) == 40, "ImageHeader must keep its wire layout");
+
+/**
+ * @brief 将图像编码为带首部的字节串
+ * @note 像素数据按行拷贝一次，行间填充被去除，结果中 stride 等于 rowSize()
+ *
+ * @param header 图像首部，stride 字段被忽略
+ * @param data 像素数据首地址
+ * @param src_stride 源像素数据中每行的字节数，0 表示行间无填充
+ * @param buffer 编码结果，容量在多次调用之间复用
+ * @return 是否成功编码
+ */
+bool encodeImage(const ImageHeader &header, const UA_Byte *data, std::size_t src_stride, std::vector<UA_Byte> &buffer);
+
+/**
+ * @brief 解析带首部的字节串，不拷贝像素数据
+ *
+ * @param data 字节串首地址
+ * @param size 字节串字节数
+ * @param header 图像首部
+ * @param pixels 像素数据首地址，指向 data 内部
+ * @return 是否为有效的图像
+ */
+bool decodeImage(const UA_Byte *data, std::size_t size, ImageHeader &header, const UA_Byte *&pixels);
+
+/**
+ * @brief 解析 ByteString 类型的图像变量的值，不拷贝像素数据
+ *
+ * @param value 图像变量的值
+ * @param header 图像首部
+ * @param pixels 像素数据首地址，在 value 的生命周期内有效
+ * @return 是否为有效的图像
+ */
+bool decodeImage(const UA_Variant &value, ImageHeader &header, const UA_Byte *&pixels);
+
+//! @} opcua_cs
+
+} // namespace ua
@@ -0,0 +1,140 @@
+/**
+ * @file image_mat.hpp
+ * @author 赵曦 (535394140@qq.com)
+ * @brief Header-only cv::Mat adapters for image variables
+ * @version 1.0
+ * @date 2023-03-20
+ *
+ * @copyright Copyright (c) 2023, zhaoxi
+ *
+ */
+
+#pragma once
+
+#include <opencv2/core.hpp>
+
+#include "client.hpp"
+#include "server.hpp"
+
+namespace ua
+{
+
+//! @addtogroup opcua_cs
+//! @{
+
+// 模块本身不依赖 OpenCV，本文件仅由链接了 OpenCV 的目标包含，未加入 opcua_cs.hpp
+
+//! cv::Mat 对应的像素格式，3 通道与 4 通道按 OpenCV 的惯例视为 BGR 与 BGRA
+inline PixelFormat pixelFormatOf(const cv::Mat &mat)
+{
+    switch (mat.type())
+    {
+    case CV_8UC1:
+        return PixelFormat::Mono8;
+    case CV_8UC3:
+        return PixelFormat::BGR8;
+    case CV_8UC4:
+        return PixelFormat::BGRA8;
+    case CV_16UC1:
+        return PixelFormat::Mono16;
+    default:
+        return PixelFormat::Unknown;
+    }
+}
+
+//! 图像首部对应的 cv::Mat 类型
+inline int matTypeOf(const ImageHeader &header)
+{
+    if (header.format == PixelFormat::Mono16)
+        return CV_16UC1;
+    return CV_8UC(static_cast<int>(header.channels));
+}
+
+/**
+ * @brief 构造引用像素数据的 cv::Mat，不拷贝像素数据
+ *
+ * @param header 图像首部
+ * @param pixels 像素数据首地址
+ * @return 引用像素数据的 cv::Mat，其生命周期不能超过像素数据
+ */
+inline cv::Mat imageView(const ImageHeader &header, const UA_Byte *pixels)
+{
+    if (header.width == 0 || header.height == 0 || header.channels == 0 || header.channels > CV_CN_MAX)
+        return cv::Mat();
+    return cv::Mat(static_cast<int>(header.height), static_cast<int>(header.width), matTypeOf(header),
+                   const_cast<UA_Byte *>(pixels), header.stride);
+}
+
+/**
+ * @brief 构造引用图像变量的值的 cv::Mat，不拷贝像素数据，可直接在数据变更回调函数中使用
+ *
+ * @param value 图像变量的值
+ * @param header 图像首部，可为 nullptr
+ * @return 引用像素数据的 cv::Mat，不是有效的图像时为空，其生命周期不能超过 value
+ */
+inline cv::Mat imageView(const UA_Variant &value, ImageHeader *header = nullptr)
+{
+    ImageHeader h;
+    const UA_Byte *pixels = nullptr;
+    if (!decodeImage(value, h, pixels))
+        return cv::Mat();
+    if (header != nullptr)
+        *header = h;
+    return imageView(h, pixels);
+}
+
+/**
+ * @brief 把 cv::Mat 写入服务器中的图像变量
+ * @note 像素数据仅被拷贝至编码缓冲区一次，不连续的 cv::Mat (如 ROI) 按行拷贝
+ *
+ * @param node_id 图像变量节点 ID
+ * @param mat 图像
+ * @param frame 帧计数器
+ * @param timestamp 采集时间戳，作为源时间戳
+ * @param format 像素格式，Unknown 表示由 cv::Mat 的类型推断
+ * @return 是否成功写入变量节点
+ */
+inline UA_Boolean writeImage(const UA_NodeId &node_id, const cv::Mat &mat, UA_UInt64 frame,
+                             UA_DateTime timestamp = UA_DateTime_now(), PixelFormat format = PixelFormat::Unknown)
+{
+    if (mat.dims != 2 || (mat.depth() != CV_8U && mat.depth() != CV_16U))
+        return UA_FALSE;
+    ImageHeader header;
+    header.format = format != PixelFormat::Unknown ? format : pixelFormatOf(mat);
+    header.width = static_cast<UA_UInt32>(mat.cols);
+    header.height = static_cast<UA_UInt32>(mat.rows);
+    header.channels = static_cast<UA_UInt32>(mat.channels());
+    header.frame = frame;
+    header.timestamp = timestamp;
+    return Server::writeImage(node_id, header, mat.data, mat.step[0]);
+}
+
+/**
+ * @brief 从服务器中读取图像变量至 cv::Mat
+ * @note 像素数据从响应中拷贝一次至 mat，尺寸与类型不变时复用 mat 的内存
+ *
+ * @param client 客户端
+ * @param node_id 图像变量节点 ID
+ * @param mat 读取的图像
+ * @param header 图像首部，可为 nullptr
+ * @return 是否成功读取
+ */
+inline bool readImage(Client &client, const UA_NodeId &node_id, cv::Mat &mat, ImageHeader *header = nullptr)
+{
+    ImageHeader h;
+    const UA_Byte *pixels = nullptr;
+    Variable value = client.readImage(node_id, h, pixels);
+    if (value.empty())
+        return false;
+    cv::Mat view = imageView(h, pixels);
+    if (view.empty())
+        return false;
+    view.copyTo(mat);
+    if (header != nullptr)
+        *header = h;
+    return true;
+}
+
+//! @} opcua_cs
+
+} // namespace ua
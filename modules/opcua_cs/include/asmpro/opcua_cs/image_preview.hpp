@@ -0,0 +1,82 @@
+/**
+ * @file image_preview.hpp
+ * @author 赵曦 (535394140@qq.com)
+ * @brief Preview (downscale, Mono8, ROI) kernels for image variables
+ * @version 1.0
+ * @date 2023-03-19
+ *
+ * @copyright Copyright (c) 2023, zhaoxi
+ *
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "ua_utility.hpp"
+
+namespace ua
+{
+
+//! @addtogroup opcua_cs
+//! @{
+
+/**
+ * @brief 图像预览的参数，图像为按行存储、通道交错的 Byte 数组 (如 BGR888 或 Mono8)
+ * @note 处理顺序为裁剪 ROI、转换 Mono8、缩放。目标尺寸为 ROI 尺寸的整数分之一时使用区域平均，
+ *       否则使用最近邻采样
+ */
+struct ImagePreview
+{
+    UA_UInt32 src_width = 0;    //!< 源图像宽度
+    UA_UInt32 src_height = 0;   //!< 源图像高度
+    UA_UInt32 src_channels = 3; //!< 源图像通道数
+    UA_UInt32 width = 0;        //!< 预览宽度，0 表示与 ROI 宽度相同
+    UA_UInt32 height = 0;       //!< 预览高度，0 表示与 ROI 高度相同
+    UA_Boolean mono = false;    //!< 是否将 BGR888 转换为 Mono8
+    UA_UInt32 roi_x = 0;        //!< ROI 左上角横坐标
+    UA_UInt32 roi_y = 0;        //!< ROI 左上角纵坐标
+    UA_UInt32 roi_width = 0;    //!< ROI 宽度，0 表示至源图像右边界
+    UA_UInt32 roi_height = 0;   //!< ROI 高度，0 表示至源图像下边界
+
+    //! 实际的 ROI 宽度
+    inline UA_UInt32 roiWidth() const { return roi_width != 0 ? roi_width : src_width - roi_x; }
+    //! 实际的 ROI 高度
+    inline UA_UInt32 roiHeight() const { return roi_height != 0 ? roi_height : src_height - roi_y; }
+    //! 实际的预览宽度
+    inline UA_UInt32 outWidth() const { return width != 0 ? width : roiWidth(); }
+    //! 实际的预览高度
+    inline UA_UInt32 outHeight() const { return height != 0 ? height : roiHeight(); }
+    //! 预览的通道数
+    inline UA_UInt32 outChannels() const { return mono && src_channels == 3 ? 1 : src_channels; }
+    //! 源图像的字节数
+    inline std::size_t srcSize() const { return std::size_t(src_width) * src_height * src_channels; }
+    //! 预览的字节数
+    inline std::size_t outSize() const { return std::size_t(outWidth()) * outHeight() * outChannels(); }
+
+    //! 参数是否有效：ROI 位于源图像内，且预览尺寸不大于 ROI 尺寸
+    bool valid() const;
+};
+
+/**
+ * @brief 将 BGR888 像素转换为 Mono8，使用 BT.601 系数的 8 位定点近似
+ *
+ * @param src BGR888 像素
+ * @param dst Mono8 像素
+ * @param pixels 像素数
+ */
+void bgrToMono(const UA_Byte *src, UA_Byte *dst, std::size_t pixels);
+
+/**
+ * @brief 生成图像预览
+ *
+ * @param src 源图像，字节数为 preview.srcSize()
+ * @param preview 预览参数，需满足 preview.valid()
+ * @param dst 预览图像，字节数为 preview.outSize()
+ * @param buffer 中间结果的缓冲区，可在多次调用之间复用以避免分配
+ */
+void makePreview(const UA_Byte *src, const ImagePreview &preview, UA_Byte *dst, std::vector<UA_UInt32> &buffer);
+
+//! @} opcua_cs
+
+} // namespace ua
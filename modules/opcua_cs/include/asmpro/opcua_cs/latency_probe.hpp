@@ -0,0 +1,128 @@
+/**
+ * @file latency_probe.hpp
+ * @author 赵曦 (535394140@qq.com)
+ * @brief NTP-style latency probe and clock offset estimation against Server::addLatencyProbe
+ * @version 1.0
+ * @date 2023-03-18
+ *
+ * @copyright Copyright (c) 2023, zhaoxi
+ *
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include "client.hpp"
+
+namespace ua
+{
+
+//! @addtogroup opcua_cs
+//! @{
+
+/**
+ * @brief 延迟探测器，基于 Server::addLatencyProbe 添加的 LatencyProbe 方法进行 NTP 式的时间戳交换
+ * @note 每次交换得到 4 个时间戳：客户端发送 t1、服务器接收 t2、服务器发送 t3、客户端接收 t4，
+ *       往返网络延迟为 (t4 - t1) - (t3 - t2)，时钟偏差 (服务器 - 客户端) 为 ((t2 - t1) + (t3 - t4)) / 2。
+ *       与 NTP 相同，时钟偏差取窗口内网络延迟最小的一次交换的估计值，再据此拆分上行、下行的单向延迟。
+ *       t1 与 t4 在持有客户端锁期间取得 (见 Client::callLatencyProbe)，可与客户端的后台事件循环同时运行。
+ *       可调用 start 在后台线程中周期性探测，作为生产环境的健康信号
+ */
+class LatencyProbe
+{
+public:
+    //! 单次交换的时间戳 (UA_DateTime，单位：100 ns)
+    struct Sample
+    {
+        UA_DateTime client_send = 0;    //!< t1
+        UA_DateTime server_receive = 0; //!< t2
+        UA_DateTime server_send = 0;    //!< t3
+        UA_DateTime client_receive = 0; //!< t4
+
+        //! 往返时间 t4 - t1
+        inline UA_Int64 roundTrip() const { return client_receive - client_send; }
+        //! 服务器处理时间 t3 - t2
+        inline UA_Int64 server() const { return server_send - server_receive; }
+        //! 往返网络延迟，不包括服务器处理时间
+        inline UA_Int64 delay() const { return roundTrip() - server(); }
+        //! 时钟偏差估计值 (服务器 - 客户端)
+        inline UA_Int64 offset() const { return ((server_receive - client_send) + (server_send - client_receive)) / 2; }
+    };
+
+    //! 窗口内的统计结果 (单位：us)
+    struct Stats
+    {
+        std::size_t count = 0;     //!< 窗口内成功的交换次数
+        UA_UInt64 failures = 0;    //!< 累计失败的交换次数
+        double offset = 0;         //!< 时钟偏差 (服务器 - 客户端)，取网络延迟最小的交换
+        double min_delay = 0;      //!< 最小往返网络延迟
+        double uplink = 0;         //!< 上行单向延迟中位数，按时钟偏差校正
+        double downlink = 0;       //!< 下行单向延迟中位数，按时钟偏差校正
+        double server = 0;         //!< 服务器处理时间中位数
+        double round_trip_p50 = 0; //!< 往返时间中位数
+        double round_trip_p99 = 0; //!< 往返时间 99% 分位数
+        double round_trip_max = 0; //!< 往返时间最大值
+    };
+
+private:
+    Client &__client;                  //!< 客户端
+    UA_NodeId __method_id;             //!< LatencyProbe 方法节点 ID
+    UA_NodeId __object_id;             //!< 方法所属的对象节点 ID
+    std::size_t __window;              //!< 统计窗口的大小
+    std::deque<Sample> __samples;      //!< 最近的交换结果
+    UA_UInt64 __failures = 0;          //!< 累计失败的交换次数
+    mutable std::mutex __mtx;          //!< 交换结果互斥锁
+    std::atomic_bool __running{false}; //!< 后台探测运行标志
+    std::condition_variable __cv;      //!< 用于停止时唤醒后台线程
+    std::thread __worker;              //!< 后台探测线程
+
+public:
+    /**
+     * @brief 创建延迟探测器
+     *
+     * @param client 已连接的客户端，生命周期需长于探测器
+     * @param method_id LatencyProbe 方法节点 ID
+     * @param object_id 方法所属的对象节点 ID (default: ns=0, s=UA_NS0ID_OBJECTSFOLDER)
+     * @param window 统计窗口的大小
+     */
+    LatencyProbe(Client &client, const UA_NodeId &method_id,
+                 const UA_NodeId &object_id = UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER), std::size_t window = 64);
+
+    ~LatencyProbe();
+
+    LatencyProbe(const LatencyProbe &) = delete;
+    LatencyProbe &operator=(const LatencyProbe &) = delete;
+
+    /**
+     * @brief 进行一次时间戳交换，结果加入统计窗口
+     *
+     * @param sample 交换结果，可为 nullptr
+     * @return 是否成功完成交换
+     */
+    UA_Boolean probe(Sample *sample = nullptr);
+
+    /**
+     * @brief 在后台线程中周期性探测
+     *
+     * @param interval_ms 探测周期 (单位：ms)
+     */
+    void start(UA_UInt32 interval_ms = 1000);
+
+    //! 停止后台探测
+    void stop();
+
+    //! 获取窗口内的统计结果
+    Stats stats() const;
+
+    //! 生成统计摘要文本
+    std::string summary() const;
+};
+
+//! @} opcua_cs
+
+} // namespace ua
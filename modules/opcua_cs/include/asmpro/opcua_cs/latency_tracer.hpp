@@ -0,0 +1,137 @@
+/**
+ * @file latency_tracer.hpp
+ * @author 赵曦 (535394140@qq.com)
+ * @brief End-to-end latency tracer of the subscription pipeline
+ * @version 1.0
+ * @date 2023-03-13
+ *
+ * @copyright Copyright (c) 2023, zhaoxi
+ *
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <string>
+
+#include "ua_utility.hpp"
+
+namespace ua
+{
+
+//! @addtogroup opcua_cs
+//! @{
+
+/**
+ * @brief 对数分桶的延迟直方图
+ * @note 每个 2 的幂区间被均分为 16 个子桶，相对误差不超过 6.25%，
+ *       记录操作仅包含原子自增，可在多个线程中并发调用
+ */
+class Histogram
+{
+    static constexpr std::size_t sub_bits = 4;                            //!< 子桶数量的位数
+    static constexpr std::size_t sub_count = 1 << sub_bits;               //!< 每个区间的子桶数量
+    static constexpr std::size_t major_count = 40;                        //!< 区间数量，可表示约 12 天
+    static constexpr std::size_t bucket_count = sub_count * major_count;  //!< 桶数量
+
+    std::array<std::atomic<UA_UInt64>, bucket_count> __buckets{};        //!< 各桶的样本数
+    std::atomic<UA_UInt64> __count{0};                                   //!< 样本数
+    std::atomic<UA_UInt64> __sum{0};                                     //!< 样本之和
+    std::atomic<UA_UInt64> __max{0};                                     //!< 最大值
+
+public:
+    Histogram() = default;
+    Histogram(const Histogram &) = delete;
+    Histogram &operator=(const Histogram &) = delete;
+
+    /**
+     * @brief 记录一个样本
+     *
+     * @param value 样本值，负值 (如时钟偏差导致的) 按 0 记录
+     */
+    void record(UA_Int64 value);
+
+    /**
+     * @brief 获取分位数，结果为样本所在桶的中点
+     *
+     * @param q 分位点，范围 [0, 1]
+     * @return 分位数，无样本时返回 0
+     */
+    double percentile(double q) const;
+
+    //! 样本数
+    inline UA_UInt64 count() const { return __count; }
+    //! 均值
+    inline double mean() const { return __count == 0 ? 0 : static_cast<double>(__sum) / __count; }
+    //! 最大值
+    inline UA_UInt64 max() const { return __max; }
+
+    //! 清空所有样本
+    void reset();
+};
+
+/**
+ * @brief 订阅链路的端到端延迟追踪器
+ * @note 根据数据值中的源时间戳、服务器时间戳以及客户端的接收、回调时刻，将一次数据变更通知的延迟拆分为
+ *       生产者写入 → 服务器采样 → 发布并到达客户端 → 回调开始 → 回调结束 几个阶段，分别记录至直方图
+ *       (单位：us)。未携带源时间戳的写入由服务器以写入时刻同时作为源时间戳与服务器时间戳，
+ *       这类通知不计入 SourceToServer，EndToEnd 从服务器时间戳开始计算。
+ *       跨主机使用时，源时间戳与服务器、客户端时间戳的差值包含时钟偏差
+ */
+class LatencyTracer
+{
+public:
+    //! 延迟阶段
+    enum Stage
+    {
+        SourceToServer,  //!< 生产者给出的源时间戳至服务器时间戳 (写入)，只统计携带源时间戳的写入
+        ServerToClient,  //!< 服务器时间戳至客户端接收，包括发布间隔的等待与网络传输
+        ClientToHandler, //!< 客户端接收至回调开始，包括执行器中的排队
+        Handler,         //!< 回调函数的执行时间
+        EndToEnd,        //!< 生产者写入至回调结束，无源时间戳时从服务器时间戳开始计算
+        StageCount
+    };
+
+private:
+    std::array<Histogram, StageCount> __histograms; //!< 各阶段的延迟直方图
+
+public:
+    /**
+     * @brief 记录单个阶段的延迟
+     *
+     * @param stage 延迟阶段
+     * @param us 延迟 (单位：us)
+     */
+    inline void record(Stage stage, UA_Int64 us) { __histograms[stage].record(us); }
+
+    /**
+     * @brief 记录一次数据变更通知的各阶段延迟
+     *
+     * @param value 数据变更通知中的数据值
+     * @param received 客户端接收到通知的时刻
+     * @param begin 回调开始的时刻
+     * @param end 回调结束的时刻
+     */
+    void record(const UA_DataValue &value, UA_DateTime received, UA_DateTime begin, UA_DateTime end);
+
+    //! 获取指定阶段的延迟直方图
+    inline const Histogram &histogram(Stage stage) const { return __histograms[stage]; }
+
+    //! 获取阶段名
+    static const char *name(Stage stage);
+
+    /**
+     * @brief 生成各阶段的统计摘要，每个阶段一行
+     *
+     * @return 包含样本数、均值、p50、p90、p99、p99.9、最大值的文本 (单位：us)
+     */
+    std::string summary() const;
+
+    //! 清空所有阶段的样本
+    void reset();
+};
+
+//! @} opcua_cs
+
+} // namespace ua
@@ -0,0 +1,155 @@
+/**
+ * @file proxy.hpp
+ * @author 赵曦 (535394140@qq.com)
+ * @brief Aggregating proxy that mirrors upstream nodes and fans them out to downstream clients
+ * @version 1.0
+ * @date 2023-03-22
+ *
+ * @copyright Copyright (c) 2023, zhaoxi
+ *
+ */
+
+#pragma once
+
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include "client.hpp"
+#include "server.hpp"
+
+namespace ua
+{
+
+//! @addtogroup opcua_cs
+//! @{
+
+/**
+ * @brief 聚合代理，以一个客户端订阅上游服务器的节点，并在本地服务器中镜像，供任意数量的下游客户端访问
+ * @note 每个上游变量只订阅一次，下游订阅的采样与通知编码均在代理所在的主机上完成，上游的开销与下游客户端数无关。
+ *       镜像变量为数据源变量，读取时返回上游最近一次通知的数据值 (包括源时间戳与状态码)。
+ *       open62541 的服务器回调没有异步写入的接口 (异步方法调用依赖实验性的编译选项)，
+ *       写入与方法调用在回调中被同步转发至上游，转发期间本地服务器的事件循环被阻塞，
+ *       所有下游客户端的读取与通知都会推迟一个上游往返时间，多个转发依次执行。
+ *       阻塞的时间以 connect 的 forward_timeout 为上限，超时的转发向下游返回失败。
+ *       下游写入成功后的新值经由上游的通知回到镜像变量。
+ *       镜像节点作为节点上下文传递给回调函数，上游通知的数据值与镜像保存的数据值直接交换，不做深拷贝。
+ *       需要在 Server::init 之后、Server::run 之前完成配置并调用 start
+ */
+class Proxy final
+{
+    //! 镜像节点，上游节点与本地节点一一对应，作为本地节点的节点上下文
+    struct Mirror
+    {
+        std::string path;                           //!< 浏览名路径
+        UA_Boolean method = UA_FALSE;               //!< 是否为方法
+        UA_NodeId upstream_id = UA_NODEID_NULL;     //!< 上游节点 ID
+        UA_NodeId upstream_parent = UA_NODEID_NULL; //!< 上游父对象节点 ID，转发方法调用时使用
+        std::mutex mtx;                             //!< 数据值的互斥锁，通知在客户端线程中更新数据值
+        UA_DataValue value = UA_DataValue{};        //!< 上游最近一次通知的数据值
+
+        ~Mirror()
+        {
+            UA_NodeId_clear(&upstream_id);
+            UA_NodeId_clear(&upstream_parent);
+            UA_DataValue_clear(&value);
+        }
+    };
+
+    static std::unique_ptr<Client> __upstream;                   //!< 上游客户端
+    static std::deque<Mirror> __mirrors;                         //!< 镜像节点，地址在代理生命周期内保持不变
+    static std::unordered_map<std::string, UA_NodeId> __objects; //!< 已镜像的父对象，以路径为键
+
+public:
+    /**
+     * @brief 连接上游服务器
+     *
+     * @param address 上游服务器地址
+     * @param username 用户名
+     * @param password 密码
+     * @param forward_timeout 转发写入与方法调用的超时时间，即本地服务器事件循环被阻塞的上限 (单位：ms)
+     * @return 是否连接成功
+     */
+    static UA_Boolean connect(const std::string &address, const std::string &username = "",
+                              const std::string &password = "", UA_UInt32 forward_timeout = 1000);
+
+    /**
+     * @brief 镜像上游服务器中的变量，本地变量位于相同的浏览路径下
+     *
+     * @param path 以 '/' 分隔的浏览名路径，起始于 ObjectsFolder，各级节点均位于命名空间 1，
+     *             例如 "VisionServer/Camera[1]/Image"
+     * @return 本地镜像变量的节点 ID
+     * @note 上游的通知队列只保留最新值，差分变量依赖完整的通知序列，应镜像其源图像而不是差分变量本身
+     */
+    static UA_NodeId mirrorVariable(const std::string &path);
+
+    /**
+     * @brief 镜像上游服务器中的方法，输入输出参数从上游方法的 InputArguments 与 OutputArguments 属性读取
+     *
+     * @param path 以 '/' 分隔的浏览名路径，最后一级为方法名
+     * @return 本地镜像方法的节点 ID
+     */
+    static UA_NodeId mirrorMethod(const std::string &path);
+
+    /**
+     * @brief 从配置文件中读取需要镜像的节点
+     * @note 每行为 "variable <路径>" 或 "method <路径>"，空行与以 '#' 开头的行被忽略
+     *
+     * @param path 配置文件路径
+     * @return 是否所有节点均镜像成功
+     */
+    static UA_Boolean loadConfig(const std::string &path);
+
+    /**
+     * @brief 在一个订阅中批量创建所有镜像变量的监视项，并启动客户端的后台事件循环
+     * @note 上游监视项的采样间隔为 0，每次写入都会被采样，通知队列长度为 1，只保留最新值
+     *
+     * @param publishing_interval 上游订阅的发布间隔 (单位：ms)
+     * @return 是否所有监视项均创建成功
+     */
+    static UA_Boolean start(UA_Double publishing_interval = 100.0);
+
+    /**
+     * @brief 停止客户端的后台事件循环，断开上游连接
+     * @note 本地镜像节点仍然存在，读取返回最后一次通知的数据值，写入与方法调用返回 BadCommunicationError
+     */
+    static void stop();
+
+private:
+    /**
+     * @brief 在上游服务器中逐级查找路径，并在本地创建缺失的父对象
+     *
+     * @param path 以 '/' 分隔的浏览名路径
+     * @param upstream_parent 上游父对象节点 ID
+     * @param local_parent 本地父对象节点 ID
+     * @param name 路径的最后一级浏览名
+     * @return 上游节点 ID，失败时为空
+     */
+    static UA_NodeId resolve(const std::string &path, UA_NodeId &upstream_parent, UA_NodeId &local_parent,
+                             std::string &name);
+
+    //! 读取上游方法的参数属性
+    static std::vector<Argument> readArguments(const UA_NodeId &method_id, const std::string &name);
+
+    static UA_StatusCode mirrorReadHandler(UA_Server *server, const UA_NodeId *session_id, void *session_context,
+                                           const UA_NodeId *node_id, void *node_context, UA_Boolean source_timestamp,
+                                           const UA_NumericRange *range, UA_DataValue *value);
+
+    static UA_StatusCode mirrorWriteHandler(UA_Server *server, const UA_NodeId *session_id, void *session_context,
+                                            const UA_NodeId *node_id, void *node_context,
+                                            const UA_NumericRange *range, const UA_DataValue *value);
+
+    static UA_StatusCode mirrorMethodHandler(UA_Server *server, const UA_NodeId *session_id, void *session_context,
+                                             const UA_NodeId *method_id, void *method_context,
+                                             const UA_NodeId *object_id, void *object_context, size_t input_size,
+                                             const UA_Variant *input, size_t output_size, UA_Variant *output);
+};
+
+inline std::unique_ptr<Client> Proxy::__upstream;
+inline std::deque<Proxy::Mirror> Proxy::__mirrors;
+inline std::unordered_map<std::string, UA_NodeId> Proxy::__objects;
+
+//! @} opcua_cs
+
+} // namespace ua
@@ -0,0 +1,228 @@
+/**
+ * @file recorder.hpp
+ * @author 赵曦 (535394140@qq.com)
+ * @brief Record-and-replay of data-change streams for offline load testing
+ * @version 1.0
+ * @date 2023-03-22
+ *
+ * @copyright Copyright (c) 2023, zhaoxi
+ *
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdio>
+#include <deque>
+#include <unordered_map>
+
+#include "client.hpp"
+#include "server.hpp"
+
+namespace ua
+{
+
+//! @addtogroup opcua_cs
+//! @{
+
+/**
+ * @brief 数据变更记录器，将带时间戳的 (节点 ID, 数据值) 记录追加至二进制日志
+ * @note 日志由 8 字节魔数与若干条记录组成，每条记录为 16 字节的记录头 (长度、类别、记录时刻)
+ *       与二进制编码的节点 ID 及载荷。载荷为节点声明的浏览名 (String) 或数据变更的数据值 (DataValue)。
+ *       记录先写入内存缓冲区，缓冲区满时才写入文件。线程安全，可同时记录多个订阅
+ */
+class Recorder final
+{
+    //! 服务器本地监视项，作为 monContext 传递给回调函数
+    struct ServerWatch
+    {
+        Recorder *recorder = nullptr;       //!< 所属记录器
+        UA_NodeId node_id = UA_NODEID_NULL; //!< 被监视的节点 ID
+        UA_UInt32 mon_id = 0;               //!< 监视项 ID
+    };
+
+    FILE *__fp = nullptr;                     //!< 日志文件
+    const UA_Logger *__logger;                //!< 日志记录器
+    std::mutex __mtx;                         //!< 缓冲区互斥锁
+    std::vector<UA_Byte> __buffer;            //!< 尚未写入文件的记录
+    std::size_t __buffer_size;                //!< 缓冲区容量，超过后写入文件
+    std::atomic<UA_UInt64> __records{0};      //!< 已记录的数据变更数
+    std::atomic<UA_UInt64> __bytes{0};        //!< 已记录的字节数
+    std::atomic<UA_UInt64> __lost{0};         //!< 因写入文件失败而丢失的字节数
+    std::deque<UA_NodeId> __watched;          //!< 客户端回调函数引用的节点 ID 拷贝
+    std::deque<ServerWatch> __server_watches; //!< 服务器本地监视项，地址在记录器生命周期内保持不变
+
+public:
+    /**
+     * @brief 创建日志文件并写入魔数
+     *
+     * @param path 日志文件路径，已存在时被覆盖
+     * @param buffer_size 缓冲区容量 (单位：字节)
+     * @param logger 报告文件错误的日志记录器，生命周期需长于记录器 (default: UA_Log_Stdout)
+     */
+    explicit Recorder(const std::string &path, std::size_t buffer_size = 1 << 20,
+                      const UA_Logger *logger = UA_Log_Stdout);
+
+    //! 删除服务器本地监视项，写入缓冲区中的记录并关闭日志文件
+    ~Recorder();
+
+    Recorder(const Recorder &) = delete;
+    Recorder &operator=(const Recorder &) = delete;
+
+    //! 日志文件是否成功打开
+    inline bool isOpen() const { return __fp != nullptr; }
+
+    /**
+     * @brief 声明节点的浏览名，回放时可据此在本地服务器中创建对应的变量
+     *
+     * @param node_id 节点 ID
+     * @param name 浏览名
+     */
+    void declare(const UA_NodeId &node_id, const std::string &name);
+
+    /**
+     * @brief 记录一次数据变更
+     *
+     * @param node_id 节点 ID
+     * @param value 数据值
+     * @param time 记录时刻，回放时按相邻记录时刻的差值控制节奏
+     */
+    void record(const UA_NodeId &node_id, const UA_DataValue &value, UA_DateTime time = UA_DateTime_now());
+
+    /**
+     * @brief 生成记录指定节点的数据变更回调函数，可直接传入 Client::createVariableMonitors
+     *
+     * @param node_id 被监视的节点 ID
+     * @param name 浏览名，非空时先声明该节点
+     * @return 数据变更回调函数，记录器的生命周期需长于监视项
+     */
+    Client::DataChangeHandler handler(const UA_NodeId &node_id, const std::string &name = "");
+
+    /**
+     * @brief 以本地监视项记录服务器中指定变量的数据变更
+     * @note 本地监视项不占用变量的值回调，可与图像预览等功能共存。每个监视项以其所属的记录器为上下文，
+     *       多个记录器可以同时监视服务器。记录器销毁时删除其创建的监视项，服务器运行时需在服务器线程中销毁
+     *
+     * @param node_id 变量节点 ID
+     * @param name 浏览名
+     * @param sampling_interval 采样间隔，0 表示每次写入都被采样 (单位：ms)
+     */
+    void watch(const UA_NodeId &node_id, const std::string &name, UA_Double sampling_interval = 0);
+
+    //! 将缓冲区中的记录写入文件
+    void flush();
+
+    //! 已记录的数据变更数
+    inline UA_UInt64 records() const { return __records; }
+    //! 已记录的字节数
+    inline UA_UInt64 bytes() const { return __bytes; }
+    //! 因写入文件失败而丢失的字节数
+    inline UA_UInt64 lost() const { return __lost; }
+
+private:
+    //! 将缓冲区写入文件，失败时记录日志并丢弃缓冲区，需持有缓冲区互斥锁
+    void writeBuffer();
+
+    //! 追加一条记录，需持有缓冲区互斥锁
+    void append(UA_UInt32 kind, UA_DateTime time, const UA_NodeId &node_id, const void *payload,
+                const UA_DataType *type);
+
+    //! 服务器本地监视项的数据变更回调函数
+    static void serverDataChangeHandler(UA_Server *server, UA_UInt32 mon_id, void *mon_context,
+                                        const UA_NodeId *node_id, void *node_context, UA_UInt32 attribute_id,
+                                        const UA_DataValue *value);
+};
+
+//! 回放参数
+struct ReplayOptions
+{
+    double speed = 1.0;        //!< 回放速度倍数，小于等于 0 时不等待，尽快回放
+    UA_Boolean loop = false;   //!< 回放至末尾后是否从头开始
+    UA_Boolean restamp = true; //!< 是否以写入时刻替换源时间戳，便于下游统计端到端延迟
+};
+
+/**
+ * @brief 数据变更回放器，以内存映射读取记录器生成的日志，按原有节奏或 N 倍速写入本地服务器
+ * @note 记录中的节点 ID 默认原样写入，可通过 map 映射至本地节点，或通过 addNodes 为声明过的节点创建变量
+ */
+class Replayer final
+{
+    struct NodeIdHash
+    {
+        inline std::size_t operator()(const UA_NodeId &id) const { return UA_NodeId_hash(&id); }
+    };
+
+    struct NodeIdEqual
+    {
+        inline bool operator()(const UA_NodeId &lhs, const UA_NodeId &rhs) const { return UA_NodeId_equal(&lhs, &rhs); }
+    };
+
+    const UA_Byte *__data = nullptr;                                          //!< 映射的日志
+    std::size_t __size = 0;                                                   //!< 日志字节数
+    std::unordered_map<UA_NodeId, UA_NodeId, NodeIdHash, NodeIdEqual> __map; //!< 记录中的节点 ID 至本地节点 ID 的映射
+    std::atomic_bool __running{false};                                        //!< 是否正在回放
+    std::atomic<UA_UInt64> __replayed{0};                                     //!< 成功写入的数据变更数
+    std::atomic<UA_UInt64> __failed{0};                                       //!< 写入失败的数据变更数
+
+public:
+    /**
+     * @brief 映射日志文件
+     *
+     * @param path 日志文件路径
+     */
+    explicit Replayer(const std::string &path);
+
+    ~Replayer();
+
+    Replayer(const Replayer &) = delete;
+    Replayer &operator=(const Replayer &) = delete;
+
+    //! 日志文件是否有效
+    inline bool isOpen() const { return __data != nullptr; }
+
+    /**
+     * @brief 将记录中的节点映射至本地节点
+     *
+     * @param recorded_id 记录中的节点 ID
+     * @param local_id 本地节点 ID
+     */
+    void map(const UA_NodeId &recorded_id, const UA_NodeId &local_id);
+
+    /**
+     * @brief 为声明过且尚未映射的节点在本地服务器中创建变量，初值为该节点的第一条数据变更
+     * @note 需要在 Server::init 之后调用，重名的节点在浏览名后追加序号
+     *
+     * @return 创建的变量数
+     */
+    std::size_t addNodes();
+
+    //! 日志中声明的浏览名
+    std::vector<std::string> names() const;
+
+    /**
+     * @brief 回放日志，阻塞至回放结束或调用 stop
+     *
+     * @param options 回放参数
+     * @return 日志是否完整，末尾的残缺记录 (记录器异常退出) 被忽略并返回 false
+     */
+    UA_Boolean run(const ReplayOptions &options = ReplayOptions());
+
+    //! 停止回放，可在其他线程中调用
+    inline void stop() { __running = false; }
+
+    //! 成功写入的数据变更数
+    inline UA_UInt64 replayed() const { return __replayed; }
+    //! 写入失败的数据变更数
+    inline UA_UInt64 failed() const { return __failed; }
+
+private:
+    //! 记录的回调函数，返回 false 时停止遍历
+    using Visitor = std::function<bool(UA_UInt32, UA_DateTime, const UA_ByteString &)>;
+
+    //! 依次访问日志中的记录，返回日志是否完整
+    UA_Boolean visit(const Visitor &visitor) const;
+};
+
+//! @} opcua_cs
+
+} // namespace ua
@@ -11,10 +11,20 @@
 
 #pragma once
 
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
 #include <unordered_set>
 
 #include "argument.hpp"
+#include "compression.hpp"
+#include "frame_delta.hpp"
+#include "history.hpp"
+#include "image_frame.hpp"
+#include "image_preview.hpp"
 #include "object.hpp"
+#include "shm_channel.hpp"
 #include "variable.hpp"
 
 namespace ua
@@ -23,6 +33,13 @@ namespace ua
 //! @addtogroup opcua_cs
 //! @{
 
+//! 变量节点的写入模式
+enum class WriteMode
+{
+    Always,       //!< 每次调用都写入
+    SkipUnchanged //!< 值的内容哈希与上一次写入相同时跳过写入
+};
+
 /**
  * @brief 基于 OPC UA 协议的工业互联网服务器
  */
@@ -43,9 +60,94 @@ class Server final
     using DataSourceWrite = UA_StatusCode (*)(UA_Server *, const UA_NodeId *, void *, const UA_NodeId *, void *,
                                               const UA_NumericRange *, const UA_DataValue *);
 
-    static UA_Server *__server;  //!< OPC UA 服务器指针
-    static UA_Boolean __is_init; //!< 服务器初始化状态
-    static UA_Boolean __running; //!< 服务器运行状态
+    //! 节点回调上下文，作为节点上下文传递给 open62541，在用户回调的外层记录追踪区间
+    struct CallbackContext
+    {
+        const char *name = "";                                          //!< 追踪区间名，由 Trace::intern 保存
+        UA_MethodCallback method = nullptr;                             //!< 方法回调函数
+        ValueCallBackRead before_read = nullptr;                        //!< 值回调，在读取之前执行
+        ValueCallBackWrite after_write = nullptr;                       //!< 值回调，在写入之后执行
+        DataSourceRead read = nullptr;                                  //!< 数据源读取回调函数
+        DataSourceWrite write = nullptr;                                //!< 数据源写入回调函数
+        UA_Server_DataChangeNotificationCallback data_change = nullptr; //!< 本地监视项回调函数
+        void *user_context = nullptr;                                   //!< 用户上下文，代替节点、方法或监视项上下文传递给用户回调函数
+    };
+
+    //! 差分变量的上下文
+    struct DeltaContext
+    {
+        UA_NodeId node_id = UA_NODEID_NULL; //!< 差分变量节点 ID
+        DeltaEncoder encoder;               //!< 差分编码器，保存上一帧
+        std::vector<UA_Byte> data;          //!< 最近一次的差分
+    };
+
+    //! 图像变量的写入观察者，同一图像的多个预览共享一份源图像的拷贝
+    struct ImageSource
+    {
+        UA_NodeId image_id = UA_NODEID_NULL;    //!< 图像变量节点 ID
+        UA_UInt64 version = 1;                  //!< 帧序号，每次写入图像后递增
+        UA_UInt64 snapshot_version = 0;         //!< 源图像拷贝对应的帧序号
+        UA_DataValue snapshot = UA_DataValue{}; //!< 源图像拷贝
+        std::unique_ptr<ShmWriter> channel;     //!< 共享内存通道，每次写入图像后发布
+        std::vector<DeltaContext *> deltas;     //!< 差分变量，每次写入图像后更新
+    };
+
+    //! 图像预览的上下文，作为预览变量的节点上下文
+    struct PreviewContext
+    {
+        ImageSource *source = nullptr;    //!< 源图像
+        ImagePreview preview;             //!< 预览参数
+        UA_UInt64 version = 0;            //!< 当前预览对应的帧序号，0 表示尚未生成
+        UA_DateTime source_timestamp = 0; //!< 当前预览对应的源时间戳
+        std::vector<UA_Byte> data;        //!< 当前预览
+        std::vector<UA_UInt32> buffer;    //!< 预览内核的中间结果缓冲区
+    };
+
+    //! 压缩变量的上下文，作为压缩变量的节点上下文
+    struct CompressedContext
+    {
+        ImageSource *source = nullptr;    //!< 源变量
+        Compression options;              //!< 压缩参数
+        UA_UInt64 version = 0;            //!< 当前压缩结果对应的帧序号，0 表示尚未生成
+        UA_DateTime source_timestamp = 0; //!< 当前压缩结果对应的源时间戳
+        std::vector<UA_Byte> data;        //!< 当前压缩结果
+        std::vector<UA_Byte> scratch;     //!< 差分的中间结果缓冲区
+    };
+
+    //! 变量节点的写入去重状态，mode、valid、hash 与 suppressed 由 __dedup_mtx 保护
+    struct WriteDedup
+    {
+        WriteMode mode = WriteMode::Always; //!< 写入模式
+        UA_Boolean valid = UA_FALSE;        //!< 是否已记录哈希，其他途径写入该节点后失效
+        UA_UInt64 hash = 0;                 //!< 上一次写入的值的内容哈希
+        UA_UInt64 suppressed = 0;           //!< 被跳过的写入次数
+        std::mutex write_mtx;               //!< 节点的写入锁，比较哈希与写入在同一次加锁中完成
+    };
+
+    struct NodeIdHash
+    {
+        inline std::size_t operator()(const UA_NodeId &id) const { return UA_NodeId_hash(&id); }
+    };
+
+    struct NodeIdEqual
+    {
+        inline bool operator()(const UA_NodeId &lhs, const UA_NodeId &rhs) const { return UA_NodeId_equal(&lhs, &rhs); }
+    };
+
+    static UA_Server *__server;                        //!< OPC UA 服务器指针
+    static UA_Boolean __is_init;                       //!< 服务器初始化状态
+    static UA_Boolean __running;                       //!< 服务器运行状态
+    static std::deque<CallbackContext> __contexts;     //!< 节点回调上下文，地址在进程生命周期内保持不变
+    static std::deque<ImageSource> __image_sources;    //!< 图像变量的写入观察者
+    static std::deque<PreviewContext> __previews;      //!< 图像预览的上下文
+    static std::deque<CompressedContext> __compressed; //!< 压缩变量的上下文
+    static std::deque<DeltaContext> __deltas;          //!< 差分变量的上下文
+
+    static std::unordered_map<UA_NodeId, WriteDedup, NodeIdHash, NodeIdEqual> __dedups; //!< 写入去重状态，条目不会被删除
+    static std::mutex __dedup_mtx;                                                      //!< 写入去重状态的互斥锁
+
+    //! 变量的历史数据存储，服务器运行时只读
+    static std::unordered_map<UA_NodeId, std::unique_ptr<HistoryBuffer>, NodeIdHash, NodeIdEqual> __histories;
 
 #ifndef NDEBUG
 #define SERVER_RUNNING_ASSERT()                                                         \
@@ -99,14 +201,23 @@ public:
 
     /**
      * @brief 运行服务器
-     * @note 此函数需要在初始化服务器配置之后再运行
+     * @note 此函数需要在初始化服务器配置之后再运行，启用 Trace 时每次事件循环迭代记录为一个区间
      */
     static void run();
 
     /**
-     * @brief 手动终止服务器
+     * @brief 手动终止服务器，之后可重新初始化
+     */
+    static void stop();
+
+    /**
+     * @brief 替换服务器的日志记录器，此后服务器内部与本类的日志均通过该记录器输出
+     * @note 需要在初始化服务器之后调用，记录器的 clear 函数会在服务器销毁时调用，
+     *       使用 AsyncLogger 时可避免日志 I/O 阻塞服务器事件循环
+     *
+     * @param logger 日志记录器
      */
-    static void stop() { UA_Server_delete(__server); }
+    static void setLogger(const UA_Logger &logger);
 
     /**
      * @brief 服务端路径搜索，获取目标节点 ID
@@ -142,6 +253,62 @@ public:
      */
     static UA_Boolean writeVariable(const UA_NodeId &node_id, const Variable &data);
 
+    /**
+     * @brief 把值连同源时间戳写入服务器中的变量节点
+     * @note 源时间戳随数据变更通知一同发送至客户端，可用于计算端到端延迟
+     *
+     * @param node_id 变量节点 ID
+     * @param data 变量数据信息
+     * @param source_timestamp 源时间戳，一般为数据产生 (如图像采集) 的时刻
+     * @return 是否成功写入变量节点
+     */
+    static UA_Boolean writeVariable(const UA_NodeId &node_id, const Variable &data, UA_DateTime source_timestamp);
+
+    /**
+     * @brief 把完整的数据值写入服务器中的变量节点
+     *
+     * @param node_id 变量节点 ID
+     * @param value 数据值，包括值、状态码以及时间戳
+     * @return 是否成功写入变量节点
+     */
+    static UA_Boolean writeDataValue(const UA_NodeId &node_id, const UA_DataValue &value);
+
+    /**
+     * @brief 把图像写入 ByteString 类型的图像变量，首部的 timestamp 作为源时间戳，为 0 时由服务器以写入时刻标记
+     * @note 像素数据仅被拷贝至复用的编码缓冲区一次，随后由服务器拷贝至节点。
+     *       cv::Mat 的写入见 image_mat.hpp
+     *
+     * @param node_id 图像变量节点 ID
+     * @param header 图像首部，stride 字段被忽略
+     * @param data 像素数据首地址
+     * @param src_stride 源像素数据中每行的字节数，0 表示行间无填充
+     * @return 是否成功写入变量节点
+     */
+    static UA_Boolean writeImage(const UA_NodeId &node_id, const ImageHeader &header, const UA_Byte *data,
+                                 std::size_t src_stride = 0);
+
+    /**
+     * @brief 设置变量节点的写入模式
+     * @note SkipUnchanged 模式下，writeVariable、writeDataValue 与 writeImage 先计算值的 64 位内容哈希 (见 contentHash)，
+     *       与上一次成功写入的哈希相同时直接返回，不调用 open62541 的写入服务，因此也不触发值回调、采样比较与数据变更通知，
+     *       节点的源时间戳保持为上一次写入的时刻。writeDataValue 的状态码与是否有值参与哈希，时间戳不参与。
+     *       writeImage 只对图像的尺寸、格式与像素计算哈希，帧计数器与时间戳不参与。
+     *       客户端的 Write 服务等其他途径的写入经由节点的写入之后的值回调使记录的哈希失效，下一次写入不会被跳过，
+     *       因此不能用于数据源变量。同一节点的并发写入按节点串行执行
+     *
+     * @param node_id 变量节点 ID
+     * @param mode 写入模式
+     */
+    static void setWriteMode(const UA_NodeId &node_id, WriteMode mode);
+
+    /**
+     * @brief 获取变量节点在 SkipUnchanged 模式下被跳过的写入次数
+     *
+     * @param node_id 变量节点 ID
+     * @return 被跳过的写入次数
+     */
+    static UA_UInt64 suppressedWrites(const UA_NodeId &node_id);
+
     /**
      * @brief 从服务器中读取指定的变量节点
      *
@@ -152,6 +319,8 @@ public:
 
     /**
      * @brief 为变量节点添加值回调函数
+     * @note 节点上下文由内部接管，节点原有的上下文作为 nodeContext 参数原样传递给值回调函数，
+     *       在此之后请勿再对该节点调用 UA_Server_setNodeContext
      *
      * @param node_id 变量节点 ID
      * @param before_read 值回调，在读取之前执行
@@ -169,11 +338,86 @@ public:
      * @param on_read 数据源回调，在读取时执行
      * @param on_write 数据源回调，在写入时执行
      * @param type_id 变量类型节点 ID (default: ns=0, s=UA_NS0ID_BASEDATAVARIABLETYPE)
+     * @param parent_id 父对象节点 ID (default: ns=0, s=UA_NS0ID_OBJECTSFOLDER)
+     * @param context 用户上下文，作为 nodeContext 参数传递给数据源回调函数 (default: nullptr)
      * @return 添加的节点 ID
      */
     static UA_NodeId addDataSourceVariableNode(const std::string &browse_name, const std::string &description,
                                                const Variable &data, DataSourceRead on_read, DataSourceWrite on_write,
-                                               const UA_NodeId &type_id = UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATAVARIABLETYPE));
+                                               const UA_NodeId &type_id = UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATAVARIABLETYPE),
+                                               const UA_NodeId &parent_id = UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                               void *context = nullptr);
+
+    /**
+     * @brief 为图像变量添加预览变量 (缩放、Mono8、ROI)，预览变量为 Byte 数组类型的数据源变量
+     * @note 预览仅在被读取 (包括订阅的采样) 时生成，没有订阅者时不产生任何开销。每帧图像最多生成一次预览，
+     *       多个订阅者共享同一结果，同一图像的多个预览共享一份源图像的拷贝。图像的新帧通过写入之后的值回调感知，
+     *       因此不能再为该图像变量调用 addVariableNodeValueCallBack
+     *
+     * @param browse_name 预览变量的浏览信息名
+     * @param description 预览变量的描述
+     * @param image_id 图像变量节点 ID，其值为按行存储、通道交错的 Byte 数组，或 8 位通道、行间无填充的带首部图像
+     * @param preview 预览参数
+     * @param parent_id 父对象节点 ID，一般与图像变量相同 (default: ns=0, s=UA_NS0ID_OBJECTSFOLDER)
+     * @return 添加的节点 ID
+     */
+    static UA_NodeId addImagePreview(const std::string &browse_name, const std::string &description,
+                                     const UA_NodeId &image_id, const ImagePreview &preview,
+                                     const UA_NodeId &parent_id = UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER));
+
+    /**
+     * @brief 为图像变量添加共享内存通道，供同一主机上的客户端绕过 TCP 协议栈读取
+     * @note 每次写入图像后，值回调将新值直接拷贝至共享内存环形缓冲区并通过 futex 唤醒读取方，
+     *       读取方 (ShmReader) 在共享内存中直接读取，不再经过编码、回环 TCP 与解码。
+     *       共享内存名写入图像变量的 SharedMemory 属性，客户端可据此打开通道。
+     *       与 addImagePreview 相同，不能再为该图像变量调用 addVariableNodeValueCallBack
+     *
+     * @param image_id 图像变量节点 ID，其值为元素不含指针的数组或 ByteString
+     * @param name 共享内存名，如 "/ua_camera1_image"
+     * @param slot_size 单帧的最大字节数，0 表示使用图像变量当前值的字节数
+     * @param slot_count 帧缓冲区数量
+     * @param mode 共享内存段的访问权限，其他用户的客户端需要读取时应放宽 (default: 0600)
+     * @return 是否成功添加
+     */
+    static UA_Boolean addSharedMemoryChannel(const UA_NodeId &image_id, const std::string &name,
+                                             std::size_t slot_size = 0, std::size_t slot_count = 4,
+                                             mode_t mode = 0600);
+
+    /**
+     * @brief 为大型数组变量添加差分变量，差分变量为 ByteString 类型的只读变量，只包含与上一次写入相比发生变化的块
+     * @note 每次写入源变量后，值回调逐块比较新旧两帧并将差分写入差分变量，画面大部分静止时只传输变化的区域。
+     *       差分是相对于上一次写入的，订阅差分变量时应将采样间隔设为 0 (每次写入都采样) 并设置足够的队列长度，
+     *       客户端使用 DeltaAssembler 重建完整帧，丢失差分时等待下一个完整帧重新同步。
+     *       与 addImagePreview 相同，不能再为源变量调用 addVariableNodeValueCallBack
+     *
+     * @param browse_name 差分变量的浏览信息名
+     * @param description 差分变量的描述
+     * @param source_id 源变量节点 ID，其值为元素不含指针的数组或 ByteString
+     * @param options 差分参数
+     * @param parent_id 父对象节点 ID，一般与源变量相同 (default: ns=0, s=UA_NS0ID_OBJECTSFOLDER)
+     * @return 添加的节点 ID
+     */
+    static UA_NodeId addDeltaVariable(const std::string &browse_name, const std::string &description,
+                                      const UA_NodeId &source_id, const DeltaOptions &options = DeltaOptions(),
+                                      const UA_NodeId &parent_id = UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER));
+
+    /**
+     * @brief 为大型变量添加压缩变量，压缩变量为 ByteString 类型的数据源变量，其 Codec 属性给出压缩参数
+     * @note 与 addImagePreview 相同，压缩仅在被读取 (包括订阅的采样) 时进行，每次值变更最多压缩一次，
+     *       多个订阅者共享同一结果。压缩结果带有描述编码格式与原始数据类型的首部，
+     *       Client 在第一次读取或创建监视项时查询 Codec 属性，确认后 readVariable 与数据变更回调才会将其还原为原始的值。
+     *       不能再为源变量调用 addVariableNodeValueCallBack
+     *
+     * @param browse_name 压缩变量的浏览信息名
+     * @param description 压缩变量的描述
+     * @param source_id 源变量节点 ID，其值为元素不含指针的数组或 ByteString
+     * @param options 压缩参数
+     * @param parent_id 父对象节点 ID，一般与源变量相同 (default: ns=0, s=UA_NS0ID_OBJECTSFOLDER)
+     * @return 添加的节点 ID
+     */
+    static UA_NodeId addCompressedVariable(const std::string &browse_name, const std::string &description,
+                                           const UA_NodeId &source_id, const Compression &options = Compression(),
+                                           const UA_NodeId &parent_id = UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER));
 
     /**
      * @brief 创建变量节点添加监测项
@@ -183,9 +427,18 @@ public:
      * @param node_id 变量节点 ID
      * @param data_change 数据更改回调函数
      * @param sampling_interval 采样间隔
+     * @param context 作为 monContext 参数传递给回调函数的用户上下文，为空时传递 &node_id (default: nullptr)
+     * @return 监视项 ID，失败时为 0
      */
-    static void createVariableMonitor(UA_NodeId &node_id, UA_Server_DataChangeNotificationCallback data_change,
-                                      UA_Double sampling_interval);
+    static UA_UInt32 createVariableMonitor(UA_NodeId &node_id, UA_Server_DataChangeNotificationCallback data_change,
+                                           UA_Double sampling_interval, void *context = nullptr);
+
+    /**
+     * @brief 删除 createVariableMonitor 创建的监视项，服务器已停止时不做任何操作
+     *
+     * @param mon_id 监视项 ID
+     */
+    static void deleteVariableMonitor(UA_UInt32 mon_id);
 
     /**
      * @brief 添加变量类型节点至 OPC UA 服务器中
@@ -250,11 +503,23 @@ public:
      * @param input_args 输入参数列表
      * @param output_args 输出参数列表
      * @param parent_id 父对象节点 ID (default: ns=0, s=UA_NS0ID_OBJECTSFOLDER)
+     * @param context 用户上下文，作为 methodContext 参数传递给方法回调函数 (default: nullptr)
      * @return 添加的节点 ID
      */
     static UA_NodeId addMethodNode(const std::string &browse_name, const std::string &description, UA_MethodCallback on_method,
                                    const std::vector<Argument> &input_args, const std::vector<Argument> &output_args,
-                                   const UA_NodeId &parent_id = UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER));
+                                   const UA_NodeId &parent_id = UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                   void *context = nullptr);
+
+    /**
+     * @brief 添加延迟探测方法 LatencyProbe，供 LatencyProbe 客户端进行 NTP 式的时间戳交换
+     * @note 输入参数为客户端发送时刻 ClientSendTime，输出参数依次为原样返回的 ClientSendTime、
+     *       进入方法回调的时刻 ServerReceiveTime 以及返回前的时刻 ServerSendTime，均为 DateTime 类型
+     *
+     * @param parent_id 父对象节点 ID (default: ns=0, s=UA_NS0ID_OBJECTSFOLDER)
+     * @return 添加的方法节点 ID
+     */
+    static UA_NodeId addLatencyProbe(const UA_NodeId &parent_id = UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER));
 
     /**
      * @brief 创建事件
@@ -284,7 +549,47 @@ public:
      */
     static UA_Boolean triggerEvent(const UA_NodeId &node_id, const UA_NodeId &origin_id = UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER));
 
+    /**
+     * @brief 将用户地址空间 (命名空间 0 以外的节点、引用及其当前值) 保存为二进制快照
+     * @note 节点以 AddNodesItem、引用以 AddReferencesItem 的 OPC UA 二进制编码依次写入，
+     *       值回调与数据源不会被保存，数据源变量保存其当前读取到的值。应在运行服务器之前调用
+     *
+     * @param path 快照文件路径
+     * @return 是否成功保存
+     */
+    static UA_Boolean saveSnapshot(const std::string &path);
+
+    /**
+     * @brief 从二进制快照恢复用户地址空间，用于代替逐个调用 add*Node 构建模型
+     * @note 快照文件以 mmap 方式映射后直接解码，所有节点先创建后统一完成，对象实例化时不会重复
+     *       创建子节点。节点 ID 与保存时一致，值回调需要在恢复后重新设置。任一阶段失败时，
+     *       已添加的节点与其回调上下文都会被删除
+     *
+     * @param path 快照文件路径
+     * @param methods 方法浏览名至回调函数的映射，用于重新绑定方法节点的回调
+     * @return 是否成功恢复
+     */
+    static UA_Boolean loadSnapshot(const std::string &path,
+                                   const std::unordered_map<std::string, UA_MethodCallback> &methods = {});
+
+    /**
+     * @brief 为变量开启历史数据记录，此后每次写入的数据值都会被保存，客户端可通过 HistoryRead 服务读取
+     * @note 开启后变量的 Historizing 属性为 true、访问级别包含 HistoryRead，当前值作为第一个样本。
+     *       仅支持原始数据读取 (ReadRawModifiedDetails 中 isReadModified 与 returnBounds 均为 false)，
+     *       其余请求返回 BadHistoryOperationUnsupported，续读点为续读序号，不在服务器中保存状态。需要 open62541 开启 UA_ENABLE_HISTORIZING，
+     *       应在运行服务器之前调用
+     *
+     * @param node_id 变量节点 ID
+     * @param options 历史数据的存储参数
+     * @return 是否成功开启
+     */
+    static UA_Boolean enableHistory(const UA_NodeId &node_id, const HistoryOptions &options = HistoryOptions());
+
+    //! 获取服务器配置中的日志记录器，需在初始化之后、服务器运行结束之前调用
+    static inline const UA_Logger *logger() { return &UA_Server_getConfig(__server)->logger; }
+
 private:
+
     /**
      * @brief 在添加变量节点之前配置变量属性
      *
@@ -295,11 +600,140 @@ private:
      */
     static UA_VariableAttributes configVariableAttribute(const std::string &name, const std::string &description,
                                                          const Variable &data);
+
+    //! 方法回调的转发函数
+    static UA_StatusCode methodHandler(UA_Server *server, const UA_NodeId *session_id, void *session_context,
+                                       const UA_NodeId *method_id, void *method_context, const UA_NodeId *object_id,
+                                       void *object_context, size_t input_size, const UA_Variant *input,
+                                       size_t output_size, UA_Variant *output);
+
+    //! 读取之前的值回调的转发函数
+    static void beforeReadHandler(UA_Server *server, const UA_NodeId *session_id, void *session_context,
+                                  const UA_NodeId *node_id, void *node_context, const UA_NumericRange *range,
+                                  const UA_DataValue *value);
+
+    //! 写入之后的值回调的转发函数
+    static void afterWriteHandler(UA_Server *server, const UA_NodeId *session_id, void *session_context,
+                                  const UA_NodeId *node_id, void *node_context, const UA_NumericRange *range,
+                                  const UA_DataValue *value);
+
+    //! 数据源读取回调的转发函数
+    static UA_StatusCode dataSourceReadHandler(UA_Server *server, const UA_NodeId *session_id, void *session_context,
+                                               const UA_NodeId *node_id, void *node_context, UA_Boolean source_timestamp,
+                                               const UA_NumericRange *range, UA_DataValue *value);
+
+    //! 数据源写入回调的转发函数
+    static UA_StatusCode dataSourceWriteHandler(UA_Server *server, const UA_NodeId *session_id, void *session_context,
+                                                const UA_NodeId *node_id, void *node_context,
+                                                const UA_NumericRange *range, const UA_DataValue *value);
+
+    //! 延迟探测方法的回调函数
+    static UA_StatusCode latencyProbeHandler(UA_Server *server, const UA_NodeId *session_id, void *session_context,
+                                             const UA_NodeId *method_id, void *method_context,
+                                             const UA_NodeId *object_id, void *object_context, size_t input_size,
+                                             const UA_Variant *input, size_t output_size, UA_Variant *output);
+
+    /**
+     * @brief 获取图像变量的写入观察者，不存在时创建并设置写入之后的值回调
+     *
+     * @param image_id 图像变量节点 ID
+     * @return 写入观察者，设置值回调失败时返回 nullptr
+     */
+    static ImageSource *watchImage(const UA_NodeId &image_id);
+
+    /**
+     * @brief 为节点添加 String 类型的属性
+     *
+     * @param node_id 节点 ID
+     * @param name 属性的浏览信息名
+     * @param value 属性值
+     * @return 是否成功添加
+     */
+    static UA_Boolean addStringProperty(const UA_NodeId &node_id, const std::string &name, const std::string &value);
+
+    /**
+     * @brief 获取在父节点下添加子变量时使用的引用类型
+     *
+     * @param parent_id 父节点 ID
+     * @return 父节点为 Objects 文件夹时为 Organizes，否则为 HasComponent
+     */
+    static UA_NodeId childReferenceType(const UA_NodeId &parent_id);
+
+    /**
+     * @brief 按变量节点的写入模式执行写入，仅在 server.cpp 中实例化
+     *
+     * @param node_id 变量节点 ID
+     * @param hasher 计算内容哈希的函数，仅在 SkipUnchanged 模式下调用
+     * @param write 执行写入的函数，返回是否成功写入
+     * @return 是否成功写入，跳过写入时同样返回 UA_TRUE
+     */
+    template <typename _Hasher, typename _Write>
+    static UA_Boolean dedupWrite(const UA_NodeId &node_id, _Hasher &&hasher, _Write &&write);
+
+    //! 直接写入完整的数据值，不经过写入去重
+    static UA_Boolean storeDataValue(const UA_NodeId &node_id, const UA_DataValue &value);
+
+    //! 变量节点被写入之后调用，不是由 dedupWrite 发起的写入使记录的哈希失效
+    static void invalidateDedup(const UA_NodeId &node_id);
+
+    //! 没有其他值回调的去重变量的写入之后的值回调
+    static void dedupWrittenHandler(UA_Server *server, const UA_NodeId *session_id, void *session_context,
+                                    const UA_NodeId *node_id, void *node_context, const UA_NumericRange *range,
+                                    const UA_DataValue *value);
+
+    /**
+     * @brief 获取源变量当前值的拷贝，每帧最多拷贝一次
+     *
+     * @param server 服务器指针
+     * @param source 源变量的写入观察者
+     * @return 源变量当前值的拷贝
+     */
+    static const UA_DataValue &refreshSnapshot(UA_Server *server, ImageSource *source);
+
+    //! 图像写入之后的值回调，标记新帧、发布至共享内存通道并更新差分变量
+    static void imageWrittenHandler(UA_Server *server, const UA_NodeId *session_id, void *session_context,
+                                    const UA_NodeId *node_id, void *node_context, const UA_NumericRange *range,
+                                    const UA_DataValue *value);
+
+    //! 预览变量的数据源读取回调，按需生成预览
+    static UA_StatusCode previewReadHandler(UA_Server *server, const UA_NodeId *session_id, void *session_context,
+                                            const UA_NodeId *node_id, void *node_context, UA_Boolean source_timestamp,
+                                            const UA_NumericRange *range, UA_DataValue *value);
+
+    //! 压缩变量的数据源读取回调，按需压缩
+    static UA_StatusCode compressedReadHandler(UA_Server *server, const UA_NodeId *session_id, void *session_context,
+                                               const UA_NodeId *node_id, void *node_context,
+                                               UA_Boolean source_timestamp, const UA_NumericRange *range,
+                                               UA_DataValue *value);
+
+    //! 本地监视项数据变更回调的转发函数
+    static void dataChangeHandler(UA_Server *server, UA_UInt32 mon_id, void *mon_context, const UA_NodeId *node_id,
+                                  void *node_context, UA_UInt32 attribute_id, const UA_DataValue *value);
+
+    //! 历史数据库的写入回调，将历史变量的数据值追加至历史数据存储
+    static void historySetValueHandler(UA_Server *server, void *hdb_context, const UA_NodeId *session_id,
+                                       void *session_context, const UA_NodeId *node_id, UA_Boolean historizing,
+                                       const UA_DataValue *value);
+
+    //! 历史数据库的原始数据读取回调
+    static void historyReadRawHandler(UA_Server *server, void *hdb_context, const UA_NodeId *session_id,
+                                      void *session_context, const UA_RequestHeader *request_header,
+                                      const UA_ReadRawModifiedDetails *details, UA_TimestampsToReturn timestamps,
+                                      UA_Boolean release, size_t nodes_size, const UA_HistoryReadValueId *nodes,
+                                      UA_HistoryReadResponse *response, UA_HistoryData *const *const history_data);
 };
 
 inline UA_Server *Server::__server = nullptr;
 inline UA_Boolean Server::__is_init = UA_FALSE;
 inline UA_Boolean Server::__running = UA_FALSE;
+inline std::deque<Server::CallbackContext> Server::__contexts;
+inline std::deque<Server::ImageSource> Server::__image_sources;
+inline std::deque<Server::PreviewContext> Server::__previews;
+inline std::deque<Server::CompressedContext> Server::__compressed;
+inline std::deque<Server::DeltaContext> Server::__deltas;
+inline std::unordered_map<UA_NodeId, Server::WriteDedup, Server::NodeIdHash, Server::NodeIdEqual> Server::__dedups;
+inline std::mutex Server::__dedup_mtx;
+inline std::unordered_map<UA_NodeId, std::unique_ptr<HistoryBuffer>, Server::NodeIdHash, Server::NodeIdEqual> Server::__histories;
 
 //! @} opcua_cs
 
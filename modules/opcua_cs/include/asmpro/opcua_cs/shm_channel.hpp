@@ -0,0 +1,211 @@
+/**
+ * @file shm_channel.hpp
+ * @author 赵曦 (535394140@qq.com)
+ * @brief Shared memory ring with futex wakeups for co-located server and client processes
+ * @version 1.0
+ * @date 2023-03-19
+ *
+ * @copyright Copyright (c) 2023, zhaoxi
+ *
+ */
+
+#pragma once
+
+#include <atomic>
+#include <string>
+
+#include <sys/types.h>
+
+#include "ua_utility.hpp"
+
+namespace ua
+{
+
+//! @addtogroup opcua_cs
+//! @{
+
+//! 共享内存环形缓冲区的布局，由 ShmWriter 与 ShmReader 共用
+namespace shm
+{
+
+//! 共享内存段的首部
+struct Header
+{
+    char magic[8];                  //!< 魔数 "UASHM001"
+    UA_UInt32 slot_count;           //!< 帧缓冲区数量
+    UA_UInt32 reserved;             //!< 保留
+    UA_UInt64 slot_size;            //!< 单帧的最大字节数
+    std::atomic<UA_UInt64> seq;     //!< 最新发布的帧序号，0 表示尚未发布
+    std::atomic<UA_UInt32> futex;   //!< 每次发布后递增，读取方在此等待
+    std::atomic<UA_UInt32> waiters; //!< 正在等待的读取方数量
+};
+
+//! 帧缓冲区的首部，数据紧随其后
+struct Slot
+{
+    std::atomic<UA_UInt64> seq;   //!< 帧序号，写入期间为 0
+    UA_UInt64 size;               //!< 数据字节数
+    UA_UInt32 type_id;            //!< 数组元素的数据类型 (ns=0 的数值型节点 ID)
+    UA_UInt32 reserved;           //!< 保留
+    UA_DateTime source_timestamp; //!< 源时间戳
+};
+
+//! 帧缓冲区的对齐字节数
+constexpr std::size_t alignment = 64;
+
+//! 帧缓冲区 (首部与数据) 的跨度
+inline std::size_t stride(std::size_t slot_size)
+{
+    return (sizeof(Slot) + slot_size + alignment - 1) / alignment * alignment;
+}
+
+//! 共享内存段的总字节数
+inline std::size_t segmentSize(std::size_t slot_size, std::size_t slot_count)
+{
+    return alignment + stride(slot_size) * slot_count;
+}
+
+} // namespace shm
+
+/**
+ * @brief 共享内存写入方，将变量的值发布至共享内存环形缓冲区
+ * @note 发布时将数据直接拷贝至共享内存 (唯一的一次拷贝)，随后通过 futex 唤醒等待的读取方，
+ *       从不等待读取方，读取方处理缓慢时最旧的帧被覆盖。写入方只能有一个线程
+ */
+class ShmWriter final
+{
+    std::string __name;              //!< 共享内存名
+    int __fd = -1;                   //!< 共享内存文件描述符
+    UA_Byte *__base = nullptr;       //!< 共享内存映射的首地址
+    std::size_t __size = 0;          //!< 共享内存映射的字节数
+    shm::Header *__header = nullptr; //!< 共享内存段的首部
+    UA_UInt64 __seq = 0;             //!< 已发布的帧数
+    UA_UInt64 __oversize = 0;        //!< 因过大或类型不支持而未发布的帧数
+
+public:
+    /**
+     * @brief 创建共享内存段，已存在的同名共享内存段会被替换
+     *
+     * @param name 共享内存名，如 "/ua_camera1_image"
+     * @param slot_size 单帧的最大字节数
+     * @param slot_count 帧缓冲区数量，至少为 2
+     * @param mode 共享内存段的访问权限，默认仅允许同一用户的进程读取 (default: 0600)
+     */
+    ShmWriter(const std::string &name, std::size_t slot_size, std::size_t slot_count = 4, mode_t mode = 0600);
+
+    //! 删除共享内存段，已打开的读取方仍可访问其映射
+    ~ShmWriter();
+
+    ShmWriter(const ShmWriter &) = delete;
+    ShmWriter &operator=(const ShmWriter &) = delete;
+
+    //! 是否成功创建共享内存段
+    inline bool isOpen() const { return __base != nullptr; }
+
+    //! 共享内存名
+    inline const std::string &name() const { return __name; }
+
+    /**
+     * @brief 发布一帧数据
+     *
+     * @param data 数据首地址
+     * @param size 数据字节数
+     * @param type_id 数组元素的数据类型 (ns=0 的数值型节点 ID)
+     * @param source_timestamp 源时间戳
+     * @return 是否成功发布
+     */
+    bool publish(const void *data, std::size_t size, UA_UInt32 type_id, UA_DateTime source_timestamp);
+
+    /**
+     * @brief 发布 UA_Variant 中的数据，可直接在写入之后的值回调中使用
+     * @note 支持元素不含指针的数组与标量，以及 ByteString 类型的标量
+     *
+     * @param value 变量的值
+     * @param source_timestamp 源时间戳
+     * @return 是否成功发布
+     */
+    bool publish(const UA_Variant &value, UA_DateTime source_timestamp);
+
+    //! 已发布的帧数
+    inline UA_UInt64 published() const { return __seq; }
+    //! 因过大或类型不支持而未发布的帧数
+    inline UA_UInt64 oversize() const { return __oversize; }
+};
+
+/**
+ * @brief 共享内存读取方，直接在共享内存中读取 ShmWriter 发布的最新帧
+ * @note 读取过程不进行拷贝，读取结束后通过帧序号检查该帧是否在读取期间被写入方覆盖。
+ *       读取方之间互不影响，每个读取方只能有一个线程
+ */
+class ShmReader final
+{
+    int __fd = -1;                   //!< 共享内存文件描述符
+    UA_Byte *__base = nullptr;       //!< 共享内存映射的首地址
+    std::size_t __size = 0;          //!< 共享内存映射的字节数
+    shm::Header *__header = nullptr; //!< 共享内存段的首部
+    UA_UInt64 __last = 0;            //!< 最近读取的帧序号
+    UA_UInt64 __received = 0;        //!< 读取完成的帧数
+    UA_UInt64 __skipped = 0;         //!< 未被读取的帧数
+    UA_UInt64 __torn = 0;            //!< 读取期间被覆盖的帧数
+
+public:
+    /**
+     * @brief 打开共享内存段
+     *
+     * @param name 共享内存名
+     */
+    explicit ShmReader(const std::string &name);
+
+    ~ShmReader();
+
+    ShmReader(const ShmReader &) = delete;
+    ShmReader &operator=(const ShmReader &) = delete;
+
+    //! 是否成功打开共享内存段
+    inline bool isOpen() const { return __base != nullptr; }
+
+    /**
+     * @brief 读取最新的一帧数据
+     * @note 只读取比上一次更新的帧，中间的帧被跳过并计数。f 返回后该帧若已被覆盖则视为读取失败，
+     *       此时 f 中得到的数据可能不完整，应丢弃其结果
+     *
+     * @param f 读取函数，签名为 void(const UA_Byte *data, std::size_t size, UA_UInt64 seq, UA_DateTime source_timestamp)
+     * @param timeout 等待数据的超时时间 (单位：ms)
+     * @return 是否在超时前完整读取到数据
+     */
+    template <typename _Callable>
+    bool consume(_Callable &&f, UA_UInt32 timeout)
+    {
+        UA_UInt64 seq = 0;
+        const shm::Slot *slot = acquire(timeout, seq);
+        if (slot == nullptr)
+            return false;
+        f(reinterpret_cast<const UA_Byte *>(slot + 1), static_cast<std::size_t>(slot->size), seq,
+          slot->source_timestamp);
+        return release(slot, seq);
+    }
+
+    //! 读取完成的帧数
+    inline UA_UInt64 received() const { return __received; }
+    //! 写入方发布后未被读取的帧数
+    inline UA_UInt64 skipped() const { return __skipped; }
+    //! 读取期间被覆盖的帧数
+    inline UA_UInt64 torn() const { return __torn; }
+
+private:
+    /**
+     * @brief 等待并定位最新的一帧
+     *
+     * @param timeout 等待数据的超时时间 (单位：ms)
+     * @param seq 帧序号
+     * @return 帧缓冲区，超时时返回 nullptr
+     */
+    const shm::Slot *acquire(UA_UInt32 timeout, UA_UInt64 &seq);
+
+    //! 检查该帧在读取期间是否被覆盖
+    bool release(const shm::Slot *slot, UA_UInt64 seq);
+};
+
+//! @} opcua_cs
+
+} // namespace ua
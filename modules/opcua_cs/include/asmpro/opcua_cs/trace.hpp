@@ -0,0 +1,120 @@
+/**
+ * @file trace.hpp
+ * @author 赵曦 (535394140@qq.com)
+ * @brief Span instrumentation exported as Chrome trace events
+ * @version 1.0
+ * @date 2023-03-15
+ *
+ * @copyright Copyright (c) 2023, zhaoxi
+ *
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <string>
+
+#include "ua_utility.hpp"
+
+namespace ua
+{
+
+//! @addtogroup opcua_cs
+//! @{
+
+/**
+ * @brief 区间追踪，导出为 Chrome trace_event 格式，可在 Perfetto 或 chrome://tracing 中查看
+ * @note 每个线程拥有独立的无锁环形缓冲区，记录区间时不加锁、不分配内存 (线程首次记录时除外)，
+ *       缓冲区满时丢弃新的区间并计数。未启用时每个区间的开销仅为一次原子读取
+ */
+class Trace final
+{
+    static std::atomic_bool __enabled;    //!< 是否启用追踪
+    static std::atomic_size_t __capacity; //!< 每个线程的环形缓冲区容量
+
+public:
+    Trace() = delete;
+
+    /**
+     * @brief 启用追踪
+     *
+     * @param capacity 每个线程的环形缓冲区可容纳的区间数，仅对之后首次记录的线程生效
+     */
+    static void enable(std::size_t capacity = 1 << 16);
+
+    //! 停用追踪，已记录的区间仍可导出
+    static void disable() { __enabled.store(false, std::memory_order_relaxed); }
+
+    //! 是否启用追踪
+    static inline bool enabled() { return __enabled.load(std::memory_order_relaxed); }
+
+    //! 单调时钟的当前时间 (单位：ns)
+    static inline UA_UInt64 now()
+    {
+        using namespace std::chrono;
+        return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+    }
+
+    /**
+     * @brief 记录一个区间至当前线程的环形缓冲区
+     *
+     * @param name 区间名，必须在导出之前保持有效 (字符串字面量或 intern 的返回值)
+     * @param category 区间类别，要求同 name
+     * @param begin 开始时间 (单位：ns)
+     * @param end 结束时间 (单位：ns)
+     */
+    static void record(const char *name, const char *category, UA_UInt64 begin, UA_UInt64 end);
+
+    /**
+     * @brief 将运行时生成的区间名保存至追踪器持有的存储中
+     * @note 相同的名称只保存一份，保存的名称在进程退出前不会释放，
+     *       应在创建回调上下文时调用一次，而不是在每次记录区间时调用
+     *
+     * @param name 区间名
+     * @return 与进程同生命周期的区间名
+     */
+    static const char *intern(const std::string &name);
+
+    /**
+     * @brief 取出所有线程中已记录的区间，写入 Chrome trace_event JSON 文件
+     *
+     * @param path 文件路径
+     * @param logger 用于报告错误的日志记录器，一般为 Server::logger() 或 Client::logger() (default: UA_Log_Stdout)
+     * @return 是否成功写入
+     */
+    static bool flush(const std::string &path, const UA_Logger *logger = UA_Log_Stdout);
+
+    //! 因缓冲区已满而被丢弃的区间数
+    static UA_UInt64 dropped();
+};
+
+inline std::atomic_bool Trace::__enabled{false};
+inline std::atomic_size_t Trace::__capacity{1 << 16};
+
+/**
+ * @brief 作用域区间，构造时开始、析构时结束
+ */
+class TraceSpan final
+{
+    const char *__name;     //!< 区间名
+    const char *__category; //!< 区间类别
+    UA_UInt64 __begin;      //!< 开始时间，为 0 表示未启用追踪
+
+public:
+    TraceSpan(const char *name, const char *category)
+        : __name(name), __category(category), __begin(Trace::enabled() ? Trace::now() : 0) {}
+
+    ~TraceSpan()
+    {
+        if (__begin != 0)
+            Trace::record(__name, __category, __begin, Trace::now());
+    }
+
+    TraceSpan(const TraceSpan &) = delete;
+    TraceSpan &operator=(const TraceSpan &) = delete;
+};
+
+//! @} opcua_cs
+
+} // namespace ua
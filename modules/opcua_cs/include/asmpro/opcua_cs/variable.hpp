@@ -13,6 +13,7 @@
 
 #include <vector>
 #include <string>
+#include <type_traits>
 
 #include "ua_utility.hpp"
 
@@ -24,7 +25,8 @@ namespace ua
 
 /**
  * @brief 基于 OPC UA 协议的变量类型
- * @note 通过 get() 方法可直接从 VariableType 获取其默认值
+ * @note 通过 get() 方法可直接从 VariableType 获取其默认值，VariableType 独占其默认值的内存，
+ *       拷贝时执行深拷贝，移动时转移所有权
  */
 class VariableType
 {
@@ -32,10 +34,36 @@ class VariableType
     UA_UInt32 __size;      //!< 数组大小
 
 public:
-    VariableType() { UA_Variant_init(&__init_val); }
-    ~VariableType() = default;
+    VariableType() : __size(0) { UA_Variant_init(&__init_val); }
+    ~VariableType() { UA_Variant_clear(&__init_val); }
 
-    template <typename _Tp>
+    VariableType(const VariableType &val) : __size(val.__size) { UA_Variant_copy(&val.__init_val, &__init_val); }
+    VariableType(VariableType &&val) noexcept : __init_val(val.__init_val), __size(val.__size) { UA_Variant_init(&val.__init_val); }
+
+    VariableType &operator=(const VariableType &val)
+    {
+        if (this != &val)
+        {
+            UA_Variant_clear(&__init_val);
+            UA_Variant_copy(&val.__init_val, &__init_val);
+            __size = val.__size;
+        }
+        return *this;
+    }
+
+    VariableType &operator=(VariableType &&val) noexcept
+    {
+        if (this != &val)
+        {
+            UA_Variant_clear(&__init_val);
+            __init_val = val.__init_val;
+            __size = val.__size;
+            UA_Variant_init(&val.__init_val);
+        }
+        return *this;
+    }
+
+    template <typename _Tp, typename Enable = std::enable_if_t<!std::is_same_v<_Tp, VariableType>>>
     VariableType(const _Tp &val) : __size(0)
     {
         UA_Variant_init(&__init_val);
@@ -56,13 +84,7 @@ public:
     }
 
     //! clone
-    VariableType clone() const
-    {
-        VariableType retval;
-        UA_Variant_copy(&__init_val, &retval.__init_val);
-        retval.__size = __size;
-        return retval;
-    }
+    VariableType clone() const { return *this; }
 
     //!< 获取 VariableType 的默认 UA_Variant 值
     inline const UA_Variant &get() const { return __init_val; }
@@ -88,8 +110,9 @@ private:
         else
         {
             UA_Variant_setArrayCopy(&__init_val, data, __size, type);
+            __init_val.arrayDimensions = static_cast<UA_UInt32 *>(UA_Array_new(1, &UA_TYPES[UA_TYPES_UINT32]));
+            __init_val.arrayDimensions[0] = __size;
             __init_val.arrayDimensionsSize = 1;
-            __init_val.arrayDimensions = &__size;
         }
     }
 };
@@ -97,7 +120,8 @@ private:
 /**
  * @brief 基于 OPC UA 协议的变量
  * @note 可直接从 VariableType 构造一个 Variable，也可通过与 VariableType
- *       同样的构造方式构造 Variable，Variable 的构造方式均为 
+ *       同样的构造方式构造 Variable，Variable 的构造方式均为深拷贝。Variable
+ *       独占其数据的内存，拷贝时执行深拷贝，移动时转移所有权
  */
 class Variable
 {
@@ -105,9 +129,35 @@ class Variable
     UA_UInt32 __size; //!< 数组大小
 
 public:
-    Variable() { UA_Variant_init(&__val); }
+    Variable() : __size(0) { UA_Variant_init(&__val); }
+
+    ~Variable() { UA_Variant_clear(&__val); }
 
-    ~Variable() = default;
+    Variable(const Variable &val) : __size(val.__size) { UA_Variant_copy(&val.__val, &__val); }
+    Variable(Variable &&val) noexcept : __val(val.__val), __size(val.__size) { UA_Variant_init(&val.__val); }
+
+    Variable &operator=(const Variable &val)
+    {
+        if (this != &val)
+        {
+            UA_Variant_clear(&__val);
+            UA_Variant_copy(&val.__val, &__val);
+            __size = val.__size;
+        }
+        return *this;
+    }
+
+    Variable &operator=(Variable &&val) noexcept
+    {
+        if (this != &val)
+        {
+            UA_Variant_clear(&__val);
+            __val = val.__val;
+            __size = val.__size;
+            UA_Variant_init(&val.__val);
+        }
+        return *this;
+    }
 
     explicit Variable(const VariableType &val_type)
     {
@@ -117,7 +167,8 @@ public:
         initVal(val.data, val.type);
     }
 
-    template <typename _Tp, typename Enable = std::enable_if_t<!std::is_same_v<_Tp, VariableType>>>
+    template <typename _Tp, typename Enable = std::enable_if_t<!std::is_same_v<_Tp, VariableType> &&
+                                                               !std::is_same_v<_Tp, Variable>>>
     Variable(const _Tp &val) : __size(0)
     {
         UA_Variant_init(&__val);
@@ -137,15 +188,24 @@ public:
         initVal(&ua_str, &UA_TYPES[UA_TYPES_STRING]);
     }
 
-    //! clone
-    Variable clone() const
+    /**
+     * @brief 接管 UA_Variant 的所有权构造变量，不拷贝数据
+     *
+     * @param val 被接管的 UA_Variant，接管后被重置为空
+     * @return 持有原数据的变量
+     */
+    static Variable adopt(UA_Variant &val)
     {
         Variable retval;
-        UA_Variant_copy(&__val, &retval.__val);
-        retval.__size = __size;
+        retval.__val = val;
+        retval.__size = UA_Variant_isScalar(&val) ? 0 : static_cast<UA_UInt32>(val.arrayLength);
+        UA_Variant_init(&val);
         return retval;
     }
 
+    //! clone
+    Variable clone() const { return *this; }
+
     //! 获取 UA_Variant 值
     inline const UA_Variant &get() const { return __val; }
     //! 判空
@@ -170,8 +230,9 @@ private:
         else
         {
             UA_Variant_setArrayCopy(&__val, data, __size, type);
+            __val.arrayDimensions = static_cast<UA_UInt32 *>(UA_Array_new(1, &UA_TYPES[UA_TYPES_UINT32]));
+            __val.arrayDimensions[0] = __size;
             __val.arrayDimensionsSize = 1;
-            __val.arrayDimensions = &__size;
         }
     }
 };
@@ -0,0 +1,105 @@
+/**
+ * @file write_scheduler.hpp
+ * @author 赵曦 (535394140@qq.com)
+ * @brief Client-side write coalescing with a per-scheduler flush rate limit
+ * @version 1.0
+ * @date 2023-03-22
+ *
+ * @copyright Copyright (c) 2023, zhaoxi
+ *
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <future>
+#include <thread>
+#include <unordered_map>
+
+#include "client.hpp"
+
+namespace ua
+{
+
+//! @addtogroup opcua_cs
+//! @{
+
+/**
+ * @brief 客户端写入调度器，合并同一变量的连续写入并限制写入频率
+ * @note 每个变量只保留最新的待写入值，后台线程以不超过 max_rate 的频率将所有待写入的变量合并为一次
+ *       批量写入 (见 Client::write)。写入返回的 future 在该值或之后的更新值被服务器确认时就绪，
+ *       其结果为实际写入的状态码。只有后台线程发送写入请求，同一变量的写入不会乱序。线程安全
+ */
+class WriteScheduler final
+{
+    struct NodeIdHash
+    {
+        inline std::size_t operator()(const UA_NodeId &id) const { return UA_NodeId_hash(&id); }
+    };
+
+    struct NodeIdEqual
+    {
+        inline bool operator()(const UA_NodeId &lhs, const UA_NodeId &rhs) const { return UA_NodeId_equal(&lhs, &rhs); }
+    };
+
+    //! 变量的待写入状态
+    struct Pending
+    {
+        Variable data;                                    //!< 最新的待写入值
+        std::vector<std::promise<UA_StatusCode>> waiters; //!< 等待该值或更新值被确认的写入
+        UA_Boolean dirty = UA_FALSE;                      //!< 是否有尚未发送的值
+    };
+
+    Client &__client;                                                           //!< 执行写入的客户端
+    std::chrono::steady_clock::duration __interval;                             //!< 相邻两次批量写入的最小间隔
+    std::unordered_map<UA_NodeId, Pending, NodeIdHash, NodeIdEqual> __pendings; //!< 变量的待写入状态，条目不会被删除
+    std::vector<std::pair<const UA_NodeId *, Pending *>> __dirty;               //!< 有尚未发送的值的变量，按首次变脏的顺序排列
+    std::mutex __mtx;                                                           //!< 待写入状态的互斥锁
+    std::condition_variable __cv;                                               //!< 唤醒后台线程的条件变量
+    UA_Boolean __running = UA_TRUE;                                             //!< 后台线程是否运行
+    std::thread __worker;                                                       //!< 执行批量写入的后台线程
+    std::atomic<UA_UInt64> __submitted{0};                                      //!< 提交的写入数
+    std::atomic<UA_UInt64> __written{0};                                        //!< 实际发送的变量写入数
+    std::atomic<UA_UInt64> __batches{0};                                        //!< 发送的 Write 请求数
+
+public:
+    /**
+     * @brief 创建写入调度器并启动后台线程
+     *
+     * @param client 执行写入的客户端，生命周期需长于调度器
+     * @param max_rate 每秒最多的批量写入次数，小于等于 0 时不限制
+     */
+    explicit WriteScheduler(Client &client, double max_rate = 20.0);
+
+    //! 发送所有待写入的值后停止后台线程
+    ~WriteScheduler();
+
+    WriteScheduler(const WriteScheduler &) = delete;
+    WriteScheduler &operator=(const WriteScheduler &) = delete;
+
+    /**
+     * @brief 提交一次变量写入，覆盖该变量尚未发送的值，不阻塞
+     *
+     * @param node_id 变量节点 ID
+     * @param data 写入的值
+     * @return 该值或之后的更新值被服务器确认时就绪的状态码
+     */
+    std::future<UA_StatusCode> write(const UA_NodeId &node_id, Variable data);
+
+    //! 提交的写入数
+    inline UA_UInt64 submitted() const { return __submitted; }
+    //! 实际发送的变量写入数
+    inline UA_UInt64 written() const { return __written; }
+    //! 发送的 Write 请求数
+    inline UA_UInt64 batches() const { return __batches; }
+
+private:
+    //! 后台线程，按最小间隔取出所有待写入的值并批量写入
+    void run();
+};
+
+//! @} opcua_cs
+
+} // namespace ua
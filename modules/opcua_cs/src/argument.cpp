@@ -14,13 +14,13 @@
 using namespace std;
 using namespace ua;
 
-Argument::Argument(const string &name, const string &description, const UA_DataType *type, UA_UInt32 size) : __size(size)
+Argument::Argument(const string &name, const string &description, const UA_DataType *type, UA_UInt32 size)
 {
     UA_Argument_init(&__argument);
     __argument.name = UA_STRING_ALLOC(name.c_str());
     __argument.description = UA_LOCALIZEDTEXT_ALLOC("en-US", description.c_str());
     __argument.dataType = type->typeId;
-    if (__size == 0)
+    if (size == 0)
     {
         __argument.valueRank = UA_VALUERANK_SCALAR;
         __argument.arrayDimensionsSize = 0;
@@ -30,6 +30,7 @@ Argument::Argument(const string &name, const string &description, const UA_DataT
     {
         __argument.valueRank = 1;
         __argument.arrayDimensionsSize = 1;
-        __argument.arrayDimensions = &__size;
+        __argument.arrayDimensions = static_cast<UA_UInt32 *>(UA_Array_new(1, &UA_TYPES[UA_TYPES_UINT32]));
+        __argument.arrayDimensions[0] = size;
     }
 }
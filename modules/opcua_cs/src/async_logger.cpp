@@ -0,0 +1,278 @@
+/**
+ * @file async_logger.cpp
+ * @author 赵曦 (535394140@qq.com)
+ * @brief Asynchronous UA_Logger writing from a background thread
+ * @version 1.0
+ * @date 2023-03-17
+ *
+ * @copyright Copyright (c) 2023, zhaoxi
+ *
+ */
+
+#include <chrono>
+#include <cstdarg>
+#include <cstring>
+
+#include "asmpro/opcua_cs/async_logger.hpp"
+
+using namespace std;
+using namespace ua;
+
+namespace
+{
+
+const char *level_names[] = {"trace", "debug", "info", "warn", "error", "fatal"};
+const char *category_names[] = {"network", "channel", "session", "server", "client", "userland", "securitypolicy"};
+
+//! 单调时钟的当前时间 (单位：ms)
+inline UA_Int64 steadyMillis()
+{
+    using namespace chrono;
+    return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+//! 按 UA_Log_Stdout 的格式写入时间戳、级别与类别，返回写入的长度
+size_t formatPrefix(char *buf, size_t size, UA_DateTime time, UA_LogLevel level, UA_LogCategory category)
+{
+    UA_DateTimeStruct t = UA_DateTime_toStruct(time + UA_DateTime_localTimeUtcOffset());
+    int len = snprintf(buf, size, "[%04d-%02u-%02u %02u:%02u:%02u.%03u] %s/%s\t", t.year, t.month, t.day,
+                       t.hour, t.min, t.sec, t.milliSec, level_names[level], category_names[category]);
+    return len < 0 ? 0 : min(static_cast<size_t>(len), size - 1);
+}
+
+/**
+ * @brief 复制消息体并移除其中的 ANSI 转义序列，例如终端颜色控制
+ * @note CSI 序列为 ESC '[' 加参数与中间字节，以 0x40 ~ 0x7E 之间的字节结尾，其余转义序列只移除 ESC 与其后的一个字节
+ *
+ * @return 写入的长度
+ */
+size_t copyStripped(char *dst, const char *src, size_t len)
+{
+    size_t n = 0;
+    for (size_t i = 0; i < len; ++i)
+    {
+        if (src[i] != '\x1b')
+        {
+            dst[n++] = src[i];
+            continue;
+        }
+        if (i + 1 < len && src[i + 1] == '[')
+        {
+            i += 2;
+            while (i < len && (src[i] < 0x40 || src[i] > 0x7e))
+                ++i;
+        }
+        else
+            ++i;
+    }
+    return n;
+}
+
+} // namespace
+
+AsyncLogger::AsyncLogger(FILE *out, size_t capacity, UA_LogLevel level) : __out(out)
+{
+    size_t n = 2;
+    while (n < capacity)
+        n <<= 1;
+    __ring.reset(new Record[n]);
+    __mask = n - 1;
+    for (size_t i = 0; i < n; ++i)
+        __ring[i].seq.store(i, memory_order_relaxed);
+    setLevel(level);
+    __worker = thread(&AsyncLogger::consume, this);
+}
+
+AsyncLogger::~AsyncLogger()
+{
+    __running = false;
+    {
+        lock_guard<mutex> lk(__wake_mtx);
+        __wake.notify_one();
+    }
+    if (__worker.joinable())
+        __worker.join();
+}
+
+UA_Logger AsyncLogger::logger()
+{
+    UA_Logger retval;
+    retval.log = log;
+    retval.context = this;
+    //!< The server or the client must not destroy the logger
+    retval.clear = nullptr;
+    return retval;
+}
+
+void AsyncLogger::setLevel(UA_LogLevel level)
+{
+    for (auto &each : __levels)
+        each = level;
+}
+
+void AsyncLogger::setRateLimit(UA_UInt32 burst, UA_UInt32 interval_ms)
+{
+    __interval_ms = interval_ms > 0 ? interval_ms : 1;
+    __burst = burst;
+}
+
+void AsyncLogger::flush()
+{
+    //!< Dropped messages never claim a slot, so the head counts exactly the messages to be written
+    size_t target = __head.load(memory_order_acquire);
+    while (__written.load(memory_order_acquire) < target && __running)
+        this_thread::sleep_for(chrono::microseconds(200));
+}
+
+void AsyncLogger::log(void *context, UA_LogLevel level, UA_LogCategory category, const char *msg, va_list args)
+{
+    auto self = static_cast<AsyncLogger *>(context);
+    if (static_cast<size_t>(category) >= category_count || level < self->__levels[category].load(memory_order_relaxed))
+        return;
+    if (!self->admit(category, msg))
+        return;
+    self->push(level, category, msg, args);
+}
+
+bool AsyncLogger::admit(UA_LogCategory category, const char *msg)
+{
+    UA_UInt32 burst = __burst.load(memory_order_relaxed);
+    if (burst == 0)
+        return true;
+    UA_Int64 window = steadyMillis() / __interval_ms.load(memory_order_relaxed);
+    RateEntry &entry = __rate[(reinterpret_cast<uintptr_t>(msg) >> 3) % rate_slots];
+    const char *key = entry.key.load(memory_order_relaxed);
+    if (key != msg)
+    {
+        //!< A new call site takes over the slot, the unreported count of the old one is kept
+        entry.key.store(msg, memory_order_relaxed);
+        entry.category.store(category, memory_order_relaxed);
+        entry.window.store(window, memory_order_relaxed);
+        entry.count.store(0, memory_order_relaxed);
+    }
+    else if (entry.window.load(memory_order_relaxed) != window)
+    {
+        entry.window.store(window, memory_order_relaxed);
+        entry.count.store(0, memory_order_relaxed);
+    }
+    if (entry.count.fetch_add(1, memory_order_relaxed) < burst)
+        return true;
+    entry.suppressed.fetch_add(1, memory_order_relaxed);
+    __suppressed.fetch_add(1, memory_order_relaxed);
+    return false;
+}
+
+void AsyncLogger::push(UA_LogLevel level, UA_LogCategory category, const char *msg, va_list args)
+{
+    //!< Bounded multi-producer queue: claim a slot by advancing the head, publish it by its sequence
+    size_t pos = __head.load(memory_order_relaxed);
+    Record *record = nullptr;
+    while (true)
+    {
+        record = &__ring[pos & __mask];
+        size_t seq = record->seq.load(memory_order_acquire);
+        auto diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+        if (diff == 0)
+        {
+            if (__head.compare_exchange_weak(pos, pos + 1, memory_order_relaxed))
+                break;
+        }
+        else if (diff < 0)
+        {
+            __dropped.fetch_add(1, memory_order_relaxed);
+            return;
+        }
+        else
+            pos = __head.load(memory_order_relaxed);
+    }
+    record->time = UA_DateTime_now();
+    record->level = level;
+    record->category = category;
+    int len = vsnprintf(record->msg, msg_size, msg, args);
+    record->length = static_cast<UA_UInt16>(len < 0 ? 0 : min(static_cast<size_t>(len), msg_size - 1));
+    record->seq.store(pos + 1, memory_order_release);
+    //!< Pairs with the fence in consume(): either the worker sees the record or the writer sees it sleeping
+    atomic_thread_fence(memory_order_seq_cst);
+    if (__sleeping.load(memory_order_relaxed))
+        wake();
+}
+
+void AsyncLogger::wake()
+{
+    lock_guard<mutex> lk(__wake_mtx);
+    __wake.notify_one();
+}
+
+void AsyncLogger::consume()
+{
+    constexpr size_t buf_size = 1 << 16;
+    unique_ptr<char[]> buf(new char[buf_size]);
+    size_t offset = 0;
+    UA_Int64 last_report = steadyMillis();
+    auto write = [&]() {
+        if (offset == 0)
+            return;
+        fwrite(buf.get(), 1, offset, __out);
+        fflush(__out);
+        offset = 0;
+    };
+    //!< Keep draining after stop until the ring is empty
+    bool running = true;
+    while (true)
+    {
+        size_t consumed = 0;
+        while (true)
+        {
+            Record &record = __ring[__tail & __mask];
+            if (record.seq.load(memory_order_acquire) != __tail + 1)
+                break;
+            if (offset + msg_size + 128 > buf_size)
+                write();
+            offset += formatPrefix(buf.get() + offset, 128, record.time, record.level, record.category);
+            offset += copyStripped(buf.get() + offset, record.msg, record.length);
+            buf[offset++] = '\n';
+            record.seq.store(__tail + __mask + 1, memory_order_release);
+            ++__tail;
+            ++consumed;
+        }
+        //!< Summarize the suppressed messages once per rate limit interval
+        UA_Int64 now = steadyMillis();
+        if (now - last_report >= __interval_ms.load(memory_order_relaxed))
+        {
+            last_report = now;
+            for (auto &entry : __rate)
+            {
+                UA_UInt32 n = entry.suppressed.exchange(0, memory_order_relaxed);
+                const char *key = entry.key.load(memory_order_relaxed);
+                if (n == 0 || key == nullptr)
+                    continue;
+                if (offset + msg_size + 128 > buf_size)
+                    write();
+                offset += formatPrefix(buf.get() + offset, 128, UA_DateTime_now(), UA_LOGLEVEL_WARNING,
+                                       entry.category.load(memory_order_relaxed));
+                int len = snprintf(buf.get() + offset, msg_size, "Suppressed %u repeated messages: ", n);
+                offset += len < 0 ? 0 : static_cast<size_t>(len);
+                //!< The key is the raw format string, strip its color codes like the messages themselves
+                offset += copyStripped(buf.get() + offset, key, min(strlen(key), msg_size - (len < 0 ? 0 : len)));
+                buf[offset++] = '\n';
+            }
+        }
+        write();
+        __written.fetch_add(consumed, memory_order_release);
+        if (consumed > 0)
+            continue;
+        if (!running)
+            break;
+        running = __running.load(memory_order_relaxed);
+        if (!running)
+            continue;
+        //!< Sleep until a writer publishes a record, the timeout keeps the suppression summaries on time
+        unique_lock<mutex> lk(__wake_mtx);
+        __sleeping.store(true, memory_order_relaxed);
+        atomic_thread_fence(memory_order_seq_cst);
+        if (__ring[__tail & __mask].seq.load(memory_order_acquire) != __tail + 1 &&
+            __running.load(memory_order_relaxed))
+            __wake.wait_for(lk, chrono::milliseconds(__interval_ms.load(memory_order_relaxed)));
+        __sleeping.store(false, memory_order_relaxed);
+    }
+}
@@ -11,23 +11,236 @@
 
 #include <string>
 #include <memory>
+#include <chrono>
+
+#include <poll.h>
 
 #include "asmpro/opcua_cs/client.hpp"
+#include "asmpro/opcua_cs/compression.hpp"
+#include "asmpro/opcua_cs/trace.hpp"
 
 using namespace std;
 using namespace ua;
 
+namespace
+{
+
+//! 当前线程中持有客户端服务互斥锁进行连接或网络迭代的客户端
+thread_local Client *polling_client = nullptr;
+
+//! 在作用域内登记当前线程中正在连接或迭代的客户端
+struct PollingScope
+{
+    explicit PollingScope(Client *client) { polling_client = client; }
+    ~PollingScope() { polling_client = nullptr; }
+};
+
+} // namespace
+
 Client::Client()
 {
     __client = UA_Client_new();
     UA_ClientConfig *config = UA_Client_getConfig(__client);
     UA_StatusCode status = UA_ClientConfig_setDefault(config);
     if (status != UA_STATUSCODE_GOOD)
+    {
         UA_Client_delete(__client);
+        return;
+    }
+    //!< The default poll function is the same for every client, wrap it to learn the connection of this one
+    if (config->pollConnectionFunc != pollConnection)
+    {
+        __poll_connection = config->pollConnectionFunc;
+        config->pollConnectionFunc = pollConnection;
+    }
+}
+
+UA_StatusCode Client::pollConnection(UA_Connection *connection, UA_UInt32 timeout, const UA_Logger *logger)
+{
+    if (polling_client != nullptr)
+        polling_client->__connection = connection;
+    return __poll_connection(connection, timeout, logger);
+}
+
+Client::~Client()
+{
+    stop();
+    disconnect();
+    UA_Client_delete(__client);
+    for (auto &[node_id, entry] : __cache)
+        UA_NodeId_clear(const_cast<UA_NodeId *>(&node_id));
+    clearCodecs();
+}
+
+unique_lock<recursive_mutex> Client::lock()
+{
+    ++__waiting;
+    unique_lock<recursive_mutex> lk(__mtx);
+    --__waiting;
+    return lk;
+}
+
+Client::MonitorContext &Client::addMonitor(const UA_NodeId &node_id)
+{
+    MonitorContext &monitor = *__monitors.emplace_back(make_shared<MonitorContext>());
+    monitor.client = this;
+    UA_NodeId_copy(&node_id, &monitor.node_id);
+    return monitor;
+}
+
+void Client::disconnect()
+{
+    auto lk = lock();
+    UA_Client_disconnect(__client);
+    __is_connect = UA_FALSE;
+    __max_method_calls.reset();
+    __max_writes.reset();
+    clearCodecs();
+    //!< The subscriptions are gone with the session, pending executor tasks keep their own references
+    __monitors.clear();
+    //!< Cache entries are kept since pending executor tasks may still reference them
+    __cache_sub = 0;
+    lock_guard<mutex> cache_lk(__cache_mtx);
+    __cache_watched = 0;
+    __cache_alive = chrono::steady_clock::time_point();
+    for (auto &[node_id, entry] : __cache)
+    {
+        entry.reads = 0;
+        entry.stale = UA_TRUE;
+        entry.watching = UA_FALSE;
+        entry.watched = UA_FALSE;
+    }
+}
+
+void Client::runIterate(UA_UInt32 timeOut)
+{
+    TraceSpan span("Client::iterate", "client");
+    auto lk = lock();
+    PollingScope scope(this);
+    UA_Client_run_iterate(__client, timeOut);
+}
+
+void Client::start(UA_UInt32 timeout)
+{
+    if (__loop_running.exchange(true))
+        return;
+    __loop = thread([this, timeout]() {
+        while (__loop_running)
+        {
+            //!< Give way to the threads which are waiting for the client services
+            while (__waiting > 0)
+                this_thread::yield();
+            unique_lock<recursive_mutex> lk(__mtx);
+            UA_StatusCode status;
+            {
+                //!< Only the data which has already arrived is processed while the service mutex is held
+                TraceSpan span("Client::iterate", "client");
+                PollingScope scope(this);
+                status = UA_Client_run_iterate(__client, 0);
+            }
+            pollfd fd{UA_INVALID_SOCKET, POLLIN, 0};
+            if (__connection != nullptr && __connection->state == UA_CONNECTIONSTATE_ESTABLISHED)
+                fd.fd = __connection->sockfd;
+            lk.unlock();
+            //!< Block on the socket without the mutex, the foreground services never wait for the timeout.
+            //!< Without a connection this only sleeps, which also avoids busy-spinning on the error path
+            if (status != UA_STATUSCODE_GOOD || fd.fd == UA_INVALID_SOCKET)
+                this_thread::sleep_for(chrono::milliseconds(timeout));
+            else
+                poll(&fd, 1, static_cast<int>(timeout));
+        }
+    });
+}
+
+void Client::stop()
+{
+    __loop_running = false;
+    if (__loop.joinable())
+        __loop.join();
+}
+
+void Client::setExecutor(Executor executor)
+{
+    auto lk = lock();
+    __executor = std::move(executor);
+}
+
+void Client::setLogger(const UA_Logger &logger)
+{
+    auto lk = lock();
+    UA_ClientConfig *config = UA_Client_getConfig(__client);
+    if (config->logger.clear != nullptr)
+        config->logger.clear(config->logger.context);
+    config->logger = logger;
+}
+
+void Client::setTracer(shared_ptr<LatencyTracer> tracer)
+{
+    auto lk = lock();
+    __tracer = std::move(tracer);
+}
+
+void Client::dataChangeHandler(UA_Client *client, UA_UInt32 sub_id, void *sub_context,
+                               UA_UInt32 mon_id, void *mon_context, UA_DataValue *value)
+{
+    //!< Queued tasks share the context, it may be released before they run
+    auto monitor = static_cast<MonitorContext *>(mon_context)->shared_from_this();
+    const Executor &executor = monitor->client->__executor;
+    shared_ptr<LatencyTracer> tracer = monitor->client->__tracer;
+    UA_DateTime received = tracer != nullptr ? UA_DateTime_now() : 0;
+    auto notify = [=](UA_DataValue *data_value) {
+        UA_DateTime begin = tracer != nullptr ? UA_DateTime_now() : 0;
+        TraceSpan span("Client::dataChange", "callback");
+        //!< Decode off the network thread when an executor is set
+        if (data_value->hasValue && monitor->codec)
+            decompressValue(data_value->value, *monitor->codec);
+        //!< The handler may take the value over, the tracer only needs the timestamps
+        UA_DataValue stamps = *data_value;
+        UA_Variant_init(&stamps.value);
+        if (monitor->on_change)
+            monitor->on_change(mon_id, *data_value);
+        else
+            monitor->data_change(client, sub_id, sub_context, mon_id, &monitor->node_id, data_value);
+        if (tracer != nullptr)
+            tracer->record(stamps, received, begin, UA_DateTime_now());
+    };
+    if (!executor)
+    {
+        notify(value);
+        return;
+    }
+    //!< The notification is only valid during the callback, deep copy it for the executor
+    shared_ptr<UA_DataValue> copied(UA_DataValue_new(), UA_DataValue_delete);
+    UA_DataValue_copy(value, copied.get());
+    executor([=]() { notify(copied.get()); });
+}
+
+void Client::eventHandler(UA_Client *client, UA_UInt32 sub_id, void *sub_context, UA_UInt32 mon_id,
+                          void *mon_context, size_t n_event_fields, UA_Variant *event_fields)
+{
+    auto monitor = static_cast<MonitorContext *>(mon_context)->shared_from_this();
+    const Executor &executor = monitor->client->__executor;
+    if (!executor)
+    {
+        monitor->event(client, sub_id, sub_context, mon_id, &monitor->node_id, n_event_fields, event_fields);
+        return;
+    }
+    void *fields = nullptr;
+    UA_Array_copy(event_fields, n_event_fields, &fields, &UA_TYPES[UA_TYPES_VARIANT]);
+    shared_ptr<UA_Variant> copied(static_cast<UA_Variant *>(fields), [n_event_fields](UA_Variant *p) {
+        UA_Array_delete(p, n_event_fields, &UA_TYPES[UA_TYPES_VARIANT]);
+    });
+    executor([=]() { monitor->event(client, sub_id, sub_context, mon_id, &monitor->node_id, n_event_fields, copied.get()); });
 }
 
 UA_Boolean Client::connect(const string &address, const string &username, const string &password)
 {
+    auto lk = lock();
+    //!< The operation limits and the codecs belong to the server connected to
+    __max_method_calls.reset();
+    __max_writes.reset();
+    clearCodecs();
+    PollingScope scope(this);
     if (username.empty() || password.empty())
         return UA_Client_connect(__client, address.c_str()) == UA_STATUSCODE_GOOD;
     __is_connect = UA_Client_connectUsername(__client, address.c_str(), username.c_str(), password.c_str()) == UA_STATUSCODE_GOOD;
@@ -36,35 +249,47 @@ UA_Boolean Client::connect(const string &address, const string &username, const
 
 UA_NodeId Client::findNodeId(const UA_NodeId &origin_id, const UA_UInt32 target_ns, const string &target_name)
 {
+    TraceSpan span("Client::findNodeId", "client");
+    auto lk = lock();
     UA_BrowsePath browsePath;
     UA_BrowsePath_init(&browsePath);
     browsePath.startingNode = origin_id;
-    unique_ptr<UA_RelativePathElement> elem = make_unique<UA_RelativePathElement>();
-    browsePath.relativePath.elements = elem.get();
+    //!< The request only references the path element, it lives on the stack
+    UA_RelativePathElement elem;
+    UA_RelativePathElement_init(&elem);
+    browsePath.relativePath.elements = &elem;
     browsePath.relativePath.elementsSize = 1;
 
-    elem->targetName = UA_QUALIFIEDNAME(target_ns, to_c(target_name));
+    elem.targetName = UA_QUALIFIEDNAME(target_ns, to_c(target_name));
 
     UA_TranslateBrowsePathsToNodeIdsRequest request;
     UA_TranslateBrowsePathsToNodeIdsRequest_init(&request);
     request.browsePaths = &browsePath;
     request.browsePathsSize = 1;
 
+    ++__requests;
     UA_TranslateBrowsePathsToNodeIdsResponse response = UA_Client_Service_translateBrowsePathsToNodeIds(__client, request);
-    if (response.responseHeader.serviceResult == UA_STATUSCODE_GOOD)
-        if (response.resultsSize == 1 && response.results[0].targetsSize == 1)
-            return response.results[0].targets[0].targetId.nodeId;
-
-    printf("Error: %s\n", UA_StatusCode_name(response.responseHeader.serviceResult));
-    return UA_NODEID_NULL;
+    UA_NodeId retval = UA_NODEID_NULL;
+    if (response.responseHeader.serviceResult == UA_STATUSCODE_GOOD &&
+        response.resultsSize == 1 && response.results[0].targetsSize == 1)
+        UA_NodeId_copy(&response.results[0].targets[0].targetId.nodeId, &retval);
+    else
+        UA_LOG_ERROR(logger(), UA_LOGCATEGORY_CLIENT,
+                     "Function findNodeId: %s", UA_StatusCode_name(response.responseHeader.serviceResult));
+    UA_TranslateBrowsePathsToNodeIdsResponse_clear(&response);
+    return retval;
 }
 
 UA_Boolean Client::writeVariable(const UA_NodeId &node_id, const Variable &data)
 {
+    TraceSpan span("Client::writeVariable", "client");
+    invalidateCached(node_id);
+    auto lk = lock();
+    ++__requests;
     auto status = UA_Client_writeValueAttribute(__client, node_id, &data.get());
     if (status != UA_STATUSCODE_GOOD)
     {
-        UA_LOG_ERROR(UA_Log_Stdout, UA_LOGCATEGORY_CLIENT, "%s", UA_StatusCode_name(status));
+        UA_LOG_ERROR(logger(), UA_LOGCATEGORY_CLIENT, "%s", UA_StatusCode_name(status));
         return UA_FALSE;
     }
     return UA_TRUE;
@@ -72,88 +297,708 @@ UA_Boolean Client::writeVariable(const UA_NodeId &node_id, const Variable &data)
 
 Variable Client::readVariable(const UA_NodeId &node_id)
 {
+    TraceSpan span("Client::readVariable", "client");
+    auto lk = lock();
     UA_Variant val;
     UA_Variant_init(&val);
+    ++__requests;
     UA_StatusCode retval = UA_Client_readValueAttribute(__client, node_id, &val);
     if (retval != UA_STATUSCODE_GOOD)
     {
-        UA_LOG_ERROR(UA_Log_Stdout, UA_LOGCATEGORY_CLIENT, "%s", UA_StatusCode_name(retval));
+        UA_LOG_ERROR(logger(), UA_LOGCATEGORY_CLIENT, "%s", UA_StatusCode_name(retval));
         return Variable();
     }
+    //!< Only a scalar ByteString can carry a compressed value, other values skip the codec lookup
+    if (UA_Variant_hasScalarType(&val, &UA_TYPES[UA_TYPES_BYTESTRING]))
+    {
+        auto codec = codecOf(node_id);
+        if (codec && !decompressValue(val, *codec))
+            UA_LOG_WARNING(logger(), UA_LOGCATEGORY_CLIENT, "Function readVariable: corrupted compressed value");
+    }
     //!< Variant information
-    return Variable(val.data, val.type, val.arrayLength);
+    return Variable::adopt(val);
+}
+
+void Client::enableReadCache(const ReadCacheOptions &options)
+{
+    lock_guard<mutex> lk(__cache_mtx);
+    __cache_options = options;
+    __cache_enabled = true;
+}
+
+Variable Client::readVariable(const UA_NodeId &node_id, UA_Double max_age)
+{
+    if (!__cache_enabled)
+        return readValue(node_id, max_age);
+    UA_UInt64 generation = 0;
+    {
+        lock_guard<mutex> lk(__cache_mtx);
+        auto it = __cache.find(node_id);
+        if (it == __cache.end())
+        {
+            //!< The entry exists before the read is sent, so a write during the read can invalidate it
+            UA_NodeId key;
+            UA_NodeId_copy(&node_id, &key);
+            it = __cache.emplace(key, CacheEntry()).first;
+        }
+        CacheEntry &entry = it->second;
+        ++entry.reads;
+        generation = entry.generation;
+        //!< A watched variable is only notified on change, so every change before the latest publish
+        //!< has been delivered. Its age counts from that publish plus the maximum notification delay
+        auto seen = entry.watched ? max(entry.updated, __cache_alive) : entry.updated;
+        double age = chrono::duration<double, milli>(chrono::steady_clock::now() - seen).count();
+        if (entry.watched)
+            age += __cache_options.publishing_interval + __cache_options.sampling_interval;
+        if (!entry.stale && max_age > 0 && age <= max_age)
+        {
+            ++__cache_hits;
+            return entry.value;
+        }
+    }
+    ++__cache_misses;
+    Variable retval = readValue(node_id, max_age);
+    if (retval.empty())
+        return retval;
+    const UA_NodeId *watch_key = nullptr;
+    {
+        lock_guard<mutex> lk(__cache_mtx);
+        auto it = __cache.find(node_id);
+        CacheEntry &entry = it->second;
+        if (entry.generation != generation)
+            return retval;
+        entry.value = retval;
+        entry.updated = chrono::steady_clock::now();
+        entry.stale = UA_FALSE;
+        if (!entry.watching && entry.reads >= __cache_options.hot_reads &&
+            __cache_watched < __cache_options.max_watched)
+        {
+            entry.watching = UA_TRUE;
+            ++__cache_watched;
+            watch_key = &it->first;
+        }
+    }
+    if (watch_key != nullptr)
+        watchCached(watch_key);
+    return retval;
+}
+
+Variable Client::readValue(const UA_NodeId &node_id, UA_Double max_age)
+{
+    TraceSpan span("Client::readValue", "client");
+    UA_ReadValueId item;
+    UA_ReadValueId_init(&item);
+    item.nodeId = node_id;
+    item.attributeId = UA_ATTRIBUTEID_VALUE;
+    UA_ReadRequest request;
+    UA_ReadRequest_init(&request);
+    request.maxAge = max_age;
+    request.timestampsToReturn = UA_TIMESTAMPSTORETURN_NEITHER;
+    request.nodesToRead = &item;
+    request.nodesToReadSize = 1;
+
+    auto lk = lock();
+    ++__requests;
+    UA_ReadResponse response = UA_Client_Service_read(__client, request);
+    UA_StatusCode retval = response.responseHeader.serviceResult;
+    if (retval == UA_STATUSCODE_GOOD && response.resultsSize != 1)
+        retval = UA_STATUSCODE_BADUNEXPECTEDERROR;
+    if (retval == UA_STATUSCODE_GOOD && response.results[0].hasStatus)
+        retval = response.results[0].status;
+    if (retval == UA_STATUSCODE_GOOD && !response.results[0].hasValue)
+        retval = UA_STATUSCODE_BADUNEXPECTEDERROR;
+    if (retval != UA_STATUSCODE_GOOD)
+    {
+        UA_LOG_ERROR(logger(), UA_LOGCATEGORY_CLIENT, "%s", UA_StatusCode_name(retval));
+        UA_ReadResponse_clear(&response);
+        return Variable();
+    }
+    UA_Variant &val = response.results[0].value;
+    if (UA_Variant_hasScalarType(&val, &UA_TYPES[UA_TYPES_BYTESTRING]))
+    {
+        auto codec = codecOf(node_id);
+        if (codec && !decompressValue(val, *codec))
+            UA_LOG_WARNING(logger(), UA_LOGCATEGORY_CLIENT, "Function readVariable: corrupted compressed value");
+    }
+    Variable data = Variable::adopt(val);
+    UA_ReadResponse_clear(&response);
+    return data;
+}
+
+void Client::watchCached(const UA_NodeId *key)
+{
+    CacheEntry *entry = nullptr;
+    {
+        lock_guard<mutex> lk(__cache_mtx);
+        entry = &__cache.find(*key)->second;
+    }
+    auto lk = lock();
+    if (__cache_sub == 0)
+    {
+        __cache_sub = createSubscription(__cache_options.publishing_interval);
+        //!< The server time changes every sample, its notifications show that the subscription is alive
+        if (__cache_sub != 0)
+            createVariableMonitors(__cache_sub, {UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERSTATUS_CURRENTTIME)},
+                                   {[this](UA_UInt32, const UA_DataValue &) {
+                                       lock_guard<mutex> cache_lk(__cache_mtx);
+                                       __cache_alive = chrono::steady_clock::now();
+                                   }},
+                                   __cache_options.publishing_interval, 1);
+    }
+    UA_UInt32 mon_id = 0;
+    if (__cache_sub != 0)
+        mon_id = createVariableMonitors(
+                     __cache_sub, {*key},
+                     {[this, entry](UA_UInt32, const UA_DataValue &value) {
+                         if (!value.hasValue)
+                             return;
+                         //!< Copy outside the cache lock, readers only wait for the swap
+                         UA_Variant val;
+                         UA_Variant_copy(&value.value, &val);
+                         Variable data = Variable::adopt(val);
+                         lock_guard<mutex> cache_lk(__cache_mtx);
+                         entry->value = std::move(data);
+                         entry->updated = __cache_alive = chrono::steady_clock::now();
+                         entry->stale = UA_FALSE;
+                     }},
+                     __cache_options.sampling_interval, 1)[0];
+    lock_guard<mutex> cache_lk(__cache_mtx);
+    if (mon_id != 0)
+        entry->watched = UA_TRUE;
+    else
+        --__cache_watched;
+}
+
+void Client::resolveCodecs(const vector<UA_NodeId> &node_ids)
+{
+    auto lk = lock();
+    vector<const UA_NodeId *> keys;
+    for (auto &node_id : node_ids)
+    {
+        if (__codecs.find(node_id) != __codecs.end())
+            continue;
+        UA_NodeId key;
+        UA_NodeId_copy(&node_id, &key);
+        keys.push_back(&__codecs.emplace(key, nullopt).first->first);
+    }
+    if (keys.empty())
+        return;
+    //!< One request looks up the Codec property of every node, a second one reads the properties found
+    char codec_name[] = "Codec";
+    vector<UA_RelativePathElement> elems(keys.size());
+    vector<UA_BrowsePath> paths(keys.size());
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+        UA_RelativePathElement_init(&elems[i]);
+        elems[i].referenceTypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_HASPROPERTY);
+        elems[i].targetName = UA_QUALIFIEDNAME(1, codec_name);
+        UA_BrowsePath_init(&paths[i]);
+        paths[i].startingNode = *keys[i];
+        paths[i].relativePath.elements = &elems[i];
+        paths[i].relativePath.elementsSize = 1;
+    }
+    UA_TranslateBrowsePathsToNodeIdsRequest request;
+    UA_TranslateBrowsePathsToNodeIdsRequest_init(&request);
+    request.browsePaths = paths.data();
+    request.browsePathsSize = paths.size();
+    ++__requests;
+    UA_TranslateBrowsePathsToNodeIdsResponse response = UA_Client_Service_translateBrowsePathsToNodeIds(__client, request);
+    bool ok = response.responseHeader.serviceResult == UA_STATUSCODE_GOOD && response.resultsSize == keys.size();
+    vector<size_t> found;
+    vector<UA_ReadValueId> items;
+    for (size_t i = 0; ok && i < keys.size(); ++i)
+    {
+        if (response.results[i].statusCode != UA_STATUSCODE_GOOD || response.results[i].targetsSize == 0)
+            continue;
+        items.emplace_back();
+        UA_ReadValueId_init(&items.back());
+        items.back().nodeId = response.results[i].targets[0].targetId.nodeId;
+        items.back().attributeId = UA_ATTRIBUTEID_VALUE;
+        found.push_back(i);
+    }
+    if (ok && !items.empty())
+    {
+        UA_ReadRequest read_request;
+        UA_ReadRequest_init(&read_request);
+        read_request.timestampsToReturn = UA_TIMESTAMPSTORETURN_NEITHER;
+        read_request.nodesToRead = items.data();
+        read_request.nodesToReadSize = items.size();
+        ++__requests;
+        UA_ReadResponse read_response = UA_Client_Service_read(__client, read_request);
+        ok = read_response.responseHeader.serviceResult == UA_STATUSCODE_GOOD &&
+             read_response.resultsSize == items.size();
+        for (size_t j = 0; ok && j < items.size(); ++j)
+        {
+            const UA_DataValue &dv = read_response.results[j];
+            if (!dv.hasValue || !UA_Variant_hasScalarType(&dv.value, &UA_TYPES[UA_TYPES_STRING]))
+                continue;
+            auto str = static_cast<const UA_String *>(dv.value.data);
+            Codec codec;
+            if (parseCodec(string(reinterpret_cast<const char *>(str->data), str->length), codec))
+                __codecs[*keys[found[j]]] = codec;
+        }
+        UA_ReadResponse_clear(&read_response);
+    }
+    UA_TranslateBrowsePathsToNodeIdsResponse_clear(&response);
+    if (ok)
+        return;
+    //!< The lookup failed as a whole, try again next time
+    UA_LOG_WARNING(logger(), UA_LOGCATEGORY_CLIENT, "Function resolveCodecs: failed to read the Codec properties");
+    for (auto key : keys)
+    {
+        auto it = __codecs.find(*key);
+        UA_NodeId node_id = it->first;
+        __codecs.erase(it);
+        UA_NodeId_clear(&node_id);
+    }
+}
+
+optional<Codec> Client::codecOf(const UA_NodeId &node_id)
+{
+    auto lk = lock();
+    resolveCodecs({node_id});
+    auto it = __codecs.find(node_id);
+    return it != __codecs.end() ? it->second : nullopt;
+}
+
+void Client::clearCodecs()
+{
+    for (auto &[node_id, codec] : __codecs)
+        UA_NodeId_clear(const_cast<UA_NodeId *>(&node_id));
+    __codecs.clear();
+}
+
+void Client::invalidateCached(const UA_NodeId &node_id)
+{
+    if (!__cache_enabled)
+        return;
+    lock_guard<mutex> lk(__cache_mtx);
+    auto it = __cache.find(node_id);
+    if (it != __cache.end())
+    {
+        it->second.stale = UA_TRUE;
+        ++it->second.generation;
+    }
+}
+
+Variable Client::readImage(const UA_NodeId &node_id, ImageHeader &header, const UA_Byte *&pixels)
+{
+    Variable retval = readVariable(node_id);
+    if (retval.empty())
+        return retval;
+    if (!decodeImage(retval.get(), header, pixels))
+    {
+        UA_LOG_ERROR(logger(), UA_LOGCATEGORY_CLIENT, "Function readImage: not an image");
+        return Variable();
+    }
+    return retval;
 }
 
 UA_Boolean Client::call(const UA_NodeId &node_id, const std::vector<Variable> &inputs,
                         std::vector<Variable> &outputs, const UA_NodeId &parent_id)
 {
-    //!< Initialize the I/O argumenst: vector of UA_Variant
-    vector<UA_Variant> input_variants;
-    input_variants.reserve(inputs.size());
-    for (const auto &input : inputs)
-        input_variants.push_back(input.get());
+    TraceSpan span("Client::call", "client");
+    //!< Shallow views of the input variants, the data is referenced rather than copied
+    constexpr size_t stack_inputs_size = 8;
+    UA_Variant stack_inputs[stack_inputs_size];
+    vector<UA_Variant> heap_inputs;
+    UA_Variant *input_variants = stack_inputs;
+    if (inputs.size() > stack_inputs_size)
+    {
+        heap_inputs.resize(inputs.size());
+        input_variants = heap_inputs.data();
+    }
+    for (size_t i = 0; i < inputs.size(); ++i)
+        input_variants[i] = inputs[i].get();
 
-    size_t output_size;
-    UA_Variant *output_variants;
+    size_t output_size = 0;
+    UA_Variant *output_variants = nullptr;
     //!< Call
+    auto lk = lock();
+    ++__requests;
     UA_StatusCode retval = UA_Client_call(__client, parent_id, node_id,
-                                          input_variants.size(), input_variants.data(),
+                                          inputs.size(), input_variants,
                                           &output_size, &output_variants);
     if (retval != UA_STATUSCODE_GOOD)
     {
-        UA_LOG_ERROR(UA_Log_Stdout, UA_LOGCATEGORY_CLIENT, "Failed to call the method: %s \033[31m(ns=%u,s=%d)\033[0m",
+        UA_LOG_ERROR(logger(), UA_LOGCATEGORY_CLIENT, "Failed to call the method: %s \033[31m(ns=%u,s=%d)\033[0m",
                      UA_StatusCode_name(retval), node_id.namespaceIndex, node_id.identifier.numeric);
         return UA_FALSE;
-    }    
-    //!< Process the output variants
-    outputs.reserve(output_size);
+    }
+    //!< Adopt the output variants, then release the container only
+    outputs.reserve(outputs.size() + output_size);
     for (size_t i = 0; i < output_size; ++i)
-        outputs.emplace_back(output_variants[i].data, output_variants[i].type, output_variants[i].arrayLength);
+        outputs.push_back(Variable::adopt(output_variants[i]));
+    UA_Array_delete(output_variants, output_size, &UA_TYPES[UA_TYPES_VARIANT]);
     return UA_TRUE;
 }
 
-UA_UInt32 Client::createSubscription()
+UA_Boolean Client::callLatencyProbe(const UA_NodeId &method_id, const UA_NodeId &object_id, UA_DateTime &send_time,
+                                    UA_DateTime &receive_time, vector<Variable> &outputs)
 {
+    TraceSpan span("Client::callLatencyProbe", "client");
+    UA_Variant input;
+    size_t output_size = 0;
+    UA_Variant *output_variants = nullptr;
+    auto lk = lock();
+    ++__requests;
+    //!< Stamp once the lock is held, waiting for other callers or the event loop is not network delay
+    send_time = UA_DateTime_now();
+    UA_Variant_setScalar(&input, &send_time, &UA_TYPES[UA_TYPES_DATETIME]);
+    UA_StatusCode retval = UA_Client_call(__client, object_id, method_id, 1, &input, &output_size, &output_variants);
+    receive_time = UA_DateTime_now();
+    lk.unlock();
+    if (retval != UA_STATUSCODE_GOOD)
+    {
+        UA_LOG_ERROR(logger(), UA_LOGCATEGORY_CLIENT, "Failed to call the latency probe: %s",
+                     UA_StatusCode_name(retval));
+        return UA_FALSE;
+    }
+    outputs.reserve(outputs.size() + output_size);
+    for (size_t i = 0; i < output_size; ++i)
+        outputs.push_back(Variable::adopt(output_variants[i]));
+    UA_Array_delete(output_variants, output_size, &UA_TYPES[UA_TYPES_VARIANT]);
+    return UA_TRUE;
+}
+
+UA_UInt32 Client::readOperationLimit(UA_UInt32 limit_id, optional<UA_UInt32> &cache)
+{
+    if (cache.has_value())
+        return *cache;
+    UA_Variant val;
+    UA_Variant_init(&val);
+    ++__requests;
+    UA_StatusCode retval = UA_Client_readValueAttribute(__client, UA_NODEID_NUMERIC(0, limit_id), &val);
+    //!< Servers without the operation limits are treated as unlimited, and are not asked again
+    cache = 0;
+    if (retval == UA_STATUSCODE_GOOD && UA_Variant_hasScalarType(&val, &UA_TYPES[UA_TYPES_UINT32]))
+        cache = *static_cast<UA_UInt32 *>(val.data);
+    UA_Variant_clear(&val);
+    return *cache;
+}
+
+vector<Client::CallResult> Client::call(const vector<MethodCall> &calls)
+{
+    TraceSpan span("Client::call(batch)", "client");
+    vector<CallResult> results(calls.size());
+    if (calls.empty())
+        return results;
+    //!< Shallow views of the input variants, all of them share one buffer
+    size_t input_size = 0;
+    for (auto &method_call : calls)
+        input_size += method_call.inputs.size();
+    vector<UA_Variant> input_variants;
+    input_variants.reserve(input_size);
+    vector<UA_CallMethodRequest> items(calls.size());
+    for (size_t i = 0; i < calls.size(); ++i)
+    {
+        UA_CallMethodRequest &item = items[i];
+        UA_CallMethodRequest_init(&item);
+        item.objectId = calls[i].object_id;
+        item.methodId = calls[i].method_id;
+        item.inputArgumentsSize = calls[i].inputs.size();
+        item.inputArguments = input_variants.data() + input_variants.size();
+        for (auto &input : calls[i].inputs)
+            input_variants.push_back(input.get());
+    }
+
+    auto lk = lock();
+    UA_UInt32 max_calls = maxMethodCalls();
+    size_t chunk_size = max_calls == 0 ? calls.size() : max_calls;
+    for (size_t begin = 0; begin < calls.size(); begin += chunk_size)
+    {
+        size_t end = min(begin + chunk_size, calls.size());
+        UA_CallRequest request;
+        UA_CallRequest_init(&request);
+        request.methodsToCall = items.data() + begin;
+        request.methodsToCallSize = end - begin;
+        ++__requests;
+        UA_CallResponse response = UA_Client_Service_call(__client, request);
+        UA_StatusCode retval = response.responseHeader.serviceResult;
+        if (retval == UA_STATUSCODE_GOOD && response.resultsSize != end - begin)
+            retval = UA_STATUSCODE_BADUNEXPECTEDERROR;
+        if (retval != UA_STATUSCODE_GOOD)
+        {
+            UA_LOG_ERROR(logger(), UA_LOGCATEGORY_CLIENT, "Failed to call %zu methods: %s",
+                         end - begin, UA_StatusCode_name(retval));
+            for (size_t i = begin; i < end; ++i)
+                results[i].status = retval;
+            UA_CallResponse_clear(&response);
+            continue;
+        }
+        //!< Adopt the output variants, the response only releases the emptied containers
+        for (size_t i = begin; i < end; ++i)
+        {
+            UA_CallMethodResult &result = response.results[i - begin];
+            results[i].status = result.statusCode;
+            if (result.statusCode != UA_STATUSCODE_GOOD)
+            {
+                const UA_NodeId &node_id = calls[i].method_id;
+                UA_LOG_ERROR(logger(), UA_LOGCATEGORY_CLIENT, "Failed to call the method: %s \033[31m(ns=%u,s=%d)\033[0m",
+                             UA_StatusCode_name(result.statusCode), node_id.namespaceIndex, node_id.identifier.numeric);
+                continue;
+            }
+            results[i].outputs.reserve(result.outputArgumentsSize);
+            for (size_t j = 0; j < result.outputArgumentsSize; ++j)
+                results[i].outputs.push_back(Variable::adopt(result.outputArguments[j]));
+        }
+        UA_CallResponse_clear(&response);
+    }
+    return results;
+}
+
+vector<UA_StatusCode> Client::write(const vector<VariableWrite> &writes)
+{
+    TraceSpan span("Client::write(batch)", "client");
+    vector<UA_StatusCode> results(writes.size(), UA_STATUSCODE_GOOD);
+    if (writes.empty())
+        return results;
+    //!< Shallow views of the values, the data is referenced rather than copied
+    vector<UA_WriteValue> items(writes.size());
+    for (size_t i = 0; i < writes.size(); ++i)
+    {
+        invalidateCached(writes[i].node_id);
+        UA_WriteValue &item = items[i];
+        UA_WriteValue_init(&item);
+        item.nodeId = writes[i].node_id;
+        item.attributeId = UA_ATTRIBUTEID_VALUE;
+        item.value.value = writes[i].data.get();
+        item.value.hasValue = true;
+    }
+
+    auto lk = lock();
+    UA_UInt32 max_writes = maxWrites();
+    size_t chunk_size = max_writes == 0 ? writes.size() : max_writes;
+    for (size_t begin = 0; begin < writes.size(); begin += chunk_size)
+    {
+        size_t end = min(begin + chunk_size, writes.size());
+        UA_WriteRequest request;
+        UA_WriteRequest_init(&request);
+        request.nodesToWrite = items.data() + begin;
+        request.nodesToWriteSize = end - begin;
+        ++__requests;
+        UA_WriteResponse response = UA_Client_Service_write(__client, request);
+        UA_StatusCode retval = response.responseHeader.serviceResult;
+        if (retval == UA_STATUSCODE_GOOD && response.resultsSize != end - begin)
+            retval = UA_STATUSCODE_BADUNEXPECTEDERROR;
+        if (retval != UA_STATUSCODE_GOOD)
+            UA_LOG_ERROR(logger(), UA_LOGCATEGORY_CLIENT, "Failed to write %zu variables: %s",
+                         end - begin, UA_StatusCode_name(retval));
+        for (size_t i = begin; i < end; ++i)
+            results[i] = retval != UA_STATUSCODE_GOOD ? retval : response.results[i - begin];
+        UA_WriteResponse_clear(&response);
+    }
+    return results;
+}
+
+UA_Boolean Client::readHistory(const UA_NodeId &node_id, UA_DateTime start, UA_DateTime end,
+                               const HistoryHandler &on_chunk, UA_UInt32 values_per_chunk)
+{
+    TraceSpan span("Client::readHistory", "client");
+#ifdef UA_ENABLE_HISTORIZING
+    UA_ReadRawModifiedDetails details;
+    UA_ReadRawModifiedDetails_init(&details);
+    details.startTime = start;
+    details.endTime = end;
+    details.numValuesPerNode = values_per_chunk;
+    UA_HistoryReadValueId item;
+    UA_HistoryReadValueId_init(&item);
+    item.nodeId = node_id;
+    UA_HistoryReadRequest request;
+    UA_HistoryReadRequest_init(&request);
+    UA_ExtensionObject_setValue(&request.historyReadDetails, &details, &UA_TYPES[UA_TYPES_READRAWMODIFIEDDETAILS]);
+    request.timestampsToReturn = UA_TIMESTAMPSTORETURN_BOTH;
+    request.nodesToReadSize = 1;
+    request.nodesToRead = &item;
+
+    //!< The continuation point is taken over from each response and handed back in the next request
+    UA_ByteString cp = UA_BYTESTRING_NULL;
+    UA_Boolean retval = UA_TRUE;
+    //!< The client lock is held only around each request, on_chunk may call back into the client
+    auto serviceHistoryRead = [&]() {
+        auto lk = lock();
+        ++__requests;
+        return UA_Client_Service_historyRead(__client, request);
+    };
+    while (true)
+    {
+        item.continuationPoint = cp;
+        UA_HistoryReadResponse response = serviceHistoryRead();
+        UA_StatusCode status = response.responseHeader.serviceResult;
+        if (status == UA_STATUSCODE_GOOD && response.resultsSize != 1)
+            status = UA_STATUSCODE_BADUNEXPECTEDERROR;
+        if (status == UA_STATUSCODE_GOOD)
+            status = response.results[0].statusCode;
+        if (UA_StatusCode_isBad(status))
+        {
+            UA_LOG_ERROR(logger(), UA_LOGCATEGORY_CLIENT, "Failed to read the history: %s \033[31m(ns=%u,s=%d)\033[0m",
+                         UA_StatusCode_name(status), node_id.namespaceIndex, node_id.identifier.numeric);
+            UA_HistoryReadResponse_clear(&response);
+            retval = UA_FALSE;
+            break;
+        }
+        UA_HistoryReadResult &result = response.results[0];
+        bool more = true;
+        if (result.historyData.encoding == UA_EXTENSIONOBJECT_DECODED &&
+            result.historyData.content.decoded.type == &UA_TYPES[UA_TYPES_HISTORYDATA])
+        {
+            auto data = static_cast<const UA_HistoryData *>(result.historyData.content.decoded.data);
+            if (data->dataValuesSize > 0)
+                more = on_chunk(data->dataValues, data->dataValuesSize);
+        }
+        UA_ByteString_clear(&cp);
+        cp = result.continuationPoint;
+        UA_ByteString_init(&result.continuationPoint);
+        UA_HistoryReadResponse_clear(&response);
+        if (cp.length == 0)
+            break;
+        if (!more)
+        {
+            item.continuationPoint = cp;
+            request.releaseContinuationPoints = true;
+            response = serviceHistoryRead();
+            UA_HistoryReadResponse_clear(&response);
+            break;
+        }
+    }
+    UA_ByteString_clear(&cp);
+    return retval;
+#else
+    UA_LOG_ERROR(logger(), UA_LOGCATEGORY_CLIENT, "Failed to read the history: "
+                                                  "open62541 is built without UA_ENABLE_HISTORIZING");
+    return UA_FALSE;
+#endif
+}
+
+UA_UInt32 Client::createSubscription(UA_Double publishing_interval)
+{
+    TraceSpan span("Client::createSubscription", "client");
+    auto lk = lock();
     UA_CreateSubscriptionRequest sub_request = UA_CreateSubscriptionRequest_default();
+    sub_request.requestedPublishingInterval = publishing_interval;
+    ++__requests;
     UA_CreateSubscriptionResponse sub_response =
         UA_Client_Subscriptions_create(__client, sub_request, nullptr, nullptr, nullptr);
     UA_UInt32 sub_id = 0;
     if (sub_response.responseHeader.serviceResult == UA_STATUSCODE_GOOD)
     {
         sub_id = sub_response.subscriptionId;
-        UA_LOG_INFO(UA_Log_Stdout, UA_LOGCATEGORY_CLIENT,
+        UA_LOG_INFO(logger(), UA_LOGCATEGORY_CLIENT,
                     "\033[32m[subscription id: %u] Create subscription succeeded!\033[0m", sub_id);
     }
     else
-        UA_LOG_WARNING(UA_Log_Stdout, UA_LOGCATEGORY_CLIENT, "\033[33mFailed to create subscription!\033[0m");
+        UA_LOG_WARNING(logger(), UA_LOGCATEGORY_CLIENT, "\033[33mFailed to create subscription!\033[0m");
     return sub_id;
 }
 
 UA_Boolean Client::createVariableMonitor(UA_UInt32 sub_id, UA_NodeId node_id,
                                          UA_Client_DataChangeNotificationCallback data_change_handler)
 {
+    TraceSpan span("Client::createVariableMonitor", "client");
+    auto lk = lock();
+    //!< The context must outlive this function, it is released with the client
+    MonitorContext &monitor = addMonitor(node_id);
+    monitor.data_change = data_change_handler;
+    monitor.codec = codecOf(node_id);
     UA_MonitoredItemCreateRequest request_item = UA_MonitoredItemCreateRequest_default(node_id);
+    ++__requests;
     UA_MonitoredItemCreateResult result =
         UA_Client_MonitoredItems_createDataChange(__client, sub_id, UA_TIMESTAMPSTORETURN_BOTH,
-                                                  request_item, &node_id, data_change_handler, nullptr);
+                                                  request_item, &monitor, dataChangeHandler, nullptr);
     if (result.statusCode != UA_STATUSCODE_GOOD)
     {
-        UA_LOG_ERROR(UA_Log_Stdout, UA_LOGCATEGORY_CLIENT,
+        __monitors.pop_back();
+        UA_LOG_ERROR(logger(), UA_LOGCATEGORY_CLIENT,
                      "\033[31mcreateVariableMonitor: %s\033[0m", UA_StatusCode_name(result.statusCode));
         return UA_FALSE;
     }
     else
     {
-        UA_LOG_INFO(UA_Log_Stdout, UA_LOGCATEGORY_CLIENT,
+        UA_LOG_INFO(logger(), UA_LOGCATEGORY_CLIENT,
                     "\033[32m[subscription id: %u, monitoredItem id: %u] Monitoring the node: ns=%u, s=%u\033[0m",
                     sub_id, result.monitoredItemId, node_id.identifier.numeric, node_id.namespaceIndex);
         return UA_TRUE;
     }
 }
 
+vector<UA_UInt32> Client::createVariableMonitors(UA_UInt32 sub_id, const vector<UA_NodeId> &node_ids,
+                                                vector<DataChangeHandler> handlers,
+                                                UA_Double sampling_interval, UA_UInt32 queue_size)
+{
+    TraceSpan span("Client::createVariableMonitors", "client");
+    vector<UA_UInt32> mon_ids(node_ids.size(), 0);
+    if (node_ids.empty() || node_ids.size() != handlers.size())
+    {
+        UA_LOG_ERROR(logger(), UA_LOGCATEGORY_CLIENT,
+                     "\033[31mcreateVariableMonitors: %zu node ids with %zu handlers\033[0m",
+                     node_ids.size(), handlers.size());
+        return mon_ids;
+    }
+    auto lk = lock();
+    resolveCodecs(node_ids);
+    //!< Prepare the monitored items and their contexts
+    size_t n = node_ids.size();
+    vector<UA_MonitoredItemCreateRequest> items(n);
+    vector<void *> contexts(n);
+    vector<UA_Client_DataChangeNotificationCallback> callbacks(n, dataChangeHandler);
+    vector<UA_Client_DeleteMonitoredItemCallback> delete_callbacks(n, nullptr);
+    auto first = __monitors.end();
+    for (size_t i = 0; i < n; ++i)
+    {
+        MonitorContext &monitor = addMonitor(node_ids[i]);
+        monitor.on_change = std::move(handlers[i]);
+        monitor.codec = codecOf(node_ids[i]);
+        if (i == 0)
+            first = prev(__monitors.end());
+        contexts[i] = &monitor;
+        items[i] = UA_MonitoredItemCreateRequest_default(node_ids[i]);
+        items[i].requestedParameters.samplingInterval = sampling_interval;
+        items[i].requestedParameters.queueSize = queue_size;
+    }
+    UA_CreateMonitoredItemsRequest request;
+    UA_CreateMonitoredItemsRequest_init(&request);
+    request.subscriptionId = sub_id;
+    request.timestampsToReturn = UA_TIMESTAMPSTORETURN_BOTH;
+    request.itemsToCreate = items.data();
+    request.itemsToCreateSize = n;
+    //!< Create all of the monitored items in one request
+    ++__requests;
+    UA_CreateMonitoredItemsResponse response =
+        UA_Client_MonitoredItems_createDataChanges(__client, request, contexts.data(),
+                                                   callbacks.data(), delete_callbacks.data());
+    if (response.responseHeader.serviceResult != UA_STATUSCODE_GOOD || response.resultsSize != n)
+    {
+        //!< None of the monitored items exists, the client holds no reference to their contexts
+        UA_LOG_ERROR(logger(), UA_LOGCATEGORY_CLIENT, "\033[31mcreateVariableMonitors: %s\033[0m",
+                     UA_StatusCode_name(response.responseHeader.serviceResult));
+        __monitors.erase(first, __monitors.end());
+    }
+    else
+    {
+        //!< Failed items are discarded by the client, so are their contexts
+        size_t failed = 0;
+        for (size_t i = 0; i < n; ++i)
+        {
+            auto it = first++;
+            if (response.results[i].statusCode == UA_STATUSCODE_GOOD)
+                mon_ids[i] = response.results[i].monitoredItemId;
+            else
+            {
+                __monitors.erase(it);
+                ++failed;
+            }
+        }
+        UA_LOG_INFO(logger(), UA_LOGCATEGORY_CLIENT,
+                    "\033[32m[subscription id: %u] Monitoring %zu nodes, %zu failed\033[0m", sub_id, n - failed, failed);
+    }
+    UA_CreateMonitoredItemsResponse_clear(&response);
+    return mon_ids;
+}
+
 UA_Boolean Client::createEventMonitor(UA_UInt32 sub_id, UA_NodeId node_id, vector<string> &names,
                                       UA_Client_EventNotificationCallback event_handler)
 {
+    TraceSpan span("Client::createEventMonitor", "client");
     UA_MonitoredItemCreateRequest request_item;
     UA_MonitoredItemCreateRequest_init(&request_item);
     request_item.itemToMonitor.nodeId = node_id;
@@ -181,19 +1026,23 @@ UA_Boolean Client::createEventMonitor(UA_UInt32 sub_id, UA_NodeId node_id, vecto
     request_item.requestedParameters.filter.encoding = UA_EXTENSIONOBJECT_DECODED;
     request_item.requestedParameters.filter.content.decoded.data = &filter;
     request_item.requestedParameters.filter.content.decoded.type = &UA_TYPES[UA_TYPES_EVENTFILTER];
-    UA_UInt32 monitor_id = 0;
+    auto lk = lock();
+    MonitorContext &monitor = addMonitor(node_id);
+    monitor.event = event_handler;
+    ++__requests;
     UA_MonitoredItemCreateResult result =
         UA_Client_MonitoredItems_createEvent(__client, sub_id, UA_TIMESTAMPSTORETURN_BOTH,
-                                             request_item, &monitor_id, event_handler, nullptr);
+                                             request_item, &monitor, eventHandler, nullptr);
     if (result.statusCode != UA_STATUSCODE_GOOD)
     {
-        UA_LOG_ERROR(UA_Log_Stdout, UA_LOGCATEGORY_CLIENT,
+        __monitors.pop_back();
+        UA_LOG_ERROR(logger(), UA_LOGCATEGORY_CLIENT,
                      "\033[31mcreateEventMonitor: %s\033[0m", UA_StatusCode_name(result.statusCode));
         return UA_FALSE;
     }
     else
     {
-        UA_LOG_INFO(UA_Log_Stdout, UA_LOGCATEGORY_CLIENT,
+        UA_LOG_INFO(logger(), UA_LOGCATEGORY_CLIENT,
                     "\033[32m[subscription id: %u, monitoredItem id: %u] Monitoring the node: ns=%u, s=%u\033[0m",
                     sub_id, result.monitoredItemId, node_id.identifier.numeric, node_id.namespaceIndex);
         return UA_TRUE;
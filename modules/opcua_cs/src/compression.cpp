@@ -0,0 +1,255 @@
+/**
+ * @file compression.cpp
+ * @author 赵曦 (535394140@qq.com)
+ * @brief Self-describing compressed ByteString encoding of large variable values
+ * @version 1.0
+ * @date 2023-03-20
+ *
+ * @copyright Copyright (c) 2023, zhaoxi
+ *
+ */
+
+#include <cstring>
+
+#include <zlib.h>
+
+#include "asmpro/opcua_cs/compression.hpp"
+
+using namespace std;
+using namespace ua;
+
+namespace
+{
+
+//! 首部的字段，多字节字段按小端字节序存储
+constexpr UA_Byte magic[4] = {0x89, 'U', 'A', 'Z'};
+constexpr size_t header_size = 24;
+constexpr UA_Byte flag_bytestring = 0x01; //!< 原始的值为 ByteString 标量
+constexpr UA_Byte flag_scalar = 0x02;     //!< 原始的值为标量
+
+//! 压缩首部
+struct Header
+{
+    Codec codec;
+    UA_Byte flags;
+    UA_UInt32 type_id;
+    UA_UInt32 stride;
+    UA_UInt64 raw_size;
+};
+
+//! 按小端字节序写入 n 个字节
+inline void storeLE(UA_Byte *p, UA_UInt64 value, size_t n)
+{
+    for (size_t i = 0; i < n; ++i)
+        p[i] = static_cast<UA_Byte>(value >> (8 * i));
+}
+
+//! 按小端字节序读取 n 个字节
+inline UA_UInt64 loadLE(const UA_Byte *p, size_t n)
+{
+    UA_UInt64 value = 0;
+    for (size_t i = 0; i < n; ++i)
+        value |= static_cast<UA_UInt64>(p[i]) << (8 * i);
+    return value;
+}
+
+void writeHeader(UA_Byte *p, const Header &h)
+{
+    memcpy(p, magic, sizeof(magic));
+    p[4] = static_cast<UA_Byte>(h.codec);
+    p[5] = h.flags;
+    p[6] = p[7] = 0;
+    storeLE(p + 8, h.type_id, 4);
+    storeLE(p + 12, h.stride, 4);
+    storeLE(p + 16, h.raw_size, 8);
+}
+
+bool readHeader(const UA_ByteString &str, Header &h)
+{
+    if (str.length < header_size || memcmp(str.data, magic, sizeof(magic)) != 0)
+        return false;
+    h.codec = static_cast<Codec>(str.data[4]);
+    h.flags = str.data[5];
+    h.type_id = static_cast<UA_UInt32>(loadLE(str.data + 8, 4));
+    h.stride = static_cast<UA_UInt32>(loadLE(str.data + 12, 4));
+    h.raw_size = loadLE(str.data + 16, 8);
+    return h.codec == Codec::None || h.codec == Codec::Deflate || h.codec == Codec::DeltaDeflate;
+}
+
+//! 按字节间隔差分，结果的前 stride 个字节与原始数据相同
+void deltaEncode(const UA_Byte *__restrict src, UA_Byte *__restrict dst, size_t size, size_t stride)
+{
+    size_t head = min(stride, size);
+    memcpy(dst, src, head);
+    for (size_t i = head; i < size; ++i)
+        dst[i] = static_cast<UA_Byte>(src[i] - src[i - stride]);
+}
+
+//! 原地还原差分
+void deltaDecode(UA_Byte *data, size_t size, size_t stride)
+{
+    for (size_t i = stride; i < size; ++i)
+        data[i] = static_cast<UA_Byte>(data[i] + data[i - stride]);
+}
+
+} // namespace
+
+string Compression::describe() const
+{
+    string retval = codecName(codec);
+    if (codec != Codec::None)
+        retval += ";level=" + to_string(level);
+    if (codec == Codec::DeltaDeflate)
+        retval += ";stride=" + to_string(stride);
+    return retval;
+}
+
+const char *ua::codecName(Codec codec)
+{
+    switch (codec)
+    {
+    case Codec::None:
+        return "none";
+    case Codec::Deflate:
+        return "deflate";
+    case Codec::DeltaDeflate:
+        return "delta-deflate";
+    }
+    return "unknown";
+}
+
+bool ua::parseCodec(const string &text, Codec &codec)
+{
+    string name = text.substr(0, text.find(';'));
+    for (Codec each : {Codec::None, Codec::Deflate, Codec::DeltaDeflate})
+        if (name == codecName(each))
+        {
+            codec = each;
+            return true;
+        }
+    return false;
+}
+
+bool ua::compressValue(const UA_Variant &value, const Compression &options, vector<UA_Byte> &out,
+                       vector<UA_Byte> &scratch)
+{
+    if (UA_Variant_isEmpty(&value))
+        return false;
+    Header h;
+    h.codec = options.codec;
+    h.stride = max<UA_UInt32>(options.stride, 1);
+    const UA_Byte *raw = nullptr;
+    if (UA_Variant_hasScalarType(&value, &UA_TYPES[UA_TYPES_BYTESTRING]))
+    {
+        auto str = static_cast<const UA_ByteString *>(value.data);
+        raw = str->data;
+        h.raw_size = str->length;
+        h.flags = flag_bytestring | flag_scalar;
+        h.type_id = UA_NS0ID_BYTE;
+    }
+    else
+    {
+        //!< Only the memory of pointer-free types can be encoded directly
+        if (!value.type->pointerFree || value.type->typeId.namespaceIndex != 0)
+            return false;
+        bool scalar = UA_Variant_isScalar(&value);
+        raw = static_cast<const UA_Byte *>(value.data);
+        h.raw_size = (scalar ? 1 : value.arrayLength) * value.type->memSize;
+        h.flags = scalar ? flag_scalar : 0;
+        h.type_id = value.type->typeId.identifier.numeric;
+    }
+    size_t size = static_cast<size_t>(h.raw_size);
+    if (h.codec == Codec::None)
+    {
+        out.resize(header_size + size);
+        memcpy(out.data() + header_size, raw, size);
+    }
+    else
+    {
+        if (h.codec == Codec::DeltaDeflate)
+        {
+            scratch.resize(size);
+            deltaEncode(raw, scratch.data(), size, h.stride);
+            raw = scratch.data();
+        }
+        uLongf len = compressBound(static_cast<uLong>(size));
+        out.resize(header_size + len);
+        if (compress2(out.data() + header_size, &len, raw, static_cast<uLong>(size), options.level) != Z_OK)
+            return false;
+        out.resize(header_size + len);
+    }
+    writeHeader(out.data(), h);
+    return true;
+}
+
+bool ua::isCompressed(const UA_Variant &value)
+{
+    if (!UA_Variant_hasScalarType(&value, &UA_TYPES[UA_TYPES_BYTESTRING]))
+        return false;
+    Header h;
+    return readHeader(*static_cast<const UA_ByteString *>(value.data), h);
+}
+
+bool ua::decompressValue(UA_Variant &value, Codec codec)
+{
+    if (!UA_Variant_hasScalarType(&value, &UA_TYPES[UA_TYPES_BYTESTRING]))
+        return false;
+    auto str = static_cast<const UA_ByteString *>(value.data);
+    Header h;
+    if (!readHeader(*str, h) || h.codec != codec)
+        return false;
+    UA_NodeId type_id = UA_NODEID_NUMERIC(0, h.type_id);
+    const UA_DataType *type = (h.flags & flag_bytestring) ? &UA_TYPES[UA_TYPES_BYTE] : UA_findDataType(&type_id);
+    if (type == nullptr || !type->pointerFree || h.raw_size % type->memSize != 0)
+        return false;
+    size_t count = static_cast<size_t>(h.raw_size / type->memSize);
+    if ((h.flags & flag_scalar) && !(h.flags & flag_bytestring) && count != 1)
+        return false;
+    //!< Reject sizes deflate cannot reach (its ratio is bounded by 1032:1) before allocating
+    size_t payload_size = str->length - header_size;
+    if (h.codec != Codec::None && h.raw_size / 1032 > payload_size)
+        return false;
+    //!< Decode into the final allocation of the variant
+    UA_Byte *raw = static_cast<UA_Byte *>(UA_Array_new(count, type));
+    if (raw == nullptr)
+        return false;
+    size_t size = static_cast<size_t>(h.raw_size);
+    const UA_Byte *payload = str->data + header_size;
+    bool ok = true;
+    if (h.codec == Codec::None)
+    {
+        ok = payload_size == size;
+        if (ok)
+            memcpy(raw, payload, size);
+    }
+    else
+    {
+        uLongf len = static_cast<uLongf>(size);
+        ok = uncompress(raw, &len, payload, static_cast<uLong>(payload_size)) == Z_OK && len == size;
+        if (ok && h.codec == Codec::DeltaDeflate)
+            deltaDecode(raw, size, h.stride);
+    }
+    if (!ok)
+    {
+        UA_Array_delete(raw, count, type);
+        return false;
+    }
+    UA_ByteString *bytes = nullptr;
+    if ((h.flags & flag_bytestring) && (bytes = UA_ByteString_new()) == nullptr)
+    {
+        UA_Array_delete(raw, count, type);
+        return false;
+    }
+    UA_Variant_clear(&value);
+    if (bytes != nullptr)
+    {
+        bytes->data = raw;
+        bytes->length = size;
+        UA_Variant_setScalar(&value, bytes, &UA_TYPES[UA_TYPES_BYTESTRING]);
+    }
+    else if (h.flags & flag_scalar)
+        UA_Variant_setScalar(&value, raw, type);
+    else
+        UA_Variant_setArray(&value, raw, count, type);
+    return true;
+}
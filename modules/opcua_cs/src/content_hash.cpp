@@ -0,0 +1,122 @@
+/**
+ * @file content_hash.cpp
+ * @author 赵曦 (535394140@qq.com)
+ * @brief Fast non-cryptographic 64-bit content hash of variable values
+ * @version 1.0
+ * @date 2023-03-21
+ *
+ * @copyright Copyright (c) 2023, zhaoxi
+ *
+ */
+
+#include <atomic>
+#include <cstring>
+
+#include "asmpro/opcua_cs/content_hash.hpp"
+
+using namespace std;
+using namespace ua;
+
+namespace
+{
+
+constexpr size_t lanes = 8;
+constexpr size_t stripe = lanes * sizeof(UA_UInt64);
+//! 每处理若干条带对累加器进行一次扰乱，避免长数据的累加相互抵消
+constexpr size_t stripes_per_block = 16;
+constexpr UA_UInt64 prime32 = 0x9E3779B1ULL;
+constexpr UA_UInt64 prime64 = 0x9E3779B97F4A7C15ULL;
+
+//! 各通道的密钥，取自 π 的小数部分
+constexpr UA_UInt64 secret[lanes] = {0x243F6A8885A308D3ULL, 0x13198A2E03707344ULL, 0xA4093822299F31D0ULL,
+                                     0x082EFA98EC4E6C89ULL, 0x452821E638D01377ULL, 0xBE5466CF34E90C6CULL,
+                                     0xC0AC29B7C97C50DDULL, 0x3F84D5B5B5470917ULL};
+
+inline UA_UInt64 fmix64(UA_UInt64 h)
+{
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+//! 累加一个条带，各通道之间无依赖
+inline void accumulate(UA_UInt64 *__restrict acc, const UA_Byte *__restrict p)
+{
+    for (size_t i = 0; i < lanes; ++i)
+    {
+        UA_UInt64 v;
+        memcpy(&v, p + i * sizeof(UA_UInt64), sizeof(UA_UInt64));
+        UA_UInt64 k = v ^ secret[i];
+        acc[i] += v + (k & 0xFFFFFFFFULL) * (k >> 32);
+    }
+}
+
+inline void scramble(UA_UInt64 *acc)
+{
+    for (size_t i = 0; i < lanes; ++i)
+        acc[i] = ((acc[i] ^ (acc[i] >> 47)) ^ secret[i]) * prime32;
+}
+
+} // namespace
+
+UA_UInt64 ua::contentHash(const void *data, size_t size, UA_UInt64 seed)
+{
+    auto p = static_cast<const UA_Byte *>(data);
+    UA_UInt64 acc[lanes];
+    for (size_t i = 0; i < lanes; ++i)
+        acc[i] = secret[i] ^ (seed + i * prime64);
+    size_t n = size / stripe;
+    for (size_t s = 0; s < n; ++s)
+    {
+        accumulate(acc, p + s * stripe);
+        if ((s + 1) % stripes_per_block == 0)
+            scramble(acc);
+    }
+    //!< The tail is zero-padded into a last stripe, the length below tells it apart from real zeros
+    size_t tail = size - n * stripe;
+    if (tail > 0)
+    {
+        UA_Byte last[stripe] = {};
+        memcpy(last, p + n * stripe, tail);
+        accumulate(acc, last);
+    }
+    UA_UInt64 h = size * prime64 ^ seed;
+    for (size_t i = 0; i < lanes; ++i)
+        h = fmix64(h ^ acc[i]) * prime64;
+    return fmix64(h);
+}
+
+UA_UInt64 ua::contentHash(const UA_Variant &value)
+{
+    if (UA_Variant_isEmpty(&value))
+        return 0;
+    //!< Type and shape take part in the hash, so equal bytes of different shapes differ
+    UA_UInt64 h = fmix64(reinterpret_cast<uintptr_t>(value.type) ^ (UA_UInt64(value.arrayLength) << 1) ^
+                         UA_Variant_isScalar(&value));
+    if (value.arrayDimensionsSize > 0)
+        h = contentHash(value.arrayDimensions, value.arrayDimensionsSize * sizeof(UA_UInt32), h);
+    bool scalar = UA_Variant_isScalar(&value);
+    if (scalar && (value.type == &UA_TYPES[UA_TYPES_BYTESTRING] || value.type == &UA_TYPES[UA_TYPES_STRING]))
+    {
+        auto str = static_cast<const UA_String *>(value.data);
+        return contentHash(str->data, str->length, h);
+    }
+    if (value.type->pointerFree)
+        return contentHash(value.data, (scalar ? 1 : value.arrayLength) * value.type->memSize, h);
+    //!< Types with pointers are hashed through their binary encoding
+    UA_ByteString encoded = UA_BYTESTRING_NULL;
+    UA_StatusCode status = scalar ? UA_encodeBinary(value.data, value.type, &encoded)
+                                  : UA_encodeBinary(&value, &UA_TYPES[UA_TYPES_VARIANT], &encoded);
+    if (status != UA_STATUSCODE_GOOD)
+    {
+        //!< Never report an unencodable value as unchanged
+        static atomic<UA_UInt64> unique{0};
+        return fmix64(h ^ ++unique * prime64);
+    }
+    h = contentHash(encoded.data, encoded.length, h);
+    UA_ByteString_clear(&encoded);
+    return h;
+}
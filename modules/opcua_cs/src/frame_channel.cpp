@@ -0,0 +1,90 @@
+/**
+ * @file frame_channel.cpp
+ * @author 赵曦 (535394140@qq.com)
+ * @brief Latest frame channel with a preallocated buffer ring
+ * @version 1.0
+ * @date 2023-03-06
+ *
+ * @copyright Copyright (c) 2023, zhaoxi
+ *
+ */
+
+#include <algorithm>
+#include <cstring>
+
+#include "asmpro/opcua_cs/frame_channel.hpp"
+
+using namespace std;
+using namespace ua;
+
+FrameChannel::FrameChannel(size_t capacity, size_t slots, Policy policy) : __policy(policy)
+{
+    slots = max<size_t>(slots, 3);
+    __slots.resize(slots);
+    for (auto &slot : __slots)
+        slot.data.resize(capacity);
+    __free.reserve(slots);
+    for (size_t i = 0; i < slots; ++i)
+        __free.push_back(i);
+    __ready.resize(slots);
+}
+
+bool FrameChannel::push(const void *data, size_t size)
+{
+    ++__pushed;
+    if (size > __slots.front().data.size())
+    {
+        ++__dropped;
+        return false;
+    }
+    //!< Acquire a slot for writing
+    size_t idx;
+    {
+        lock_guard<mutex> lk(__mtx);
+        if (!__free.empty())
+        {
+            idx = __free.back();
+            __free.pop_back();
+        }
+        else if (__policy == Policy::DropOldest && __count > 0)
+        {
+            idx = __ready[__head];
+            __head = (__head + 1) % __ready.size();
+            --__count;
+            ++__dropped;
+        }
+        else
+        {
+            ++__dropped;
+            return false;
+        }
+    }
+    //!< Copy outside the lock, the slot is owned by the producer now
+    Slot &slot = __slots[idx];
+    memcpy(slot.data.data(), data, size);
+    slot.size = size;
+    {
+        lock_guard<mutex> lk(__mtx);
+        slot.seq = ++__seq;
+        __ready[(__head + __count) % __ready.size()] = idx;
+        ++__count;
+    }
+    __cv.notify_one();
+    return true;
+}
+
+bool FrameChannel::push(const UA_Variant &value)
+{
+    if (UA_Variant_isEmpty(&value))
+        return false;
+    if (UA_Variant_hasScalarType(&value, &UA_TYPES[UA_TYPES_BYTESTRING]))
+    {
+        auto str = static_cast<const UA_ByteString *>(value.data);
+        return push(str->data, str->length);
+    }
+    //!< Only the memory of pointer-free types can be copied directly
+    if (!value.type->pointerFree)
+        return false;
+    size_t count = UA_Variant_isScalar(&value) ? 1 : value.arrayLength;
+    return push(value.data, count * value.type->memSize);
+}
@@ -0,0 +1,195 @@
+/**
+ * @file frame_delta.cpp
+ * @author 赵曦 (535394140@qq.com)
+ * @brief Dirty-tile delta encoding of large array values and the client-side frame assembler
+ * @version 1.0
+ * @date 2023-03-21
+ *
+ * @copyright Copyright (c) 2023, zhaoxi
+ *
+ */
+
+#include <cstring>
+
+#include "asmpro/opcua_cs/frame_delta.hpp"
+
+using namespace std;
+using namespace ua;
+
+namespace
+{
+
+constexpr UA_Byte magic[4] = {0x89, 'U', 'A', 'D'};
+constexpr UA_UInt16 flag_keyframe = 0x01;
+
+//! 差分首部，按主机字节序存储
+struct Header
+{
+    UA_Byte magic[4];
+    UA_UInt16 version;
+    UA_UInt16 flags;
+    UA_UInt32 tile_size;
+    UA_UInt32 run_count;
+    UA_UInt64 seq;
+    UA_UInt64 size;
+};
+
+//! 区段，数据按区段表的顺序紧随其后
+struct Run
+{
+    UA_UInt64 offset;
+    UA_UInt64 length;
+};
+
+static_assert(sizeof(Header) == 32 && sizeof(Run) == 16, "delta layout must not have padding");
+
+void writeHeader(vector<UA_Byte> &out, UA_UInt16 flags, UA_UInt32 tile_size, UA_UInt32 run_count, UA_UInt64 seq,
+                 UA_UInt64 size)
+{
+    Header h;
+    memcpy(h.magic, magic, sizeof(magic));
+    h.version = 1;
+    h.flags = flags;
+    h.tile_size = tile_size;
+    h.run_count = run_count;
+    h.seq = seq;
+    h.size = size;
+    memcpy(out.data(), &h, sizeof(Header));
+}
+
+} // namespace
+
+void DeltaEncoder::encode(const UA_Byte *data, size_t size, vector<UA_Byte> &out)
+{
+    ++__seq;
+    size_t tile = max<size_t>(__options.tile_size, 64);
+    //!< The first frame is a keyframe even when it is empty, the assembler has nothing to apply a delta to
+    bool keyframe = __seq == 1 || __previous.size() != size ||
+                    (__options.keyframe_interval > 0 && (__seq - 1) % __options.keyframe_interval == 0);
+    //!< Collect runs of dirty tiles, adjacent dirty tiles are merged into one run
+    vector<Run> runs;
+    size_t dirty = 0;
+    if (!keyframe)
+    {
+        size_t limit = static_cast<size_t>(__options.max_dirty_ratio * size);
+        for (size_t offset = 0; offset < size && dirty <= limit; offset += tile)
+        {
+            size_t len = min(tile, size - offset);
+            if (memcmp(data + offset, __previous.data() + offset, len) == 0)
+                continue;
+            if (!runs.empty() && runs.back().offset + runs.back().length == offset)
+                runs.back().length += len;
+            else
+                runs.push_back({offset, len});
+            dirty += len;
+        }
+        keyframe = dirty > limit;
+    }
+    if (keyframe)
+    {
+        ++__keyframes;
+        __previous.assign(data, data + size);
+        out.resize(sizeof(Header) + sizeof(Run) + size);
+        writeHeader(out, flag_keyframe, static_cast<UA_UInt32>(tile), 1, __seq, size);
+        Run run{0, size};
+        memcpy(out.data() + sizeof(Header), &run, sizeof(Run));
+        memcpy(out.data() + sizeof(Header) + sizeof(Run), data, size);
+        return;
+    }
+    out.resize(sizeof(Header) + runs.size() * sizeof(Run) + dirty);
+    writeHeader(out, 0, static_cast<UA_UInt32>(tile), static_cast<UA_UInt32>(runs.size()), __seq, size);
+    if (!runs.empty())
+        memcpy(out.data() + sizeof(Header), runs.data(), runs.size() * sizeof(Run));
+    UA_Byte *payload = out.data() + sizeof(Header) + runs.size() * sizeof(Run);
+    for (const Run &run : runs)
+    {
+        memcpy(payload, data + run.offset, run.length);
+        memcpy(__previous.data() + run.offset, data + run.offset, run.length);
+        payload += run.length;
+    }
+}
+
+bool DeltaEncoder::encode(const UA_Variant &value, vector<UA_Byte> &out)
+{
+    if (UA_Variant_isEmpty(&value))
+        return false;
+    if (UA_Variant_hasScalarType(&value, &UA_TYPES[UA_TYPES_BYTESTRING]))
+    {
+        auto str = static_cast<const UA_ByteString *>(value.data);
+        encode(str->data, str->length, out);
+        return true;
+    }
+    if (!value.type->pointerFree)
+        return false;
+    size_t count = UA_Variant_isScalar(&value) ? 1 : value.arrayLength;
+    encode(static_cast<const UA_Byte *>(value.data), count * value.type->memSize, out);
+    return true;
+}
+
+bool DeltaAssembler::apply(const UA_Byte *data, size_t size)
+{
+    Header h;
+    if (data == nullptr || size < sizeof(Header))
+        return __synced;
+    memcpy(&h, data, sizeof(Header));
+    if (memcmp(h.magic, magic, sizeof(magic)) != 0 || h.version != 1)
+        return __synced;
+    //!< Validate the run table against the received size before touching the frame
+    size_t table = size_t(h.run_count) * sizeof(Run);
+    if (table > size - sizeof(Header))
+        return __synced;
+    const UA_Byte *payload = data + sizeof(Header) + table;
+    size_t remaining = size - sizeof(Header) - table;
+    bool keyframe = h.flags & flag_keyframe;
+    if (!keyframe)
+    {
+        if (__synced && h.seq != __seq + 1)
+        {
+            ++__gaps;
+            __synced = false;
+        }
+        if (!__synced || h.size != __frame.size())
+        {
+            __synced = false;
+            ++__discarded;
+            return false;
+        }
+    }
+    UA_UInt64 covered = 0;
+    for (UA_UInt32 i = 0; i < h.run_count; ++i)
+    {
+        Run run;
+        memcpy(&run, data + sizeof(Header) + i * sizeof(Run), sizeof(Run));
+        if (run.length > remaining || run.offset > h.size || run.length > h.size - run.offset)
+        {
+            __synced = false;
+            return false;
+        }
+        remaining -= run.length;
+        covered += run.length;
+    }
+    //!< A keyframe has to cover the whole frame
+    if (keyframe && covered != h.size)
+        return __synced;
+    if (keyframe)
+        __frame.resize(static_cast<size_t>(h.size));
+    for (UA_UInt32 i = 0; i < h.run_count; ++i)
+    {
+        Run run;
+        memcpy(&run, data + sizeof(Header) + i * sizeof(Run), sizeof(Run));
+        memcpy(__frame.data() + run.offset, payload, run.length);
+        payload += run.length;
+    }
+    __seq = h.seq;
+    __synced = true;
+    ++__applied;
+    return true;
+}
+
+bool DeltaAssembler::apply(const UA_Variant &value)
+{
+    if (!UA_Variant_hasScalarType(&value, &UA_TYPES[UA_TYPES_BYTESTRING]))
+        return __synced;
+    auto str = static_cast<const UA_ByteString *>(value.data);
+    return apply(str->data, str->length);
+}
@@ -0,0 +1,227 @@
+/**
+ * @file history.cpp
+ * @author 赵曦 (535394140@qq.com)
+ * @brief Per-node history storage with an in-memory ring and memory-mapped spill segments
+ * @version 1.0
+ * @date 2023-03-22
+ *
+ * @copyright Copyright (c) 2023, zhaoxi
+ *
+ */
+
+#include <algorithm>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "asmpro/opcua_cs/history.hpp"
+
+using namespace std;
+using namespace ua;
+
+namespace
+{
+
+//! 创建并映射一个匿名的段文件，文件创建后即被删除
+UA_Byte *mapSegment(const string &directory, size_t size)
+{
+    string path = directory + "/ua_history_XXXXXX";
+    int fd = mkstemp(path.data());
+    if (fd < 0)
+        return nullptr;
+    unlink(path.c_str());
+    void *base = MAP_FAILED;
+    if (ftruncate(fd, static_cast<off_t>(size)) == 0)
+        base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    return base == MAP_FAILED ? nullptr : static_cast<UA_Byte *>(base);
+}
+
+} // namespace
+
+HistoryBuffer::HistoryBuffer(const HistoryOptions &options) : __segment_size(options.segment_size)
+{
+    size_t capacity = max<size_t>(options.capacity, 1);
+    __ring.resize(capacity);
+    __ring_keys.resize(capacity);
+    if (__segment_size == 0)
+        return;
+    for (auto &segment : __segments)
+        segment.base = mapSegment(options.directory, __segment_size);
+    if (__segments[0].base == nullptr || __segments[1].base == nullptr)
+    {
+        //!< Reported by the owner through its own logger, see spilling()
+        for (auto &segment : __segments)
+            if (segment.base != nullptr)
+                munmap(segment.base, __segment_size);
+        __segments[0].base = __segments[1].base = nullptr;
+        __segment_size = 0;
+    }
+}
+
+HistoryBuffer::~HistoryBuffer()
+{
+    for (auto &value : __ring)
+        UA_DataValue_clear(&value);
+    for (auto &segment : __segments)
+        if (segment.base != nullptr)
+            munmap(segment.base, __segment_size);
+}
+
+void HistoryBuffer::append(const UA_DataValue &value)
+{
+    //!< Deep copy outside the lock, readers only wait for the slot assignment
+    UA_DataValue copy;
+    UA_DataValue_copy(&value, &copy);
+    UA_DateTime key = value.hasSourceTimestamp   ? value.sourceTimestamp
+                      : value.hasServerTimestamp ? value.serverTimestamp
+                                                 : UA_DateTime_now();
+    lock_guard<mutex> lk(__mtx);
+    key = max(key, __last_key);
+    __last_key = key;
+    if (__count == __ring.size())
+    {
+        UA_DataValue &oldest = __ring[__head];
+        if (__segment_size > 0)
+            spill(oldest, __ring_keys[__head]);
+        else
+            ++__dropped;
+        UA_DataValue_clear(&oldest);
+        __head = (__head + 1) % __ring.size();
+        --__count;
+        ++__ring_first;
+    }
+    size_t pos = (__head + __count) % __ring.size();
+    __ring[pos] = copy;
+    __ring_keys[pos] = key;
+    ++__count;
+}
+
+void HistoryBuffer::spill(const UA_DataValue &value, UA_DateTime key)
+{
+    size_t size = UA_calcSizeBinary(&value, &UA_TYPES[UA_TYPES_DATAVALUE]);
+    Segment *segment = &__segments[__active];
+    if (size <= __segment_size && segment->used + size > __segment_size)
+    {
+        //!< The active segment is full, recycle the other one and continue there
+        __active = 1 - __active;
+        segment = &__segments[__active];
+        __dropped += segment->keys.size();
+        segment->used = 0;
+        segment->keys.clear();
+        segment->offsets.clear();
+    }
+    UA_ByteString buf{size, segment->base + segment->used};
+    if (size > __segment_size || UA_encodeBinary(&value, &UA_TYPES[UA_TYPES_DATAVALUE], &buf) != UA_STATUSCODE_GOOD)
+    {
+        //!< Sequence numbers must stay contiguous, so every spilled sample older than this one goes too
+        for (auto &s : __segments)
+        {
+            __dropped += s.keys.size();
+            s.used = 0;
+            s.keys.clear();
+            s.offsets.clear();
+        }
+        ++__dropped;
+        return;
+    }
+    if (segment->keys.empty())
+        segment->first = __ring_first;
+    segment->keys.push_back(key);
+    segment->offsets.push_back(segment->used);
+    segment->used += size;
+    ++__spilled;
+}
+
+UA_UInt64 HistoryBuffer::first() const
+{
+    const Segment &older = __segments[1 - __active];
+    const Segment &active = __segments[__active];
+    if (!older.keys.empty())
+        return older.first;
+    if (!active.keys.empty())
+        return active.first;
+    return __ring_first;
+}
+
+UA_DateTime HistoryBuffer::keyAt(UA_UInt64 seq) const
+{
+    if (seq >= __ring_first)
+        return __ring_keys[(__head + (seq - __ring_first)) % __ring.size()];
+    const Segment &active = __segments[__active];
+    if (!active.keys.empty() && seq >= active.first)
+        return active.keys[seq - active.first];
+    const Segment &older = __segments[1 - __active];
+    return older.keys[seq - older.first];
+}
+
+UA_Boolean HistoryBuffer::valueAt(UA_UInt64 seq, UA_DataValue &value) const
+{
+    if (seq >= __ring_first)
+        return UA_DataValue_copy(&__ring[(__head + (seq - __ring_first)) % __ring.size()], &value) ==
+               UA_STATUSCODE_GOOD;
+    const Segment &active = __segments[__active];
+    const Segment &segment = !active.keys.empty() && seq >= active.first ? active : __segments[1 - __active];
+    UA_ByteString buf{segment.used, segment.base};
+    size_t offset = segment.offsets[seq - segment.first];
+    return UA_decodeBinary(&buf, &offset, &value, &UA_TYPES[UA_TYPES_DATAVALUE], nullptr) == UA_STATUSCODE_GOOD;
+}
+
+UA_UInt64 HistoryBuffer::lowerBound(UA_DateTime key) const
+{
+    UA_UInt64 lo = first();
+    UA_UInt64 hi = next();
+    while (lo < hi)
+    {
+        UA_UInt64 mid = lo + (hi - lo) / 2;
+        if (keyAt(mid) < key)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+UA_UInt64 HistoryBuffer::read(UA_DateTime start, UA_DateTime end, size_t max_values, UA_UInt64 from,
+                              vector<UA_DataValue> &values) const
+{
+    lock_guard<mutex> lk(__mtx);
+    size_t taken = 0;
+    auto take = [&](UA_UInt64 seq) {
+        values.emplace_back();
+        UA_DataValue_init(&values.back());
+        if (valueAt(seq, values.back()))
+            ++taken;
+        else
+            values.pop_back();
+    };
+    //!< Reverse read of (end, start]
+    if (end != 0 && start > end)
+    {
+        UA_UInt64 top = lowerBound(start + 1);
+        UA_UInt64 bottom = lowerBound(end + 1);
+        if (from != 0)
+            top = min(top, from);
+        UA_UInt64 seq = top;
+        while (seq > bottom && (max_values == 0 || taken < max_values))
+            take(--seq);
+        //!< Exclusive upper bound of the unread part, greater than bottom and therefore never 0
+        return seq > bottom ? seq : 0;
+    }
+    //!< Forward read of [start, end)
+    UA_UInt64 lo = start == 0 ? first() : lowerBound(start);
+    UA_UInt64 hi = end == 0 ? next() : lowerBound(end);
+    if (from != 0)
+        lo = max(lo, from);
+    UA_UInt64 seq = lo;
+    for (; seq < hi && (max_values == 0 || taken < max_values); ++seq)
+        take(seq);
+    return seq < hi ? seq : 0;
+}
+
+size_t HistoryBuffer::size() const
+{
+    lock_guard<mutex> lk(__mtx);
+    return next() - first();
+}
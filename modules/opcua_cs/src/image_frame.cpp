@@ -0,0 +1,78 @@
+/**
+ * @file image_frame.cpp
+ * @author 赵曦 (535394140@qq.com)
+ * @brief Image value consisting of a fixed header and the pixels in a single ByteString
+ * @version 1.0
+ * @date 2023-03-20
+ *
+ * @copyright Copyright (c) 2023, zhaoxi
+ *
+ */
+
+#include <cstring>
+
+#include "asmpro/opcua_cs/image_frame.hpp"
+
+using namespace std;
+using namespace ua;
+
+const char *ua::pixelFormatName(PixelFormat format)
+{
+    switch (format)
+    {
+    case PixelFormat::Unknown:
+        return "Unknown";
+    case PixelFormat::Mono8:
+        return "Mono8";
+    case PixelFormat::BGR8:
+        return "BGR8";
+    case PixelFormat::RGB8:
+        return "RGB8";
+    case PixelFormat::BGRA8:
+        return "BGRA8";
+    case PixelFormat::Mono16:
+        return "Mono16";
+    }
+    return "Unknown";
+}
+
+bool ua::encodeImage(const ImageHeader &header, const UA_Byte *data, size_t src_stride, vector<UA_Byte> &buffer)
+{
+    ImageHeader h = header;
+    size_t row = h.rowSize();
+    if (src_stride == 0)
+        src_stride = row;
+    if (src_stride < row || (row > 0 && data == nullptr))
+        return false;
+    h.stride = static_cast<UA_UInt32>(row);
+    buffer.resize(sizeof(ImageHeader) + h.payloadSize());
+    memcpy(buffer.data(), &h, sizeof(ImageHeader));
+    UA_Byte *dst = buffer.data() + sizeof(ImageHeader);
+    if (src_stride == row)
+        memcpy(dst, data, h.payloadSize());
+    else
+        for (size_t y = 0; y < h.height; ++y)
+            memcpy(dst + y * row, data + y * src_stride, row);
+    return true;
+}
+
+bool ua::decodeImage(const UA_Byte *data, size_t size, ImageHeader &header, const UA_Byte *&pixels)
+{
+    static const ImageHeader reference;
+    if (data == nullptr || size < sizeof(ImageHeader) || memcmp(data, reference.magic, sizeof(reference.magic)) != 0)
+        return false;
+    memcpy(&header, data, sizeof(ImageHeader));
+    if (header.version != reference.version || header.stride < header.rowSize() ||
+        header.payloadSize() > size - sizeof(ImageHeader))
+        return false;
+    pixels = data + sizeof(ImageHeader);
+    return true;
+}
+
+bool ua::decodeImage(const UA_Variant &value, ImageHeader &header, const UA_Byte *&pixels)
+{
+    if (!UA_Variant_hasScalarType(&value, &UA_TYPES[UA_TYPES_BYTESTRING]))
+        return false;
+    auto str = static_cast<const UA_ByteString *>(value.data);
+    return decodeImage(str->data, str->length, header, pixels);
+}
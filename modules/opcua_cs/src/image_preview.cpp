@@ -0,0 +1,142 @@
+/**
+ * @file image_preview.cpp
+ * @author 赵曦 (535394140@qq.com)
+ * @brief Preview (downscale, Mono8, ROI) kernels for image variables
+ * @version 1.0
+ * @date 2023-03-19
+ *
+ * @copyright Copyright (c) 2023, zhaoxi
+ *
+ */
+
+#include <cstring>
+
+#include "asmpro/opcua_cs/image_preview.hpp"
+
+using namespace std;
+using namespace ua;
+
+namespace
+{
+
+//! BT.601 亮度系数的 8 位定点近似，和为 256
+constexpr UA_UInt32 coeff_b = 29;
+constexpr UA_UInt32 coeff_g = 150;
+constexpr UA_UInt32 coeff_r = 77;
+
+// 以下内核均为无别名、无分支的连续循环，编译器可自动向量化
+
+//! 将一行像素累加至累加器
+void accumulateRow(const UA_Byte *__restrict src, UA_UInt32 *__restrict acc, size_t n)
+{
+    for (size_t i = 0; i < n; ++i)
+        acc[i] += src[i];
+}
+
+//! 将一行 BGR888 像素的亮度累加至累加器，亮度未除以 256
+void accumulateMonoRow(const UA_Byte *__restrict src, UA_UInt32 *__restrict acc, size_t pixels)
+{
+    for (size_t i = 0; i < pixels; ++i)
+        acc[i] += coeff_b * src[3 * i] + coeff_g * src[3 * i + 1] + coeff_r * src[3 * i + 2];
+}
+
+//! 区域平均缩放，缩放倍数为整数
+void boxDownscale(const UA_Byte *src, size_t stride, const ImagePreview &p, UA_Byte *dst, vector<UA_UInt32> &buffer)
+{
+    size_t fx = p.roiWidth() / p.outWidth(), fy = p.roiHeight() / p.outHeight();
+    size_t ow = p.outWidth(), oh = p.outHeight(), oc = p.outChannels();
+    bool to_mono = oc != p.src_channels;
+    size_t row_len = p.roiWidth() * oc;
+    buffer.resize(row_len);
+    UA_UInt32 *acc = buffer.data();
+    //!< Divide by multiplying with the 32-bit fixed-point reciprocal of the box area
+    UA_UInt64 area = fx * fy * (to_mono ? 256 : 1);
+    UA_UInt64 scale = ((UA_UInt64(1) << 32) + area / 2) / area;
+    for (size_t y = 0; y < oh; ++y)
+    {
+        memset(acc, 0, row_len * sizeof(UA_UInt32));
+        for (size_t k = 0; k < fy; ++k)
+        {
+            const UA_Byte *row = src + (y * fy + k) * stride;
+            if (to_mono)
+                accumulateMonoRow(row, acc, p.roiWidth());
+            else
+                accumulateRow(row, acc, row_len);
+        }
+        UA_Byte *out = dst + y * ow * oc;
+        for (size_t x = 0; x < ow; ++x)
+            for (size_t c = 0; c < oc; ++c)
+            {
+                UA_UInt64 sum = 0;
+                for (size_t j = 0; j < fx; ++j)
+                    sum += acc[(x * fx + j) * oc + c];
+                out[x * oc + c] = static_cast<UA_Byte>((sum * scale + (UA_UInt64(1) << 31)) >> 32);
+            }
+    }
+}
+
+//! 最近邻采样，取目标像素中心对应的源像素
+void nearestDownscale(const UA_Byte *src, size_t stride, const ImagePreview &p, UA_Byte *dst, vector<UA_UInt32> &buffer)
+{
+    size_t ow = p.outWidth(), oh = p.outHeight(), oc = p.outChannels(), sc = p.src_channels;
+    size_t rw = p.roiWidth(), rh = p.roiHeight();
+    bool to_mono = oc != sc;
+    buffer.resize(ow);
+    UA_UInt32 *xs = buffer.data();
+    for (size_t x = 0; x < ow; ++x)
+        xs[x] = static_cast<UA_UInt32>((2 * x + 1) * rw / (2 * ow) * sc);
+    for (size_t y = 0; y < oh; ++y)
+    {
+        const UA_Byte *row = src + (2 * y + 1) * rh / (2 * oh) * stride;
+        UA_Byte *out = dst + y * ow * oc;
+        if (to_mono)
+            for (size_t x = 0; x < ow; ++x)
+            {
+                const UA_Byte *px = row + xs[x];
+                out[x] = static_cast<UA_Byte>((coeff_b * px[0] + coeff_g * px[1] + coeff_r * px[2] + 128) >> 8);
+            }
+        else
+            for (size_t x = 0; x < ow; ++x)
+                memcpy(out + x * oc, row + xs[x], oc);
+    }
+}
+
+} // namespace
+
+bool ImagePreview::valid() const
+{
+    if (src_width == 0 || src_height == 0 || src_channels == 0 || roi_x >= src_width || roi_y >= src_height)
+        return false;
+    if (roiWidth() > src_width - roi_x || roiHeight() > src_height - roi_y)
+        return false;
+    return outWidth() > 0 && outHeight() > 0 && outWidth() <= roiWidth() && outHeight() <= roiHeight();
+}
+
+void ua::bgrToMono(const UA_Byte *__restrict src, UA_Byte *__restrict dst, size_t pixels)
+{
+    for (size_t i = 0; i < pixels; ++i)
+        dst[i] = static_cast<UA_Byte>((coeff_b * src[3 * i] + coeff_g * src[3 * i + 1] + coeff_r * src[3 * i + 2] + 128) >> 8);
+}
+
+void ua::makePreview(const UA_Byte *src, const ImagePreview &preview, UA_Byte *dst, vector<UA_UInt32> &buffer)
+{
+    size_t stride = size_t(preview.src_width) * preview.src_channels;
+    const UA_Byte *roi = src + preview.roi_y * stride + size_t(preview.roi_x) * preview.src_channels;
+    size_t rw = preview.roiWidth(), rh = preview.roiHeight();
+    size_t ow = preview.outWidth(), oh = preview.outHeight(), oc = preview.outChannels();
+    if (ow == rw && oh == rh)
+    {
+        //!< Crop and (or) color conversion only
+        for (size_t y = 0; y < oh; ++y)
+        {
+            if (oc != preview.src_channels)
+                bgrToMono(roi + y * stride, dst + y * ow, ow);
+            else
+                memcpy(dst + y * ow * oc, roi + y * stride, ow * oc);
+        }
+    }
+    else if (rw % ow == 0 && rh % oh == 0)
+        boxDownscale(roi, stride, preview, dst, buffer);
+    else
+        nearestDownscale(roi, stride, preview, dst, buffer);
+}
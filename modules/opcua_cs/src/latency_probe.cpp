@@ -0,0 +1,152 @@
+/**
+ * @file latency_probe.cpp
+ * @author 赵曦 (535394140@qq.com)
+ * @brief NTP-style latency probe and clock offset estimation against Server::addLatencyProbe
+ * @version 1.0
+ * @date 2023-03-18
+ *
+ * @copyright Copyright (c) 2023, zhaoxi
+ *
+ */
+
+#include <algorithm>
+#include <cstdio>
+
+#include "asmpro/opcua_cs/latency_probe.hpp"
+
+using namespace std;
+using namespace ua;
+
+namespace
+{
+
+//! 读取 DateTime 类型的标量输出参数
+bool readDateTime(const Variable &val, UA_DateTime &out)
+{
+    const UA_Variant &v = val.get();
+    if (!UA_Variant_hasScalarType(&v, &UA_TYPES[UA_TYPES_DATETIME]))
+        return false;
+    out = *static_cast<const UA_DateTime *>(v.data);
+    return true;
+}
+
+//! 样本的分位数，样本会被排序 (单位：us)
+double percentile(vector<UA_Int64> &values, double q)
+{
+    if (values.empty())
+        return 0;
+    sort(values.begin(), values.end());
+    return static_cast<double>(values[static_cast<size_t>(q * (values.size() - 1))]) / UA_DATETIME_USEC;
+}
+
+} // namespace
+
+LatencyProbe::LatencyProbe(Client &client, const UA_NodeId &method_id, const UA_NodeId &object_id, size_t window)
+    : __client(client), __window(max<size_t>(window, 1))
+{
+    UA_NodeId_copy(&method_id, &__method_id);
+    UA_NodeId_copy(&object_id, &__object_id);
+}
+
+LatencyProbe::~LatencyProbe()
+{
+    stop();
+    UA_NodeId_clear(&__method_id);
+    UA_NodeId_clear(&__object_id);
+}
+
+UA_Boolean LatencyProbe::probe(Sample *sample)
+{
+    Sample s;
+    vector<Variable> outputs;
+    UA_Boolean ok = __client.callLatencyProbe(__method_id, __object_id, s.client_send, s.client_receive, outputs);
+    //!< The outputs are [ClientSendTime, ServerReceiveTime, ServerSendTime], the echo rejects stale replies
+    UA_DateTime echo = 0;
+    ok = ok && outputs.size() == 3 && readDateTime(outputs[0], echo) && echo == s.client_send &&
+         readDateTime(outputs[1], s.server_receive) && readDateTime(outputs[2], s.server_send);
+    lock_guard<mutex> lk(__mtx);
+    if (!ok)
+    {
+        ++__failures;
+        return UA_FALSE;
+    }
+    __samples.push_back(s);
+    if (__samples.size() > __window)
+        __samples.pop_front();
+    if (sample != nullptr)
+        *sample = s;
+    return UA_TRUE;
+}
+
+void LatencyProbe::start(UA_UInt32 interval_ms)
+{
+    if (__running.exchange(true))
+        return;
+    __worker = thread([this, interval_ms]() {
+        while (__running)
+        {
+            probe();
+            unique_lock<mutex> lk(__mtx);
+            __cv.wait_for(lk, chrono::milliseconds(interval_ms), [this]() { return !__running; });
+        }
+    });
+}
+
+void LatencyProbe::stop()
+{
+    {
+        lock_guard<mutex> lk(__mtx);
+        __running = false;
+    }
+    __cv.notify_all();
+    if (__worker.joinable())
+        __worker.join();
+}
+
+LatencyProbe::Stats LatencyProbe::stats() const
+{
+    Stats retval;
+    vector<Sample> samples;
+    {
+        lock_guard<mutex> lk(__mtx);
+        samples.assign(__samples.begin(), __samples.end());
+        retval.failures = __failures;
+    }
+    retval.count = samples.size();
+    if (samples.empty())
+        return retval;
+    //!< The exchange with the smallest network delay bounds the offset error most tightly
+    auto best = min_element(samples.begin(), samples.end(),
+                            [](const Sample &a, const Sample &b) { return a.delay() < b.delay(); });
+    UA_Int64 offset = best->offset();
+    retval.offset = static_cast<double>(offset) / UA_DATETIME_USEC;
+    retval.min_delay = static_cast<double>(best->delay()) / UA_DATETIME_USEC;
+
+    vector<UA_Int64> uplink, downlink, server, round_trip;
+    for (const auto &s : samples)
+    {
+        uplink.push_back(s.server_receive - s.client_send - offset);
+        downlink.push_back(s.client_receive - s.server_send + offset);
+        server.push_back(s.server());
+        round_trip.push_back(s.roundTrip());
+    }
+    retval.uplink = percentile(uplink, 0.5);
+    retval.downlink = percentile(downlink, 0.5);
+    retval.server = percentile(server, 0.5);
+    retval.round_trip_p50 = percentile(round_trip, 0.5);
+    retval.round_trip_p99 = percentile(round_trip, 0.99);
+    retval.round_trip_max = static_cast<double>(round_trip.back()) / UA_DATETIME_USEC;
+    return retval;
+}
+
+string LatencyProbe::summary() const
+{
+    Stats s = stats();
+    char buf[320];
+    snprintf(buf, sizeof(buf),
+             "count: %zu failures: %llu offset: %.1f min_delay: %.1f uplink: %.1f downlink: %.1f server: %.1f "
+             "rtt p50: %.1f p99: %.1f max: %.1f (us)\n",
+             s.count, static_cast<unsigned long long>(s.failures), s.offset, s.min_delay, s.uplink, s.downlink,
+             s.server, s.round_trip_p50, s.round_trip_p99, s.round_trip_max);
+    return buf;
+}
@@ -0,0 +1,114 @@
+/**
+ * @file latency_tracer.cpp
+ * @author 赵曦 (535394140@qq.com)
+ * @brief End-to-end latency tracer of the subscription pipeline
+ * @version 1.0
+ * @date 2023-03-13
+ *
+ * @copyright Copyright (c) 2023, zhaoxi
+ *
+ */
+
+#include <cstdio>
+
+#include "asmpro/opcua_cs/latency_tracer.hpp"
+
+using namespace std;
+using namespace ua;
+
+void Histogram::record(UA_Int64 value)
+{
+    UA_UInt64 v = value < 0 ? 0 : static_cast<UA_UInt64>(value);
+    //!< Values below sub_count map to themselves, the others to (major, sub) by the leading bits
+    size_t idx = v;
+    if (v >= sub_count)
+    {
+        size_t major = 63 - __builtin_clzll(v);
+        size_t sub = (v >> (major - sub_bits)) - sub_count;
+        idx = sub_count + (major - sub_bits) * sub_count + sub;
+    }
+    idx = min(idx, bucket_count - 1);
+    __buckets[idx].fetch_add(1, memory_order_relaxed);
+    __count.fetch_add(1, memory_order_relaxed);
+    __sum.fetch_add(v, memory_order_relaxed);
+    UA_UInt64 prev = __max.load(memory_order_relaxed);
+    while (prev < v && !__max.compare_exchange_weak(prev, v, memory_order_relaxed))
+        ;
+}
+
+double Histogram::percentile(double q) const
+{
+    UA_UInt64 total = __count;
+    if (total == 0)
+        return 0;
+    UA_UInt64 rank = static_cast<UA_UInt64>(q * (total - 1)) + 1;
+    UA_UInt64 seen = 0;
+    for (size_t idx = 0; idx < bucket_count; ++idx)
+    {
+        seen += __buckets[idx].load(memory_order_relaxed);
+        if (seen < rank)
+            continue;
+        if (idx < sub_count)
+            return static_cast<double>(idx);
+        size_t shift = (idx - sub_count) / sub_count;
+        size_t sub = (idx - sub_count) % sub_count;
+        double lower = static_cast<double>((sub_count + sub) << shift);
+        return lower + static_cast<double>(1ULL << shift) / 2;
+    }
+    return static_cast<double>(__max);
+}
+
+void Histogram::reset()
+{
+    for (auto &bucket : __buckets)
+        bucket = 0;
+    __count = 0;
+    __sum = 0;
+    __max = 0;
+}
+
+void LatencyTracer::record(const UA_DataValue &value, UA_DateTime received, UA_DateTime begin, UA_DateTime end)
+{
+    //!< The server stamps a write without a source timestamp with its own write time, which is not a source
+    bool has_source = value.hasSourceTimestamp &&
+                      !(value.hasServerTimestamp && value.sourceTimestamp == value.serverTimestamp);
+    if (has_source && value.hasServerTimestamp)
+        record(SourceToServer, (value.serverTimestamp - value.sourceTimestamp) / UA_DATETIME_USEC);
+    if (value.hasServerTimestamp)
+        record(ServerToClient, (received - value.serverTimestamp) / UA_DATETIME_USEC);
+    record(ClientToHandler, (begin - received) / UA_DATETIME_USEC);
+    record(Handler, (end - begin) / UA_DATETIME_USEC);
+    if (has_source)
+        record(EndToEnd, (end - value.sourceTimestamp) / UA_DATETIME_USEC);
+    else if (value.hasServerTimestamp)
+        record(EndToEnd, (end - value.serverTimestamp) / UA_DATETIME_USEC);
+}
+
+const char *LatencyTracer::name(Stage stage)
+{
+    static const char *names[] = {"source->server", "server->client", "client->handler", "handler", "end-to-end"};
+    return stage < StageCount ? names[stage] : "unknown";
+}
+
+string LatencyTracer::summary() const
+{
+    string retval;
+    char line[256];
+    for (size_t i = 0; i < StageCount; ++i)
+    {
+        const Histogram &h = __histograms[i];
+        snprintf(line, sizeof(line),
+                 "%-16s count: %-8llu mean: %-10.1f p50: %-10.1f p90: %-10.1f p99: %-10.1f p99.9: %-10.1f max: %llu\n",
+                 name(static_cast<Stage>(i)), static_cast<unsigned long long>(h.count()), h.mean(),
+                 h.percentile(0.5), h.percentile(0.9), h.percentile(0.99), h.percentile(0.999),
+                 static_cast<unsigned long long>(h.max()));
+        retval += line;
+    }
+    return retval;
+}
+
+void LatencyTracer::reset()
+{
+    for (auto &h : __histograms)
+        h.reset();
+}
@@ -0,0 +1,317 @@
+/**
+ * @file proxy.cpp
+ * @author 赵曦 (535394140@qq.com)
+ * @brief Aggregating proxy that mirrors upstream nodes and fans them out to downstream clients
+ * @version 1.0
+ * @date 2023-03-22
+ *
+ * @copyright Copyright (c) 2023, zhaoxi
+ *
+ */
+
+#include <fstream>
+#include <sstream>
+
+#include "asmpro/opcua_cs/proxy.hpp"
+
+using namespace std;
+using namespace ua;
+
+UA_Boolean Proxy::connect(const string &address, const string &username, const string &password,
+                          UA_UInt32 forward_timeout)
+{
+    __upstream = make_unique<Client>();
+    if (!__upstream->connect(address, username, password))
+    {
+        UA_LOG_ERROR(Server::logger(), UA_LOGCATEGORY_SERVER,
+                     "Function connect: failed to connect to \033[31m%s\033[0m", address.c_str());
+        __upstream.reset();
+        return UA_FALSE;
+    }
+    //!< Writes and calls are forwarded inside the server callbacks, the timeout bounds how long they block the server
+    __upstream->setTimeout(forward_timeout);
+    return UA_TRUE;
+}
+
+UA_NodeId Proxy::resolve(const string &path, UA_NodeId &upstream_parent, UA_NodeId &local_parent, string &name)
+{
+    vector<string> names;
+    istringstream is(path);
+    for (string token; getline(is, token, '/');)
+        if (!token.empty())
+            names.push_back(token);
+    if (__upstream == nullptr || names.empty())
+    {
+        UA_LOG_ERROR(Server::logger(), UA_LOGCATEGORY_SERVER,
+                     "Function resolve: invalid path or not connected \033[31m(path = %s)\033[0m", path.c_str());
+        return UA_NODEID_NULL;
+    }
+    UA_NodeId upstream_id = UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER);
+    upstream_parent = UA_NODEID_NULL;
+    local_parent = UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER);
+    string prefix;
+    for (size_t i = 0; i < names.size(); ++i)
+    {
+        UA_NodeId next_id = __upstream->findNodeId(upstream_id, 1, names[i]);
+        UA_NodeId_clear(&upstream_parent);
+        upstream_parent = upstream_id;
+        upstream_id = next_id;
+        if (UA_NodeId_isNull(&upstream_id))
+        {
+            UA_LOG_ERROR(Server::logger(), UA_LOGCATEGORY_SERVER,
+                         "Function resolve: \033[31m%s\033[0m not found upstream (path = %s)",
+                         names[i].c_str(), path.c_str());
+            UA_NodeId_clear(&upstream_parent);
+            return UA_NODEID_NULL;
+        }
+        if (i + 1 == names.size())
+            break;
+        //!< Parent objects are mirrored as plain objects, shared by every node below them
+        prefix += "/" + names[i];
+        auto it = __objects.find(prefix);
+        if (it == __objects.end())
+        {
+            Object object;
+            UA_NodeId object_id = Server::addObjectNode(names[i], names[i], object,
+                                                        UA_NODEID_NUMERIC(0, UA_NS0ID_BASEOBJECTTYPE), local_parent);
+            if (UA_NodeId_isNull(&object_id))
+            {
+                UA_NodeId_clear(&upstream_parent);
+                UA_NodeId_clear(&upstream_id);
+                return UA_NODEID_NULL;
+            }
+            it = __objects.emplace(prefix, object_id).first;
+        }
+        local_parent = it->second;
+    }
+    name = names.back();
+    return upstream_id;
+}
+
+UA_NodeId Proxy::mirrorVariable(const string &path)
+{
+    UA_NodeId upstream_parent, local_parent;
+    string name;
+    UA_NodeId upstream_id = resolve(path, upstream_parent, local_parent, name);
+    if (UA_NodeId_isNull(&upstream_id))
+        return UA_NODEID_NULL;
+    Mirror &mirror = __mirrors.emplace_back();
+    mirror.path = path;
+    mirror.upstream_id = upstream_id;
+    mirror.upstream_parent = upstream_parent;
+    //!< The current value gives the mirror its data type and serves reads until the first notification
+    Variable data = __upstream->readVariable(upstream_id);
+    if (data.empty())
+    {
+        UA_LOG_ERROR(Server::logger(), UA_LOGCATEGORY_SERVER,
+                     "Function mirrorVariable: failed to read \033[31m%s\033[0m", path.c_str());
+        __mirrors.pop_back();
+        return UA_NODEID_NULL;
+    }
+    UA_Variant_copy(&data.get(), &mirror.value.value);
+    mirror.value.hasValue = true;
+    //!< The mirror is the node context, so it is reachable even by the type check read while adding the node
+    UA_NodeId local_id = Server::addDataSourceVariableNode(name, path, data, mirrorReadHandler, mirrorWriteHandler,
+                                                           UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATAVARIABLETYPE),
+                                                           local_parent, &mirror);
+    if (UA_NodeId_isNull(&local_id))
+        __mirrors.pop_back();
+    return local_id;
+}
+
+vector<Argument> Proxy::readArguments(const UA_NodeId &method_id, const string &name)
+{
+    vector<Argument> args;
+    UA_NodeId property_id = __upstream->findNodeId(method_id, 0, name);
+    if (UA_NodeId_isNull(&property_id))
+        return args;
+    Variable value = __upstream->readVariable(property_id);
+    UA_NodeId_clear(&property_id);
+    const UA_Variant &val = value.get();
+    if (UA_Variant_isEmpty(&val) || val.type != &UA_TYPES[UA_TYPES_ARGUMENT])
+        return args;
+    auto data = static_cast<const UA_Argument *>(val.data);
+    size_t size = UA_Variant_isScalar(&val) ? 1 : val.arrayLength;
+    args.reserve(size);
+    for (size_t i = 0; i < size; ++i)
+        args.emplace_back(data[i]);
+    return args;
+}
+
+UA_NodeId Proxy::mirrorMethod(const string &path)
+{
+    UA_NodeId upstream_parent, local_parent;
+    string name;
+    UA_NodeId upstream_id = resolve(path, upstream_parent, local_parent, name);
+    if (UA_NodeId_isNull(&upstream_id))
+        return UA_NODEID_NULL;
+    Mirror &mirror = __mirrors.emplace_back();
+    mirror.path = path;
+    mirror.method = UA_TRUE;
+    mirror.upstream_id = upstream_id;
+    mirror.upstream_parent = upstream_parent;
+    vector<Argument> inputs = readArguments(upstream_id, "InputArguments");
+    vector<Argument> outputs = readArguments(upstream_id, "OutputArguments");
+    UA_NodeId local_id = Server::addMethodNode(name, path, mirrorMethodHandler, inputs, outputs, local_parent, &mirror);
+    if (UA_NodeId_isNull(&local_id))
+        __mirrors.pop_back();
+    return local_id;
+}
+
+UA_Boolean Proxy::loadConfig(const string &path)
+{
+    ifstream ifs(path);
+    if (!ifs.is_open())
+    {
+        UA_LOG_ERROR(Server::logger(), UA_LOGCATEGORY_SERVER,
+                     "Function loadConfig: failed to open \033[31m%s\033[0m", path.c_str());
+        return UA_FALSE;
+    }
+    UA_Boolean retval = UA_TRUE;
+    size_t line_no = 0;
+    for (string line; getline(ifs, line);)
+    {
+        ++line_no;
+        istringstream is(line);
+        string kind, node_path;
+        is >> kind >> node_path;
+        if (kind.empty() || kind[0] == '#')
+            continue;
+        UA_NodeId node_id = UA_NODEID_NULL;
+        if (kind == "variable")
+            node_id = mirrorVariable(node_path);
+        else if (kind == "method")
+            node_id = mirrorMethod(node_path);
+        else
+            UA_LOG_ERROR(Server::logger(), UA_LOGCATEGORY_SERVER,
+                         "Function loadConfig: unknown kind \033[31m%s\033[0m on line %zu", kind.c_str(), line_no);
+        if (UA_NodeId_isNull(&node_id))
+            retval = UA_FALSE;
+    }
+    return retval;
+}
+
+UA_Boolean Proxy::start(UA_Double publishing_interval)
+{
+    if (__upstream == nullptr)
+    {
+        UA_LOG_ERROR(Server::logger(), UA_LOGCATEGORY_SERVER, "Function start: not connected");
+        return UA_FALSE;
+    }
+    vector<Mirror *> variables;
+    vector<UA_NodeId> node_ids;
+    vector<Client::DataChangeHandler> handlers;
+    for (Mirror &mirror : __mirrors)
+    {
+        if (mirror.method)
+            continue;
+        variables.push_back(&mirror);
+        node_ids.push_back(mirror.upstream_id);
+        //!< Take the notification over, the client releases the previous value outside the lock
+        handlers.emplace_back([target = &mirror](UA_UInt32, UA_DataValue &value) {
+            lock_guard<mutex> lk(target->mtx);
+            swap(value, target->value);
+        });
+    }
+    UA_Boolean retval = UA_TRUE;
+    if (!node_ids.empty())
+    {
+        UA_UInt32 sub_id = __upstream->createSubscription(publishing_interval);
+        auto mon_ids = __upstream->createVariableMonitors(sub_id, node_ids, std::move(handlers), 0, 1);
+        for (size_t i = 0; i < mon_ids.size(); ++i)
+        {
+            if (mon_ids[i] != 0)
+                continue;
+            UA_LOG_ERROR(Server::logger(), UA_LOGCATEGORY_SERVER,
+                         "Function start: failed to monitor \033[31m%s\033[0m", variables[i]->path.c_str());
+            retval = UA_FALSE;
+        }
+    }
+    __upstream->start();
+    return retval;
+}
+
+void Proxy::stop()
+{
+    if (__upstream != nullptr)
+    {
+        __upstream->stop();
+        __upstream->disconnect();
+        __upstream.reset();
+    }
+    //!< The local nodes keep pointing at their mirrors, which therefore stay alive with the last values
+    __objects.clear();
+}
+
+UA_StatusCode Proxy::mirrorReadHandler(UA_Server *, const UA_NodeId *, void *, const UA_NodeId *, void *node_context,
+                                       UA_Boolean, const UA_NumericRange *range, UA_DataValue *value)
+{
+    auto mirror = static_cast<Mirror *>(node_context);
+    if (mirror == nullptr)
+        return UA_STATUSCODE_BADNODEIDUNKNOWN;
+    lock_guard<mutex> lk(mirror->mtx);
+    if (range == nullptr)
+        return UA_DataValue_copy(&mirror->value, value);
+    //!< Timestamps and status come along with the requested range of the value
+    UA_Variant sub_range;
+    UA_StatusCode retval = UA_Variant_copyRange(&mirror->value.value, &sub_range, *range);
+    if (retval != UA_STATUSCODE_GOOD)
+        return retval;
+    UA_Variant cached = mirror->value.value;
+    UA_Variant_init(&mirror->value.value);
+    retval = UA_DataValue_copy(&mirror->value, value);
+    mirror->value.value = cached;
+    value->value = sub_range;
+    return retval;
+}
+
+UA_StatusCode Proxy::mirrorWriteHandler(UA_Server *, const UA_NodeId *, void *, const UA_NodeId *, void *node_context,
+                                        const UA_NumericRange *range, const UA_DataValue *value)
+{
+    auto mirror = static_cast<Mirror *>(node_context);
+    if (mirror == nullptr)
+        return UA_STATUSCODE_BADNODEIDUNKNOWN;
+    if (__upstream == nullptr)
+        return UA_STATUSCODE_BADCOMMUNICATIONERROR;
+    //!< Partial writes would have to be merged with a value that may already be stale upstream
+    if (range != nullptr)
+        return UA_STATUSCODE_BADWRITENOTSUPPORTED;
+    if (!value->hasValue || UA_Variant_isEmpty(&value->value))
+        return UA_STATUSCODE_BADTYPEMISMATCH;
+    UA_Variant val;
+    UA_Variant_copy(&value->value, &val);
+    //!< Synchronous round trip inside the server callback, bounded by the forward timeout of the upstream client.
+    //!< The upstream status code is logged by the client, downstream only learns about the failure
+    return __upstream->writeVariable(mirror->upstream_id, Variable::adopt(val)) ? UA_STATUSCODE_GOOD
+                                                                                : UA_STATUSCODE_BADCOMMUNICATIONERROR;
+}
+
+UA_StatusCode Proxy::mirrorMethodHandler(UA_Server *, const UA_NodeId *, void *, const UA_NodeId *,
+                                         void *method_context, const UA_NodeId *, void *, size_t input_size,
+                                         const UA_Variant *input, size_t output_size, UA_Variant *output)
+{
+    auto mirror = static_cast<Mirror *>(method_context);
+    if (mirror == nullptr)
+        return UA_STATUSCODE_BADMETHODINVALID;
+    if (__upstream == nullptr)
+        return UA_STATUSCODE_BADCOMMUNICATIONERROR;
+    Client::MethodCall call;
+    call.method_id = mirror->upstream_id;
+    call.object_id = mirror->upstream_parent;
+    call.inputs.reserve(input_size);
+    for (size_t i = 0; i < input_size; ++i)
+    {
+        UA_Variant val;
+        UA_Variant_copy(&input[i], &val);
+        call.inputs.push_back(Variable::adopt(val));
+    }
+    //!< Synchronous round trip as for writes, the upstream status code is passed through as is
+    auto results = __upstream->call({call});
+    if (results.empty())
+        return UA_STATUSCODE_BADCOMMUNICATIONERROR;
+    if (results[0].status != UA_STATUSCODE_GOOD)
+        return results[0].status;
+    for (size_t i = 0; i < output_size && i < results[0].outputs.size(); ++i)
+        UA_Variant_copy(&results[0].outputs[i].get(), &output[i]);
+    return UA_STATUSCODE_GOOD;
+}
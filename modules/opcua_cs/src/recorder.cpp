@@ -0,0 +1,382 @@
+/**
+ * @file recorder.cpp
+ * @author 赵曦 (535394140@qq.com)
+ * @brief Record-and-replay of data-change streams for offline load testing
+ * @version 1.0
+ * @date 2023-03-22
+ *
+ * @copyright Copyright (c) 2023, zhaoxi
+ *
+ */
+
+#include <cerrno>
+#include <cstring>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "asmpro/opcua_cs/recorder.hpp"
+
+using namespace std;
+using namespace ua;
+
+namespace
+{
+
+//! 日志文件魔数，末尾两位为格式版本
+constexpr char record_magic[8] = {'U', 'A', 'R', 'E', 'C', '0', '0', '1'};
+
+constexpr UA_UInt32 kind_node = 0;  //!< 节点声明，载荷为浏览名
+constexpr UA_UInt32 kind_value = 1; //!< 数据变更，载荷为数据值
+
+//! 记录头，按主机字节序存储，其后为 length 字节的节点 ID 与载荷
+struct RecordHeader
+{
+    UA_UInt32 length;
+    UA_UInt32 kind;
+    UA_DateTime time;
+};
+
+static_assert(sizeof(RecordHeader) == 16, "record header must not have padding");
+
+//! 解码记录体中的节点 ID 与载荷
+bool decodeRecord(const UA_ByteString &body, UA_NodeId &node_id, void *payload, const UA_DataType *type)
+{
+    size_t offset = 0;
+    if (UA_decodeBinary(&body, &offset, &node_id, &UA_TYPES[UA_TYPES_NODEID], nullptr) != UA_STATUSCODE_GOOD)
+        return false;
+    if (UA_decodeBinary(&body, &offset, payload, type, nullptr) != UA_STATUSCODE_GOOD)
+    {
+        UA_NodeId_clear(&node_id);
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+Recorder::Recorder(const string &path, size_t buffer_size, const UA_Logger *logger)
+    : __logger(logger), __buffer_size(buffer_size)
+{
+    __fp = fopen(path.c_str(), "wb");
+    if (__fp == nullptr)
+    {
+        UA_LOG_ERROR(__logger, UA_LOGCATEGORY_USERLAND, "Failed to open the record file: %s", path.c_str());
+        return;
+    }
+    __buffer.reserve(buffer_size);
+    __buffer.insert(__buffer.end(), record_magic, record_magic + sizeof(record_magic));
+}
+
+Recorder::~Recorder()
+{
+    //!< No notification may reach this recorder once it is gone
+    for (auto &watch : __server_watches)
+    {
+        Server::deleteVariableMonitor(watch.mon_id);
+        UA_NodeId_clear(&watch.node_id);
+    }
+    if (__fp != nullptr)
+    {
+        flush();
+        if (fclose(__fp) != 0)
+            UA_LOG_ERROR(__logger, UA_LOGCATEGORY_USERLAND, "Failed to close the record file: %s", strerror(errno));
+    }
+    for (auto &node_id : __watched)
+        UA_NodeId_clear(&node_id);
+}
+
+void Recorder::writeBuffer()
+{
+    if (__buffer.empty())
+        return;
+    if (fwrite(__buffer.data(), 1, __buffer.size(), __fp) != __buffer.size())
+    {
+        __lost += __buffer.size();
+        UA_LOG_ERROR(__logger, UA_LOGCATEGORY_USERLAND, "Failed to write %zu bytes to the record file: %s",
+                     __buffer.size(), strerror(errno));
+    }
+    __buffer.clear();
+}
+
+void Recorder::append(UA_UInt32 kind, UA_DateTime time, const UA_NodeId &node_id, const void *payload,
+                      const UA_DataType *type)
+{
+    if (__fp == nullptr)
+        return;
+    //!< Both parts are encoded in place at the end of the buffer, no temporary allocation
+    size_t node_size = UA_calcSizeBinary(&node_id, &UA_TYPES[UA_TYPES_NODEID]);
+    size_t payload_size = UA_calcSizeBinary(payload, type);
+    size_t offset = __buffer.size();
+    __buffer.resize(offset + sizeof(RecordHeader) + node_size + payload_size);
+    UA_Byte *body = __buffer.data() + offset + sizeof(RecordHeader);
+    UA_ByteString node_buf{node_size, body};
+    UA_ByteString payload_buf{payload_size, body + node_size};
+    if (UA_encodeBinary(&node_id, &UA_TYPES[UA_TYPES_NODEID], &node_buf) != UA_STATUSCODE_GOOD ||
+        UA_encodeBinary(payload, type, &payload_buf) != UA_STATUSCODE_GOOD)
+    {
+        __buffer.resize(offset);
+        return;
+    }
+    RecordHeader h{static_cast<UA_UInt32>(node_size + payload_size), kind, time};
+    memcpy(__buffer.data() + offset, &h, sizeof(RecordHeader));
+    __bytes += sizeof(RecordHeader) + node_size + payload_size;
+    if (__buffer.size() >= __buffer_size)
+        writeBuffer();
+}
+
+void Recorder::declare(const UA_NodeId &node_id, const string &name)
+{
+    UA_String str = UA_STRING(const_cast<char *>(name.c_str()));
+    lock_guard<mutex> lk(__mtx);
+    append(kind_node, UA_DateTime_now(), node_id, &str, &UA_TYPES[UA_TYPES_STRING]);
+}
+
+void Recorder::record(const UA_NodeId &node_id, const UA_DataValue &value, UA_DateTime time)
+{
+    lock_guard<mutex> lk(__mtx);
+    append(kind_value, time, node_id, &value, &UA_TYPES[UA_TYPES_DATAVALUE]);
+    ++__records;
+}
+
+Client::DataChangeHandler Recorder::handler(const UA_NodeId &node_id, const string &name)
+{
+    if (!name.empty())
+        declare(node_id, name);
+    lock_guard<mutex> lk(__mtx);
+    __watched.emplace_back();
+    UA_NodeId_copy(&node_id, &__watched.back());
+    return [this, id = &__watched.back()](UA_UInt32, const UA_DataValue &value) { record(*id, value); };
+}
+
+void Recorder::watch(const UA_NodeId &node_id, const string &name, UA_Double sampling_interval)
+{
+    declare(node_id, name);
+    ServerWatch *watch = nullptr;
+    {
+        lock_guard<mutex> lk(__mtx);
+        watch = &__server_watches.emplace_back();
+        watch->recorder = this;
+        UA_NodeId_copy(&node_id, &watch->node_id);
+    }
+    watch->mon_id = Server::createVariableMonitor(watch->node_id, serverDataChangeHandler, sampling_interval, watch);
+}
+
+void Recorder::flush()
+{
+    lock_guard<mutex> lk(__mtx);
+    if (__fp == nullptr)
+        return;
+    writeBuffer();
+    if (fflush(__fp) != 0)
+        UA_LOG_ERROR(__logger, UA_LOGCATEGORY_USERLAND, "Failed to flush the record file: %s", strerror(errno));
+}
+
+void Recorder::serverDataChangeHandler(UA_Server *, UA_UInt32, void *mon_context, const UA_NodeId *, void *,
+                                       UA_UInt32, const UA_DataValue *value)
+{
+    auto watch = static_cast<ServerWatch *>(mon_context);
+    watch->recorder->record(watch->node_id, *value);
+}
+
+Replayer::Replayer(const string &path)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(record_magic))
+    {
+        UA_LOG_ERROR(UA_Log_Stdout, UA_LOGCATEGORY_USERLAND, "Failed to open the record file: %s", path.c_str());
+        if (fd >= 0)
+            close(fd);
+        return;
+    }
+    //!< Records are decoded straight from the mapped pages, no intermediate read buffer
+    void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        UA_LOG_ERROR(UA_Log_Stdout, UA_LOGCATEGORY_USERLAND, "Failed to map the record file: %s", path.c_str());
+        return;
+    }
+    if (memcmp(data, record_magic, sizeof(record_magic)) != 0)
+    {
+        UA_LOG_ERROR(UA_Log_Stdout, UA_LOGCATEGORY_USERLAND, "Not a record file: %s", path.c_str());
+        munmap(data, st.st_size);
+        return;
+    }
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+    __data = static_cast<const UA_Byte *>(data);
+    __size = st.st_size;
+}
+
+Replayer::~Replayer()
+{
+    if (__data != nullptr)
+        munmap(const_cast<UA_Byte *>(__data), __size);
+    for (auto &[recorded_id, local_id] : __map)
+    {
+        UA_NodeId_clear(const_cast<UA_NodeId *>(&recorded_id));
+        UA_NodeId_clear(&local_id);
+    }
+}
+
+UA_Boolean Replayer::visit(const Visitor &visitor) const
+{
+    size_t offset = sizeof(record_magic);
+    while (offset + sizeof(RecordHeader) <= __size)
+    {
+        RecordHeader h;
+        memcpy(&h, __data + offset, sizeof(RecordHeader));
+        if (h.length > __size - offset - sizeof(RecordHeader))
+            return UA_FALSE;
+        UA_ByteString body{h.length, const_cast<UA_Byte *>(__data + offset + sizeof(RecordHeader))};
+        offset += sizeof(RecordHeader) + h.length;
+        if (!visitor(h.kind, h.time, body))
+            return UA_TRUE;
+    }
+    return offset == __size;
+}
+
+void Replayer::map(const UA_NodeId &recorded_id, const UA_NodeId &local_id)
+{
+    auto it = __map.find(recorded_id);
+    if (it != __map.end())
+    {
+        UA_NodeId_clear(&it->second);
+        UA_NodeId_copy(&local_id, &it->second);
+        return;
+    }
+    UA_NodeId key, value;
+    UA_NodeId_copy(&recorded_id, &key);
+    UA_NodeId_copy(&local_id, &value);
+    __map.emplace(key, value);
+}
+
+vector<string> Replayer::names() const
+{
+    vector<string> retval;
+    if (__data == nullptr)
+        return retval;
+    visit([&](UA_UInt32 kind, UA_DateTime, const UA_ByteString &body) {
+        UA_NodeId node_id;
+        UA_String name;
+        if (kind == kind_node && decodeRecord(body, node_id, &name, &UA_TYPES[UA_TYPES_STRING]))
+        {
+            retval.emplace_back(reinterpret_cast<const char *>(name.data), name.length);
+            UA_NodeId_clear(&node_id);
+            UA_String_clear(&name);
+        }
+        return true;
+    });
+    return retval;
+}
+
+size_t Replayer::addNodes()
+{
+    if (__data == nullptr)
+        return 0;
+    //!< The first value of each declared node gives the new variable its data type
+    unordered_map<UA_NodeId, string, NodeIdHash, NodeIdEqual> declared;
+    unordered_map<string, size_t> used;
+    size_t added = 0;
+    visit([&](UA_UInt32 kind, UA_DateTime, const UA_ByteString &body) {
+        UA_NodeId node_id;
+        if (kind == kind_node)
+        {
+            UA_String name;
+            if (!decodeRecord(body, node_id, &name, &UA_TYPES[UA_TYPES_STRING]))
+                return true;
+            if (__map.count(node_id) == 0 && declared.count(node_id) == 0)
+                declared.emplace(node_id, string(reinterpret_cast<const char *>(name.data), name.length));
+            else
+                UA_NodeId_clear(&node_id);
+            UA_String_clear(&name);
+            return true;
+        }
+        UA_DataValue value;
+        if (kind != kind_value || declared.empty() ||
+            !decodeRecord(body, node_id, &value, &UA_TYPES[UA_TYPES_DATAVALUE]))
+            return true;
+        auto it = declared.find(node_id);
+        if (it != declared.end() && value.hasValue && !UA_Variant_isEmpty(&value.value))
+        {
+            string name = it->second;
+            size_t n = used[name]++;
+            if (n > 0)
+                name += "_" + to_string(n);
+            Variable data = Variable::adopt(value.value);
+            UA_NodeId local_id = Server::addVariableNode(name, name, data);
+            if (!UA_NodeId_isNull(&local_id))
+            {
+                map(it->first, local_id);
+                ++added;
+            }
+            UA_NodeId key = it->first;
+            declared.erase(it);
+            UA_NodeId_clear(&key);
+        }
+        UA_NodeId_clear(&node_id);
+        UA_DataValue_clear(&value);
+        return true;
+    });
+    for (auto &[node_id, name] : declared)
+        UA_NodeId_clear(const_cast<UA_NodeId *>(&node_id));
+    return added;
+}
+
+UA_Boolean Replayer::run(const ReplayOptions &options)
+{
+    if (__data == nullptr)
+        return UA_FALSE;
+    __running = true;
+    UA_Boolean retval = UA_TRUE;
+    do
+    {
+        //!< Pacing follows the recording times relative to the first data change of the pass
+        auto start = chrono::steady_clock::now();
+        UA_DateTime first = 0;
+        bool started = false;
+        retval = visit([&](UA_UInt32 kind, UA_DateTime time, const UA_ByteString &body) {
+            if (!__running)
+                return false;
+            if (kind != kind_value)
+                return true;
+            if (!started)
+            {
+                first = time;
+                started = true;
+            }
+            if (options.speed > 0)
+                this_thread::sleep_until(start + chrono::microseconds(static_cast<int64_t>(
+                                                     (time - first) / UA_DATETIME_USEC / options.speed)));
+            UA_NodeId node_id;
+            UA_DataValue value;
+            if (!decodeRecord(body, node_id, &value, &UA_TYPES[UA_TYPES_DATAVALUE]))
+            {
+                ++__failed;
+                return true;
+            }
+            if (options.restamp)
+            {
+                value.sourceTimestamp = UA_DateTime_now();
+                value.hasSourceTimestamp = true;
+            }
+            auto it = __map.find(node_id);
+            if (Server::writeDataValue(it != __map.end() ? it->second : node_id, value))
+                ++__replayed;
+            else
+                ++__failed;
+            UA_NodeId_clear(&node_id);
+            UA_DataValue_clear(&value);
+            return true;
+        });
+        //!< A log without data changes would spin forever in loop mode
+        if (!started)
+            break;
+    } while (options.loop && __running);
+    __running = false;
+    return retval;
+}
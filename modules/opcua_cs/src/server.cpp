@@ -9,17 +9,37 @@
  *
  */
 
+#include <cstdint>
+#include <cstring>
 #include <thread>
 #include <string>
 
+#include "asmpro/opcua_cs/content_hash.hpp"
 #include "asmpro/opcua_cs/server.hpp"
+#include "asmpro/opcua_cs/trace.hpp"
 
 using namespace std;
 using namespace ua;
 
+//! 当前线程正在经由 dedupWrite 写入的节点的去重状态，用于在值回调中区分自身的写入
+static thread_local const void *dedup_writing = nullptr;
+
+//! 读取节点的浏览名，用作追踪区间名
+static string browseName(UA_Server *server, const UA_NodeId &node_id)
+{
+    UA_QualifiedName name;
+    UA_QualifiedName_init(&name);
+    if (UA_Server_readBrowseName(server, node_id, &name) != UA_STATUSCODE_GOOD)
+        return "Unknown";
+    string retval(reinterpret_cast<const char *>(name.name.data), name.name.length);
+    UA_QualifiedName_clear(&name);
+    return retval;
+}
+
 void Server::stopHandler(int sign)
 {
-    UA_LOG_INFO(UA_Log_Stdout, UA_LOGCATEGORY_SERVER, "received ctrl-c");
+    if (__server != nullptr)
+        UA_LOG_INFO(logger(), UA_LOGCATEGORY_SERVER, "received ctrl-c");
     Server::__running = false;
 }
 
@@ -61,12 +81,57 @@ void Server::run()
     SERVER_RUNNING_ASSERT();
     SERVER_INIT_ASSERT();
     __running = true;
-    UA_StatusCode retval = UA_Server_run(__server, &__running);
+    //!< Equivalent to UA_Server_run, but every iteration is a trace span
+    UA_StatusCode retval = UA_Server_run_startup(__server);
+    if (retval == UA_STATUSCODE_GOOD)
+    {
+        while (__running)
+        {
+            TraceSpan span("Server::iterate", "server");
+            UA_Server_run_iterate(__server, true);
+        }
+        retval = UA_Server_run_shutdown(__server);
+    }
     if (retval != UA_STATUSCODE_GOOD)
-        UA_LOG_ERROR(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+        UA_LOG_ERROR(logger(), UA_LOGCATEGORY_SERVER,
                      "ServerInit: %s", UA_StatusCode_name(retval));
 }
 
+void Server::stop()
+{
+    if (__server != nullptr)
+        UA_Server_delete(__server);
+    __server = nullptr;
+    __is_init = UA_FALSE;
+    __contexts.clear();
+    __previews.clear();
+    __compressed.clear();
+    for (auto &delta : __deltas)
+        UA_NodeId_clear(&delta.node_id);
+    __deltas.clear();
+    for (auto &source : __image_sources)
+    {
+        UA_NodeId_clear(&source.image_id);
+        UA_DataValue_clear(&source.snapshot);
+    }
+    __image_sources.clear();
+    for (auto &[node_id, dedup] : __dedups)
+        UA_NodeId_clear(const_cast<UA_NodeId *>(&node_id));
+    __dedups.clear();
+    for (auto &[node_id, history] : __histories)
+        UA_NodeId_clear(const_cast<UA_NodeId *>(&node_id));
+    __histories.clear();
+}
+
+void Server::setLogger(const UA_Logger &logger)
+{
+    SERVER_INIT_ASSERT();
+    UA_ServerConfig *config = UA_Server_getConfig(__server);
+    if (config->logger.clear != nullptr)
+        config->logger.clear(config->logger.context);
+    config->logger = logger;
+}
+
 UA_VariableAttributes Server::configVariableAttribute(const string &browse_name,
                                                       const string &description, const Variable &data)
 {
@@ -97,13 +162,15 @@ UA_NodeId Server::findNodeId(const UA_NodeId &origin_id, UA_UInt32 target_ns, co
     UA_NodeId retval = UA_NODEID_NULL;
     if (bpr.statusCode != UA_STATUSCODE_GOOD || bpr.targetsSize < 1)
     {
-        UA_LOG_ERROR(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+        UA_LOG_ERROR(logger(), UA_LOGCATEGORY_SERVER,
                      "Function findNodeId: %s \033[31m(ns = %u, name = %s)\033[0m",
                      UA_StatusCode_name(bpr.statusCode), target_ns, target_name.c_str());
+        UA_BrowsePathResult_clear(&bpr);
         return UA_NODEID_NULL;
     }
     else
         UA_NodeId_copy(&bpr.targets[0].targetId.nodeId, &retval);
+    UA_BrowsePathResult_clear(&bpr);
     return retval;
 }
 
@@ -121,26 +188,224 @@ UA_NodeId Server::addVariableNode(const string &browse_name, const string &descr
                                             type_id, var_attr, nullptr, &node_id);
     if (retval != UA_STATUSCODE_GOOD)
     {
-        UA_LOG_ERROR(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+        UA_LOG_ERROR(logger(), UA_LOGCATEGORY_SERVER,
                      "Function addVariableNode: %s", UA_StatusCode_name(retval));
         return UA_NODEID_NULL;
     }
     return node_id;
 }
 
+template <typename _Hasher, typename _Write>
+UA_Boolean Server::dedupWrite(const UA_NodeId &node_id, _Hasher &&hasher, _Write &&write)
+{
+    WriteDedup *dedup = nullptr;
+    {
+        lock_guard<mutex> lk(__dedup_mtx);
+        auto it = __dedups.find(node_id);
+        if (it != __dedups.end() && it->second.mode == WriteMode::SkipUnchanged)
+            dedup = &it->second;
+    }
+    if (dedup == nullptr)
+        return write();
+    //!< Hash before taking the node lock, entries are never erased while the server is alive
+    UA_UInt64 hash = hasher();
+    //!< Compare and write under one lock per node, so concurrent writers cannot record each other's hash
+    lock_guard<mutex> write_lk(dedup->write_mtx);
+    {
+        lock_guard<mutex> lk(__dedup_mtx);
+        if (dedup->valid && dedup->hash == hash)
+        {
+            ++dedup->suppressed;
+            return UA_TRUE;
+        }
+    }
+    //!< The value callbacks of this write must not invalidate the hash it is about to record
+    dedup_writing = dedup;
+    UA_Boolean ok = write();
+    dedup_writing = nullptr;
+    //!< Remember the hash only after a successful write, so a failed write is retried
+    lock_guard<mutex> lk(__dedup_mtx);
+    dedup->hash = hash;
+    dedup->valid = ok;
+    return ok;
+}
+
+void Server::invalidateDedup(const UA_NodeId &node_id)
+{
+    lock_guard<mutex> lk(__dedup_mtx);
+    auto it = __dedups.find(node_id);
+    if (it != __dedups.end() && &it->second != dedup_writing)
+        it->second.valid = UA_FALSE;
+}
+
+void Server::dedupWrittenHandler(UA_Server *, const UA_NodeId *, void *, const UA_NodeId *node_id, void *,
+                                 const UA_NumericRange *, const UA_DataValue *)
+{
+    invalidateDedup(*node_id);
+}
+
 UA_Boolean Server::writeVariable(const UA_NodeId &node_id, const Variable &data)
 {
     SERVER_INIT_ASSERT();
-    auto status = UA_Server_writeValue(__server, node_id, data.get());
+    return dedupWrite(
+        node_id, [&]() { return contentHash(data.get()); },
+        [&]() {
+            auto status = UA_Server_writeValue(__server, node_id, data.get());
+            if (status != UA_STATUSCODE_GOOD)
+            {
+                UA_LOG_ERROR(logger(), UA_LOGCATEGORY_SERVER,
+                             "Function writeVariable: %s", UA_StatusCode_name(status));
+                return UA_FALSE;
+            }
+            return UA_TRUE;
+        });
+}
+
+UA_Boolean Server::writeVariable(const UA_NodeId &node_id, const Variable &data, UA_DateTime source_timestamp)
+{
+    //!< Shallow view of the variant, the server copies the value itself
+    UA_DataValue value;
+    UA_DataValue_init(&value);
+    value.value = data.get();
+    value.hasValue = true;
+    value.sourceTimestamp = source_timestamp;
+    value.hasSourceTimestamp = true;
+    return writeDataValue(node_id, value);
+}
+
+UA_Boolean Server::writeImage(const UA_NodeId &node_id, const ImageHeader &header, const UA_Byte *data,
+                              size_t src_stride)
+{
+    SERVER_INIT_ASSERT();
+    //!< Validate before hashing, the hasher reads height rows of the source
+    static const ImageHeader reference;
+    size_t row = header.rowSize();
+    if (memcmp(header.magic, reference.magic, sizeof(reference.magic)) != 0 || header.version != reference.version ||
+        row > UINT32_MAX || (src_stride != 0 && src_stride < row) || (row > 0 && header.height > 0 && data == nullptr))
+    {
+        UA_LOG_ERROR(logger(), UA_LOGCATEGORY_SERVER,
+                     "Function writeImage: invalid image \033[31m(%ux%u, stride = %zu)\033[0m", header.width,
+                     header.height, src_stride);
+        return UA_FALSE;
+    }
+    //!< Hash the geometry and the pixels only, an unchanged frame is skipped before it is encoded
+    auto hasher = [&]() {
+        UA_UInt64 geometry[4] = {static_cast<UA_UInt64>(header.format), header.width, header.height, header.channels};
+        UA_UInt64 hash = contentHash(geometry, sizeof(geometry));
+        if (src_stride == 0 || src_stride == row)
+            return contentHash(data, row * header.height, hash);
+        for (size_t y = 0; y < header.height; ++y)
+            hash = contentHash(data + y * src_stride, row, hash);
+        return hash;
+    };
+    return dedupWrite(node_id, hasher, [&]() {
+        //!< Reuse the encoding buffer of the writing thread across frames
+        thread_local vector<UA_Byte> buffer;
+        if (!encodeImage(header, data, src_stride, buffer))
+        {
+            UA_LOG_ERROR(logger(), UA_LOGCATEGORY_SERVER,
+                         "Function writeImage: invalid image \033[31m(%ux%u, stride = %zu)\033[0m", header.width,
+                         header.height, src_stride);
+            return UA_FALSE;
+        }
+        UA_ByteString str{buffer.size(), buffer.data()};
+        UA_DataValue value;
+        UA_DataValue_init(&value);
+        UA_Variant_setScalar(&value.value, &str, &UA_TYPES[UA_TYPES_BYTESTRING]);
+        value.hasValue = true;
+        //!< Without a capture time the server stamps the write itself
+        value.sourceTimestamp = header.timestamp;
+        value.hasSourceTimestamp = header.timestamp != 0;
+        return storeDataValue(node_id, value);
+    });
+}
+
+UA_Boolean Server::writeDataValue(const UA_NodeId &node_id, const UA_DataValue &value)
+{
+    SERVER_INIT_ASSERT();
+    auto hash = [&]() {
+        //!< A new status or a value appearing or disappearing is a change even if the variant is the same
+        UA_StatusCode status = value.hasStatus ? value.status : UA_STATUSCODE_GOOD;
+        UA_Byte meta[sizeof(status) + 1];
+        memcpy(meta, &status, sizeof(status));
+        meta[sizeof(status)] = value.hasValue;
+        return contentHash(meta, sizeof(meta), value.hasValue ? contentHash(value.value) : 0);
+    };
+    return dedupWrite(node_id, hash, [&]() { return storeDataValue(node_id, value); });
+}
+
+UA_Boolean Server::storeDataValue(const UA_NodeId &node_id, const UA_DataValue &value)
+{
+    auto status = UA_Server_writeDataValue(__server, node_id, value);
     if (status != UA_STATUSCODE_GOOD)
     {
-        UA_LOG_ERROR(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
-                     "Function writeVariable: %s", UA_StatusCode_name(status));
+        UA_LOG_ERROR(logger(), UA_LOGCATEGORY_SERVER,
+                     "Function writeDataValue: %s", UA_StatusCode_name(status));
         return UA_FALSE;
     }
     return UA_TRUE;
 }
 
+void Server::setWriteMode(const UA_NodeId &node_id, WriteMode mode)
+{
+    SERVER_INIT_ASSERT();
+    {
+        lock_guard<mutex> lk(__dedup_mtx);
+        auto it = __dedups.find(node_id);
+        if (it == __dedups.end())
+        {
+            if (mode == WriteMode::Always)
+                return;
+            UA_NodeId key;
+            UA_NodeId_copy(&node_id, &key);
+            it = __dedups.try_emplace(key).first;
+        }
+        it->second.mode = mode;
+        it->second.valid = UA_FALSE;
+    }
+    if (mode != WriteMode::SkipUnchanged)
+        return;
+    //!< Nodes with value callbacks of this class already report their writes, the others get a callback of their own.
+    //!< The server is called outside the dedup lock, its write callbacks take that lock
+    void *node_context = nullptr;
+    UA_Server_getNodeContext(__server, node_id, &node_context);
+    for (auto &registered : __contexts)
+        if (&registered == node_context)
+            return;
+    for (auto &source : __image_sources)
+        if (&source == node_context)
+            return;
+    UA_ValueCallback callback;
+    callback.onRead = nullptr;
+    callback.onWrite = dedupWrittenHandler;
+    auto status = UA_Server_setVariableNode_valueCallback(__server, node_id, callback);
+    if (status != UA_STATUSCODE_GOOD)
+    {
+        UA_LOG_ERROR(logger(), UA_LOGCATEGORY_SERVER, "Function setWriteMode: %s", UA_StatusCode_name(status));
+        lock_guard<mutex> lk(__dedup_mtx);
+        __dedups.find(node_id)->second.mode = WriteMode::Always;
+    }
+}
+
+UA_UInt64 Server::suppressedWrites(const UA_NodeId &node_id)
+{
+    lock_guard<mutex> lk(__dedup_mtx);
+    auto it = __dedups.find(node_id);
+    return it != __dedups.end() ? it->second.suppressed : 0;
+}
+
+UA_NodeId Server::addLatencyProbe(const UA_NodeId &parent_id)
+{
+    SERVER_INIT_ASSERT();
+    vector<Argument> inputs, outputs;
+    inputs.emplace_back("ClientSendTime", "Time when the client sends the request", &UA_TYPES[UA_TYPES_DATETIME]);
+    outputs.emplace_back("ClientSendTime", "Echo of the input", &UA_TYPES[UA_TYPES_DATETIME]);
+    outputs.emplace_back("ServerReceiveTime", "Time when the server receives the request", &UA_TYPES[UA_TYPES_DATETIME]);
+    outputs.emplace_back("ServerSendTime", "Time when the server sends the response", &UA_TYPES[UA_TYPES_DATETIME]);
+    return addMethodNode("LatencyProbe", "Echo the client timestamp with the server timestamps",
+                         latencyProbeHandler, inputs, outputs, parent_id);
+}
+
 UA_NodeId Server::createEvent(const UA_NodeId &event_type_id)
 {
     SERVER_INIT_ASSERT();
@@ -148,7 +413,7 @@ UA_NodeId Server::createEvent(const UA_NodeId &event_type_id)
     auto status = UA_Server_createEvent(__server, event_type_id, &event_id);
     if (status != UA_STATUSCODE_GOOD)
     {
-        UA_LOG_ERROR(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+        UA_LOG_ERROR(logger(), UA_LOGCATEGORY_SERVER,
                      "Function createEvent: %s", UA_StatusCode_name(status));
         return UA_NODEID_NULL;
     }
@@ -163,7 +428,7 @@ UA_Boolean Server::writeProperty(const UA_NodeId &node_id, const std::string &ta
                                                 data.get());
     if (retval != UA_STATUSCODE_GOOD)
     {
-        UA_LOG_ERROR(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+        UA_LOG_ERROR(logger(), UA_LOGCATEGORY_SERVER,
                      "Function writeProperty: %s \033[31m(qualified name: %s)\033[0m", UA_StatusCode_name(retval), target_name.c_str());
         return UA_FALSE;
     }
@@ -176,7 +441,7 @@ UA_Boolean Server::triggerEvent(const UA_NodeId &node_id, const UA_NodeId &origi
     auto retval = UA_Server_triggerEvent(__server, node_id, origin_id, nullptr, UA_TRUE);
     if (retval != UA_STATUSCODE_GOOD)
     {
-        UA_LOG_WARNING(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+        UA_LOG_WARNING(logger(), UA_LOGCATEGORY_SERVER,
                        "Triggering event failed: %s \033[31m(event id: ns=%u, s=%u)\033[0m",
                        UA_StatusCode_name(retval), node_id.namespaceIndex, node_id.identifier.numeric);
         return UA_FALSE;
@@ -191,12 +456,12 @@ Variable Server::readVariable(const UA_NodeId &node_id)
     auto status = UA_Server_readValue(__server, node_id, &val);
     if (status != UA_STATUSCODE_GOOD)
     {
-        UA_LOG_ERROR(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+        UA_LOG_ERROR(logger(), UA_LOGCATEGORY_SERVER,
                      "Function readVariable: %s", UA_StatusCode_name(status));
         return Variable();
     }
     // Variant information
-    return Variable(val.data, val.type, val.arrayLength);
+    return Variable::adopt(val);
 }
 
 void Server::addVariableNodeValueCallBack(const UA_NodeId &node_id, ValueCallBackRead before_read,
@@ -204,53 +469,109 @@ void Server::addVariableNodeValueCallBack(const UA_NodeId &node_id, ValueCallBac
 {
     SERVER_RUNNING_ASSERT();
     SERVER_INIT_ASSERT();
+    //!< The user callbacks are reached through the node context, the previous one is kept as the user context
+    void *node_context = nullptr;
+    UA_Server_getNodeContext(__server, node_id, &node_context);
+    for (auto &registered : __contexts)
+        if (&registered == node_context)
+        {
+            node_context = registered.user_context;
+            break;
+        }
+    CallbackContext context;
+    context.name = Trace::intern(browseName(__server, node_id));
+    context.before_read = before_read;
+    context.after_write = after_write;
+    context.user_context = node_context;
+    __contexts.push_back(std::move(context));
     UA_ValueCallback callback;
-    callback.onRead = before_read;
-    callback.onWrite = after_write;
-    auto status = UA_Server_setVariableNode_valueCallback(__server, node_id, callback);
+    callback.onRead = before_read != nullptr ? beforeReadHandler : nullptr;
+    //!< The write callback is always installed, it also reports the write to the write dedup
+    callback.onWrite = afterWriteHandler;
+    auto status = UA_Server_setNodeContext(__server, node_id, &__contexts.back());
+    if (status == UA_STATUSCODE_GOOD)
+        status = UA_Server_setVariableNode_valueCallback(__server, node_id, callback);
     if (status != UA_STATUSCODE_GOOD)
-        UA_LOG_ERROR(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+    {
+        //!< Hand the node back its own context
+        UA_Server_setNodeContext(__server, node_id, node_context);
+        __contexts.pop_back();
+        UA_LOG_ERROR(logger(), UA_LOGCATEGORY_SERVER,
                      "Function addVariableNodeValueCallBack: %s", UA_StatusCode_name(status));
+    }
+}
+
+UA_NodeId Server::childReferenceType(const UA_NodeId &parent_id)
+{
+    UA_NodeId objects_id = UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER);
+    return UA_NodeId_equal(&parent_id, &objects_id) ? UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES)
+                                                    : UA_NODEID_NUMERIC(0, UA_NS0ID_HASCOMPONENT);
 }
 
 UA_NodeId Server::addDataSourceVariableNode(const string &browse_name, const string &description,
                                             const Variable &data, DataSourceRead on_read,
-                                            DataSourceWrite on_write, const UA_NodeId &type_id)
+                                            DataSourceWrite on_write, const UA_NodeId &type_id,
+                                            const UA_NodeId &parent_id, void *user_context)
 {
     SERVER_INIT_ASSERT();
     auto var_attr = configVariableAttribute(browse_name, description, data);
     //!< Add the variable node to the information model
+    CallbackContext context;
+    context.name = Trace::intern(browse_name);
+    context.read = on_read;
+    context.write = on_write;
+    context.user_context = user_context;
+    __contexts.push_back(std::move(context));
     UA_DataSource data_source;
-    data_source.read = on_read;
-    data_source.write = on_write;
+    data_source.read = on_read != nullptr ? dataSourceReadHandler : nullptr;
+    data_source.write = on_write != nullptr ? dataSourceWriteHandler : nullptr;
     UA_NodeId node_id = UA_NODEID_NULL;
-    auto retval = UA_Server_addDataSourceVariableNode(__server, UA_NODEID_NULL,
-                                                      UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
-                                                      UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+    auto retval = UA_Server_addDataSourceVariableNode(__server, UA_NODEID_NULL, parent_id,
+                                                      childReferenceType(parent_id),
                                                       UA_QUALIFIEDNAME(1, to_c(browse_name)),
-                                                      type_id, var_attr, data_source, nullptr, &node_id);
+                                                      type_id, var_attr, data_source, &__contexts.back(), &node_id);
     if (retval != UA_STATUSCODE_GOOD)
     {
-        UA_LOG_ERROR(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+        UA_LOG_ERROR(logger(), UA_LOGCATEGORY_SERVER,
                      "Function addDataSourceVariableNode: %s", UA_StatusCode_name(retval));
+        __contexts.pop_back();
         return UA_NODEID_NULL;
     }
     return node_id;
 }
 
-void Server::createVariableMonitor(UA_NodeId &node_id, UA_Server_DataChangeNotificationCallback data_change,
-                                   UA_Double sampling_interval)
+UA_UInt32 Server::createVariableMonitor(UA_NodeId &node_id, UA_Server_DataChangeNotificationCallback data_change,
+                                        UA_Double sampling_interval, void *user_context)
 {
     SERVER_INIT_ASSERT();
     UA_MonitoredItemCreateRequest mon_request = UA_MonitoredItemCreateRequest_default(node_id);
     //!< Sampling interval (ms)
     mon_request.requestedParameters.samplingInterval = sampling_interval;
+    CallbackContext context;
+    context.name = Trace::intern(browseName(__server, node_id));
+    context.data_change = data_change;
+    context.user_context = user_context != nullptr ? user_context : &node_id;
+    __contexts.push_back(std::move(context));
     UA_MonitoredItemCreateResult mon_response =
         UA_Server_createDataChangeMonitoredItem(__server, UA_TIMESTAMPSTORETURN_BOTH,
-                                                mon_request, &node_id, data_change);
+                                                mon_request, &__contexts.back(), dataChangeHandler);
     if (mon_response.statusCode != UA_STATUSCODE_GOOD)
-        UA_LOG_ERROR(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+    {
+        UA_LOG_ERROR(logger(), UA_LOGCATEGORY_SERVER,
                      "Function createVariableMonitor: %s", UA_StatusCode_name(mon_response.statusCode));
+        return 0;
+    }
+    return mon_response.monitoredItemId;
+}
+
+void Server::deleteVariableMonitor(UA_UInt32 mon_id)
+{
+    if (__server == nullptr || mon_id == 0)
+        return;
+    auto status = UA_Server_deleteMonitoredItem(__server, mon_id);
+    if (status != UA_STATUSCODE_GOOD)
+        UA_LOG_WARNING(logger(), UA_LOGCATEGORY_SERVER,
+                       "Function deleteVariableMonitor: %s", UA_StatusCode_name(status));
 }
 
 UA_NodeId Server::addVariableTypeNode(const string &browse_name, const string &description,
@@ -279,7 +600,7 @@ UA_NodeId Server::addVariableTypeNode(const string &browse_name, const string &d
                                                 UA_NODEID_NULL, type_attr, nullptr, &node_id);
     if (retval != UA_STATUSCODE_GOOD)
     {
-        UA_LOG_ERROR(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+        UA_LOG_ERROR(logger(), UA_LOGCATEGORY_SERVER,
                      "Function addVariableTypeNode: %s", UA_StatusCode_name(retval));
         return UA_NODEID_NULL;
     }
@@ -301,7 +622,7 @@ UA_NodeId Server::addObjectNode(const string &browse_name, const string &descrip
                                           type_id, obj_attr, nullptr, &node_id);
     if (retval != UA_STATUSCODE_GOOD)
     {
-        UA_LOG_ERROR(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+        UA_LOG_ERROR(logger(), UA_LOGCATEGORY_SERVER,
                      "Function addObject: %s", UA_StatusCode_name(retval));
         return UA_NODEID_NULL;
     }
@@ -313,7 +634,7 @@ UA_NodeId Server::addObjectNode(const string &browse_name, const string &descrip
         auto write_static = UA_Server_writeValue(__server, var_node_id, variable.second.get());
         if (write_static != UA_STATUSCODE_GOOD)
         {
-            UA_LOG_ERROR(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+            UA_LOG_ERROR(logger(), UA_LOGCATEGORY_SERVER,
                          "Function addObject, write variable: %s", UA_StatusCode_name(retval));
             return UA_NODEID_NULL;
         }
@@ -336,7 +657,7 @@ UA_NodeId Server::addObjectTypeNode(const string &browse_name, const string &des
                                               obj_attr, nullptr, &node_id);
     if (retval != UA_STATUSCODE_GOOD)
     {
-        UA_LOG_ERROR(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+        UA_LOG_ERROR(logger(), UA_LOGCATEGORY_SERVER,
                      "Function addObjectType: %s", UA_StatusCode_name(retval));
         return UA_NODEID_NULL;
     }
@@ -353,7 +674,7 @@ UA_NodeId Server::addObjectTypeNode(const string &browse_name, const string &des
                                            variable.first, attr, nullptr, &var_node_id);
         if (retval != UA_STATUSCODE_GOOD)
         {
-            UA_LOG_ERROR(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+            UA_LOG_ERROR(logger(), UA_LOGCATEGORY_SERVER,
                          "addObjectTypeNode->addVariableNode: %s\033[31m(name = %s)\033[0m",
                          UA_StatusCode_name(retval), name.c_str());
             return UA_NODEID_NULL;
@@ -363,7 +684,7 @@ UA_NodeId Server::addObjectTypeNode(const string &browse_name, const string &des
                                         UA_EXPANDEDNODEID_NUMERIC(0, UA_NS0ID_MODELLINGRULE_MANDATORY), true);
         if (retval != UA_STATUSCODE_GOOD)
         {
-            UA_LOG_ERROR(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+            UA_LOG_ERROR(logger(), UA_LOGCATEGORY_SERVER,
                          "addObjectTypeNode->addReference: %s", UA_StatusCode_name(retval));
             return UA_NODEID_NULL;
         }
@@ -386,7 +707,7 @@ UA_NodeId Server::addEventTypeNode(const string &browse_name, const string &desc
                                               attr, nullptr, &event_type_node_id);
     if (retval != UA_STATUSCODE_GOOD)
     {
-        UA_LOG_ERROR(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+        UA_LOG_ERROR(logger(), UA_LOGCATEGORY_SERVER,
                      "Function addEventType: %s", UA_StatusCode_name(retval));
         return UA_NODEID_NULL;
     }
@@ -408,7 +729,7 @@ UA_NodeId Server::addEventTypeNode(const string &browse_name, const string &desc
                                            attr, nullptr, &var_node_id);
         if (retval != UA_STATUSCODE_GOOD)
         {
-            UA_LOG_ERROR(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+            UA_LOG_ERROR(logger(), UA_LOGCATEGORY_SERVER,
                          "Function addEventType, add variable: %s", UA_StatusCode_name(retval));
             return UA_NODEID_NULL;
         }
@@ -418,7 +739,7 @@ UA_NodeId Server::addEventTypeNode(const string &browse_name, const string &desc
                                         UA_EXPANDEDNODEID_NUMERIC(0, UA_NS0ID_MODELLINGRULE_MANDATORY), true);
         if (retval != UA_STATUSCODE_GOOD)
         {
-            UA_LOG_ERROR(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+            UA_LOG_ERROR(logger(), UA_LOGCATEGORY_SERVER,
                          "AddEventTypeVariable: %s", UA_StatusCode_name(retval));
             return UA_NODEID_NULL;
         }
@@ -428,7 +749,7 @@ UA_NodeId Server::addEventTypeNode(const string &browse_name, const string &desc
 
 UA_NodeId Server::addMethodNode(const string &browse_name, const string &description, UA_MethodCallback on_method,
                                 const vector<Argument> &input_args, const vector<Argument> &output_args,
-                                const UA_NodeId &parent_id)
+                                const UA_NodeId &parent_id, void *user_context)
 {
     SERVER_INIT_ASSERT();
     UA_MethodAttributes method_attr = UA_MethodAttributes_default;
@@ -445,16 +766,21 @@ UA_NodeId Server::addMethodNode(const string &browse_name, const string &descrip
     outputs.reserve(output_args.size());
     for (auto &outputArg : output_args)
         outputs.emplace_back(outputArg.get());
-    //!< Add method node
+    //!< Add method node, the user callback is reached through the method context
+    CallbackContext context;
+    context.name = Trace::intern(browse_name);
+    context.method = on_method;
+    context.user_context = user_context;
+    __contexts.push_back(std::move(context));
     UA_NodeId node_id = UA_NODEID_NULL;
     auto retval = UA_Server_addMethodNode(__server, UA_NODEID_NULL, parent_id,
                                           UA_NODEID_NUMERIC(0, UA_NS0ID_HASCOMPONENT),
                                           UA_QUALIFIEDNAME(1, to_c(browse_name)),
-                                          method_attr, on_method, input_args.size(), inputs.data(),
-                                          output_args.size(), outputs.data(), nullptr, &node_id);
+                                          method_attr, methodHandler, input_args.size(), inputs.data(),
+                                          output_args.size(), outputs.data(), &__contexts.back(), &node_id);
     if (retval != UA_STATUSCODE_GOOD)
     {
-        UA_LOG_ERROR(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+        UA_LOG_ERROR(logger(), UA_LOGCATEGORY_SERVER,
                      "Function addMethod: %s", UA_StatusCode_name(retval));
         return UA_NODEID_NULL;
     }
@@ -464,9 +790,83 @@ UA_NodeId Server::addMethodNode(const string &browse_name, const string &descrip
                                     UA_EXPANDEDNODEID_NUMERIC(0, UA_NS0ID_MODELLINGRULE_MANDATORY), true);
     if (retval != UA_STATUSCODE_GOOD)
     {
-        UA_LOG_ERROR(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+        UA_LOG_ERROR(logger(), UA_LOGCATEGORY_SERVER,
                      "AddEventTypeVariable: %s", UA_StatusCode_name(retval));
         return UA_NODEID_NULL;
     }
     return node_id;
 }
+
+UA_StatusCode Server::methodHandler(UA_Server *server, const UA_NodeId *session_id, void *session_context,
+                                    const UA_NodeId *method_id, void *method_context, const UA_NodeId *object_id,
+                                    void *object_context, size_t input_size, const UA_Variant *input,
+                                    size_t output_size, UA_Variant *output)
+{
+    auto context = static_cast<CallbackContext *>(method_context);
+    TraceSpan span(context->name, "method");
+    return context->method(server, session_id, session_context, method_id, context->user_context, object_id,
+                           object_context, input_size, input, output_size, output);
+}
+
+void Server::beforeReadHandler(UA_Server *server, const UA_NodeId *session_id, void *session_context,
+                               const UA_NodeId *node_id, void *node_context, const UA_NumericRange *range,
+                               const UA_DataValue *value)
+{
+    auto context = static_cast<CallbackContext *>(node_context);
+    TraceSpan span(context->name, "value.read");
+    context->before_read(server, session_id, session_context, node_id, context->user_context, range, value);
+}
+
+void Server::afterWriteHandler(UA_Server *server, const UA_NodeId *session_id, void *session_context,
+                               const UA_NodeId *node_id, void *node_context, const UA_NumericRange *range,
+                               const UA_DataValue *value)
+{
+    invalidateDedup(*node_id);
+    auto context = static_cast<CallbackContext *>(node_context);
+    if (context->after_write == nullptr)
+        return;
+    TraceSpan span(context->name, "value.write");
+    context->after_write(server, session_id, session_context, node_id, context->user_context, range, value);
+}
+
+UA_StatusCode Server::dataSourceReadHandler(UA_Server *server, const UA_NodeId *session_id, void *session_context,
+                                            const UA_NodeId *node_id, void *node_context, UA_Boolean source_timestamp,
+                                            const UA_NumericRange *range, UA_DataValue *value)
+{
+    auto context = static_cast<CallbackContext *>(node_context);
+    TraceSpan span(context->name, "datasource.read");
+    return context->read(server, session_id, session_context, node_id, context->user_context, source_timestamp,
+                         range, value);
+}
+
+UA_StatusCode Server::dataSourceWriteHandler(UA_Server *server, const UA_NodeId *session_id, void *session_context,
+                                             const UA_NodeId *node_id, void *node_context,
+                                             const UA_NumericRange *range, const UA_DataValue *value)
+{
+    auto context = static_cast<CallbackContext *>(node_context);
+    TraceSpan span(context->name, "datasource.write");
+    return context->write(server, session_id, session_context, node_id, context->user_context, range, value);
+}
+
+void Server::dataChangeHandler(UA_Server *server, UA_UInt32 mon_id, void *mon_context, const UA_NodeId *node_id,
+                               void *node_context, UA_UInt32 attribute_id, const UA_DataValue *value)
+{
+    auto context = static_cast<CallbackContext *>(mon_context);
+    TraceSpan span(context->name, "monitor");
+    context->data_change(server, mon_id, context->user_context, node_id, node_context, attribute_id, value);
+}
+
+UA_StatusCode Server::latencyProbeHandler(UA_Server *server, const UA_NodeId *session_id, void *session_context,
+                                          const UA_NodeId *method_id, void *method_context,
+                                          const UA_NodeId *object_id, void *object_context, size_t input_size,
+                                          const UA_Variant *input, size_t output_size, UA_Variant *output)
+{
+    UA_DateTime received = UA_DateTime_now();
+    if (input_size < 1 || output_size < 3 || !UA_Variant_hasScalarType(&input[0], &UA_TYPES[UA_TYPES_DATETIME]))
+        return UA_STATUSCODE_BADINVALIDARGUMENT;
+    UA_Variant_setScalarCopy(&output[0], input[0].data, &UA_TYPES[UA_TYPES_DATETIME]);
+    UA_Variant_setScalarCopy(&output[1], &received, &UA_TYPES[UA_TYPES_DATETIME]);
+    UA_DateTime sent = UA_DateTime_now();
+    UA_Variant_setScalarCopy(&output[2], &sent, &UA_TYPES[UA_TYPES_DATETIME]);
+    return UA_STATUSCODE_GOOD;
+}
@@ -0,0 +1,160 @@
+/**
+ * @file server_history.cpp
+ * @author 赵曦 (535394140@qq.com)
+ * @brief History database backend serving HistoryReadRawModified from per-node history buffers
+ * @version 1.0
+ * @date 2023-03-22
+ *
+ * @copyright Copyright (c) 2023, zhaoxi
+ *
+ */
+
+#include <cstring>
+
+#include "asmpro/opcua_cs/server.hpp"
+
+using namespace std;
+using namespace ua;
+
+namespace
+{
+
+//! 单次 HistoryRead 中每个节点最多返回的样本数，客户端未限制或限制更大时以续读点分块返回
+constexpr size_t max_history_values = 10000;
+
+//! 按请求的时间戳类型去除数据值中不需要的时间戳
+void filterTimestamps(UA_DataValue &value, UA_TimestampsToReturn timestamps)
+{
+    if (timestamps == UA_TIMESTAMPSTORETURN_SERVER || timestamps == UA_TIMESTAMPSTORETURN_NEITHER)
+        value.hasSourceTimestamp = false, value.hasSourcePicoseconds = false;
+    if (timestamps == UA_TIMESTAMPSTORETURN_SOURCE || timestamps == UA_TIMESTAMPSTORETURN_NEITHER)
+        value.hasServerTimestamp = false, value.hasServerPicoseconds = false;
+}
+
+} // namespace
+
+UA_Boolean Server::enableHistory(const UA_NodeId &node_id, const HistoryOptions &options)
+{
+    SERVER_RUNNING_ASSERT();
+    SERVER_INIT_ASSERT();
+#ifdef UA_ENABLE_HISTORIZING
+    if (__histories.find(node_id) != __histories.end())
+        return UA_TRUE;
+    UA_Byte access_level = 0;
+    auto status = UA_Server_readAccessLevel(__server, node_id, &access_level);
+    if (status == UA_STATUSCODE_GOOD)
+        status = UA_Server_writeAccessLevel(__server, node_id, access_level | UA_ACCESSLEVELMASK_HISTORYREAD);
+    if (status == UA_STATUSCODE_GOOD)
+        status = UA_Server_writeHistorizing(__server, node_id, true);
+    if (status != UA_STATUSCODE_GOOD)
+    {
+        UA_LOG_ERROR(logger(), UA_LOGCATEGORY_SERVER, "Function enableHistory: %s", UA_StatusCode_name(status));
+        return UA_FALSE;
+    }
+    UA_ServerConfig *config = UA_Server_getConfig(__server);
+    if (config->historyDatabase.readRaw != historyReadRawHandler)
+    {
+        //!< The store is owned by the Server, the database itself carries no state
+        if (config->historyDatabase.clear != nullptr)
+            config->historyDatabase.clear(&config->historyDatabase);
+        memset(&config->historyDatabase, 0, sizeof(UA_HistoryDatabase));
+        config->historyDatabase.setValue = historySetValueHandler;
+        config->historyDatabase.readRaw = historyReadRawHandler;
+        config->accessHistoryDataCapability = true;
+        config->maxReturnDataValues = max_history_values;
+    }
+    UA_NodeId key;
+    UA_NodeId_copy(&node_id, &key);
+    auto &history = *__histories.emplace(key, make_unique<HistoryBuffer>(options)).first->second;
+    if (options.segment_size > 0 && !history.spilling())
+        UA_LOG_WARNING(logger(), UA_LOGCATEGORY_SERVER,
+                       "Function enableHistory: failed to map the spill segments in \"%s\", "
+                       "only the in-memory ring is used",
+                       options.directory.c_str());
+
+    //!< The current value is the first sample
+    UA_ReadValueId rvi;
+    UA_ReadValueId_init(&rvi);
+    rvi.nodeId = node_id;
+    rvi.attributeId = UA_ATTRIBUTEID_VALUE;
+    UA_DataValue value = UA_Server_read(__server, &rvi, UA_TIMESTAMPSTORETURN_BOTH);
+    if (value.hasValue)
+        history.append(value);
+    UA_DataValue_clear(&value);
+    return UA_TRUE;
+#else
+    UA_LOG_ERROR(logger(), UA_LOGCATEGORY_SERVER,
+                 "Function enableHistory: open62541 is built without UA_ENABLE_HISTORIZING");
+    return UA_FALSE;
+#endif
+}
+
+void Server::historySetValueHandler(UA_Server *, void *, const UA_NodeId *, void *, const UA_NodeId *node_id,
+                                    UA_Boolean historizing, const UA_DataValue *value)
+{
+    if (!historizing)
+        return;
+    auto it = __histories.find(*node_id);
+    if (it != __histories.end())
+        it->second->append(*value);
+}
+
+void Server::historyReadRawHandler(UA_Server *, void *, const UA_NodeId *, void *, const UA_RequestHeader *,
+                                   const UA_ReadRawModifiedDetails *details, UA_TimestampsToReturn timestamps,
+                                   UA_Boolean release, size_t nodes_size, const UA_HistoryReadValueId *nodes,
+                                   UA_HistoryReadResponse *response, UA_HistoryData *const *const history_data)
+{
+    response->responseHeader.serviceResult = UA_STATUSCODE_GOOD;
+    vector<UA_DataValue> values;
+    for (size_t i = 0; i < nodes_size; ++i)
+    {
+        UA_HistoryReadResult &result = response->results[i];
+        //!< Continuation points keep no state in the server, nothing to release
+        if (release)
+        {
+            result.statusCode = UA_STATUSCODE_GOOD;
+            continue;
+        }
+        auto it = __histories.find(nodes[i].nodeId);
+        if (it == __histories.end() || details->isReadModified || details->returnBounds)
+        {
+            result.statusCode = UA_STATUSCODE_BADHISTORYOPERATIONUNSUPPORTED;
+            continue;
+        }
+        UA_UInt64 from = 0;
+        const UA_ByteString &cp = nodes[i].continuationPoint;
+        if (cp.length == sizeof(from))
+            memcpy(&from, cp.data, sizeof(from));
+        else if (cp.length != 0)
+        {
+            result.statusCode = UA_STATUSCODE_BADCONTINUATIONPOINTINVALID;
+            continue;
+        }
+        size_t max_values = details->numValuesPerNode == 0
+                                ? max_history_values
+                                : min<size_t>(details->numValuesPerNode, max_history_values);
+        values.clear();
+        UA_UInt64 next = it->second->read(details->startTime, details->endTime, max_values, from, values);
+
+        //!< The DataValues are moved into the response array, only the array itself is allocated here
+        UA_HistoryData *data = history_data[i];
+        if (!values.empty())
+        {
+            data->dataValues = static_cast<UA_DataValue *>(UA_Array_new(values.size(), &UA_TYPES[UA_TYPES_DATAVALUE]));
+            if (data->dataValues == nullptr)
+            {
+                for (auto &value : values)
+                    UA_DataValue_clear(&value);
+                result.statusCode = UA_STATUSCODE_BADOUTOFMEMORY;
+                continue;
+            }
+            for (auto &value : values)
+                filterTimestamps(value, timestamps);
+            memcpy(data->dataValues, values.data(), values.size() * sizeof(UA_DataValue));
+            data->dataValuesSize = values.size();
+        }
+        if (next != 0 && UA_ByteString_allocBuffer(&result.continuationPoint, sizeof(next)) == UA_STATUSCODE_GOOD)
+            memcpy(result.continuationPoint.data, &next, sizeof(next));
+        result.statusCode = values.empty() && next == 0 ? UA_STATUSCODE_GOODNODATA : UA_STATUSCODE_GOOD;
+    }
+}
@@ -0,0 +1,335 @@
+/**
+ * @file server_image.cpp
+ * @author 赵曦 (535394140@qq.com)
+ * @brief Preview, compressed and delta companion variables and shared memory channels of image variables
+ * @version 1.0
+ * @date 2023-03-19
+ *
+ * @copyright Copyright (c) 2023, zhaoxi
+ *
+ */
+
+#include "asmpro/opcua_cs/compression.hpp"
+#include "asmpro/opcua_cs/server.hpp"
+#include "asmpro/opcua_cs/trace.hpp"
+
+using namespace std;
+using namespace ua;
+
+Server::ImageSource *Server::watchImage(const UA_NodeId &image_id)
+{
+    //!< Previews and channels of the same image share one source and one value callback
+    for (auto &each : __image_sources)
+        if (UA_NodeId_equal(&each.image_id, &image_id))
+            return &each;
+    __image_sources.emplace_back();
+    ImageSource *source = &__image_sources.back();
+    UA_NodeId_copy(&image_id, &source->image_id);
+    void *node_context = nullptr;
+    UA_Server_getNodeContext(__server, image_id, &node_context);
+    UA_ValueCallback callback;
+    callback.onRead = nullptr;
+    callback.onWrite = imageWrittenHandler;
+    auto status = UA_Server_setNodeContext(__server, image_id, source);
+    if (status == UA_STATUSCODE_GOOD)
+        status = UA_Server_setVariableNode_valueCallback(__server, image_id, callback);
+    if (status != UA_STATUSCODE_GOOD)
+    {
+        //!< The source is about to be destroyed, the node must not keep pointing at it
+        UA_Server_setNodeContext(__server, image_id, node_context);
+        UA_LOG_ERROR(logger(), UA_LOGCATEGORY_SERVER, "Function watchImage: %s", UA_StatusCode_name(status));
+        UA_NodeId_clear(&source->image_id);
+        __image_sources.pop_back();
+        return nullptr;
+    }
+    return source;
+}
+
+UA_NodeId Server::addImagePreview(const string &browse_name, const string &description, const UA_NodeId &image_id,
+                                  const ImagePreview &preview, const UA_NodeId &parent_id)
+{
+    SERVER_RUNNING_ASSERT();
+    SERVER_INIT_ASSERT();
+    if (!preview.valid())
+    {
+        UA_LOG_ERROR(logger(), UA_LOGCATEGORY_SERVER,
+                     "Function addImagePreview: invalid preview \033[31m(name = %s)\033[0m", browse_name.c_str());
+        return UA_NODEID_NULL;
+    }
+    ImageSource *source = watchImage(image_id);
+    if (source == nullptr)
+        return UA_NODEID_NULL;
+    PreviewContext context;
+    context.source = source;
+    context.preview = preview;
+    context.data.resize(preview.outSize());
+    __previews.push_back(std::move(context));
+    //!< The initial value only declares the data type and the length of the preview
+    Variable data(__previews.back().data.data(), &UA_TYPES[UA_TYPES_BYTE], __previews.back().data.size());
+    auto var_attr = configVariableAttribute(browse_name, description, data);
+    var_attr.accessLevel = UA_ACCESSLEVELMASK_READ;
+    UA_DataSource data_source;
+    data_source.read = previewReadHandler;
+    data_source.write = nullptr;
+    UA_NodeId node_id = UA_NODEID_NULL;
+    auto retval = UA_Server_addDataSourceVariableNode(__server, UA_NODEID_NULL, parent_id,
+                                                      childReferenceType(parent_id),
+                                                      UA_QUALIFIEDNAME(1, to_c(browse_name)),
+                                                      UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATAVARIABLETYPE), var_attr,
+                                                      data_source, &__previews.back(), &node_id);
+    if (retval != UA_STATUSCODE_GOOD)
+    {
+        UA_LOG_ERROR(logger(), UA_LOGCATEGORY_SERVER,
+                     "Function addImagePreview: %s", UA_StatusCode_name(retval));
+        __previews.pop_back();
+        return UA_NODEID_NULL;
+    }
+    return node_id;
+}
+
+UA_Boolean Server::addSharedMemoryChannel(const UA_NodeId &image_id, const string &name, size_t slot_size,
+                                         size_t slot_count, mode_t mode)
+{
+    SERVER_RUNNING_ASSERT();
+    SERVER_INIT_ASSERT();
+    if (slot_size == 0)
+    {
+        //!< Size the slots by the current value of the image
+        Variable current = readVariable(image_id);
+        const UA_Variant &val = current.get();
+        if (UA_Variant_hasScalarType(&val, &UA_TYPES[UA_TYPES_BYTESTRING]))
+            slot_size = static_cast<const UA_ByteString *>(val.data)->length;
+        else if (!UA_Variant_isEmpty(&val))
+            slot_size = (UA_Variant_isScalar(&val) ? 1 : val.arrayLength) * val.type->memSize;
+    }
+    ImageSource *source = watchImage(image_id);
+    if (source == nullptr)
+        return UA_FALSE;
+    auto channel = make_unique<ShmWriter>(name, slot_size, slot_count, mode);
+    if (!channel->isOpen())
+    {
+        UA_LOG_ERROR(logger(), UA_LOGCATEGORY_SERVER,
+                     "Function addSharedMemoryChannel: failed to create \033[31m%s\033[0m", name.c_str());
+        return UA_FALSE;
+    }
+    //!< Clients on the same host discover the channel through the SharedMemory property of the image
+    if (!addStringProperty(image_id, "SharedMemory", channel->name()))
+        return UA_FALSE;
+    source->channel = std::move(channel);
+    return UA_TRUE;
+}
+
+UA_NodeId Server::addCompressedVariable(const string &browse_name, const string &description,
+                                        const UA_NodeId &source_id, const Compression &options,
+                                        const UA_NodeId &parent_id)
+{
+    SERVER_RUNNING_ASSERT();
+    SERVER_INIT_ASSERT();
+    ImageSource *source = watchImage(source_id);
+    if (source == nullptr)
+        return UA_NODEID_NULL;
+    CompressedContext context;
+    context.source = source;
+    context.options = options;
+    __compressed.push_back(std::move(context));
+    UA_ByteString empty{0, nullptr};
+    Variable data(&empty, &UA_TYPES[UA_TYPES_BYTESTRING]);
+    auto var_attr = configVariableAttribute(browse_name, description, data);
+    var_attr.accessLevel = UA_ACCESSLEVELMASK_READ;
+    UA_DataSource data_source;
+    data_source.read = compressedReadHandler;
+    data_source.write = nullptr;
+    UA_NodeId node_id = UA_NODEID_NULL;
+    auto retval = UA_Server_addDataSourceVariableNode(__server, UA_NODEID_NULL, parent_id,
+                                                      childReferenceType(parent_id),
+                                                      UA_QUALIFIEDNAME(1, to_c(browse_name)),
+                                                      UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATAVARIABLETYPE), var_attr,
+                                                      data_source, &__compressed.back(), &node_id);
+    if (retval != UA_STATUSCODE_GOOD)
+    {
+        UA_LOG_ERROR(logger(), UA_LOGCATEGORY_SERVER,
+                     "Function addCompressedVariable: %s", UA_StatusCode_name(retval));
+        __compressed.pop_back();
+        return UA_NODEID_NULL;
+    }
+    //!< Clients only decode the values of nodes carrying a Codec property that matches the header,
+    //!< a node without it would be served as opaque bytes, so it is removed again
+    if (!addStringProperty(node_id, "Codec", options.describe()))
+    {
+        UA_Server_deleteNode(__server, node_id, UA_TRUE);
+        UA_NodeId_clear(&node_id);
+        __compressed.pop_back();
+        return UA_NODEID_NULL;
+    }
+    return node_id;
+}
+
+UA_NodeId Server::addDeltaVariable(const string &browse_name, const string &description, const UA_NodeId &source_id,
+                                   const DeltaOptions &options, const UA_NodeId &parent_id)
+{
+    SERVER_RUNNING_ASSERT();
+    SERVER_INIT_ASSERT();
+    ImageSource *source = watchImage(source_id);
+    if (source == nullptr)
+        return UA_NODEID_NULL;
+    UA_ByteString empty{0, nullptr};
+    Variable data(&empty, &UA_TYPES[UA_TYPES_BYTESTRING]);
+    auto var_attr = configVariableAttribute(browse_name, description, data);
+    var_attr.accessLevel = UA_ACCESSLEVELMASK_READ;
+    UA_NodeId node_id = UA_NODEID_NULL;
+    auto retval = UA_Server_addVariableNode(__server, UA_NODEID_NULL, parent_id, childReferenceType(parent_id),
+                                            UA_QUALIFIEDNAME(1, to_c(browse_name)),
+                                            UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATAVARIABLETYPE), var_attr, nullptr,
+                                            &node_id);
+    if (retval != UA_STATUSCODE_GOOD)
+    {
+        UA_LOG_ERROR(logger(), UA_LOGCATEGORY_SERVER,
+                     "Function addDeltaVariable: %s", UA_StatusCode_name(retval));
+        return UA_NODEID_NULL;
+    }
+    __deltas.emplace_back();
+    DeltaContext &context = __deltas.back();
+    UA_NodeId_copy(&node_id, &context.node_id);
+    context.encoder = DeltaEncoder(options);
+    source->deltas.push_back(&context);
+    return node_id;
+}
+
+UA_Boolean Server::addStringProperty(const UA_NodeId &node_id, const string &name, const string &value)
+{
+    UA_VariableAttributes attr = UA_VariableAttributes_default;
+    UA_String str = UA_STRING(to_c(value));
+    UA_Variant_setScalar(&attr.value, &str, &UA_TYPES[UA_TYPES_STRING]);
+    attr.dataType = UA_TYPES[UA_TYPES_STRING].typeId;
+    attr.displayName = UA_LOCALIZEDTEXT(en_US, to_c(name));
+    attr.accessLevel = UA_ACCESSLEVELMASK_READ;
+    auto status = UA_Server_addVariableNode(__server, UA_NODEID_NULL, node_id,
+                                            UA_NODEID_NUMERIC(0, UA_NS0ID_HASPROPERTY),
+                                            UA_QUALIFIEDNAME(1, to_c(name)),
+                                            UA_NODEID_NUMERIC(0, UA_NS0ID_PROPERTYTYPE), attr, nullptr, nullptr);
+    if (status != UA_STATUSCODE_GOOD)
+    {
+        UA_LOG_ERROR(logger(), UA_LOGCATEGORY_SERVER,
+                     "Function addStringProperty: %s \033[31m(name = %s)\033[0m", UA_StatusCode_name(status),
+                     name.c_str());
+        return UA_FALSE;
+    }
+    return UA_TRUE;
+}
+
+const UA_DataValue &Server::refreshSnapshot(UA_Server *server, ImageSource *source)
+{
+    //!< Copy the source at most once per frame for all of its previews and compressed variables
+    if (source->snapshot_version != source->version)
+    {
+        UA_DataValue_clear(&source->snapshot);
+        UA_ReadValueId rvi;
+        UA_ReadValueId_init(&rvi);
+        rvi.nodeId = source->image_id;
+        rvi.attributeId = UA_ATTRIBUTEID_VALUE;
+        source->snapshot = UA_Server_read(server, &rvi, UA_TIMESTAMPSTORETURN_SOURCE);
+        source->snapshot_version = source->version;
+    }
+    return source->snapshot;
+}
+
+void Server::imageWrittenHandler(UA_Server *server, const UA_NodeId *session_id, void *session_context,
+                                 const UA_NodeId *node_id, void *node_context, const UA_NumericRange *range,
+                                 const UA_DataValue *value)
+{
+    invalidateDedup(*node_id);
+    //!< Only mark the new frame, the previews are generated when they are read
+    auto source = static_cast<ImageSource *>(node_context);
+    ++source->version;
+    UA_DateTime timestamp = value->hasSourceTimestamp ? value->sourceTimestamp : UA_DateTime_now();
+    if (source->channel != nullptr)
+        source->channel->publish(value->value, timestamp);
+    //!< Deltas are relative to the previous write, so they are encoded eagerly on every write
+    for (DeltaContext *delta : source->deltas)
+    {
+        TraceSpan span("FrameDelta", "delta");
+        if (!delta->encoder.encode(value->value, delta->data))
+            continue;
+        UA_ByteString str{delta->data.size(), delta->data.data()};
+        UA_DataValue delta_value;
+        UA_DataValue_init(&delta_value);
+        UA_Variant_setScalar(&delta_value.value, &str, &UA_TYPES[UA_TYPES_BYTESTRING]);
+        delta_value.hasValue = true;
+        delta_value.sourceTimestamp = timestamp;
+        delta_value.hasSourceTimestamp = true;
+        UA_Server_writeDataValue(server, delta->node_id, delta_value);
+    }
+}
+
+UA_StatusCode Server::previewReadHandler(UA_Server *server, const UA_NodeId *session_id, void *session_context,
+                                         const UA_NodeId *node_id, void *node_context, UA_Boolean source_timestamp,
+                                         const UA_NumericRange *range, UA_DataValue *value)
+{
+    auto context = static_cast<PreviewContext *>(node_context);
+    ImageSource *source = context->source;
+    if (context->version != source->version)
+    {
+        TraceSpan span("ImagePreview", "preview");
+        const UA_DataValue &snapshot = refreshSnapshot(server, source);
+        const UA_Variant &image = snapshot.value;
+        const ImagePreview &preview = context->preview;
+        const UA_Byte *pixels = nullptr;
+        ImageHeader header;
+        if (!snapshot.hasValue)
+            return UA_STATUSCODE_BADTYPEMISMATCH;
+        if (decodeImage(image, header, pixels))
+        {
+            //!< Image values with a header must match the source geometry of the preview and be tightly packed
+            if (header.width != preview.src_width || header.height != preview.src_height ||
+                header.channels != preview.src_channels || header.channelSize() != 1 ||
+                header.stride != header.rowSize())
+                return UA_STATUSCODE_BADTYPEMISMATCH;
+        }
+        else if (image.type == &UA_TYPES[UA_TYPES_BYTE] && image.arrayLength == preview.srcSize())
+            pixels = static_cast<const UA_Byte *>(image.data);
+        else
+            return UA_STATUSCODE_BADTYPEMISMATCH;
+        makePreview(pixels, preview, context->data.data(), context->buffer);
+        context->source_timestamp = snapshot.hasSourceTimestamp ? snapshot.sourceTimestamp : UA_DateTime_now();
+        context->version = source->version;
+    }
+    auto status = UA_Variant_setArrayCopy(&value->value, context->data.data(), context->data.size(),
+                                          &UA_TYPES[UA_TYPES_BYTE]);
+    if (status != UA_STATUSCODE_GOOD)
+        return status;
+    value->hasValue = true;
+    if (source_timestamp)
+    {
+        value->sourceTimestamp = context->source_timestamp;
+        value->hasSourceTimestamp = true;
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+UA_StatusCode Server::compressedReadHandler(UA_Server *server, const UA_NodeId *session_id, void *session_context,
+                                            const UA_NodeId *node_id, void *node_context, UA_Boolean source_timestamp,
+                                            const UA_NumericRange *range, UA_DataValue *value)
+{
+    auto context = static_cast<CompressedContext *>(node_context);
+    ImageSource *source = context->source;
+    if (context->version != source->version)
+    {
+        TraceSpan span("Compression", "compress");
+        const UA_DataValue &snapshot = refreshSnapshot(server, source);
+        if (!snapshot.hasValue || !compressValue(snapshot.value, context->options, context->data, context->scratch))
+            return UA_STATUSCODE_BADTYPEMISMATCH;
+        context->source_timestamp = snapshot.hasSourceTimestamp ? snapshot.sourceTimestamp : UA_DateTime_now();
+        context->version = source->version;
+    }
+    UA_ByteString str{context->data.size(), context->data.data()};
+    auto status = UA_Variant_setScalarCopy(&value->value, &str, &UA_TYPES[UA_TYPES_BYTESTRING]);
+    if (status != UA_STATUSCODE_GOOD)
+        return status;
+    value->hasValue = true;
+    if (source_timestamp)
+    {
+        value->sourceTimestamp = context->source_timestamp;
+        value->hasSourceTimestamp = true;
+    }
+    return UA_STATUSCODE_GOOD;
+}
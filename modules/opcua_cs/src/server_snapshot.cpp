@@ -0,0 +1,508 @@
+/**
+ * @file server_snapshot.cpp
+ * @author 赵曦 (535394140@qq.com)
+ * @brief Binary snapshot of the user address space and its fast restore
+ * @version 1.0
+ * @date 2023-03-16
+ *
+ * @copyright Copyright (c) 2023, zhaoxi
+ *
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "asmpro/opcua_cs/server.hpp"
+#include "asmpro/opcua_cs/trace.hpp"
+
+using namespace std;
+using namespace ua;
+
+namespace
+{
+
+//! 快照文件魔数，末尾两位为格式版本
+constexpr char snapshot_magic[8] = {'U', 'A', 'S', 'N', 'A', 'P', '0', '1'};
+
+//! 单个 AddNodesItem 编码后的最小字节数，用于在分配之前校验节点数
+constexpr size_t min_item_size = 21;
+
+//! 快照中的节点
+struct SnapshotNode
+{
+    UA_NodeId id;                //!< 节点 ID
+    UA_NodeClass node_class;     //!< 节点类别
+    UA_NodeId parent_id;         //!< 父节点 ID
+    UA_NodeId reference_type_id; //!< 父节点指向该节点的层级引用类型
+    UA_NodeId type_id;           //!< 类型定义，仅对象与变量有效
+};
+
+void collectNode(void *context, const UA_Node *node)
+{
+    //!< Namespace 0 is rebuilt by UA_Server_new itself
+    if (node->head.nodeId.namespaceIndex == 0)
+        return;
+    auto nodes = static_cast<vector<SnapshotNode> *>(context);
+    nodes->emplace_back();
+    UA_NodeId_copy(&node->head.nodeId, &nodes->back().id);
+    nodes->back().node_class = node->head.nodeClass;
+}
+
+/**
+ * @brief 从指向节点的层级引用中找出创建节点时使用的父引用
+ * @note 类型节点取 HasSubtype，其余节点依次取 HasComponent、HasProperty、HasOrderedComponent 与 Organizes，
+ *       HasEventSource、HasNotifier 等同属层级引用的其余引用不能作为父引用
+ *
+ * @param br 反向浏览层级引用的结果
+ * @param node_class 节点类别
+ * @return 父引用，不存在时返回 nullptr
+ */
+const UA_ReferenceDescription *findParentReference(const UA_BrowseResult &br, UA_NodeClass node_class)
+{
+    static const vector<UA_UInt32> type_refs = {UA_NS0ID_HASSUBTYPE};
+    static const vector<UA_UInt32> instance_refs = {UA_NS0ID_HASCOMPONENT, UA_NS0ID_HASPROPERTY,
+                                                    UA_NS0ID_HASORDEREDCOMPONENT, UA_NS0ID_ORGANIZES};
+    bool is_type = node_class == UA_NODECLASS_OBJECTTYPE || node_class == UA_NODECLASS_VARIABLETYPE ||
+                   node_class == UA_NODECLASS_REFERENCETYPE || node_class == UA_NODECLASS_DATATYPE;
+    for (UA_UInt32 ref_type : is_type ? type_refs : instance_refs)
+    {
+        UA_NodeId ref_type_id = UA_NODEID_NUMERIC(0, ref_type);
+        for (size_t i = 0; i < br.referencesSize; ++i)
+            if (!br.references[i].isForward && UA_NodeId_equal(&br.references[i].referenceTypeId, &ref_type_id))
+                return &br.references[i];
+    }
+    return nullptr;
+}
+
+UA_BrowseResult browseReferences(UA_Server *server, const UA_NodeId &node_id,
+                                 UA_BrowseDirection direction, const UA_NodeId &reference_type_id)
+{
+    UA_BrowseDescription bd;
+    UA_BrowseDescription_init(&bd);
+    bd.nodeId = node_id;
+    bd.browseDirection = direction;
+    bd.referenceTypeId = reference_type_id;
+    bd.includeSubtypes = true;
+    bd.resultMask = UA_BROWSERESULTMASK_REFERENCETYPEID | UA_BROWSERESULTMASK_ISFORWARD;
+    return UA_Server_browse(server, 0, &bd);
+}
+
+void readArrayDimensions(UA_Server *server, const UA_NodeId &node_id,
+                         size_t &dimensions_size, UA_UInt32 *&dimensions)
+{
+    UA_Variant val;
+    UA_Variant_init(&val);
+    UA_Server_readArrayDimensions(server, node_id, &val);
+    if (val.type == &UA_TYPES[UA_TYPES_UINT32] && val.arrayLength > 0)
+    {
+        UA_Array_copy(val.data, val.arrayLength, reinterpret_cast<void **>(&dimensions), &UA_TYPES[UA_TYPES_UINT32]);
+        dimensions_size = val.arrayLength;
+    }
+    UA_Variant_clear(&val);
+}
+
+//! 读取节点属性，按节点类别封装为对应的 Attributes 结构体
+UA_Boolean readAttributes(UA_Server *server, const UA_NodeId &node_id, UA_NodeClass node_class, UA_ExtensionObject &out)
+{
+    switch (node_class)
+    {
+    case UA_NODECLASS_OBJECT:
+    {
+        auto attr = UA_ObjectAttributes_new();
+        UA_Server_readDisplayName(server, node_id, &attr->displayName);
+        UA_Server_readDescription(server, node_id, &attr->description);
+        UA_Server_readWriteMask(server, node_id, &attr->writeMask);
+        UA_Server_readEventNotifier(server, node_id, &attr->eventNotifier);
+        UA_ExtensionObject_setValue(&out, attr, &UA_TYPES[UA_TYPES_OBJECTATTRIBUTES]);
+        return UA_TRUE;
+    }
+    case UA_NODECLASS_VARIABLE:
+    {
+        auto attr = UA_VariableAttributes_new();
+        UA_Server_readDisplayName(server, node_id, &attr->displayName);
+        UA_Server_readDescription(server, node_id, &attr->description);
+        UA_Server_readWriteMask(server, node_id, &attr->writeMask);
+        UA_Server_readValue(server, node_id, &attr->value);
+        UA_Server_readDataType(server, node_id, &attr->dataType);
+        UA_Server_readValueRank(server, node_id, &attr->valueRank);
+        readArrayDimensions(server, node_id, attr->arrayDimensionsSize, attr->arrayDimensions);
+        UA_Server_readAccessLevel(server, node_id, &attr->accessLevel);
+        attr->userAccessLevel = attr->accessLevel;
+        UA_Server_readMinimumSamplingInterval(server, node_id, &attr->minimumSamplingInterval);
+        UA_Server_readHistorizing(server, node_id, &attr->historizing);
+        UA_ExtensionObject_setValue(&out, attr, &UA_TYPES[UA_TYPES_VARIABLEATTRIBUTES]);
+        return UA_TRUE;
+    }
+    case UA_NODECLASS_METHOD:
+    {
+        auto attr = UA_MethodAttributes_new();
+        UA_Server_readDisplayName(server, node_id, &attr->displayName);
+        UA_Server_readDescription(server, node_id, &attr->description);
+        UA_Server_readWriteMask(server, node_id, &attr->writeMask);
+        UA_Server_readExecutable(server, node_id, &attr->executable);
+        attr->userExecutable = attr->executable;
+        UA_ExtensionObject_setValue(&out, attr, &UA_TYPES[UA_TYPES_METHODATTRIBUTES]);
+        return UA_TRUE;
+    }
+    case UA_NODECLASS_OBJECTTYPE:
+    {
+        auto attr = UA_ObjectTypeAttributes_new();
+        UA_Server_readDisplayName(server, node_id, &attr->displayName);
+        UA_Server_readDescription(server, node_id, &attr->description);
+        UA_Server_readWriteMask(server, node_id, &attr->writeMask);
+        UA_Server_readIsAbstract(server, node_id, &attr->isAbstract);
+        UA_ExtensionObject_setValue(&out, attr, &UA_TYPES[UA_TYPES_OBJECTTYPEATTRIBUTES]);
+        return UA_TRUE;
+    }
+    case UA_NODECLASS_VARIABLETYPE:
+    {
+        auto attr = UA_VariableTypeAttributes_new();
+        UA_Server_readDisplayName(server, node_id, &attr->displayName);
+        UA_Server_readDescription(server, node_id, &attr->description);
+        UA_Server_readWriteMask(server, node_id, &attr->writeMask);
+        UA_Server_readValue(server, node_id, &attr->value);
+        UA_Server_readDataType(server, node_id, &attr->dataType);
+        UA_Server_readValueRank(server, node_id, &attr->valueRank);
+        readArrayDimensions(server, node_id, attr->arrayDimensionsSize, attr->arrayDimensions);
+        UA_Server_readIsAbstract(server, node_id, &attr->isAbstract);
+        UA_ExtensionObject_setValue(&out, attr, &UA_TYPES[UA_TYPES_VARIABLETYPEATTRIBUTES]);
+        return UA_TRUE;
+    }
+    default:
+        return UA_FALSE;
+    }
+}
+
+//! 按依赖关系排序：父节点与类型定义 (同样位于快照中时) 排在节点之前
+void sortNodes(vector<SnapshotNode> &nodes)
+{
+    unordered_map<UA_UInt32, vector<size_t>> buckets; //!< NodeId 哈希 -> 节点下标
+    for (size_t i = 0; i < nodes.size(); ++i)
+        buckets[UA_NodeId_hash(&nodes[i].id)].push_back(i);
+    auto find = [&](const UA_NodeId &id) -> long {
+        auto it = buckets.find(UA_NodeId_hash(&id));
+        if (it == buckets.end())
+            return -1;
+        for (auto idx : it->second)
+            if (UA_NodeId_equal(&nodes[idx].id, &id))
+                return static_cast<long>(idx);
+        return -1;
+    };
+    vector<SnapshotNode> sorted;
+    sorted.reserve(nodes.size());
+    vector<UA_Byte> state(nodes.size(), 0); //!< 0: 未访问，1: 访问中，2: 已输出
+    vector<pair<size_t, UA_Byte>> stack;    //!< (下标, 已入栈的依赖数)
+    for (size_t root = 0; root < nodes.size(); ++root)
+    {
+        if (state[root] != 0)
+            continue;
+        stack.emplace_back(root, 0);
+        state[root] = 1;
+        while (!stack.empty())
+        {
+            auto &[idx, visited] = stack.back();
+            const UA_NodeId *deps[] = {&nodes[idx].parent_id, &nodes[idx].type_id};
+            if (visited < 2)
+            {
+                long dep = find(*deps[visited++]);
+                if (dep >= 0 && state[dep] == 0)
+                {
+                    state[dep] = 1;
+                    stack.emplace_back(static_cast<size_t>(dep), 0);
+                }
+                continue;
+            }
+            state[idx] = 2;
+            sorted.push_back(nodes[idx]);
+            stack.pop_back();
+        }
+    }
+    nodes.swap(sorted);
+}
+
+void clearNodes(vector<SnapshotNode> &nodes)
+{
+    for (auto &node : nodes)
+    {
+        UA_NodeId_clear(&node.id);
+        UA_NodeId_clear(&node.parent_id);
+        UA_NodeId_clear(&node.reference_type_id);
+        UA_NodeId_clear(&node.type_id);
+    }
+    nodes.clear();
+}
+
+template <typename T>
+UA_Boolean writeEncoded(FILE *fp, const T *p, const UA_DataType *type)
+{
+    UA_ByteString buf = UA_BYTESTRING_NULL;
+    if (UA_encodeBinary(p, type, &buf) != UA_STATUSCODE_GOOD)
+        return UA_FALSE;
+    size_t written = fwrite(buf.data, 1, buf.length, fp);
+    UA_Boolean retval = written == buf.length;
+    UA_ByteString_clear(&buf);
+    return retval;
+}
+
+} // namespace
+
+UA_Boolean Server::saveSnapshot(const string &path)
+{
+    SERVER_INIT_ASSERT();
+    //!< Enumerate the user nodes, then find out the hierarchical parent and the type definition of each
+    vector<SnapshotNode> nodes;
+    UA_ServerConfig *config = UA_Server_getConfig(__server);
+    config->nodestore.iterate(config->nodestore.context, collectNode, &nodes);
+    for (auto &node : nodes)
+    {
+        UA_BrowseResult br = browseReferences(__server, node.id, UA_BROWSEDIRECTION_INVERSE,
+                                              UA_NODEID_NUMERIC(0, UA_NS0ID_HIERARCHICALREFERENCES));
+        const UA_ReferenceDescription *parent = findParentReference(br, node.node_class);
+        if (parent != nullptr)
+        {
+            UA_NodeId_copy(&parent->nodeId.nodeId, &node.parent_id);
+            UA_NodeId_copy(&parent->referenceTypeId, &node.reference_type_id);
+        }
+        UA_BrowseResult_clear(&br);
+        if (node.node_class == UA_NODECLASS_OBJECT || node.node_class == UA_NODECLASS_VARIABLE)
+        {
+            const UA_NodeId has_type_definition = UA_NODEID_NUMERIC(0, UA_NS0ID_HASTYPEDEFINITION);
+            br = browseReferences(__server, node.id, UA_BROWSEDIRECTION_FORWARD, has_type_definition);
+            for (size_t i = 0; i < br.referencesSize; ++i)
+                if (br.references[i].isForward &&
+                    UA_NodeId_equal(&br.references[i].referenceTypeId, &has_type_definition))
+                {
+                    UA_NodeId_copy(&br.references[i].nodeId.nodeId, &node.type_id);
+                    break;
+                }
+            UA_BrowseResult_clear(&br);
+        }
+    }
+    sortNodes(nodes);
+
+    FILE *fp = fopen(path.c_str(), "wb");
+    if (fp == nullptr)
+    {
+        UA_LOG_ERROR(logger(), UA_LOGCATEGORY_SERVER,
+                     "Function saveSnapshot: failed to open %s", path.c_str());
+        clearNodes(nodes);
+        return UA_FALSE;
+    }
+    UA_Boolean ok = fwrite(snapshot_magic, 1, sizeof(snapshot_magic), fp) == sizeof(snapshot_magic);
+    UA_UInt32 node_count = static_cast<UA_UInt32>(nodes.size());
+    ok = ok && writeEncoded(fp, &node_count, &UA_TYPES[UA_TYPES_UINT32]);
+
+    //!< Nodes are written as AddNodesItems, the parent reference is part of the item
+    for (const auto &node : nodes)
+    {
+        UA_AddNodesItem item;
+        UA_AddNodesItem_init(&item);
+        if (!readAttributes(__server, node.id, node.node_class, item.nodeAttributes))
+        {
+            UA_LOG_WARNING(logger(), UA_LOGCATEGORY_SERVER,
+                           "Function saveSnapshot: node class %d isn't supported, skipped", node.node_class);
+            --node_count;
+            continue;
+        }
+        item.parentNodeId.nodeId = node.parent_id;
+        item.referenceTypeId = node.reference_type_id;
+        item.requestedNewNodeId.nodeId = node.id;
+        UA_Server_readBrowseName(__server, node.id, &item.browseName);
+        item.nodeClass = node.node_class;
+        item.typeDefinition.nodeId = node.type_id;
+        ok = ok && writeEncoded(fp, &item, &UA_TYPES[UA_TYPES_ADDNODESITEM]);
+        //!< The node ids are owned by the node list
+        UA_QualifiedName_clear(&item.browseName);
+        UA_ExtensionObject_clear(&item.nodeAttributes);
+    }
+
+    //!< The remaining references: forward ones of the user nodes and inverse ones from namespace 0,
+    //!< except the parent references and the type definitions already covered by the items
+    const UA_NodeId has_type_definition = UA_NODEID_NUMERIC(0, UA_NS0ID_HASTYPEDEFINITION);
+    vector<UA_AddReferencesItem> refs;
+    for (const auto &node : nodes)
+    {
+        UA_BrowseResult br = browseReferences(__server, node.id, UA_BROWSEDIRECTION_BOTH, UA_NODEID_NULL);
+        for (size_t i = 0; i < br.referencesSize; ++i)
+        {
+            const UA_ReferenceDescription &rd = br.references[i];
+            const UA_NodeId &target = rd.nodeId.nodeId;
+            if (!rd.isForward && (target.namespaceIndex != 0 ||
+                                  (UA_NodeId_equal(&target, &node.parent_id) &&
+                                   UA_NodeId_equal(&rd.referenceTypeId, &node.reference_type_id))))
+                continue;
+            if (rd.isForward && UA_NodeId_equal(&rd.referenceTypeId, &has_type_definition))
+                continue;
+            UA_AddReferencesItem ref;
+            UA_AddReferencesItem_init(&ref);
+            if (rd.isForward)
+            {
+                UA_NodeId_copy(&node.id, &ref.sourceNodeId);
+                UA_ExpandedNodeId_copy(&rd.nodeId, &ref.targetNodeId);
+            }
+            else
+            {
+                UA_NodeId_copy(&target, &ref.sourceNodeId);
+                UA_NodeId_copy(&node.id, &ref.targetNodeId.nodeId);
+            }
+            UA_NodeId_copy(&rd.referenceTypeId, &ref.referenceTypeId);
+            ref.isForward = UA_TRUE;
+            refs.push_back(ref);
+        }
+        UA_BrowseResult_clear(&br);
+    }
+    UA_UInt32 ref_count = static_cast<UA_UInt32>(refs.size());
+    ok = ok && writeEncoded(fp, &ref_count, &UA_TYPES[UA_TYPES_UINT32]);
+    for (auto &ref : refs)
+    {
+        ok = ok && writeEncoded(fp, &ref, &UA_TYPES[UA_TYPES_ADDREFERENCESITEM]);
+        UA_AddReferencesItem_clear(&ref);
+    }
+    //!< Patch the node count if some nodes were skipped
+    ok = ok && fseek(fp, sizeof(snapshot_magic), SEEK_SET) == 0 &&
+         writeEncoded(fp, &node_count, &UA_TYPES[UA_TYPES_UINT32]);
+    ok = (fclose(fp) == 0) && ok;
+    clearNodes(nodes);
+    if (!ok)
+        UA_LOG_ERROR(logger(), UA_LOGCATEGORY_SERVER,
+                     "Function saveSnapshot: failed to write %s", path.c_str());
+    return ok;
+}
+
+UA_Boolean Server::loadSnapshot(const string &path, const unordered_map<string, UA_MethodCallback> &methods)
+{
+    SERVER_INIT_ASSERT();
+    int fd = open(path.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(snapshot_magic))
+    {
+        UA_LOG_ERROR(logger(), UA_LOGCATEGORY_SERVER,
+                     "Function loadSnapshot: failed to open %s", path.c_str());
+        if (fd >= 0)
+            close(fd);
+        return UA_FALSE;
+    }
+    //!< The items are decoded straight from the mapped pages, no intermediate read buffer
+    void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        UA_LOG_ERROR(logger(), UA_LOGCATEGORY_SERVER,
+                     "Function loadSnapshot: failed to map %s", path.c_str());
+        return UA_FALSE;
+    }
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+    UA_ByteString buf;
+    buf.length = st.st_size;
+    buf.data = static_cast<UA_Byte *>(data);
+    size_t offset = sizeof(snapshot_magic);
+    UA_StatusCode retval = memcmp(data, snapshot_magic, sizeof(snapshot_magic)) == 0
+                               ? UA_STATUSCODE_GOOD
+                               : UA_STATUSCODE_BADDECODINGERROR;
+
+    //!< Phase 1: create all nodes without running the type checks and constructors
+    UA_UInt32 node_count = 0;
+    if (retval == UA_STATUSCODE_GOOD)
+        retval = UA_decodeBinary(&buf, &offset, &node_count, &UA_TYPES[UA_TYPES_UINT32], nullptr);
+    //!< A corrupted count must not drive the allocation
+    if (retval == UA_STATUSCODE_GOOD && node_count > (buf.length - offset) / min_item_size)
+        retval = UA_STATUSCODE_BADDECODINGERROR;
+    vector<pair<UA_NodeId, UA_NodeClass>> added;
+    if (retval == UA_STATUSCODE_GOOD)
+        added.reserve(node_count);
+    size_t context_count = __contexts.size();
+    for (UA_UInt32 i = 0; i < node_count && retval == UA_STATUSCODE_GOOD; ++i)
+    {
+        UA_AddNodesItem item;
+        UA_AddNodesItem_init(&item);
+        retval = UA_decodeBinary(&buf, &offset, &item, &UA_TYPES[UA_TYPES_ADDNODESITEM], nullptr);
+        if (retval == UA_STATUSCODE_GOOD && item.nodeAttributes.encoding < UA_EXTENSIONOBJECT_DECODED)
+            retval = UA_STATUSCODE_BADDECODINGERROR;
+        if (retval != UA_STATUSCODE_GOOD)
+        {
+            UA_AddNodesItem_clear(&item);
+            break;
+        }
+        //!< Rebind the method callback by browse name
+        void *node_context = nullptr;
+        if (item.nodeClass == UA_NODECLASS_METHOD)
+        {
+            string name(reinterpret_cast<const char *>(item.browseName.name.data), item.browseName.name.length);
+            auto it = methods.find(name);
+            if (it != methods.end())
+            {
+                CallbackContext context;
+                context.name = Trace::intern(name);
+                context.method = it->second;
+                __contexts.push_back(std::move(context));
+                node_context = &__contexts.back();
+            }
+            else
+                UA_LOG_WARNING(logger(), UA_LOGCATEGORY_SERVER,
+                               "Function loadSnapshot: no callback for method %s", name.c_str());
+        }
+        UA_NodeId node_id = UA_NODEID_NULL;
+        retval = UA_Server_addNode_begin(__server, item.nodeClass, item.requestedNewNodeId.nodeId,
+                                         item.parentNodeId.nodeId, item.referenceTypeId, item.browseName,
+                                         item.typeDefinition.nodeId, item.nodeAttributes.content.decoded.data,
+                                         item.nodeAttributes.content.decoded.type, node_context, &node_id);
+        if (retval == UA_STATUSCODE_GOOD)
+            added.emplace_back(node_id, node_context != nullptr ? UA_NODECLASS_METHOD : UA_NODECLASS_UNSPECIFIED);
+        UA_AddNodesItem_clear(&item);
+    }
+
+    //!< Phase 2: finish the nodes, every child exists already so nothing is instantiated twice
+    for (auto &[node_id, kind] : added)
+    {
+        if (retval != UA_STATUSCODE_GOOD)
+            break;
+        retval = kind == UA_NODECLASS_METHOD
+                     ? UA_Server_addMethodNode_finish(__server, node_id, methodHandler, 0, nullptr, 0, nullptr)
+                     : UA_Server_addNode_finish(__server, node_id);
+    }
+
+    //!< Phase 3: the remaining references
+    UA_UInt32 ref_count = 0;
+    if (retval == UA_STATUSCODE_GOOD)
+        retval = UA_decodeBinary(&buf, &offset, &ref_count, &UA_TYPES[UA_TYPES_UINT32], nullptr);
+    for (UA_UInt32 i = 0; i < ref_count && retval == UA_STATUSCODE_GOOD; ++i)
+    {
+        UA_AddReferencesItem ref;
+        UA_AddReferencesItem_init(&ref);
+        retval = UA_decodeBinary(&buf, &offset, &ref, &UA_TYPES[UA_TYPES_ADDREFERENCESITEM], nullptr);
+        if (retval == UA_STATUSCODE_GOOD)
+        {
+            retval = UA_Server_addReference(__server, ref.sourceNodeId, ref.referenceTypeId,
+                                            ref.targetNodeId, ref.isForward);
+            //!< Some of them are created again while finishing the nodes
+            if (retval == UA_STATUSCODE_BADDUPLICATEREFERENCENOTALLOWED)
+                retval = UA_STATUSCODE_GOOD;
+        }
+        UA_AddReferencesItem_clear(&ref);
+    }
+
+    //!< Roll back every node of the snapshot on any failure, half-constructed or half-linked nodes must not stay.
+    //!< Every stored reference has a snapshot node at one end, so deleting the nodes removes them too
+    if (retval != UA_STATUSCODE_GOOD)
+    {
+        for (auto &[node_id, kind] : added)
+            UA_Server_deleteNode(__server, node_id, UA_TRUE);
+        __contexts.resize(context_count);
+    }
+    for (auto &[node_id, kind] : added)
+        UA_NodeId_clear(&node_id);
+    munmap(data, st.st_size);
+    if (retval != UA_STATUSCODE_GOOD)
+    {
+        UA_LOG_ERROR(logger(), UA_LOGCATEGORY_SERVER,
+                     "Function loadSnapshot: %s", UA_StatusCode_name(retval));
+        return UA_FALSE;
+    }
+    return UA_TRUE;
+}
@@ -0,0 +1,215 @@
+/**
+ * @file shm_channel.cpp
+ * @author 赵曦 (535394140@qq.com)
+ * @brief Shared memory ring with futex wakeups for co-located server and client processes
+ * @version 1.0
+ * @date 2023-03-19
+ *
+ * @copyright Copyright (c) 2023, zhaoxi
+ *
+ */
+
+#include <chrono>
+#include <climits>
+#include <cstring>
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "asmpro/opcua_cs/shm_channel.hpp"
+
+using namespace std;
+using namespace ua;
+
+namespace
+{
+
+constexpr char magic[8] = {'U', 'A', 'S', 'H', 'M', '0', '0', '1'};
+
+//! POSIX 共享内存名需要以 '/' 开头
+string normalize(const string &name) { return !name.empty() && name[0] == '/' ? name : "/" + name; }
+
+//! 帧序号对应的帧缓冲区
+inline shm::Slot *slotAt(UA_Byte *base, const shm::Header *header, UA_UInt64 seq)
+{
+    size_t index = static_cast<size_t>((seq - 1) % header->slot_count);
+    return reinterpret_cast<shm::Slot *>(base + shm::alignment + index * shm::stride(header->slot_size));
+}
+
+//! 跨进程的 futex 等待，不使用 FUTEX_PRIVATE_FLAG
+inline void futexWait(atomic<UA_UInt32> *addr, UA_UInt32 expected, chrono::nanoseconds timeout)
+{
+    timespec ts;
+    ts.tv_sec = static_cast<time_t>(timeout.count() / 1000000000);
+    ts.tv_nsec = static_cast<long>(timeout.count() % 1000000000);
+    syscall(SYS_futex, reinterpret_cast<UA_UInt32 *>(addr), FUTEX_WAIT, expected, &ts, nullptr, 0);
+}
+
+inline void futexWakeAll(atomic<UA_UInt32> *addr)
+{
+    syscall(SYS_futex, reinterpret_cast<UA_UInt32 *>(addr), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+} // namespace
+
+ShmWriter::ShmWriter(const string &name, size_t slot_size, size_t slot_count, mode_t mode) : __name(normalize(name))
+{
+    slot_count = max<size_t>(slot_count, 2);
+    //!< Replace a stale segment, readers still holding it keep their own mapping
+    shm_unlink(__name.c_str());
+    __fd = shm_open(__name.c_str(), O_CREAT | O_EXCL | O_RDWR, mode);
+    if (__fd < 0)
+        return;
+    //!< The permission bits of shm_open are filtered by the umask
+    fchmod(__fd, mode);
+    size_t size = shm::segmentSize(slot_size, slot_count);
+    if (ftruncate(__fd, static_cast<off_t>(size)) != 0)
+        return;
+    void *base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, __fd, 0);
+    if (base == MAP_FAILED)
+        return;
+    __base = static_cast<UA_Byte *>(base);
+    __size = size;
+    //!< The new segment is zero-filled, which is a valid initial state of every atomic in it
+    __header = reinterpret_cast<shm::Header *>(__base);
+    __header->slot_count = static_cast<UA_UInt32>(slot_count);
+    __header->slot_size = slot_size;
+    atomic_thread_fence(memory_order_release);
+    memcpy(__header->magic, magic, sizeof(magic));
+}
+
+ShmWriter::~ShmWriter()
+{
+    if (__base != nullptr)
+        munmap(__base, __size);
+    if (__fd >= 0)
+    {
+        close(__fd);
+        shm_unlink(__name.c_str());
+    }
+}
+
+bool ShmWriter::publish(const void *data, size_t size, UA_UInt32 type_id, UA_DateTime source_timestamp)
+{
+    if (__base == nullptr || size > __header->slot_size)
+    {
+        ++__oversize;
+        return false;
+    }
+    UA_UInt64 seq = ++__seq;
+    shm::Slot *slot = slotAt(__base, __header, seq);
+    //!< Seqlock: readers that started on the old frame detect the overwrite by the sequence number
+    slot->seq.store(0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    slot->size = size;
+    slot->type_id = type_id;
+    slot->source_timestamp = source_timestamp;
+    memcpy(reinterpret_cast<UA_Byte *>(slot + 1), data, size);
+    slot->seq.store(seq, memory_order_release);
+    __header->seq.store(seq, memory_order_release);
+    __header->futex.fetch_add(1);
+    if (__header->waiters.load() > 0)
+        futexWakeAll(&__header->futex);
+    return true;
+}
+
+bool ShmWriter::publish(const UA_Variant &value, UA_DateTime source_timestamp)
+{
+    if (UA_Variant_isEmpty(&value))
+        return false;
+    if (UA_Variant_hasScalarType(&value, &UA_TYPES[UA_TYPES_BYTESTRING]))
+    {
+        auto str = static_cast<const UA_ByteString *>(value.data);
+        return publish(str->data, str->length, UA_NS0ID_BYTE, source_timestamp);
+    }
+    //!< Only the memory of pointer-free types can be copied directly
+    if (!value.type->pointerFree)
+    {
+        ++__oversize;
+        return false;
+    }
+    size_t count = UA_Variant_isScalar(&value) ? 1 : value.arrayLength;
+    return publish(value.data, count * value.type->memSize, value.type->typeId.identifier.numeric, source_timestamp);
+}
+
+ShmReader::ShmReader(const string &name)
+{
+    __fd = shm_open(normalize(name).c_str(), O_RDWR, 0);
+    if (__fd < 0)
+        return;
+    struct stat st;
+    if (fstat(__fd, &st) != 0 || static_cast<size_t>(st.st_size) < shm::alignment)
+        return;
+    size_t size = static_cast<size_t>(st.st_size);
+    void *base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, __fd, 0);
+    if (base == MAP_FAILED)
+        return;
+    auto header = static_cast<shm::Header *>(base);
+    if (memcmp(header->magic, magic, sizeof(magic)) != 0 ||
+        shm::segmentSize(header->slot_size, header->slot_count) != size)
+    {
+        munmap(base, size);
+        return;
+    }
+    atomic_thread_fence(memory_order_acquire);
+    __base = static_cast<UA_Byte *>(base);
+    __size = size;
+    __header = header;
+    //!< Start from the newest frame at the time of opening
+    __last = __header->seq.load(memory_order_acquire);
+}
+
+ShmReader::~ShmReader()
+{
+    if (__base != nullptr)
+        munmap(__base, __size);
+    if (__fd >= 0)
+        close(__fd);
+}
+
+const shm::Slot *ShmReader::acquire(UA_UInt32 timeout, UA_UInt64 &seq)
+{
+    if (__base == nullptr)
+        return nullptr;
+    auto deadline = chrono::steady_clock::now() + chrono::milliseconds(timeout);
+    while (true)
+    {
+        //!< Read the futex word before the sequence number, so a publish in between makes the wait return at once
+        UA_UInt32 futex = __header->futex.load();
+        seq = __header->seq.load(memory_order_acquire);
+        if (seq > __last)
+        {
+            const shm::Slot *slot = slotAt(__base, __header, seq);
+            if (slot->seq.load(memory_order_acquire) == seq)
+            {
+                __skipped += seq - __last - 1;
+                __last = seq;
+                return slot;
+            }
+            //!< The slot is being overwritten by a newer frame
+            continue;
+        }
+        auto remaining = deadline - chrono::steady_clock::now();
+        if (remaining <= chrono::nanoseconds::zero())
+            return nullptr;
+        __header->waiters.fetch_add(1);
+        futexWait(&__header->futex, futex, chrono::duration_cast<chrono::nanoseconds>(remaining));
+        __header->waiters.fetch_sub(1);
+    }
+}
+
+bool ShmReader::release(const shm::Slot *slot, UA_UInt64 seq)
+{
+    atomic_thread_fence(memory_order_acquire);
+    if (slot->seq.load(memory_order_relaxed) != seq)
+    {
+        ++__torn;
+        return false;
+    }
+    ++__received;
+    return true;
+}
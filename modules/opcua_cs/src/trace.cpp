@@ -0,0 +1,151 @@
+/**
+ * @file trace.cpp
+ * @author 赵曦 (535394140@qq.com)
+ * @brief Span instrumentation exported as Chrome trace events
+ * @version 1.0
+ * @date 2023-03-15
+ *
+ * @copyright Copyright (c) 2023, zhaoxi
+ *
+ */
+
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
+
+#include <unistd.h>
+
+#include "asmpro/opcua_cs/trace.hpp"
+
+using namespace std;
+using namespace ua;
+
+namespace
+{
+
+//! 追踪区间
+struct TraceEvent
+{
+    const char *name;     //!< 区间名
+    const char *category; //!< 区间类别
+    UA_UInt64 begin;      //!< 开始时间 (单位：ns)
+    UA_UInt64 end;        //!< 结束时间 (单位：ns)
+};
+
+//! 单个线程的单生产者、单消费者环形缓冲区
+struct TraceRing
+{
+    vector<TraceEvent> events;    //!< 区间缓冲区
+    UA_UInt32 tid;                //!< 线程编号
+    atomic_size_t head{0};        //!< 写入位置，仅由所属线程修改
+    atomic_size_t tail{0};        //!< 读取位置，仅由导出线程修改
+    atomic<UA_UInt64> dropped{0}; //!< 丢弃的区间数
+
+    TraceRing(size_t capacity, UA_UInt32 id) : events(capacity), tid(id) {}
+};
+
+mutex rings_mtx;                              //!< 环形缓冲区列表互斥锁
+vector<shared_ptr<TraceRing>> rings;          //!< 所有线程的环形缓冲区，线程退出后仍保留以便导出
+thread_local TraceRing *local_ring = nullptr; //!< 当前线程的环形缓冲区
+mutex names_mtx;                              //!< 区间名集合互斥锁
+unordered_set<string> names;                  //!< 运行时生成的区间名，元素的地址在插入后保持不变
+
+TraceRing *localRing(size_t capacity)
+{
+    if (local_ring != nullptr)
+        return local_ring;
+    lock_guard<mutex> lk(rings_mtx);
+    rings.push_back(make_shared<TraceRing>(capacity, static_cast<UA_UInt32>(rings.size() + 1)));
+    local_ring = rings.back().get();
+    return local_ring;
+}
+
+} // namespace
+
+void Trace::enable(size_t capacity)
+{
+    __capacity.store(capacity > 0 ? capacity : 1, memory_order_relaxed);
+    __enabled.store(true, memory_order_relaxed);
+}
+
+void Trace::record(const char *name, const char *category, UA_UInt64 begin, UA_UInt64 end)
+{
+    TraceRing *ring = localRing(__capacity.load(memory_order_relaxed));
+    size_t head = ring->head.load(memory_order_relaxed);
+    size_t tail = ring->tail.load(memory_order_acquire);
+    if (head - tail >= ring->events.size())
+    {
+        ring->dropped.fetch_add(1, memory_order_relaxed);
+        return;
+    }
+    ring->events[head % ring->events.size()] = {name, category, begin, end};
+    ring->head.store(head + 1, memory_order_release);
+}
+
+const char *Trace::intern(const string &name)
+{
+    lock_guard<mutex> lk(names_mtx);
+    return names.insert(name).first->c_str();
+}
+
+//! 以 JSON 字符串的形式输出，转义引号、反斜杠与控制字符
+static void writeJsonString(FILE *fp, const char *str)
+{
+    fputc('"', fp);
+    for (const char *c = str; *c != '\0'; ++c)
+    {
+        if (*c == '"' || *c == '\\')
+            fputc('\\', fp);
+        if (static_cast<unsigned char>(*c) < 0x20)
+            fprintf(fp, "\\u%04x", static_cast<unsigned>(static_cast<unsigned char>(*c)));
+        else
+            fputc(*c, fp);
+    }
+    fputc('"', fp);
+}
+
+bool Trace::flush(const string &path, const UA_Logger *logger)
+{
+    FILE *fp = fopen(path.c_str(), "w");
+    if (fp == nullptr)
+    {
+        UA_LOG_ERROR(logger, UA_LOGCATEGORY_USERLAND, "Failed to open the trace file: %s", path.c_str());
+        return false;
+    }
+    int pid = static_cast<int>(getpid());
+    fprintf(fp, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [");
+    bool first = true;
+    lock_guard<mutex> lk(rings_mtx);
+    for (auto &ring : rings)
+    {
+        size_t tail = ring->tail.load(memory_order_relaxed);
+        size_t head = ring->head.load(memory_order_acquire);
+        for (size_t i = tail; i < head; ++i)
+        {
+            const TraceEvent &e = ring->events[i % ring->events.size()];
+            //!< Complete events, the timestamps of Chrome trace events are in microseconds
+            fprintf(fp, "%s\n{\"name\": ", first ? "" : ",");
+            writeJsonString(fp, e.name);
+            fprintf(fp, ", \"cat\": ");
+            writeJsonString(fp, e.category);
+            fprintf(fp, ", \"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f, \"pid\": %d, \"tid\": %u}",
+                    e.begin * 1e-3, (e.end - e.begin) * 1e-3, pid, ring->tid);
+            first = false;
+        }
+        ring->tail.store(head, memory_order_release);
+    }
+    fprintf(fp, "\n]}\n");
+    fclose(fp);
+    return true;
+}
+
+UA_UInt64 Trace::dropped()
+{
+    UA_UInt64 retval = 0;
+    lock_guard<mutex> lk(rings_mtx);
+    for (auto &ring : rings)
+        retval += ring->dropped.load(memory_order_relaxed);
+    return retval;
+}
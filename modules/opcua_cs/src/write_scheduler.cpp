@@ -0,0 +1,100 @@
+/**
+ * @file write_scheduler.cpp
+ * @author 赵曦 (535394140@qq.com)
+ * @brief Client-side write coalescing with a per-scheduler flush rate limit
+ * @version 1.0
+ * @date 2023-03-22
+ *
+ * @copyright Copyright (c) 2023, zhaoxi
+ *
+ */
+
+#include "asmpro/opcua_cs/write_scheduler.hpp"
+
+using namespace std;
+using namespace ua;
+
+WriteScheduler::WriteScheduler(Client &client, double max_rate)
+    : __client(client),
+      __interval(max_rate > 0 ? chrono::duration_cast<chrono::steady_clock::duration>(
+                                    chrono::duration<double>(1.0 / max_rate))
+                              : chrono::steady_clock::duration::zero())
+{
+    __worker = thread(&WriteScheduler::run, this);
+}
+
+WriteScheduler::~WriteScheduler()
+{
+    {
+        lock_guard<mutex> lk(__mtx);
+        __running = UA_FALSE;
+    }
+    __cv.notify_one();
+    __worker.join();
+    for (auto &[node_id, pending] : __pendings)
+        UA_NodeId_clear(const_cast<UA_NodeId *>(&node_id));
+}
+
+future<UA_StatusCode> WriteScheduler::write(const UA_NodeId &node_id, Variable data)
+{
+    ++__submitted;
+    promise<UA_StatusCode> waiter;
+    future<UA_StatusCode> retval = waiter.get_future();
+    {
+        lock_guard<mutex> lk(__mtx);
+        auto it = __pendings.find(node_id);
+        if (it == __pendings.end())
+        {
+            UA_NodeId key;
+            UA_NodeId_copy(&node_id, &key);
+            it = __pendings.emplace(key, Pending()).first;
+        }
+        //!< The older value is dropped, its waiters are resolved by the acknowledgement of this one
+        Pending &pending = it->second;
+        pending.data = std::move(data);
+        pending.waiters.push_back(std::move(waiter));
+        if (!pending.dirty)
+        {
+            pending.dirty = UA_TRUE;
+            __dirty.emplace_back(&it->first, &pending);
+        }
+    }
+    __cv.notify_one();
+    return retval;
+}
+
+void WriteScheduler::run()
+{
+    auto last = chrono::steady_clock::now() - __interval;
+    vector<Client::VariableWrite> writes;
+    vector<vector<promise<UA_StatusCode>>> waiters;
+    unique_lock<mutex> lk(__mtx);
+    while (true)
+    {
+        __cv.wait(lk, [this] { return !__running || !__dirty.empty(); });
+        if (__dirty.empty())
+            break;
+        //!< Wait out the minimum interval, writes arriving meanwhile are coalesced, on stop the rest is sent at once
+        __cv.wait_until(lk, last + __interval, [this] { return !__running; });
+        for (auto &[node_id, pending] : __dirty)
+        {
+            writes.push_back({*node_id, std::move(pending->data)});
+            waiters.push_back(std::move(pending->waiters));
+            pending->waiters.clear();
+            pending->dirty = UA_FALSE;
+        }
+        __dirty.clear();
+        last = chrono::steady_clock::now();
+        lk.unlock();
+
+        vector<UA_StatusCode> statuses = __client.write(writes);
+        __written += writes.size();
+        ++__batches;
+        for (size_t i = 0; i < waiters.size(); ++i)
+            for (auto &waiter : waiters[i])
+                waiter.set_value(statuses[i]);
+        writes.clear();
+        waiters.clear();
+        lk.lock();
+    }
+}
@@ -0,0 +1,215 @@
+/**
+ * @file test_alloc_budget.cpp
+ * @author 赵曦 (535394140@qq.com)
+ * @brief Per-operation allocation budgets of the steady-state Server and Client paths
+ * @version 1.0
+ * @date 2023-03-24
+ *
+ * @copyright Copyright (c) 2023, zhaoxi
+ *
+ */
+
+#include <functional>
+#include <memory>
+
+#include <gtest/gtest.h>
+
+#include "alloc_hook.hpp"
+#include "bench_utility.hpp"
+
+using namespace std;
+using namespace ua;
+
+namespace
+{
+
+constexpr UA_UInt16 port = 4865;
+constexpr UA_UInt16 local_port = 4866;
+constexpr size_t image_size = 640 * 480 * 3;
+
+/**
+ * @brief 每次操作的预算
+ * @note 预算是各路径的分配次数上限，包括 open62541 内部的编解码分配，与数据量无关。
+ *       字节预算只对大数组路径设置，限制值的拷贝次数
+ */
+struct Budget
+{
+    double allocs;    //!< 每次操作允许的最大分配次数
+    double bytes = 0; //!< 每次操作允许申请的最大字节数，为 0 时不检查
+};
+
+//! 服务器接口的预算，服务器只初始化而不运行
+const Budget server_write_budget{32, 3 * image_size};
+const Budget server_read_budget{8, 2 * image_size};
+const Budget server_find_budget{16};
+//! 客户端接口的预算，包括请求的编码与响应的解码
+const Budget client_read_budget{32};
+const Budget client_write_budget{32};
+const Budget client_call_budget{64};
+const Budget client_batch_call_budget{128};
+const Budget client_find_budget{32};
+
+UA_StatusCode visionTrigger(UA_Server *, const UA_NodeId *, void *, const UA_NodeId *, void *, const UA_NodeId *,
+                            void *, size_t, const UA_Variant *, size_t, UA_Variant *output)
+{
+    double position[] = {1.1, 2.2};
+    UA_Variant_setArrayCopy(&output[0], position, 2, &UA_TYPES[UA_TYPES_DOUBLE]);
+    double angle = 3.3;
+    UA_Variant_setScalarCopy(&output[1], &angle, &UA_TYPES[UA_TYPES_DOUBLE]);
+    return UA_STATUSCODE_GOOD;
+}
+
+void buildModel()
+{
+    Server::addVariableNode("Gain", "Gain of the camera", 1.0);
+    vector<Argument> inputs, outputs;
+    inputs.emplace_back("CameraIdx", "Index of the camera", &UA_TYPES[UA_TYPES_UINT16]);
+    inputs.emplace_back("ControllerIdx", "Index of the light controller", &UA_TYPES[UA_TYPES_UINT16]);
+    inputs.emplace_back("ChannelIdx", "Channel of the light controller", &UA_TYPES[UA_TYPES_BYTE]);
+    outputs.emplace_back("TargetPosition", "Position of the target", &UA_TYPES[UA_TYPES_DOUBLE], 2);
+    outputs.emplace_back("TargetAngle", "Delta angle of the target", &UA_TYPES[UA_TYPES_DOUBLE]);
+    Server::addMethodNode("VisionTrigger", "Trigger the vision program", visionTrigger, inputs, outputs);
+}
+
+/**
+ * @brief 预热后执行 iterations 次操作，检查每次操作的分配是否超出预算
+ *
+ * @param op 被测操作
+ * @param budget 每次操作的预算
+ * @param iterations 计数的执行次数
+ */
+void expectWithin(const function<void()> &op, const Budget &budget, int iterations = 200)
+{
+    for (int i = 0; i < 5; ++i)
+        op();
+    bench::startAllocCount();
+    for (int i = 0; i < iterations; ++i)
+        op();
+    bench::AllocStats stats = bench::stopAllocCount();
+    double allocs = static_cast<double>(stats.allocs()) / iterations;
+    double bytes = static_cast<double>(stats.bytes) / iterations;
+    ::testing::Test::RecordProperty("allocs_per_op", to_string(allocs));
+    ::testing::Test::RecordProperty("bytes_per_op", to_string(bytes));
+    EXPECT_LE(allocs, budget.allocs);
+    if (budget.bytes > 0)
+    {
+        EXPECT_LE(bytes, budget.bytes);
+    }
+}
+
+class AllocBudget : public ::testing::Test
+{
+protected:
+    static void SetUpTestSuite()
+    {
+        //!< The peer of the client runs in a child process, its allocations are not counted
+        server = bench::spawnServer(port, buildModel);
+        //!< The local server is initialized but not run, so no network thread allocates
+        Server::init(local_port);
+        gain_id = Server::addVariableNode("Gain", "Gain of the camera", 1.0);
+        image = make_unique<Variable>(vector<UA_Byte>(image_size, 0x5a).data(), &UA_TYPES[UA_TYPES_BYTE], image_size);
+        image_id = Server::addVariableNode("Image", "Image of the camera", *image);
+        if (server < 0)
+            return;
+        client = make_unique<Client>();
+        client->connect("opc.tcp://localhost:" + to_string(port));
+        remote_gain_id = client->findNodeId(objects_id, 1, "Gain");
+        trigger_id = client->findNodeId(objects_id, 1, "VisionTrigger");
+    }
+
+    static void TearDownTestSuite()
+    {
+        if (client != nullptr)
+            client->disconnect();
+        client.reset();
+        image.reset();
+        bench::stopServer(server);
+    }
+
+    static inline pid_t server = -1;
+    static inline unique_ptr<Client> client;
+    static inline unique_ptr<Variable> image;
+    static inline UA_NodeId objects_id = UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER);
+    static inline UA_NodeId gain_id, image_id, remote_gain_id, trigger_id;
+    Variable gain_val{2.0};
+};
+
+TEST_F(AllocBudget, server_write_double)
+{
+    expectWithin([&]() { Server::writeVariable(gain_id, gain_val); }, server_write_budget);
+}
+
+TEST_F(AllocBudget, server_write_double_with_source_timestamp)
+{
+    expectWithin([&]() { Server::writeVariable(gain_id, gain_val, UA_DateTime_now()); }, server_write_budget);
+}
+
+TEST_F(AllocBudget, server_write_image)
+{
+    expectWithin([&]() { Server::writeVariable(image_id, *image); }, server_write_budget);
+}
+
+TEST_F(AllocBudget, server_read_double)
+{
+    expectWithin([&]() { Server::readVariable(gain_id); }, server_read_budget);
+}
+
+TEST_F(AllocBudget, server_read_image)
+{
+    expectWithin([&]() { Server::readVariable(image_id); }, server_read_budget);
+}
+
+TEST_F(AllocBudget, server_find_node_id)
+{
+    expectWithin([&]() {
+        UA_NodeId node_id = Server::findNodeId(objects_id, 1, "Gain");
+        UA_NodeId_clear(&node_id);
+    }, server_find_budget);
+}
+
+TEST_F(AllocBudget, client_read_double)
+{
+    ASSERT_GT(server, 0) << "Failed to start the server on port " << port;
+    expectWithin([&]() { client->readVariable(remote_gain_id); }, client_read_budget);
+}
+
+TEST_F(AllocBudget, client_write_double)
+{
+    ASSERT_GT(server, 0) << "Failed to start the server on port " << port;
+    expectWithin([&]() { client->writeVariable(remote_gain_id, gain_val); }, client_write_budget);
+}
+
+TEST_F(AllocBudget, client_call)
+{
+    ASSERT_GT(server, 0) << "Failed to start the server on port " << port;
+    vector<Variable> inputs;
+    inputs.emplace_back(UA_UInt16(1));
+    inputs.emplace_back(UA_UInt16(0));
+    inputs.emplace_back(UA_Byte(2));
+    expectWithin([&]() {
+        vector<Variable> outputs;
+        client->call(trigger_id, inputs, outputs);
+    }, client_call_budget);
+}
+
+TEST_F(AllocBudget, client_batch_call)
+{
+    ASSERT_GT(server, 0) << "Failed to start the server on port " << port;
+    vector<Variable> inputs;
+    inputs.emplace_back(UA_UInt16(1));
+    inputs.emplace_back(UA_UInt16(0));
+    inputs.emplace_back(UA_Byte(2));
+    vector<Client::MethodCall> batch(4, Client::MethodCall{trigger_id, inputs});
+    expectWithin([&]() { client->call(batch); }, client_batch_call_budget);
+}
+
+TEST_F(AllocBudget, client_find_node_id)
+{
+    ASSERT_GT(server, 0) << "Failed to start the server on port " << port;
+    expectWithin([&]() {
+        UA_NodeId node_id = client->findNodeId(objects_id, 1, "Gain");
+        UA_NodeId_clear(&node_id);
+    }, client_find_budget);
+}
+
+} // namespace
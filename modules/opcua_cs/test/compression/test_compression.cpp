@@ -0,0 +1,302 @@
+/**
+ * @file test_compression.cpp
+ * @author 赵曦 (535394140@qq.com)
+ * @brief Unit tests of the compressed ByteString encoding: round trips, header checks and malformed input
+ * @version 1.0
+ * @date 2023-03-24
+ *
+ * @copyright Copyright (c) 2023, zhaoxi
+ *
+ */
+
+#include <cstring>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "asmpro/opcua_cs/compression.hpp"
+
+using namespace std;
+using namespace ua;
+
+namespace
+{
+
+//! 压缩首部的字节数与原始字节数字段的偏移量
+constexpr size_t header_size = 24;
+constexpr size_t raw_size_offset = 16;
+
+//! 所有的压缩编码格式
+const Codec codecs[] = {Codec::None, Codec::Deflate, Codec::DeltaDeflate};
+
+//! 生成内容确定的测试数据，相邻像素相近以便差分
+vector<UA_Byte> makeBytes(size_t size)
+{
+    vector<UA_Byte> bytes(size);
+    for (size_t i = 0; i < size; ++i)
+        bytes[i] = static_cast<UA_Byte>(i / 3 + (i % 3) * 50);
+    return bytes;
+}
+
+//! 指定编码格式的压缩参数
+Compression optionsOf(Codec codec, UA_UInt32 stride = 3)
+{
+    Compression options;
+    options.codec = codec;
+    options.stride = stride;
+    return options;
+}
+
+//! 以压缩结果的拷贝构造 ByteString 标量，decompressValue 成功时会释放原有的值
+UA_Variant compressedVariant(const vector<UA_Byte> &compressed)
+{
+    UA_ByteString str{compressed.size(), const_cast<UA_Byte *>(compressed.data())};
+    UA_Variant value;
+    UA_Variant_setScalarCopy(&value, &str, &UA_TYPES[UA_TYPES_BYTESTRING]);
+    return value;
+}
+
+//! 压缩后还原，返回是否成功，还原的值由 decoded 返回，需调用 UA_Variant_clear 释放
+bool roundTrip(const UA_Variant &value, const Compression &options, UA_Variant &decoded)
+{
+    vector<UA_Byte> out, scratch;
+    if (!compressValue(value, options, out, scratch))
+        return false;
+    decoded = compressedVariant(out);
+    return decompressValue(decoded, options.codec);
+}
+
+//! 判断两个元素不含指针的值是否相同
+bool sameValue(const UA_Variant &a, const UA_Variant &b)
+{
+    if (a.type != b.type || UA_Variant_isScalar(&a) != UA_Variant_isScalar(&b) || a.arrayLength != b.arrayLength)
+        return false;
+    if (a.type == &UA_TYPES[UA_TYPES_BYTESTRING])
+    {
+        auto sa = static_cast<const UA_ByteString *>(a.data), sb = static_cast<const UA_ByteString *>(b.data);
+        return sa->length == sb->length && (sa->length == 0 || memcmp(sa->data, sb->data, sa->length) == 0);
+    }
+    size_t count = UA_Variant_isScalar(&a) ? 1 : a.arrayLength;
+    return memcmp(a.data, b.data, count * a.type->memSize) == 0;
+}
+
+TEST(Compression, round_trip_of_arrays)
+{
+    vector<UA_Byte> bytes = makeBytes(3000);
+    vector<UA_UInt16> words(500);
+    vector<UA_Double> doubles(200);
+    for (size_t i = 0; i < words.size(); ++i)
+        words[i] = static_cast<UA_UInt16>(i * 7);
+    for (size_t i = 0; i < doubles.size(); ++i)
+        doubles[i] = i * 0.25;
+    UA_Variant values[3];
+    UA_Variant_setArray(&values[0], bytes.data(), bytes.size(), &UA_TYPES[UA_TYPES_BYTE]);
+    UA_Variant_setArray(&values[1], words.data(), words.size(), &UA_TYPES[UA_TYPES_UINT16]);
+    UA_Variant_setArray(&values[2], doubles.data(), doubles.size(), &UA_TYPES[UA_TYPES_DOUBLE]);
+    for (Codec codec : codecs)
+        for (const UA_Variant &value : values)
+        {
+            UA_Variant decoded;
+            ASSERT_TRUE(roundTrip(value, optionsOf(codec), decoded)) << codecName(codec) << " " << value.type->typeName;
+            EXPECT_TRUE(sameValue(value, decoded)) << codecName(codec) << " " << value.type->typeName;
+            UA_Variant_clear(&decoded);
+        }
+}
+
+TEST(Compression, round_trip_of_scalars)
+{
+    vector<UA_Byte> bytes = makeBytes(1000);
+    UA_ByteString str{bytes.size(), bytes.data()};
+    UA_Double number = 3.5;
+    UA_Variant values[2];
+    UA_Variant_setScalar(&values[0], &str, &UA_TYPES[UA_TYPES_BYTESTRING]);
+    UA_Variant_setScalar(&values[1], &number, &UA_TYPES[UA_TYPES_DOUBLE]);
+    for (Codec codec : codecs)
+        for (const UA_Variant &value : values)
+        {
+            UA_Variant decoded;
+            ASSERT_TRUE(roundTrip(value, optionsOf(codec), decoded)) << codecName(codec) << " " << value.type->typeName;
+            EXPECT_TRUE(UA_Variant_isScalar(&decoded));
+            EXPECT_TRUE(sameValue(value, decoded)) << codecName(codec) << " " << value.type->typeName;
+            UA_Variant_clear(&decoded);
+        }
+}
+
+TEST(Compression, unsupported_values_are_rejected)
+{
+    vector<UA_Byte> out, scratch;
+    UA_Variant empty;
+    UA_Variant_init(&empty);
+    EXPECT_FALSE(compressValue(empty, Compression(), out, scratch));
+    //!< Strings hold pointers, their memory cannot be encoded directly
+    UA_String strings[] = {UA_STRING(const_cast<char *>("a"))};
+    UA_Variant value;
+    UA_Variant_setArray(&value, strings, 1, &UA_TYPES[UA_TYPES_STRING]);
+    EXPECT_FALSE(compressValue(value, Compression(), out, scratch));
+}
+
+TEST(Compression, header_size)
+{
+    vector<UA_Byte> bytes = makeBytes(100), out, scratch;
+    UA_Variant value;
+    UA_Variant_setArray(&value, bytes.data(), bytes.size(), &UA_TYPES[UA_TYPES_BYTE]);
+    ASSERT_TRUE(compressValue(value, optionsOf(Codec::None), out, scratch));
+    EXPECT_EQ(out.size(), header_size + bytes.size());
+    EXPECT_EQ(memcmp(out.data() + header_size, bytes.data(), bytes.size()), 0);
+
+    UA_Variant compressed = compressedVariant(out);
+    EXPECT_TRUE(isCompressed(compressed));
+    UA_Variant_clear(&compressed);
+    //!< A ByteString shorter than the header is never taken for a compressed value
+    out.resize(header_size - 1);
+    compressed = compressedVariant(out);
+    EXPECT_FALSE(isCompressed(compressed));
+    EXPECT_FALSE(decompressValue(compressed, Codec::None));
+    UA_Variant_clear(&compressed);
+}
+
+TEST(Compression, truncated_input_is_rejected)
+{
+    vector<UA_Byte> bytes = makeBytes(3000);
+    UA_Variant value;
+    UA_Variant_setArray(&value, bytes.data(), bytes.size(), &UA_TYPES[UA_TYPES_BYTE]);
+    for (Codec codec : codecs)
+    {
+        vector<UA_Byte> out, scratch;
+        ASSERT_TRUE(compressValue(value, optionsOf(codec), out, scratch));
+        for (size_t size : {header_size, out.size() - 1})
+        {
+            vector<UA_Byte> truncated(out.begin(), out.begin() + size);
+            UA_Variant compressed = compressedVariant(truncated);
+            EXPECT_FALSE(decompressValue(compressed, codec)) << codecName(codec) << " " << size;
+            //!< The value is left unchanged on failure
+            EXPECT_TRUE(UA_Variant_hasScalarType(&compressed, &UA_TYPES[UA_TYPES_BYTESTRING]));
+            EXPECT_EQ(static_cast<const UA_ByteString *>(compressed.data)->length, size);
+            UA_Variant_clear(&compressed);
+        }
+    }
+}
+
+TEST(Compression, corrupted_input_is_rejected)
+{
+    vector<UA_Byte> bytes = makeBytes(3000), out, scratch;
+    UA_Variant value;
+    UA_Variant_setArray(&value, bytes.data(), bytes.size(), &UA_TYPES[UA_TYPES_BYTE]);
+    ASSERT_TRUE(compressValue(value, optionsOf(Codec::Deflate), out, scratch));
+
+    vector<UA_Byte> corrupted = out;
+    corrupted[0] ^= 0xff;
+    UA_Variant compressed = compressedVariant(corrupted);
+    EXPECT_FALSE(isCompressed(compressed));
+    EXPECT_FALSE(decompressValue(compressed, Codec::Deflate));
+    UA_Variant_clear(&compressed);
+
+    //!< The zlib stream carries an Adler-32 checksum of the raw data
+    corrupted = out;
+    corrupted[out.size() - 1] ^= 0xff;
+    compressed = compressedVariant(corrupted);
+    EXPECT_FALSE(decompressValue(compressed, Codec::Deflate));
+    UA_Variant_clear(&compressed);
+
+    //!< Unknown codec in the header
+    corrupted = out;
+    corrupted[4] = 0x7f;
+    compressed = compressedVariant(corrupted);
+    EXPECT_FALSE(isCompressed(compressed));
+    UA_Variant_clear(&compressed);
+
+    //!< The raw size must be a multiple of the element size
+    vector<UA_Double> doubles(16, 1.0);
+    UA_Variant_setArray(&value, doubles.data(), doubles.size(), &UA_TYPES[UA_TYPES_DOUBLE]);
+    ASSERT_TRUE(compressValue(value, optionsOf(Codec::None), out, scratch));
+    out[raw_size_offset] = static_cast<UA_Byte>(out[raw_size_offset] - 1);
+    compressed = compressedVariant(out);
+    EXPECT_FALSE(decompressValue(compressed, Codec::None));
+    UA_Variant_clear(&compressed);
+}
+
+TEST(Compression, mismatched_codec_is_rejected)
+{
+    vector<UA_Byte> bytes = makeBytes(1000);
+    UA_Variant value;
+    UA_Variant_setArray(&value, bytes.data(), bytes.size(), &UA_TYPES[UA_TYPES_BYTE]);
+    for (Codec codec : codecs)
+    {
+        vector<UA_Byte> out, scratch;
+        ASSERT_TRUE(compressValue(value, optionsOf(codec), out, scratch));
+        for (Codec expected : codecs)
+        {
+            if (expected == codec)
+                continue;
+            UA_Variant compressed = compressedVariant(out);
+            EXPECT_FALSE(decompressValue(compressed, expected)) << codecName(codec) << " as " << codecName(expected);
+            UA_Variant_clear(&compressed);
+        }
+    }
+}
+
+TEST(Compression, ratio_guard_rejects_impossible_sizes)
+{
+    //!< 1 MiB of zeros is within the deflate ratio and decodes
+    vector<UA_Byte> zeros(1 << 20, 0), out, scratch;
+    UA_Variant value;
+    UA_Variant_setArray(&value, zeros.data(), zeros.size(), &UA_TYPES[UA_TYPES_BYTE]);
+    ASSERT_TRUE(compressValue(value, optionsOf(Codec::Deflate), out, scratch));
+    UA_Variant compressed = compressedVariant(out);
+    ASSERT_TRUE(decompressValue(compressed, Codec::Deflate));
+    EXPECT_EQ(compressed.arrayLength, zeros.size());
+    UA_Variant_clear(&compressed);
+
+    //!< A raw size beyond 1032 times the payload is rejected before anything is allocated
+    size_t payload_size = out.size() - header_size;
+    UA_UInt64 raw_size = static_cast<UA_UInt64>(payload_size) * 1032 + 1032;
+    for (size_t i = 0; i < 8; ++i)
+        out[raw_size_offset + i] = static_cast<UA_Byte>(raw_size >> (8 * i));
+    compressed = compressedVariant(out);
+    EXPECT_FALSE(decompressValue(compressed, Codec::Deflate));
+    UA_Variant_clear(&compressed);
+
+    for (size_t i = 0; i < 8; ++i)
+        out[raw_size_offset + i] = 0xff;
+    compressed = compressedVariant(out);
+    EXPECT_FALSE(decompressValue(compressed, Codec::Deflate));
+    UA_Variant_clear(&compressed);
+}
+
+TEST(Compression, delta_stride_decoding)
+{
+    vector<UA_Byte> bytes = makeBytes(3 * 640);
+    UA_Variant value;
+    UA_Variant_setArray(&value, bytes.data(), bytes.size(), &UA_TYPES[UA_TYPES_BYTE]);
+    //!< Stride 1, the pixel size, a stride that does not divide the size, and one longer than the data
+    for (UA_UInt32 stride : {1u, 3u, 7u, 5000u})
+    {
+        UA_Variant decoded;
+        ASSERT_TRUE(roundTrip(value, optionsOf(Codec::DeltaDeflate, stride), decoded)) << stride;
+        EXPECT_TRUE(sameValue(value, decoded)) << stride;
+        UA_Variant_clear(&decoded);
+    }
+    //!< A zero stride is stored as 1
+    UA_Variant decoded;
+    ASSERT_TRUE(roundTrip(value, optionsOf(Codec::DeltaDeflate, 0), decoded));
+    EXPECT_TRUE(sameValue(value, decoded));
+    UA_Variant_clear(&decoded);
+}
+
+TEST(Compression, describe_and_parse)
+{
+    EXPECT_EQ(optionsOf(Codec::None).describe(), "none");
+    EXPECT_EQ(optionsOf(Codec::Deflate).describe(), "deflate;level=1");
+    EXPECT_EQ(optionsOf(Codec::DeltaDeflate, 4).describe(), "delta-deflate;level=1;stride=4");
+    for (Codec codec : codecs)
+    {
+        Codec parsed = codec == Codec::None ? Codec::Deflate : Codec::None;
+        EXPECT_TRUE(parseCodec(optionsOf(codec).describe(), parsed));
+        EXPECT_EQ(parsed, codec);
+    }
+    Codec parsed = Codec::None;
+    EXPECT_FALSE(parseCodec("lz4;level=1", parsed));
+    EXPECT_FALSE(parseCodec("", parsed));
+}
+
+} // namespace
@@ -0,0 +1,118 @@
+/**
+ * @file test_content_hash.cpp
+ * @author 赵曦 (535394140@qq.com)
+ * @brief Unit tests of the content hash used by the SkipUnchanged write mode
+ * @version 1.0
+ * @date 2023-03-24
+ *
+ * @copyright Copyright (c) 2023, zhaoxi
+ *
+ */
+
+#include <cstring>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "asmpro/opcua_cs/content_hash.hpp"
+#include "asmpro/opcua_cs/variable.hpp"
+
+using namespace std;
+using namespace ua;
+
+namespace
+{
+
+//! 生成内容确定的测试数据
+vector<UA_Byte> makeData(size_t size)
+{
+    vector<UA_Byte> data(size);
+    for (size_t i = 0; i < size; ++i)
+        data[i] = static_cast<UA_Byte>(i * 131 + 7);
+    return data;
+}
+
+TEST(ContentHash, empty_input_is_stable)
+{
+    EXPECT_EQ(contentHash(nullptr, 0), contentHash(nullptr, 0));
+    EXPECT_NE(contentHash(nullptr, 0), contentHash(nullptr, 0, 1));
+    UA_Byte zero = 0;
+    EXPECT_NE(contentHash(nullptr, 0), contentHash(&zero, 1));
+}
+
+TEST(ContentHash, every_byte_takes_part)
+{
+    // 覆盖不足一个条带、恰好整条带、跨越扰乱分块边界的奇数长度
+    for (size_t size : {1, 7, 63, 64, 65, 127, 1023, 1024, 1025, 4099})
+    {
+        vector<UA_Byte> data = makeData(size);
+        UA_UInt64 h = contentHash(data.data(), size);
+        EXPECT_EQ(h, contentHash(data.data(), size)) << "size = " << size;
+        for (size_t i : {size_t(0), size / 2, size - 1})
+        {
+            data[i] ^= 0x01;
+            EXPECT_NE(h, contentHash(data.data(), size)) << "size = " << size << ", byte = " << i;
+            data[i] ^= 0x01;
+        }
+    }
+}
+
+TEST(ContentHash, trailing_zeros_change_the_hash)
+{
+    vector<UA_Byte> data = makeData(65);
+    data.back() = 0;
+    EXPECT_NE(contentHash(data.data(), 64), contentHash(data.data(), 65));
+}
+
+TEST(ContentHash, seed_chains_blocks)
+{
+    vector<UA_Byte> a = makeData(100), b = makeData(200);
+    UA_UInt64 chained = contentHash(b.data(), b.size(), contentHash(a.data(), a.size()));
+    EXPECT_EQ(chained, contentHash(b.data(), b.size(), contentHash(a.data(), a.size())));
+    EXPECT_NE(chained, contentHash(b.data(), b.size()));
+}
+
+TEST(ContentHash, empty_variant_is_zero)
+{
+    Variable empty;
+    EXPECT_EQ(contentHash(empty.get()), 0);
+}
+
+TEST(ContentHash, unchanged_variant_keeps_its_hash)
+{
+    vector<UA_Byte> data = makeData(1000);
+    Variable lhs(data.data(), &UA_TYPES[UA_TYPES_BYTE], data.size());
+    Variable rhs(data.data(), &UA_TYPES[UA_TYPES_BYTE], data.size());
+    EXPECT_EQ(contentHash(lhs.get()), contentHash(rhs.get()));
+    EXPECT_EQ(contentHash(Variable(3.14).get()), contentHash(Variable(3.14).get()));
+    EXPECT_NE(contentHash(Variable(3.14).get()), contentHash(Variable(2.72).get()));
+}
+
+TEST(ContentHash, type_and_shape_take_part)
+{
+    // 相同字节、不同数据类型
+    UA_UInt64 u64 = 0x4009'1EB8'51EB'851F;
+    UA_Double f64;
+    static_assert(sizeof(u64) == sizeof(f64));
+    memcpy(&f64, &u64, sizeof(f64));
+    EXPECT_NE(contentHash(Variable(u64).get()), contentHash(Variable(f64).get()));
+    // 相同字节、标量与单元素数组
+    UA_Byte byte = 0x5a;
+    EXPECT_NE(contentHash(Variable(byte).get()), contentHash(Variable(&byte, &UA_TYPES[UA_TYPES_BYTE], 1).get()));
+    // 相同字节、String 与 ByteString
+    UA_String str = UA_STRING(const_cast<char *>("content"));
+    EXPECT_NE(contentHash(Variable(&str, &UA_TYPES[UA_TYPES_STRING]).get()),
+              contentHash(Variable(&str, &UA_TYPES[UA_TYPES_BYTESTRING]).get()));
+}
+
+TEST(ContentHash, types_with_pointers_are_hashed_by_content)
+{
+    UA_String lhs[] = {UA_STRING(const_cast<char *>("a")), UA_STRING(const_cast<char *>("bc"))};
+    UA_String rhs[] = {UA_STRING(const_cast<char *>("a")), UA_STRING(const_cast<char *>("bc"))};
+    UA_String other[] = {UA_STRING(const_cast<char *>("ab")), UA_STRING(const_cast<char *>("c"))};
+    UA_UInt64 h = contentHash(Variable(lhs, &UA_TYPES[UA_TYPES_STRING], 2).get());
+    EXPECT_EQ(h, contentHash(Variable(rhs, &UA_TYPES[UA_TYPES_STRING], 2).get()));
+    EXPECT_NE(h, contentHash(Variable(other, &UA_TYPES[UA_TYPES_STRING], 2).get()));
+}
+
+} // namespace
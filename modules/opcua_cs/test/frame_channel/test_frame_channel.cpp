@@ -0,0 +1,188 @@
+/**
+ * @file test_frame_channel.cpp
+ * @author 赵曦 (535394140@qq.com)
+ * @brief Unit tests of the frame channel drop policies and drop counting
+ * @version 1.0
+ * @date 2023-03-24
+ *
+ * @copyright Copyright (c) 2023, zhaoxi
+ *
+ */
+
+#include <stdexcept>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "asmpro/opcua_cs/frame_channel.hpp"
+
+using namespace std;
+using namespace ua;
+
+namespace
+{
+
+//! 读取到的一帧
+struct Frame
+{
+    vector<UA_Byte> data; //!< 帧数据
+    UA_UInt64 seq = 0;    //!< 帧序号
+};
+
+//! 以单字节内容推送一帧
+bool pushByte(FrameChannel &channel, UA_Byte value) { return channel.push(&value, 1); }
+
+//! 读取所有待读取的帧
+vector<Frame> drain(FrameChannel &channel)
+{
+    vector<Frame> frames;
+    while (channel.consume([&](const UA_Byte *data, size_t size, UA_UInt64 seq) {
+        frames.push_back({vector<UA_Byte>(data, data + size), seq});
+    }, 0))
+        ;
+    return frames;
+}
+
+TEST(FrameChannel, frames_are_read_in_order)
+{
+    FrameChannel channel(16);
+    EXPECT_TRUE(pushByte(channel, 10));
+    EXPECT_TRUE(pushByte(channel, 20));
+    vector<Frame> frames = drain(channel);
+    ASSERT_EQ(frames.size(), 2u);
+    EXPECT_EQ(frames[0].data, vector<UA_Byte>{10});
+    EXPECT_EQ(frames[0].seq, 1u);
+    EXPECT_EQ(frames[1].data, vector<UA_Byte>{20});
+    EXPECT_EQ(frames[1].seq, 2u);
+    EXPECT_EQ(channel.pushed(), 2u);
+    EXPECT_EQ(channel.dropped(), 0u);
+}
+
+TEST(FrameChannel, consume_times_out_when_empty)
+{
+    FrameChannel channel(16);
+    bool called = false;
+    EXPECT_FALSE(channel.consume([&](const UA_Byte *, size_t, UA_UInt64) { called = true; }, 1));
+    EXPECT_FALSE(called);
+}
+
+TEST(FrameChannel, drop_oldest_keeps_the_latest_frames)
+{
+    FrameChannel channel(16, 3, FrameChannel::Policy::DropOldest);
+    for (UA_Byte i = 1; i <= 5; ++i)
+        EXPECT_TRUE(pushByte(channel, i));
+    EXPECT_EQ(channel.pushed(), 5u);
+    EXPECT_EQ(channel.dropped(), 2u);
+    // 被丢弃的帧占用了序号，消费者可由序号间隔发现丢帧
+    vector<Frame> frames = drain(channel);
+    ASSERT_EQ(frames.size(), 3u);
+    for (size_t i = 0; i < 3; ++i)
+    {
+        EXPECT_EQ(frames[i].data, vector<UA_Byte>{static_cast<UA_Byte>(i + 3)});
+        EXPECT_EQ(frames[i].seq, i + 3);
+    }
+}
+
+TEST(FrameChannel, drop_newest_keeps_the_cached_frames)
+{
+    FrameChannel channel(16, 3, FrameChannel::Policy::DropNewest);
+    for (UA_Byte i = 1; i <= 3; ++i)
+        EXPECT_TRUE(pushByte(channel, i));
+    EXPECT_FALSE(pushByte(channel, 4));
+    EXPECT_FALSE(pushByte(channel, 5));
+    EXPECT_EQ(channel.pushed(), 5u);
+    EXPECT_EQ(channel.dropped(), 2u);
+    vector<Frame> frames = drain(channel);
+    ASSERT_EQ(frames.size(), 3u);
+    for (size_t i = 0; i < 3; ++i)
+    {
+        EXPECT_EQ(frames[i].data, vector<UA_Byte>{static_cast<UA_Byte>(i + 1)});
+        EXPECT_EQ(frames[i].seq, i + 1);
+    }
+    // 缓冲区释放后重新接收新帧
+    EXPECT_TRUE(pushByte(channel, 6));
+    frames = drain(channel);
+    ASSERT_EQ(frames.size(), 1u);
+    EXPECT_EQ(frames[0].seq, 4u);
+}
+
+TEST(FrameChannel, oversized_frames_are_dropped)
+{
+    for (auto policy : {FrameChannel::Policy::DropOldest, FrameChannel::Policy::DropNewest})
+    {
+        FrameChannel channel(4, 3, policy);
+        vector<UA_Byte> frame(5, 1);
+        EXPECT_FALSE(channel.push(frame.data(), frame.size()));
+        EXPECT_TRUE(channel.push(frame.data(), 4));
+        EXPECT_EQ(channel.pushed(), 2u);
+        EXPECT_EQ(channel.dropped(), 1u);
+        vector<Frame> frames = drain(channel);
+        ASSERT_EQ(frames.size(), 1u);
+        EXPECT_EQ(frames[0].data.size(), 4u);
+        EXPECT_EQ(frames[0].seq, 1u);
+    }
+}
+
+TEST(FrameChannel, slot_being_read_is_not_overwritten)
+{
+    FrameChannel channel(16, 3, FrameChannel::Policy::DropOldest);
+    pushByte(channel, 1);
+    channel.consume([&](const UA_Byte *data, size_t, UA_UInt64) {
+        // 读取期间生产者只能使用其余两个缓冲区
+        for (UA_Byte i = 2; i <= 6; ++i)
+            pushByte(channel, i);
+        EXPECT_EQ(data[0], 1);
+    }, 0);
+    EXPECT_EQ(channel.dropped(), 3u);
+    vector<Frame> frames = drain(channel);
+    ASSERT_EQ(frames.size(), 2u);
+    EXPECT_EQ(frames[0].data, vector<UA_Byte>{5});
+    EXPECT_EQ(frames[1].data, vector<UA_Byte>{6});
+}
+
+TEST(FrameChannel, slot_is_released_when_the_reader_throws)
+{
+    FrameChannel channel(16, 3, FrameChannel::Policy::DropNewest);
+    for (UA_Byte i = 1; i <= 3; ++i)
+        pushByte(channel, i);
+    auto reader = [](const UA_Byte *, size_t, UA_UInt64) { throw runtime_error("reader"); };
+    EXPECT_THROW(channel.consume(reader, 0), runtime_error);
+    EXPECT_TRUE(pushByte(channel, 4));
+    EXPECT_EQ(drain(channel).size(), 3u);
+}
+
+TEST(FrameChannel, at_least_three_slots)
+{
+    FrameChannel channel(16, 1, FrameChannel::Policy::DropNewest);
+    for (UA_Byte i = 1; i <= 3; ++i)
+        EXPECT_TRUE(pushByte(channel, i));
+    EXPECT_FALSE(pushByte(channel, 4));
+}
+
+TEST(FrameChannel, variant_values)
+{
+    FrameChannel channel(64);
+    UA_Variant empty;
+    UA_Variant_init(&empty);
+    EXPECT_FALSE(channel.push(empty));
+
+    UA_UInt16 array[] = {1, 2, 3};
+    UA_Variant value;
+    UA_Variant_setArray(&value, array, 3, &UA_TYPES[UA_TYPES_UINT16]);
+    EXPECT_TRUE(channel.push(value));
+    UA_Byte bytes[] = {7, 8};
+    UA_ByteString str{2, bytes};
+    UA_Variant_setScalar(&value, &str, &UA_TYPES[UA_TYPES_BYTESTRING]);
+    EXPECT_TRUE(channel.push(value));
+    // 含指针的类型不能按内存拷贝
+    UA_String strings[] = {UA_STRING(const_cast<char *>("a"))};
+    UA_Variant_setArray(&value, strings, 1, &UA_TYPES[UA_TYPES_STRING]);
+    EXPECT_FALSE(channel.push(value));
+
+    vector<Frame> frames = drain(channel);
+    ASSERT_EQ(frames.size(), 2u);
+    EXPECT_EQ(frames[0].data.size(), sizeof(array));
+    EXPECT_EQ(frames[1].data, vector<UA_Byte>(bytes, bytes + 2));
+}
+
+} // namespace
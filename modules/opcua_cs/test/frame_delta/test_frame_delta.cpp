@@ -0,0 +1,220 @@
+/**
+ * @file test_frame_delta.cpp
+ * @author 赵曦 (535394140@qq.com)
+ * @brief Unit tests of the dirty-tile delta encoder and the client-side assembler
+ * @version 1.0
+ * @date 2023-03-24
+ *
+ * @copyright Copyright (c) 2023, zhaoxi
+ *
+ */
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "asmpro/opcua_cs/frame_delta.hpp"
+
+using namespace std;
+using namespace ua;
+
+namespace
+{
+
+//! 差分首部与区段表项的字节数
+constexpr size_t header_size = 32;
+constexpr size_t run_size = 16;
+
+//! 生成内容确定的测试帧
+vector<UA_Byte> makeFrame(size_t size, UA_Byte seed = 0)
+{
+    vector<UA_Byte> frame(size);
+    for (size_t i = 0; i < size; ++i)
+        frame[i] = static_cast<UA_Byte>(i * 31 + seed);
+    return frame;
+}
+
+//! 关闭周期性完整帧的差分参数
+DeltaOptions noKeyframes(UA_UInt32 tile_size = 4096)
+{
+    DeltaOptions options;
+    options.tile_size = tile_size;
+    options.keyframe_interval = 0;
+    return options;
+}
+
+TEST(FrameDelta, first_frame_is_a_keyframe)
+{
+    DeltaEncoder encoder(noKeyframes());
+    DeltaAssembler assembler;
+    vector<UA_Byte> frame = makeFrame(10000), out;
+    encoder.encode(frame.data(), frame.size(), out);
+    EXPECT_EQ(out.size(), header_size + run_size + frame.size());
+    EXPECT_EQ(encoder.keyframes(), 1u);
+    ASSERT_TRUE(assembler.apply(out.data(), out.size()));
+    EXPECT_EQ(assembler.frame(), frame);
+    EXPECT_EQ(assembler.seq(), 1u);
+}
+
+TEST(FrameDelta, unchanged_frame_has_no_runs)
+{
+    DeltaEncoder encoder(noKeyframes());
+    DeltaAssembler assembler;
+    vector<UA_Byte> frame = makeFrame(10000), out;
+    encoder.encode(frame.data(), frame.size(), out);
+    assembler.apply(out.data(), out.size());
+    encoder.encode(frame.data(), frame.size(), out);
+    EXPECT_EQ(out.size(), header_size);
+    ASSERT_TRUE(assembler.apply(out.data(), out.size()));
+    EXPECT_EQ(assembler.frame(), frame);
+    EXPECT_EQ(assembler.seq(), 2u);
+    EXPECT_EQ(encoder.keyframes(), 1u);
+}
+
+TEST(FrameDelta, round_trip_of_dirty_tiles)
+{
+    // 10000 字节、块大小 4096：最后一块只有 1808 字节
+    DeltaEncoder encoder(noKeyframes());
+    DeltaAssembler assembler;
+    vector<UA_Byte> frame = makeFrame(10000), out;
+    encoder.encode(frame.data(), frame.size(), out);
+    assembler.apply(out.data(), out.size());
+
+    frame[9999] ^= 0xff;
+    encoder.encode(frame.data(), frame.size(), out);
+    EXPECT_EQ(out.size(), header_size + run_size + (10000 - 2 * 4096));
+    ASSERT_TRUE(assembler.apply(out.data(), out.size()));
+    EXPECT_EQ(assembler.frame(), frame);
+
+    frame[0] ^= 0xff;
+    encoder.encode(frame.data(), frame.size(), out);
+    EXPECT_EQ(out.size(), header_size + run_size + 4096);
+    ASSERT_TRUE(assembler.apply(out.data(), out.size()));
+    EXPECT_EQ(assembler.frame(), frame);
+}
+
+TEST(FrameDelta, adjacent_tiles_form_one_run)
+{
+    DeltaEncoder encoder(noKeyframes(64));
+    DeltaAssembler assembler;
+    vector<UA_Byte> frame = makeFrame(64 * 16 + 3), out;
+    encoder.encode(frame.data(), frame.size(), out);
+    assembler.apply(out.data(), out.size());
+    // 第 1、2 块相邻，第 5 块单独成段
+    frame[64] ^= 1;
+    frame[128] ^= 1;
+    frame[320] ^= 1;
+    encoder.encode(frame.data(), frame.size(), out);
+    EXPECT_EQ(out.size(), header_size + 2 * run_size + 3 * 64);
+    ASSERT_TRUE(assembler.apply(out.data(), out.size()));
+    EXPECT_EQ(assembler.frame(), frame);
+}
+
+TEST(FrameDelta, large_change_falls_back_to_a_keyframe)
+{
+    DeltaEncoder encoder(noKeyframes(64));
+    DeltaAssembler assembler;
+    vector<UA_Byte> frame = makeFrame(4096), out;
+    encoder.encode(frame.data(), frame.size(), out);
+    assembler.apply(out.data(), out.size());
+    frame = makeFrame(4096, 1);
+    encoder.encode(frame.data(), frame.size(), out);
+    EXPECT_EQ(encoder.keyframes(), 2u);
+    ASSERT_TRUE(assembler.apply(out.data(), out.size()));
+    EXPECT_EQ(assembler.frame(), frame);
+}
+
+TEST(FrameDelta, size_change_and_interval_force_keyframes)
+{
+    DeltaOptions options;
+    options.keyframe_interval = 3;
+    DeltaEncoder encoder(options);
+    vector<UA_Byte> frame = makeFrame(1000), out;
+    for (int i = 0; i < 4; ++i)
+        encoder.encode(frame.data(), frame.size(), out);
+    // 第 1、4 帧为完整帧
+    EXPECT_EQ(encoder.keyframes(), 2u);
+    frame.resize(999);
+    encoder.encode(frame.data(), frame.size(), out);
+    EXPECT_EQ(encoder.keyframes(), 3u);
+}
+
+TEST(FrameDelta, gap_is_discarded_until_the_next_keyframe)
+{
+    DeltaOptions options = noKeyframes(64);
+    options.keyframe_interval = 4;
+    DeltaEncoder encoder(options);
+    DeltaAssembler assembler;
+    vector<UA_Byte> frame = makeFrame(1024), out;
+    encoder.encode(frame.data(), frame.size(), out);
+    assembler.apply(out.data(), out.size());
+    // 丢失第 2 帧
+    frame[0] ^= 1;
+    encoder.encode(frame.data(), frame.size(), out);
+    frame[100] ^= 1;
+    encoder.encode(frame.data(), frame.size(), out);
+    EXPECT_FALSE(assembler.apply(out.data(), out.size()));
+    EXPECT_EQ(assembler.gaps(), 1u);
+    frame[200] ^= 1;
+    encoder.encode(frame.data(), frame.size(), out);
+    EXPECT_FALSE(assembler.apply(out.data(), out.size()));
+    EXPECT_EQ(assembler.discarded(), 2u);
+    // 第 5 帧为完整帧，重新同步
+    encoder.encode(frame.data(), frame.size(), out);
+    ASSERT_TRUE(assembler.apply(out.data(), out.size()));
+    EXPECT_EQ(assembler.frame(), frame);
+    EXPECT_EQ(assembler.seq(), 5u);
+}
+
+TEST(FrameDelta, empty_frames)
+{
+    DeltaEncoder encoder(noKeyframes());
+    DeltaAssembler assembler;
+    UA_Byte dummy = 0;
+    vector<UA_Byte> out;
+    encoder.encode(&dummy, 0, out);
+    ASSERT_TRUE(assembler.apply(out.data(), out.size()));
+    EXPECT_TRUE(assembler.frame().empty());
+    encoder.encode(&dummy, 0, out);
+    EXPECT_EQ(out.size(), header_size);
+    EXPECT_TRUE(assembler.apply(out.data(), out.size()));
+}
+
+TEST(FrameDelta, malformed_input_is_rejected)
+{
+    DeltaAssembler assembler;
+    EXPECT_FALSE(assembler.apply(nullptr, 0));
+    DeltaEncoder encoder(noKeyframes());
+    vector<UA_Byte> frame = makeFrame(1000), out;
+    encoder.encode(frame.data(), frame.size(), out);
+    // 截断的首部、截断的数据、错误的魔数
+    EXPECT_FALSE(assembler.apply(out.data(), header_size - 1));
+    EXPECT_FALSE(assembler.apply(out.data(), out.size() - 1));
+    vector<UA_Byte> corrupted = out;
+    corrupted[0] ^= 0xff;
+    EXPECT_FALSE(assembler.apply(corrupted.data(), corrupted.size()));
+    EXPECT_EQ(assembler.applied(), 0u);
+    EXPECT_TRUE(assembler.apply(out.data(), out.size()));
+}
+
+TEST(FrameDelta, variant_values)
+{
+    DeltaEncoder encoder(noKeyframes());
+    DeltaAssembler assembler;
+    vector<UA_Byte> out;
+    UA_Variant empty;
+    UA_Variant_init(&empty);
+    EXPECT_FALSE(encoder.encode(empty, out));
+
+    vector<UA_Byte> frame = makeFrame(333);
+    UA_Variant array;
+    UA_Variant_setArray(&array, frame.data(), frame.size(), &UA_TYPES[UA_TYPES_BYTE]);
+    ASSERT_TRUE(encoder.encode(array, out));
+    UA_ByteString str{out.size(), out.data()};
+    UA_Variant delta;
+    UA_Variant_setScalar(&delta, &str, &UA_TYPES[UA_TYPES_BYTESTRING]);
+    ASSERT_TRUE(assembler.apply(delta));
+    EXPECT_EQ(assembler.frame(), frame);
+}
+
+} // namespace
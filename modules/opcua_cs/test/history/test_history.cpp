@@ -0,0 +1,181 @@
+/**
+ * @file test_history.cpp
+ * @author 赵曦 (535394140@qq.com)
+ * @brief Unit tests of the history storage: chunked range reads, spill rotation and key clamping
+ * @version 1.0
+ * @date 2023-03-24
+ *
+ * @copyright Copyright (c) 2023, zhaoxi
+ *
+ */
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "asmpro/opcua_cs/history.hpp"
+
+using namespace std;
+using namespace ua;
+
+namespace
+{
+
+//! 以 Double 值与源时间戳创建一个样本
+UA_DataValue makeSample(double value, UA_DateTime source_timestamp)
+{
+    UA_DataValue sample;
+    UA_DataValue_init(&sample);
+    UA_Variant_setScalarCopy(&sample.value, &value, &UA_TYPES[UA_TYPES_DOUBLE]);
+    sample.hasValue = true;
+    sample.sourceTimestamp = source_timestamp;
+    sample.hasSourceTimestamp = true;
+    return sample;
+}
+
+//! 追加一个样本
+void append(HistoryBuffer &history, double value, UA_DateTime source_timestamp)
+{
+    UA_DataValue sample = makeSample(value, source_timestamp);
+    history.append(sample);
+    UA_DataValue_clear(&sample);
+}
+
+//! 取出并释放读取到的样本的值
+vector<double> takeValues(vector<UA_DataValue> &values)
+{
+    vector<double> result;
+    for (auto &value : values)
+    {
+        EXPECT_TRUE(UA_Variant_hasScalarType(&value.value, &UA_TYPES[UA_TYPES_DOUBLE]));
+        if (UA_Variant_hasScalarType(&value.value, &UA_TYPES[UA_TYPES_DOUBLE]))
+            result.push_back(*static_cast<double *>(value.value.data));
+        UA_DataValue_clear(&value);
+    }
+    values.clear();
+    return result;
+}
+
+//! 以 max_values 为块大小读完整个范围，返回各块的值
+vector<vector<double>> readChunks(const HistoryBuffer &history, UA_DateTime start, UA_DateTime end,
+                                  size_t max_values)
+{
+    vector<vector<double>> chunks;
+    vector<UA_DataValue> values;
+    UA_UInt64 from = 0;
+    do
+    {
+        from = history.read(start, end, max_values, from, values);
+        chunks.push_back(takeValues(values));
+    } while (from != 0 && chunks.size() < 100);
+    return chunks;
+}
+
+//! 样本值 1 ~ 6，键依次为 10 ~ 60
+void fillSix(HistoryBuffer &history)
+{
+    for (int i = 1; i <= 6; ++i)
+        append(history, i, i * 10);
+}
+
+TEST(HistoryBuffer, forward_read_in_chunks)
+{
+    HistoryBuffer history(HistoryOptions{8});
+    fillSix(history);
+    EXPECT_EQ(history.size(), 6u);
+    vector<vector<double>> expected{{1, 2}, {3, 4}, {5, 6}};
+    EXPECT_EQ(readChunks(history, 0, 0, 2), expected);
+    expected = {{2, 3}, {4}};
+    EXPECT_EQ(readChunks(history, 20, 50, 2), expected);
+    expected = {{1, 2, 3, 4, 5, 6}};
+    EXPECT_EQ(readChunks(history, 0, 0, 0), expected);
+}
+
+TEST(HistoryBuffer, forward_read_resumes_from_the_continuation_point)
+{
+    HistoryBuffer history(HistoryOptions{8});
+    fillSix(history);
+    vector<UA_DataValue> values;
+    UA_UInt64 from = history.read(0, 0, 3, 0, values);
+    ASSERT_NE(from, 0u);
+    EXPECT_EQ(takeValues(values), (vector<double>{1, 2, 3}));
+    //!< Samples appended between the chunks are read by the next chunk
+    append(history, 7, 70);
+    EXPECT_EQ(history.read(0, 0, 0, from, values), 0u);
+    EXPECT_EQ(takeValues(values), (vector<double>{4, 5, 6, 7}));
+}
+
+TEST(HistoryBuffer, reverse_read_in_chunks)
+{
+    HistoryBuffer history(HistoryOptions{8});
+    fillSix(history);
+    //!< end earlier than start reads (end, start] from the newest sample
+    vector<vector<double>> expected{{6, 5}, {4, 3}, {2}};
+    EXPECT_EQ(readChunks(history, 60, 10, 2), expected);
+    expected = {{5, 4, 3}, {2}};
+    EXPECT_EQ(readChunks(history, 50, 15, 3), expected);
+    //!< A chunk ending exactly at the bottom of the range finishes the read
+    expected = {{6, 5}, {4, 3}, {2, 1}};
+    EXPECT_EQ(readChunks(history, 60, 5, 2), expected);
+}
+
+TEST(HistoryBuffer, ring_drops_the_oldest_samples_without_spilling)
+{
+    HistoryBuffer history(HistoryOptions{3});
+    EXPECT_FALSE(history.spilling());
+    for (int i = 1; i <= 5; ++i)
+        append(history, i, i * 10);
+    EXPECT_EQ(history.size(), 3u);
+    EXPECT_EQ(history.spilled(), 0u);
+    EXPECT_EQ(history.dropped(), 2u);
+    vector<vector<double>> expected{{3, 4, 5}};
+    EXPECT_EQ(readChunks(history, 0, 0, 0), expected);
+}
+
+TEST(HistoryBuffer, spill_rotation_drops_the_recycled_segment)
+{
+    UA_DataValue sample = makeSample(0, 0);
+    size_t sample_size = UA_calcSizeBinary(&sample, &UA_TYPES[UA_TYPES_DATAVALUE]);
+    UA_DataValue_clear(&sample);
+    //!< Every segment holds exactly two samples
+    HistoryOptions options;
+    options.capacity = 2;
+    options.segment_size = 2 * sample_size;
+    HistoryBuffer history(options);
+    ASSERT_TRUE(history.spilling());
+    for (int i = 1; i <= 10; ++i)
+        append(history, i, i * 10);
+    //!< 1 ~ 8 are spilled, 1 ~ 4 are dropped by two rotations, 5 ~ 8 stay in the segments and 9 ~ 10 in the ring
+    EXPECT_EQ(history.spilled(), 8u);
+    EXPECT_EQ(history.dropped(), 4u);
+    EXPECT_EQ(history.size(), 6u);
+    vector<vector<double>> expected{{5, 6, 7, 8}, {9, 10}};
+    EXPECT_EQ(readChunks(history, 0, 0, 4), expected);
+    expected = {{10, 9, 8}, {7, 6, 5}};
+    EXPECT_EQ(readChunks(history, 100, 10, 3), expected);
+    expected = {{6, 7}};
+    EXPECT_EQ(readChunks(history, 60, 80, 0), expected);
+}
+
+TEST(HistoryBuffer, out_of_order_keys_are_clamped)
+{
+    HistoryBuffer history(HistoryOptions{8});
+    append(history, 1, 100);
+    append(history, 2, 50);
+    append(history, 3, 200);
+    //!< The second sample is keyed at 100, the key of the sample before it
+    vector<vector<double>> expected{{1, 2}};
+    EXPECT_EQ(readChunks(history, 100, 150, 0), expected);
+    expected = {vector<double>()};
+    EXPECT_EQ(readChunks(history, 50, 100, 0), expected);
+    expected = {{2, 1}};
+    EXPECT_EQ(readChunks(history, 150, 99, 0), expected);
+    //!< Only the key is clamped, the stored source timestamp is kept
+    vector<UA_DataValue> values;
+    history.read(0, 0, 0, 0, values);
+    ASSERT_EQ(values.size(), 3u);
+    EXPECT_EQ(values[1].sourceTimestamp, 50);
+    EXPECT_EQ(takeValues(values), (vector<double>{1, 2, 3}));
+}
+
+} // namespace
@@ -0,0 +1,182 @@
+/**
+ * @file test_image_preview.cpp
+ * @author 赵曦 (535394140@qq.com)
+ * @brief Unit tests of the image preview kernels: crop, Mono8 conversion and downscaling
+ * @version 1.0
+ * @date 2023-03-24
+ *
+ * @copyright Copyright (c) 2023, zhaoxi
+ *
+ */
+
+#include <cstdlib>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "asmpro/opcua_cs/image_preview.hpp"
+
+using namespace std;
+using namespace ua;
+
+namespace
+{
+
+//! 生成内容确定的测试图像，像素值由坐标与通道决定
+vector<UA_Byte> makeImage(UA_UInt32 width, UA_UInt32 height, UA_UInt32 channels)
+{
+    vector<UA_Byte> image(size_t(width) * height * channels);
+    for (UA_UInt32 y = 0; y < height; ++y)
+        for (UA_UInt32 x = 0; x < width; ++x)
+            for (UA_UInt32 c = 0; c < channels; ++c)
+                image[(size_t(y) * width + x) * channels + c] = static_cast<UA_Byte>(x * 37 + y * 11 + c * 71);
+    return image;
+}
+
+//! 按定义计算的区域平均，四舍五入
+UA_Byte boxAverage(const vector<UA_Byte> &src, const ImagePreview &p, UA_UInt32 x, UA_UInt32 y, UA_UInt32 c)
+{
+    UA_UInt32 fx = p.roiWidth() / p.outWidth(), fy = p.roiHeight() / p.outHeight();
+    UA_UInt32 sum = 0;
+    for (UA_UInt32 j = 0; j < fy; ++j)
+        for (UA_UInt32 i = 0; i < fx; ++i)
+            sum += src[((size_t(p.roi_y) + y * fy + j) * p.src_width + p.roi_x + x * fx + i) * p.src_channels + c];
+    return static_cast<UA_Byte>((sum + fx * fy / 2) / (fx * fy));
+}
+
+TEST(ImagePreview, valid_rejects_bad_parameters)
+{
+    ImagePreview p;
+    EXPECT_FALSE(p.valid());
+    p.src_width = 8;
+    p.src_height = 6;
+    EXPECT_TRUE(p.valid());
+    p.roi_x = 8;
+    EXPECT_FALSE(p.valid());
+    p.roi_x = 4;
+    p.roi_width = 5;
+    EXPECT_FALSE(p.valid());
+    p.roi_width = 4;
+    p.width = 5;
+    EXPECT_FALSE(p.valid());
+    p.width = 4;
+    EXPECT_TRUE(p.valid());
+}
+
+TEST(ImagePreview, identity_copies_the_image)
+{
+    ImagePreview p;
+    p.src_width = 7;
+    p.src_height = 5;
+    vector<UA_Byte> src = makeImage(7, 5, 3), dst(p.outSize());
+    vector<UA_UInt32> buffer;
+    ASSERT_TRUE(p.valid());
+    makePreview(src.data(), p, dst.data(), buffer);
+    EXPECT_EQ(src, dst);
+}
+
+TEST(ImagePreview, roi_crops_odd_sizes)
+{
+    ImagePreview p;
+    p.src_width = 9;
+    p.src_height = 7;
+    p.roi_x = 3;
+    p.roi_y = 1;
+    p.roi_width = 5;
+    p.roi_height = 3;
+    vector<UA_Byte> src = makeImage(9, 7, 3), dst(p.outSize());
+    vector<UA_UInt32> buffer;
+    ASSERT_TRUE(p.valid());
+    ASSERT_EQ(dst.size(), 5u * 3 * 3);
+    makePreview(src.data(), p, dst.data(), buffer);
+    for (UA_UInt32 y = 0; y < 3; ++y)
+        for (UA_UInt32 x = 0; x < 15; ++x)
+            EXPECT_EQ(dst[y * 15 + x], src[(size_t(y) + 1) * 27 + 9 + x]) << "x = " << x << ", y = " << y;
+}
+
+TEST(ImagePreview, mono_keeps_gray_levels)
+{
+    vector<UA_Byte> src, dst(256);
+    for (int v = 0; v < 256; ++v)
+        src.insert(src.end(), 3, static_cast<UA_Byte>(v));
+    bgrToMono(src.data(), dst.data(), 256);
+    for (int v = 0; v < 256; ++v)
+        EXPECT_EQ(dst[v], v);
+    // 纯色通道按 BT.601 系数加权
+    UA_Byte bgr[] = {255, 0, 0, 0, 255, 0, 0, 0, 255}, mono[3];
+    bgrToMono(bgr, mono, 3);
+    EXPECT_EQ(mono[0], 29);
+    EXPECT_EQ(mono[1], 149);
+    EXPECT_EQ(mono[2], 77);
+}
+
+TEST(ImagePreview, box_downscale_averages)
+{
+    ImagePreview p;
+    p.src_width = 9;
+    p.src_height = 6;
+    p.width = 3;
+    p.height = 2;
+    vector<UA_Byte> src = makeImage(9, 6, 3), dst(p.outSize());
+    vector<UA_UInt32> buffer;
+    ASSERT_TRUE(p.valid());
+    makePreview(src.data(), p, dst.data(), buffer);
+    // 定点倒数的舍入与整数除法最多相差 1
+    for (UA_UInt32 y = 0; y < 2; ++y)
+        for (UA_UInt32 x = 0; x < 3; ++x)
+            for (UA_UInt32 c = 0; c < 3; ++c)
+                EXPECT_LE(abs(dst[(y * 3 + x) * 3 + c] - boxAverage(src, p, x, y, c)), 1);
+}
+
+TEST(ImagePreview, mono_downscale_of_a_gray_image)
+{
+    ImagePreview p;
+    p.src_width = 8;
+    p.src_height = 4;
+    p.width = 2;
+    p.height = 1;
+    p.mono = true;
+    vector<UA_Byte> src(p.srcSize(), 200), dst(p.outSize());
+    vector<UA_UInt32> buffer;
+    ASSERT_EQ(p.outChannels(), 1u);
+    makePreview(src.data(), p, dst.data(), buffer);
+    EXPECT_EQ(dst, vector<UA_Byte>(2, 200));
+}
+
+TEST(ImagePreview, nearest_downscale_samples_centers)
+{
+    // 5 → 2 不是整数倍，取目标像素中心对应的源像素：x = 1, 3
+    ImagePreview p;
+    p.src_width = 5;
+    p.src_height = 5;
+    p.src_channels = 1;
+    p.width = 2;
+    p.height = 2;
+    vector<UA_Byte> src = makeImage(5, 5, 1), dst(p.outSize());
+    vector<UA_UInt32> buffer;
+    makePreview(src.data(), p, dst.data(), buffer);
+    EXPECT_EQ(dst[0], src[1 * 5 + 1]);
+    EXPECT_EQ(dst[1], src[1 * 5 + 3]);
+    EXPECT_EQ(dst[2], src[3 * 5 + 1]);
+    EXPECT_EQ(dst[3], src[3 * 5 + 3]);
+}
+
+TEST(ImagePreview, buffer_is_reusable)
+{
+    ImagePreview box, nearest;
+    box.src_width = nearest.src_width = 12;
+    box.src_height = nearest.src_height = 8;
+    box.width = 4;
+    box.height = 4;
+    nearest.width = 5;
+    nearest.height = 3;
+    vector<UA_Byte> src = makeImage(12, 8, 3);
+    vector<UA_Byte> first(box.outSize()), second(box.outSize()), other(nearest.outSize());
+    vector<UA_UInt32> buffer;
+    makePreview(src.data(), box, first.data(), buffer);
+    makePreview(src.data(), nearest, other.data(), buffer);
+    makePreview(src.data(), box, second.data(), buffer);
+    EXPECT_EQ(first, second);
+}
+
+} // namespace
@@ -0,0 +1,165 @@
+/**
+ * @file test_write_scheduler.cpp
+ * @author 赵曦 (535394140@qq.com)
+ * @brief Unit tests of the write scheduler: coalescing and the resolution of superseded writes
+ * @version 1.0
+ * @date 2023-03-24
+ *
+ * @copyright Copyright (c) 2023, zhaoxi
+ *
+ */
+
+#include <limits>
+#include <memory>
+
+#include <gtest/gtest.h>
+
+#include "asmpro/opcua_cs/write_scheduler.hpp"
+
+#include "bench_utility.hpp"
+
+using namespace std;
+using namespace ua;
+
+namespace
+{
+
+constexpr UA_UInt16 port = 4867;
+
+//! 批量写入的频率，最小间隔远大于测试中连续提交写入的耗时
+constexpr double slow_rate = 1.0;
+
+void buildModel()
+{
+    Server::addVariableNode("Gain", "Gain of the camera", 1.0);
+    Server::addVariableNode("Exposure", "Exposure time of the camera", 1000.0);
+}
+
+//! 读取 Double 变量的值，读取失败时返回 NaN
+double readDouble(Client &client, const UA_NodeId &node_id)
+{
+    Variable value = client.readVariable(node_id);
+    if (!UA_Variant_hasScalarType(&value.get(), &UA_TYPES[UA_TYPES_DOUBLE]))
+        return numeric_limits<double>::quiet_NaN();
+    return *static_cast<const double *>(value.get().data);
+}
+
+class WriteSchedulerTest : public ::testing::Test
+{
+protected:
+    static void SetUpTestSuite()
+    {
+        //!< The server runs in a child process, spawned before the scheduler threads exist
+        server = bench::spawnServer(port, buildModel);
+        if (server < 0)
+            return;
+        client = make_unique<Client>();
+        client->connect("opc.tcp://localhost:" + to_string(port));
+        gain_id = client->findNodeId(objects_id, 1, "Gain");
+        exposure_id = client->findNodeId(objects_id, 1, "Exposure");
+    }
+
+    static void TearDownTestSuite()
+    {
+        if (client != nullptr)
+            client->disconnect();
+        client.reset();
+        UA_NodeId_clear(&gain_id);
+        UA_NodeId_clear(&exposure_id);
+        bench::stopServer(server);
+    }
+
+    void SetUp() override { ASSERT_GT(server, 0) << "Failed to start the server on port " << port; }
+
+    /**
+     * @brief 写入一个值并等待确认，之后的写入在最小间隔内被合并为下一次批量写入
+     *
+     * @param scheduler 写入调度器
+     */
+    static void prime(WriteScheduler &scheduler)
+    {
+        ASSERT_EQ(scheduler.write(gain_id, 0.0).get(), UA_STATUSCODE_GOOD);
+    }
+
+    static inline pid_t server = -1;
+    static inline unique_ptr<Client> client;
+    static inline UA_NodeId objects_id = UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER);
+    static inline UA_NodeId gain_id, exposure_id;
+};
+
+TEST_F(WriteSchedulerTest, single_write_is_acknowledged)
+{
+    WriteScheduler scheduler(*client, slow_rate);
+    EXPECT_EQ(scheduler.write(gain_id, 2.5).get(), UA_STATUSCODE_GOOD);
+    EXPECT_EQ(scheduler.submitted(), 1u);
+    EXPECT_EQ(scheduler.written(), 1u);
+    EXPECT_EQ(scheduler.batches(), 1u);
+    EXPECT_EQ(readDouble(*client, gain_id), 2.5);
+}
+
+TEST_F(WriteSchedulerTest, writes_to_one_variable_are_coalesced)
+{
+    WriteScheduler scheduler(*client, slow_rate);
+    prime(scheduler);
+    vector<future<UA_StatusCode>> results;
+    for (int i = 1; i <= 20; ++i)
+        results.push_back(scheduler.write(gain_id, static_cast<double>(i)));
+    for (auto &result : results)
+        EXPECT_EQ(result.get(), UA_STATUSCODE_GOOD);
+    //!< Only the latest value is sent, in a single request
+    EXPECT_EQ(scheduler.submitted(), 21u);
+    EXPECT_EQ(scheduler.written(), 2u);
+    EXPECT_EQ(scheduler.batches(), 2u);
+    EXPECT_EQ(readDouble(*client, gain_id), 20.0);
+}
+
+TEST_F(WriteSchedulerTest, writes_to_different_variables_share_one_batch)
+{
+    WriteScheduler scheduler(*client, slow_rate);
+    prime(scheduler);
+    auto gain = scheduler.write(gain_id, 3.0);
+    auto exposure = scheduler.write(exposure_id, 2000.0);
+    EXPECT_EQ(gain.get(), UA_STATUSCODE_GOOD);
+    EXPECT_EQ(exposure.get(), UA_STATUSCODE_GOOD);
+    EXPECT_EQ(scheduler.written(), 3u);
+    EXPECT_EQ(scheduler.batches(), 2u);
+    EXPECT_EQ(readDouble(*client, gain_id), 3.0);
+    EXPECT_EQ(readDouble(*client, exposure_id), 2000.0);
+}
+
+TEST_F(WriteSchedulerTest, superseded_write_takes_the_status_of_the_newer_value)
+{
+    WriteScheduler scheduler(*client, slow_rate);
+    prime(scheduler);
+    //!< A value the server would reject is replaced by a valid one before it is sent
+    auto rejected = scheduler.write(gain_id, "not a number");
+    auto accepted = scheduler.write(gain_id, 4.0);
+    EXPECT_EQ(rejected.get(), UA_STATUSCODE_GOOD);
+    EXPECT_EQ(accepted.get(), UA_STATUSCODE_GOOD);
+    EXPECT_EQ(readDouble(*client, gain_id), 4.0);
+
+    //!< And the other way round, the valid value is resolved with the rejection of its successor
+    auto valid = scheduler.write(gain_id, 5.0);
+    auto invalid = scheduler.write(gain_id, "not a number");
+    UA_StatusCode status = invalid.get();
+    EXPECT_NE(status, UA_STATUSCODE_GOOD);
+    EXPECT_EQ(valid.get(), status);
+    EXPECT_EQ(readDouble(*client, gain_id), 4.0);
+    EXPECT_EQ(scheduler.written(), 3u);
+}
+
+TEST_F(WriteSchedulerTest, pending_writes_are_sent_on_destruction)
+{
+    future<UA_StatusCode> result;
+    {
+        //!< The interval is far longer than the test, only the destructor flushes the write
+        WriteScheduler scheduler(*client, 0.01);
+        prime(scheduler);
+        result = scheduler.write(gain_id, 6.0);
+    }
+    ASSERT_EQ(result.wait_for(chrono::seconds(0)), future_status::ready);
+    EXPECT_EQ(result.get(), UA_STATUSCODE_GOOD);
+    EXPECT_EQ(readDouble(*client, gain_id), 6.0);
+}
+
+} // namespace
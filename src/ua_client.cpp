@@ -10,42 +10,103 @@
  */
 
 #include <iostream>
+#include <vector>
 
 #include <opencv2/highgui.hpp>
 #include <opencv2/imgproc.hpp>
 
 #include "asmpro/opcua_cs/client.hpp"
+#include "asmpro/opcua_cs/frame_channel.hpp"
+#include "asmpro/opcua_cs/image_mat.hpp"
+#include "asmpro/opcua_cs/latency_probe.hpp"
+#include "asmpro/opcua_cs/latency_tracer.hpp"
+#include "asmpro/opcua_cs/shm_channel.hpp"
+#include "asmpro/opcua_cs/trace.hpp"
 
 using namespace std;
 using namespace cv;
 using namespace ua;
 
-void imageChange(UA_Client *client, UA_UInt32 subId, void *subContext, UA_UInt32 monId,
-                 void *monContext, UA_DataValue *value)
-{
-    UA_Variant v = value->value;
-    if (v.arrayLength != 640 * 480 * 3)
-        throw v.arrayLength;
-    Mat img(Size(640, 480), CV_8UC3, v.data);
-    imshow("img", img);
-    waitKey(1);
-}
-
 int main(int argc, char *argv[])
 {
+    // ua_client [trace.json]，指定路径时记录客户端请求与回调的追踪区间，退出时导出
+    if (argc > 1)
+        Trace::enable();
+
     Client client;
     client.connect("opc.tcp://localhost:4840");
     UA_NodeId node_id = UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER);
     node_id = client.findNodeId(node_id, 1, "VisionServer");
+    UA_NodeId vision_server_id = node_id;
     node_id = client.findNodeId(node_id, 1, "Camera[1]");
     node_id = client.findNodeId(node_id, 1, "Image");
 
-    UA_UInt32 sub_id = client.createSubscription();
-    client.createVariableMonitor(sub_id, node_id, imageChange);
+    // 记录图像从采集到回调结束各阶段的延迟
+    auto tracer = make_shared<LatencyTracer>();
+    client.setTracer(tracer);
+
+    // 与服务器位于同一主机时，直接从图像变量 SharedMemory 属性给出的共享内存通道读取图像
+    unique_ptr<ShmReader> reader;
+    Variable shm_name = client.readVariable(client.findNodeId(node_id, 1, "SharedMemory"));
+    if (UA_Variant_hasScalarType(&shm_name.get(), &UA_TYPES[UA_TYPES_STRING]))
+    {
+        auto str = static_cast<const UA_String *>(shm_name.get().data);
+        reader = make_unique<ShmReader>(string(reinterpret_cast<const char *>(str->data), str->length));
+        if (!reader->isOpen())
+            reader.reset();
+    }
+
+    // 否则订阅图像变量，网络回调只负责将图像拷贝至预分配的帧缓冲区，显示在主线程中完成
+    FrameChannel channel(sizeof(ImageHeader) + 640 * 480 * 3);
+    if (reader == nullptr)
+    {
+        UA_UInt32 sub_id = client.createSubscription();
+        client.createVariableMonitors(sub_id, {node_id}, {[&channel](UA_UInt32, const UA_DataValue &value) {
+                                          channel.push(value.value);
+                                      }});
+    }
+
+    // 每秒进行一次时间戳交换，估计网络单向延迟与时钟偏差
+    LatencyProbe probe(client, client.findNodeId(vision_server_id, 1, "LatencyProbe"), vision_server_id);
+    probe.start(1000);
 
     namedWindow("img");
-    while (true)
-        client.runIterate(0);
+    // 后台事件循环阻塞在网络层等待通知，按下 ESC 键退出
+    client.start();
+    // 图像的尺寸与像素格式由首部给出，直接引用帧缓冲区显示
+    auto show = [](const UA_Byte *data, size_t size) {
+        ImageHeader header;
+        const UA_Byte *pixels = nullptr;
+        if (!decodeImage(data, size, header, pixels))
+            return;
+        Mat img = imageView(header, pixels);
+        if (!img.empty())
+            imshow("img", img);
+    };
+    // 共享内存中的帧可能在读取期间被写入方覆盖，先拷贝，确认读取完整后再显示
+    vector<UA_Byte> frame;
+    while (waitKey(1) != 27)
+    {
+        if (reader != nullptr)
+        {
+            auto copy = [&](const UA_Byte *data, size_t size, UA_UInt64, UA_DateTime) { frame.assign(data, data + size); };
+            if (reader->consume(copy, 100))
+                show(frame.data(), frame.size());
+        }
+        else
+            channel.consume([&](const UA_Byte *data, size_t size, UA_UInt64) { show(data, size); }, 100);
+    }
+    probe.stop();
+    client.stop();
+    client.setTracer(nullptr);
+    if (reader != nullptr)
+        cout << "received: " << reader->received() << ", skipped: " << reader->skipped() << endl;
+    else
+        cout << "received: " << channel.pushed() << ", dropped: " << channel.dropped() << endl;
+    cout << tracer->summary();
+    cout << probe.summary();
+    if (argc > 1)
+        Trace::flush(argv[1], client.logger());
 
     return 0;
 }
@@ -0,0 +1,48 @@
+/**
+ * @file ua_proxy.cpp
+ * @author zhaoxi (535394140@qq.com)
+ * @brief
+ * @version 1.0
+ * @date 2023-03-22
+ *
+ * @copyright Copyright (c) 2023, zhaoxi
+ *
+ */
+
+#include <cstdlib>
+
+#include "asmpro/opcua_cs/proxy.hpp"
+
+using namespace std;
+using namespace ua;
+
+int main(int argc, char *argv[])
+{
+    // ua_proxy [upstream] [port] [nodes.conf]，HMI 连接代理而不是控制器上的服务器
+    string upstream = argc > 1 ? argv[1] : "opc.tcp://localhost:4840";
+    UA_UInt16 port = argc > 2 ? static_cast<UA_UInt16>(atoi(argv[2])) : 4841;
+
+    Server::init(port);
+    if (!Proxy::connect(upstream))
+        return -1;
+    if (argc > 3)
+        Proxy::loadConfig(argv[3]);
+    else
+    {
+        // 未指定配置文件时镜像 ua_server 中 HMI 常用的节点
+        for (size_t i = 0; i < 4; ++i)
+        {
+            string camera = "VisionServer/Camera[" + to_string(i) + "]/";
+            Proxy::mirrorVariable(camera + "Thumbnail");
+            Proxy::mirrorVariable(camera + "Gain");
+            Proxy::mirrorVariable(camera + "Exposure");
+            Proxy::mirrorMethod(camera + "SetGain");
+            Proxy::mirrorMethod(camera + "SetExposure");
+        }
+        Proxy::mirrorVariable("VisionServer/Camera[1]/Image");
+        Proxy::mirrorMethod("VisionServer/VisionTrigger");
+    }
+    Proxy::start();
+    Server::run();
+    Proxy::stop();
+}
@@ -16,6 +16,7 @@
 #include <opencv2/core.hpp>
 
 #include "asmpro/opcua_cs.hpp"
+#include "asmpro/opcua_cs/image_mat.hpp"
 
 using namespace std;
 using namespace cv;
@@ -162,18 +163,19 @@ void changeImg()
 {
     RNG rng(getTickCount());
     double gain = 0;
+    UA_UInt64 frame = 0;
     while (is_running)
     {
         this_thread::sleep_for(chrono::milliseconds(500));
+        UA_DateTime capture_time = UA_DateTime_now();
         Mat img(Size(640, 480), CV_8UC3, Scalar(rng.uniform(0, 255), rng.uniform(0, 255), rng.uniform(0, 255)));
-        Variable img_val(img.data, &UA_TYPES[UA_TYPES_BYTE], img.cols * img.rows * img.channels());
         gain = gain > 3 ? 0 : gain + 0.01;
         UA_NodeId objects_folder_id = UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER);
         UA_NodeId vision_server_id = Server::findNodeId(objects_folder_id, 1, "VisionServer");
         UA_NodeId camera1_id = Server::findNodeId(vision_server_id, 1, "Camera[1]");
         UA_NodeId image_id = Server::findNodeId(camera1_id, 1, "Image");
         UA_NodeId gain_id = Server::findNodeId(camera1_id, 1, "Gain");
-        Server::writeVariable(image_id, img_val);
+        writeImage(image_id, img, ++frame, capture_time);
         Server::writeVariable(gain_id, static_cast<double>(gain));
     }
 
@@ -183,13 +185,25 @@ void changeImg()
 int main(int argc, char *argv[])
 {
     signal(SIGINT, onStop);
+    // ua_server [trace.json]，指定路径时记录服务器事件循环与回调的追踪区间，退出时导出
+    if (argc > 1)
+        Trace::enable();
 
     Server::init();
-    // Image VariableType
+    // Image VariableType，值为带首部 (尺寸、像素格式、帧计数器、时间戳) 的 ByteString
     Mat img_data(Size(640, 480), CV_8UC3, Scalar(0, 0, 0));
-    VariableType image(img_data.data, &UA_TYPES[UA_TYPES_BYTE], img_data.cols * img_data.rows * img_data.channels());
+    ImageHeader img_header;
+    img_header.format = PixelFormat::BGR8;
+    img_header.width = img_data.cols;
+    img_header.height = img_data.rows;
+    img_header.channels = img_data.channels();
+    vector<UA_Byte> img_buffer;
+    encodeImage(img_header, img_data.data, img_data.step[0], img_buffer);
+    UA_ByteString img_str{img_buffer.size(), img_buffer.data()};
+    VariableType image(&img_str, &UA_TYPES[UA_TYPES_BYTESTRING]);
     UA_NodeId image_id =
-        Server::addVariableTypeNode("ImageType", "Type of the image consisting of BGR888 and Mono8", image);
+        Server::addVariableTypeNode("ImageType", "Type of the image consisting of a header and BGR888 or Mono8 pixels",
+                                    image);
     // VisionDevice ObjectType
     ObjectType vision_device;
     vision_device.add("IP", "0.0.0.0");
@@ -245,14 +259,42 @@ int main(int argc, char *argv[])
     server_outputs.emplace_back("TargetAngle", "Delta angle of the target", &UA_TYPES[UA_TYPES_DOUBLE]);
     Server::addMethodNode("VisionTrigger", "Trigger the specific device to process the vision program",
                           visionTrigger, server_inputs, server_outputs, vision_server_id);
+    Server::addLatencyProbe(vision_server_id);
     // Camera Object
     vector<Object> cameras;
     cameras.reserve(4);
     for (size_t i = 0; i < 4; ++i)
         cameras.push_back(Object(camera));
+    // 仪表盘客户端订阅 160×120 的缩略图，预览仅在有订阅者时生成
+    ImagePreview thumbnail;
+    thumbnail.src_width = img_data.cols;
+    thumbnail.src_height = img_data.rows;
+    thumbnail.src_channels = img_data.channels();
+    thumbnail.width = 160;
+    thumbnail.height = 120;
+    ImagePreview thumbnail_mono = thumbnail;
+    thumbnail_mono.mono = true;
     for (size_t i = 0; i < cameras.size(); ++i)
-        Server::addObjectNode("Camera[" + to_string(i) + "]", "Camera[" + to_string(i) + "]",
-                              cameras[i], camera_id, vision_server_id);
+    {
+        UA_NodeId object_id = Server::addObjectNode("Camera[" + to_string(i) + "]", "Camera[" + to_string(i) + "]",
+                                                    cameras[i], camera_id, vision_server_id);
+        UA_NodeId camera_image_id = Server::findNodeId(object_id, 1, "Image");
+        Server::addImagePreview("Thumbnail", "BGR888 thumbnail of the image", camera_image_id, thumbnail, object_id);
+        Server::addImagePreview("ThumbnailMono", "Mono8 thumbnail of the image", camera_image_id, thumbnail_mono,
+                                object_id);
+        // 远程客户端可订阅压缩后的图像以节省带宽
+        Compression compression;
+        compression.stride = static_cast<UA_UInt32>(img_data.channels());
+        Server::addCompressedVariable("ImageCompressed", "Delta-deflate compressed image", camera_image_id, compression,
+                                      object_id);
+        // 画面大部分静止时，订阅差分变量只传输变化的块
+        Server::addDeltaVariable("ImageDelta", "Dirty-tile delta of the image", camera_image_id, DeltaOptions(),
+                                 object_id);
+        // 静止画面下内容相同的图像不再写入，不触发采样比较与数据变更通知
+        Server::setWriteMode(camera_image_id, WriteMode::SkipUnchanged);
+        // 同一主机上的客户端可通过共享内存通道读取图像
+        Server::addSharedMemoryChannel(camera_image_id, "/ua_camera" + to_string(i) + "_image");
+    }
     // LightController Object
     vector<Object> light_controllers;
     light_controllers.reserve(2);
@@ -264,4 +306,6 @@ int main(int argc, char *argv[])
     thread t1(changeImg);
     t1.detach();
     Server::run();
+    if (argc > 1)
+        Trace::flush(argv[1], Server::logger());
 }